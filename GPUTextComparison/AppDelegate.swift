@@ -19,7 +19,14 @@ class AppDelegate: NSObject, NSApplicationDelegate {
         guard let textViewController = viewController as? TextViewController else {
             fatalError()
         }
-        textViewController.frames = layout()
+        let frames = FrameSource()
+        textViewController.frames = frames
+        if let corpusPath = NSProcessInfo.processInfo().environment["OUTLINE_CORPUS_PATH"] {
+            exportOutlineCorpus(frames, path: corpusPath)
+        }
+        if let streamPath = NSProcessInfo.processInfo().environment["GLYPH_STREAM_PATH"] {
+            exportGlyphStream(frames, path: streamPath)
+        }
         // Insert code here to initialize your application
     }
 
@@ -0,0 +1,294 @@
+//
+//  BandedCurves.cpp
+//  GPUTextComparison
+//
+//  Created by Litherum on 5/30/16.
+//  Copyright © 2016 Litherum. All rights reserved.
+//
+
+#include "BandedCurves.h"
+
+#include "PathSource.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+namespace {
+
+struct Point {
+    double x;
+    double y;
+};
+
+// One glyph's contours, as quadratics sharing end points the way curveTexels does.
+class QuadraticBuilder {
+public:
+    QuadraticBuilder(std::vector<vector_float4>& texels, std::vector<uint32_t>& curves, double cubicTolerance) : texels(texels), curves(curves), cubicTolerance(cubicTolerance) {
+    }
+
+    template <typename PathSource>
+    void build(const PathSource& source) {
+        source.iterate([&](PathElement element) {
+            switch (element.type) {
+            case PathElementMoveToPoint:
+                finishContour();
+                current = begin = { element.points[0].x, element.points[0].y };
+                return;
+            case PathElementAddLineToPoint:
+                addLine({ element.points[0].x, element.points[0].y });
+                return;
+            case PathElementAddQuadCurveToPoint:
+                addQuadratic({ element.points[0].x, element.points[0].y }, { element.points[1].x, element.points[1].y });
+                return;
+            case PathElementAddCurveToPoint:
+                addCubic({ element.points[0].x, element.points[0].y }, { element.points[1].x, element.points[1].y }, { element.points[2].x, element.points[2].y });
+                return;
+            case PathElementCloseSubpath:
+                finishContour();
+                current = begin;
+                return;
+            }
+        });
+        finishContour();
+    }
+
+private:
+    void addQuadratic(Point p1, Point p2) {
+        curves.push_back(static_cast<uint32_t>(texels.size()));
+        texels.push_back(vector_float4 { static_cast<float>(current.x), static_cast<float>(current.y), static_cast<float>(p1.x), static_cast<float>(p1.y) });
+        current = p2;
+        open = true;
+    }
+
+    void addLine(Point p) {
+        if (p.x == current.x && p.y == current.y)
+            return;
+        addQuadratic({ (current.x + p.x) / 2, (current.y + p.y) / 2 }, p);
+    }
+
+    // A quadratic through a cubic's end points, with its end tangents averaged, is off by at most sqrt(3) / 36 of the
+    // cubic's third difference, which shrinks with the cube of the number of pieces.
+    void addCubic(Point p1, Point p2, Point p3) {
+        Point p0 = current;
+        double d3 = std::hypot(p3.x - 3 * p2.x + 3 * p1.x - p0.x, p3.y - 3 * p2.y + 3 * p1.y - p0.y);
+        double pieces = std::ceil(std::cbrt(std::sqrt(3.0) / 36 * d3 / cubicTolerance));
+        unsigned count = static_cast<unsigned>(std::min(std::max(pieces, 1.0), 64.0));
+        auto point = [&](double t) {
+            double s = 1 - t;
+            return Point { s * s * s * p0.x + 3 * s * s * t * p1.x + 3 * s * t * t * p2.x + t * t * t * p3.x, s * s * s * p0.y + 3 * s * s * t * p1.y + 3 * s * t * t * p2.y + t * t * t * p3.y };
+        };
+        auto derivative = [&](double t) {
+            double s = 1 - t;
+            return Point { 3 * (s * s * (p1.x - p0.x) + 2 * s * t * (p2.x - p1.x) + t * t * (p3.x - p2.x)), 3 * (s * s * (p1.y - p0.y) + 2 * s * t * (p2.y - p1.y) + t * t * (p3.y - p2.y)) };
+        };
+        for (unsigned i = 0; i < count; ++i) {
+            double t0 = static_cast<double>(i) / count;
+            double t1 = static_cast<double>(i + 1) / count;
+            double h = (t1 - t0) / 3;
+            Point c0 = current;
+            Point c3 = i + 1 == count ? p3 : point(t1);
+            Point d0 = derivative(t0);
+            Point d1 = derivative(t1);
+            Point c1 = { c0.x + d0.x * h, c0.y + d0.y * h };
+            Point c2 = { c3.x - d1.x * h, c3.y - d1.y * h };
+            addQuadratic({ (3 * (c1.x + c2.x) - c0.x - c3.x) / 4, (3 * (c1.y + c2.y) - c0.y - c3.y) / 4 }, c3);
+        }
+    }
+
+    // Closes the contour with a line, and ends it with a texel holding its end point.
+    void finishContour() {
+        if (!open)
+            return;
+        addLine(begin);
+        texels.push_back(vector_float4 { static_cast<float>(current.x), static_cast<float>(current.y), 0, 0 });
+        open = false;
+    }
+
+    std::vector<vector_float4>& texels;
+    // Where each curve's texel is.
+    std::vector<uint32_t>& curves;
+    double cubicTolerance;
+    Point current { 0, 0 };
+    Point begin { 0, 0 };
+    bool open { false };
+};
+
+struct CurveExtent {
+    uint32_t texel;
+    // Across the rays.
+    float minimum;
+    float maximum;
+    // Along the rays, for sorting.
+    float far;
+};
+
+// Fills in count bands over [minimum, maximum] across the rays. component 0 takes the rays along x, so bands are
+// split on y; component 1 the reverse.
+void addBands(const std::vector<vector_float4>& texels, const std::vector<uint32_t>& curves, unsigned component, float minimum, float maximum, unsigned count, std::vector<CurveExtent>& extents, std::vector<BandedCurveBand>& bands, std::vector<uint32_t>& curveIndices) {
+    extents.clear();
+    for (auto texel : curves) {
+        auto& a = texels[texel];
+        auto& b = texels[texel + 1];
+        float across[3] = { component ? a.x : a.y, component ? a.z : a.w, component ? b.x : b.y };
+        float along[3] = { component ? a.y : a.x, component ? a.w : a.z, component ? b.y : b.x };
+        // Parallel to the rays.
+        if (across[0] == across[1] && across[1] == across[2])
+            continue;
+        extents.push_back({ texel, std::min({ across[0], across[1], across[2] }), std::max({ across[0], across[1], across[2] }), std::max({ along[0], along[1], along[2] }) });
+    }
+    std::sort(extents.begin(), extents.end(), [](const CurveExtent& a, const CurveExtent& b) {
+        return a.far > b.far;
+    });
+    float bandSize = (maximum - minimum) / count;
+    for (unsigned band = 0; band < count; ++band) {
+        float bandMinimum = minimum + band * bandSize;
+        float bandMaximum = band + 1 == count ? maximum : bandMinimum + bandSize;
+        BandedCurveBand result = { 0, static_cast<uint32_t>(curveIndices.size()) };
+        for (auto& extent : extents) {
+            if (extent.maximum < bandMinimum || extent.minimum > bandMaximum)
+                continue;
+            curveIndices.push_back(extent.texel);
+            ++result.curveCount;
+        }
+        bands.push_back(result);
+    }
+}
+
+}
+
+template <typename T>
+static T* copyOut(const std::vector<T>& vector) {
+    if (vector.empty())
+        return nullptr;
+    auto result = static_cast<T*>(malloc(vector.size() * sizeof(T)));
+    memcpy(result, vector.data(), vector.size() * sizeof(T));
+    return result;
+}
+
+void createBandedCurveData(const CGPathRef* paths, size_t count, BandedCurveOptions options, BandedCurveData* result) {
+    std::vector<vector_float4> texels;
+    std::vector<BandedCurveBand> bands;
+    std::vector<uint32_t> curveIndices;
+    std::vector<BandedCurveGlyph> glyphs(count);
+    std::vector<uint32_t> curves;
+    std::vector<CurveExtent> extents;
+    unsigned maximumBandCount = std::max(options.maximumBandCount, 1u);
+
+    for (size_t i = 0; i < count; ++i) {
+        auto& glyph = glyphs[i];
+        glyph.minX = glyph.minY = std::numeric_limits<float>::infinity();
+        glyph.maxX = glyph.maxY = -std::numeric_limits<float>::infinity();
+        glyph.firstBand = static_cast<uint32_t>(bands.size());
+        glyph.horizontalBandCount = glyph.verticalBandCount = 0;
+        if (!paths[i])
+            continue;
+
+        curves.clear();
+        size_t firstTexel = texels.size();
+        QuadraticBuilder(texels, curves, options.cubicTolerance).build(CGPathSource(paths[i]));
+        if (curves.empty())
+            continue;
+        // Every curve lies within its control points.
+        for (size_t t = firstTexel; t < texels.size(); ++t) {
+            glyph.minX = std::min(glyph.minX, texels[t].x);
+            glyph.minY = std::min(glyph.minY, texels[t].y);
+            glyph.maxX = std::max(glyph.maxX, texels[t].x);
+            glyph.maxY = std::max(glyph.maxY, texels[t].y);
+        }
+        for (auto texel : curves) {
+            glyph.minX = std::min(glyph.minX, texels[texel].z);
+            glyph.minY = std::min(glyph.minY, texels[texel].w);
+            glyph.maxX = std::max(glyph.maxX, texels[texel].z);
+            glyph.maxY = std::max(glyph.maxY, texels[texel].w);
+        }
+        unsigned bandCount = static_cast<unsigned>(std::min<size_t>(maximumBandCount, std::max<size_t>(1, curves.size() / 4)));
+        glyph.horizontalBandCount = static_cast<uint16_t>(bandCount);
+        glyph.verticalBandCount = static_cast<uint16_t>(bandCount);
+        addBands(texels, curves, 0, glyph.minY, glyph.maxY, bandCount, extents, bands, curveIndices);
+        addBands(texels, curves, 1, glyph.minX, glyph.maxX, bandCount, extents, bands, curveIndices);
+    }
+
+    result->curveTexels = copyOut(texels);
+    result->curveTexelCount = texels.size();
+    result->bands = copyOut(bands);
+    result->bandCount = bands.size();
+    result->curveIndices = copyOut(curveIndices);
+    result->curveIndexCount = curveIndices.size();
+    result->glyphs = copyOut(glyphs);
+    result->glyphCount = glyphs.size();
+}
+
+void destroyBandedCurveData(BandedCurveData data) {
+    free(data.curveTexels);
+    free(data.bands);
+    free(data.curveIndices);
+    free(data.glyphs);
+}
+
+size_t bandedCurveDataByteCount(const BandedCurveData* data) {
+    return data->curveTexelCount * sizeof(vector_float4) + data->bandCount * sizeof(BandedCurveBand) + data->curveIndexCount * sizeof(uint32_t) + data->glyphCount * sizeof(BandedCurveGlyph);
+}
+
+// The coverage along a ray towards +x from the origin, with the curves already moved so the pixel is at the origin and
+// scaled to pixels. The sign of each end point's y picks which of the two roots cross the ray and which way, from a
+// 16-entry table packed into 0x2E74, so curves that only touch the ray or end on it count exactly once.
+static float rayCoverage(const vector_float4* texels, const uint32_t* indices, uint32_t count, unsigned component, float x, float y, float scale) {
+    float coverage = 0;
+    for (uint32_t i = 0; i < count; ++i) {
+        const vector_float4& a = texels[indices[i]];
+        const vector_float4& b = texels[indices[i] + 1];
+        float p0x = ((component ? a.y : a.x) - x) * scale;
+        float p0y = ((component ? a.x : a.y) - y) * scale;
+        float p1x = ((component ? a.w : a.z) - x) * scale;
+        float p1y = ((component ? a.z : a.w) - y) * scale;
+        float p2x = ((component ? b.y : b.x) - x) * scale;
+        float p2y = ((component ? b.x : b.y) - y) * scale;
+        // Sorted by how far along the ray they reach, so the rest are all behind the pixel.
+        if (std::max({ p0x, p1x, p2x }) < -0.5f)
+            break;
+        unsigned code = (0x2E74u >> ((p0y > 0 ? 2 : 0) + (p1y > 0 ? 4 : 0) + (p2y > 0 ? 8 : 0))) & 3;
+        if (!code)
+            continue;
+        float ax = p0x - 2 * p1x + p2x;
+        float ay = p0y - 2 * p1y + p2y;
+        float bx = p0x - p1x;
+        float by = p0y - p1y;
+        float t1;
+        float t2;
+        if (std::abs(ay) < 1.0f / 65536) {
+            t1 = t2 = p0y / (2 * by);
+        } else {
+            float d = std::sqrt(std::max(by * by - ay * p0y, 0.0f));
+            t1 = (by - d) / ay;
+            t2 = (by + d) / ay;
+        }
+        float x1 = (ax * t1 - 2 * bx) * t1 + p0x;
+        float x2 = (ax * t2 - 2 * bx) * t2 + p0x;
+        if (code & 1)
+            coverage += std::min(std::max(x1 + 0.5f, 0.0f), 1.0f);
+        if (code > 1)
+            coverage -= std::min(std::max(x2 + 0.5f, 0.0f), 1.0f);
+    }
+    return coverage;
+}
+
+float bandedCurveCoverage(const BandedCurveData* data, size_t glyphIndex, float x, float y, float pixelsPerUnit) {
+    auto& glyph = data->glyphs[glyphIndex];
+    if (!glyph.horizontalBandCount)
+        return 0;
+    auto band = [](float position, float minimum, float maximum, unsigned count) {
+        if (!(maximum > minimum))
+            return 0u;
+        int index = static_cast<int>((position - minimum) / (maximum - minimum) * count);
+        return static_cast<unsigned>(std::min(std::max(index, 0), static_cast<int>(count) - 1));
+    };
+    auto& horizontal = data->bands[glyph.firstBand + band(y, glyph.minY, glyph.maxY, glyph.horizontalBandCount)];
+    auto& vertical = data->bands[glyph.firstBand + glyph.horizontalBandCount + band(x, glyph.minX, glyph.maxX, glyph.verticalBandCount)];
+    float xCoverage = rayCoverage(data->curveTexels, data->curveIndices + horizontal.firstCurveIndex, horizontal.curveCount, 0, x, y, pixelsPerUnit);
+    float yCoverage = rayCoverage(data->curveTexels, data->curveIndices + vertical.firstCurveIndex, vertical.curveCount, 1, y, x, pixelsPerUnit);
+    return std::min((std::abs(xCoverage) + std::abs(yCoverage)) / 2, 1.0f);
+}
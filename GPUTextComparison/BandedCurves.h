@@ -0,0 +1,87 @@
+//
+//  BandedCurves.h
+//  GPUTextComparison
+//
+//  Created by Litherum on 5/30/16.
+//  Copyright © 2016 Litherum. All rights reserved.
+//
+
+#ifndef BandedCurves_h
+#define BandedCurves_h
+
+#include <CoreGraphics/CoreGraphics.h>
+#include <simd/simd.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Glyph outlines as data for a renderer that needs no triangulation: each glyph is drawn as its bounding quad, and
+// each pixel finds its coverage from the curves a ray from it crosses, as in Lengyel's Slug. Every curve is a quadratic
+// Bézier: lines get their midpoint as the control point, and cubics are split into quadratics within cubicTolerance.
+//
+// To keep the curves a pixel looks at few, each glyph is cut into horizontal bands, for rays towards +x, and vertical
+// bands, for rays towards +y. A band lists the curves that reach into it, nearest the far end of the ray first, so a
+// pixel can stop at the first curve that's wholly behind it. Curves parallel to a band's rays never cross them, so
+// they're left out.
+//
+// Everything is flat arrays that can be uploaded as they are:
+// - curveTexels: a contour of n curves is n + 1 texels. Texel i is (p0, p1) of curve i, and curve i's p2 is texel
+//   i + 1's xy, so the last texel of a contour holds only its end point. Positions are in path units.
+// - bands: (curve count, first entry in curveIndices), horizontal bands of a glyph bottom to top, then vertical bands
+//   left to right.
+// - curveIndices: indices into curveTexels.
+typedef struct BandedCurveBand {
+    uint32_t curveCount;
+    uint32_t firstCurveIndex;
+} BandedCurveBand;
+
+typedef struct BandedCurveGlyph {
+    // The quad to draw, which bounds every curve, in path units. Empty glyphs have minX > maxX.
+    float minX;
+    float minY;
+    float maxX;
+    float maxY;
+    uint32_t firstBand;
+    uint16_t horizontalBandCount;
+    uint16_t verticalBandCount;
+} BandedCurveGlyph;
+
+typedef struct BandedCurveData {
+    vector_float4* curveTexels;
+    size_t curveTexelCount;
+    BandedCurveBand* bands;
+    size_t bandCount;
+    uint32_t* curveIndices;
+    size_t curveIndexCount;
+    BandedCurveGlyph* glyphs;
+    size_t glyphCount;
+} BandedCurveData;
+
+typedef struct BandedCurveOptions {
+    // In path units.
+    CGFloat cubicTolerance;
+    // Per direction. A glyph gets about one band per 4 curves, up to this many.
+    unsigned maximumBandCount;
+} BandedCurveOptions;
+
+// glyphs[i] is for paths[i]. A NULL path makes an empty glyph. Release the result with destroyBandedCurveData().
+void createBandedCurveData(const CGPathRef* paths, size_t count, BandedCurveOptions, BandedCurveData*);
+void destroyBandedCurveData(BandedCurveData);
+
+// The total size of the arrays.
+size_t bandedCurveDataByteCount(const BandedCurveData*);
+
+// What a pixel centered at (x, y), in path units, of a glyph drawn at pixelsPerUnit would get, with nonzero filling:
+// the average of the horizontal and vertical rays' coverage, each crossing counting for as much of its pixel as lies
+// inside it. Runs the same steps a fragment shader would.
+float bandedCurveCoverage(const BandedCurveData*, size_t glyph, float x, float y, float pixelsPerUnit);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BandedCurves_h */
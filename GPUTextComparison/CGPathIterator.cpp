@@ -17,7 +17,3 @@ static void applyCallback(void *info, const CGPathElement *element) {
 void iterateCGPath(CGPathRef path, CGPathIterator iterator) {
     CGPathApply(path, &iterator, &applyCallback<CGPathIterator>);
 }
-
-void iterateCGPath(CGPathRef path, std::function<void(CGPathElement)> function) {
-    CGPathApply(path, &function, &applyCallback<std::function<void(CGPathElement)>>);
-}
@@ -12,16 +12,15 @@
 #import <CoreGraphics/CoreGraphics.h>
 
 #ifdef __cplusplus
-#import <functional>
 extern "C" {
 #endif
 
+// For Swift. C++ should use CGPathSource, from PathSource.h, which doesn't go through a block.
 typedef void (^CGPathIterator)(CGPathElement);
 void iterateCGPath(CGPathRef, CGPathIterator);
 
 #ifdef __cplusplus
 }
-void iterateCGPath(CGPathRef, std::function<void(CGPathElement)>);
 #endif
 
 #endif /* CGPathIterator_h */
@@ -0,0 +1,182 @@
+//
+//  CompactMesh.cpp
+//  GPUTextComparison
+//
+//  Created by Litherum on 5/22/16.
+//  Copyright © 2016 Litherum. All rights reserved.
+//
+
+#include "CompactMesh.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+uint16_t halfFromFloat(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    uint16_t sign = (bits >> 16) & 0x8000;
+    uint32_t magnitude = bits & 0x7fffffff;
+    // Infinities and NaNs, keeping NaNs NaN.
+    if (magnitude >= 0x7f800000)
+        return sign | 0x7c00 | (magnitude > 0x7f800000 ? 0x200 : 0);
+    // 65520 and up round to infinity.
+    if (magnitude >= 0x477ff000)
+        return sign | 0x7c00;
+    // Below half's smallest normal, 2^-14, the result is a multiple of 2^-24.
+    if (magnitude < 0x38800000) {
+        if (magnitude < 0x33000000)
+            return sign;
+        uint32_t exponent = magnitude >> 23;
+        uint32_t mantissa = (magnitude & 0x7fffff) | 0x800000;
+        uint32_t shift = 126 - exponent;
+        uint32_t result = mantissa >> shift;
+        uint32_t remainder = mantissa & ((1u << shift) - 1);
+        uint32_t halfway = 1u << (shift - 1);
+        if (remainder > halfway || (remainder == halfway && (result & 1)))
+            ++result;
+        return sign | result;
+    }
+    // Rebias the exponent from 127 to 15 and round to nearest even. A carry out of the mantissa correctly bumps the
+    // exponent.
+    uint32_t result = (magnitude >> 13) - (112 << 10);
+    uint32_t remainder = magnitude & 0x1fff;
+    if (remainder > 0x1000 || (remainder == 0x1000 && (result & 1)))
+        ++result;
+    return sign | result;
+}
+
+float floatFromHalf(uint16_t half) {
+    uint32_t sign = static_cast<uint32_t>(half & 0x8000) << 16;
+    uint32_t exponent = (half >> 10) & 0x1f;
+    uint32_t mantissa = half & 0x3ff;
+    if (!exponent) {
+        float value = std::ldexp(static_cast<float>(mantissa), -24);
+        return sign ? -value : value;
+    }
+    uint32_t bits = exponent == 0x1f ? sign | 0x7f800000 | (mantissa << 13) : sign | ((exponent + 112) << 23) | (mantissa << 13);
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+static int16_t clampToInt16(float value) {
+    return static_cast<int16_t>(std::max(-32767.f, std::min(32767.f, std::round(value))));
+}
+
+void createCompactCubicTriangleMesh(const IndexedCubicTriangleMesh* mesh, float unitsPerPathUnit, CompactCubicTriangleMesh* result) {
+    *result = { nullptr, nullptr, 0, nullptr, 0, unitsPerPathUnit };
+    if (!mesh->vertexCount)
+        return;
+
+    float extent = 0;
+    for (size_t i = 0; i < mesh->vertexCount; ++i)
+        extent = std::max(extent, std::max(std::abs(mesh->positions[i].x), std::abs(mesh->positions[i].y)));
+    if (extent * unitsPerPathUnit > 32767)
+        result->unitsPerPathUnit = 32767 / extent;
+
+    result->positions = static_cast<int16_t*>(malloc(mesh->vertexCount * 2 * sizeof(int16_t)));
+    result->coefficients = static_cast<uint16_t*>(malloc(mesh->vertexCount * 4 * sizeof(uint16_t)));
+    result->vertexCount = mesh->vertexCount;
+    for (size_t i = 0; i < mesh->vertexCount; ++i) {
+        result->positions[i * 2] = clampToInt16(mesh->positions[i].x * result->unitsPerPathUnit);
+        result->positions[i * 2 + 1] = clampToInt16(mesh->positions[i].y * result->unitsPerPathUnit);
+        result->coefficients[i * 4] = halfFromFloat(mesh->coefficients[i].x);
+        result->coefficients[i * 4 + 1] = halfFromFloat(mesh->coefficients[i].y);
+        result->coefficients[i * 4 + 2] = halfFromFloat(mesh->coefficients[i].z);
+        result->coefficients[i * 4 + 3] = 0;
+    }
+    result->indices = static_cast<uint16_t*>(malloc(mesh->indexCount * sizeof(uint16_t)));
+    result->indexCount = mesh->indexCount;
+    memcpy(result->indices, mesh->indices, mesh->indexCount * sizeof(uint16_t));
+}
+
+void destroyCompactCubicTriangleMesh(CompactCubicTriangleMesh mesh) {
+    free(mesh.positions);
+    free(mesh.coefficients);
+    free(mesh.indices);
+}
+
+namespace {
+
+struct Implicit {
+    double k, l, m;
+
+    double value() const {
+        return k * k * k - l * m;
+    }
+};
+
+// The gradient of k across a triangle, from its values at the corners.
+struct PlaneGradient {
+    bool compute(vector_float2 p0, vector_float2 p1, vector_float2 p2) {
+        e1x = p1.x - p0.x;
+        e1y = p1.y - p0.y;
+        e2x = p2.x - p0.x;
+        e2y = p2.y - p0.y;
+        determinant = e1x * e2y - e1y * e2x;
+        return determinant != 0;
+    }
+
+    void operator()(double v0, double v1, double v2, double& x, double& y) const {
+        x = ((v1 - v0) * e2y - (v2 - v0) * e1y) / determinant;
+        y = ((v2 - v0) * e1x - (v1 - v0) * e2x) / determinant;
+    }
+
+    double e1x, e1y, e2x, e2y, determinant;
+};
+
+}
+
+CompactMeshError measureCompactMeshError(const IndexedCubicTriangleMesh& original, const CompactCubicTriangleMesh& compact, unsigned subdivisions) {
+    CompactMeshError error;
+    for (size_t i = 0; i < original.vertexCount; ++i) {
+        double dx = compact.positions[i * 2] / compact.unitsPerPathUnit - original.positions[i].x;
+        double dy = compact.positions[i * 2 + 1] / compact.unitsPerPathUnit - original.positions[i].y;
+        error.maximumPositionError = std::max(error.maximumPositionError, std::sqrt(dx * dx + dy * dy));
+    }
+
+    subdivisions = std::max(subdivisions, 1u);
+    for (size_t t = 0; t + 2 < original.indexCount; t += 3) {
+        Implicit exact[3];
+        Implicit quantized[3];
+        for (unsigned j = 0; j < 3; ++j) {
+            auto v = original.indices[t + j];
+            exact[j] = { original.coefficients[v].x, original.coefficients[v].y, original.coefficients[v].z };
+            quantized[j] = { floatFromHalf(compact.coefficients[v * 4]), floatFromHalf(compact.coefficients[v * 4 + 1]), floatFromHalf(compact.coefficients[v * 4 + 2]) };
+        }
+        PlaneGradient gradient;
+        bool hasArea = gradient.compute(original.positions[original.indices[t]], original.positions[original.indices[t + 1]], original.positions[original.indices[t + 2]]);
+        double kx = 0, ky = 0, lx = 0, ly = 0, mx = 0, my = 0;
+        if (hasArea) {
+            gradient(exact[0].k, exact[1].k, exact[2].k, kx, ky);
+            gradient(exact[0].l, exact[1].l, exact[2].l, lx, ly);
+            gradient(exact[0].m, exact[1].m, exact[2].m, mx, my);
+        }
+
+        for (unsigned a = 0; a <= subdivisions; ++a) {
+            for (unsigned b = 0; a + b <= subdivisions; ++b) {
+                double w1 = static_cast<double>(a) / subdivisions;
+                double w2 = static_cast<double>(b) / subdivisions;
+                double w0 = 1 - w1 - w2;
+                auto interpolate = [&](const Implicit* corners) {
+                    return Implicit { w0 * corners[0].k + w1 * corners[1].k + w2 * corners[2].k, w0 * corners[0].l + w1 * corners[1].l + w2 * corners[2].l, w0 * corners[0].m + w1 * corners[1].m + w2 * corners[2].m };
+                };
+                Implicit reference = interpolate(exact);
+                ++error.samples;
+                if ((reference.value() <= 0) == (interpolate(quantized).value() <= 0))
+                    continue;
+                ++error.signMismatches;
+                if (!hasArea)
+                    continue;
+                double gx = 3 * reference.k * reference.k * kx - reference.m * lx - reference.l * mx;
+                double gy = 3 * reference.k * reference.k * ky - reference.m * ly - reference.l * my;
+                double length = std::sqrt(gx * gx + gy * gy);
+                if (length > 0)
+                    error.maximumMismatchDistance = std::max(error.maximumMismatchDistance, std::abs(reference.value()) / length);
+            }
+        }
+    }
+    return error;
+}
@@ -0,0 +1,74 @@
+//
+//  CompactMesh.h
+//  GPUTextComparison
+//
+//  Created by Litherum on 5/22/16.
+//  Copyright © 2016 Litherum. All rights reserved.
+//
+
+#ifndef CompactMesh_h
+#define CompactMesh_h
+
+#include <CoreGraphics/CoreGraphics.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "IndexedMesh.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// An IndexedCubicTriangleMesh in 12 bytes per vertex instead of 24:
+// - positions: two int16s per vertex, in units of 1 / unitsPerPathUnit path units. For a glyph path from
+//   CTFontCreatePathForGlyph(), unitsPerPathUnit = unitsPerEm / pointSize makes these font units.
+// - coefficients: four IEEE half floats per vertex, k, l and m, then an unused 0.
+//
+// Error analysis:
+// - Positions round to the nearest unit, so each moves at most half a unit on each axis. TrueType outlines are
+//   already on that grid, so only subdivision points move at all. A vertex shared by two triangles rounds the same
+//   way for both of them, so no cracks open up.
+// - Half floats keep 11 significant bits, so each coefficient gains a relative error of at most e = 2^-11. Triangulator
+//   normalizes the curve's d1, d2 and d3, so coefficients are within a few units of 0 and stay far from half's
+//   range limits; 0 and 1, which interior vertices use, are exact. After interpolation with barycentric weights, k
+//   is off by at most e * K, where K is the largest |k| among the triangle's vertices, and likewise for l and m.
+//   So k^3 - l*m is off by at most about e * (3 * K^3 + 2 * L * M), and the sign test can only change where
+//   k^3 - l*m is already smaller than that. That is a band around the curve whose width is that bound divided by
+//   the gradient of k^3 - l*m. measureCompactMeshError() finds the widest such band by sampling.
+typedef struct CompactCubicTriangleMesh {
+    int16_t* positions;
+    uint16_t* coefficients;
+    size_t vertexCount;
+    uint16_t* indices;
+    size_t indexCount;
+    float unitsPerPathUnit;
+} CompactCubicTriangleMesh;
+
+// If a position would overflow int16 at unitsPerPathUnit, the mesh uses the largest scale that fits instead; the
+// result's unitsPerPathUnit says which scale was used. Must be released with destroyCompactCubicTriangleMesh().
+void createCompactCubicTriangleMesh(const IndexedCubicTriangleMesh*, float unitsPerPathUnit, CompactCubicTriangleMesh*);
+void destroyCompactCubicTriangleMesh(CompactCubicTriangleMesh);
+
+
+uint16_t halfFromFloat(float);
+float floatFromHalf(uint16_t);
+
+#ifdef __cplusplus
+}
+
+struct CompactMeshError {
+    // In path units.
+    double maximumPositionError { 0 };
+    size_t samples { 0 };
+    // Samples where the shader's k^3 - l*m <= 0 test comes out differently with the half coefficients.
+    size_t signMismatches { 0 };
+    // The farthest any mismatch is from the curve, in path units, to first order: |k^3 - l*m| over its gradient.
+    double maximumMismatchDistance { 0 };
+};
+
+// Samples every triangle of compact at subdivisions + 1 points per edge, comparing it against original, which it was
+// made from.
+CompactMeshError measureCompactMeshError(const IndexedCubicTriangleMesh& original, const CompactCubicTriangleMesh& compact, unsigned subdivisions);
+#endif
+
+#endif /* CompactMesh_h */
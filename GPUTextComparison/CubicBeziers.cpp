@@ -7,54 +7,21 @@
 //
 
 #include "CubicBeziers.h"
+#include "CubicClassification.h"
+#include "CubicHull.h"
+#include "TriangulationStats.h"
+#include <algorithm>
 #include <array>
+#include <tuple>
 
 #pragma clang diagnostic push
 #pragma clang diagnostic ignored "-Wconditional-uninitialized"
 #pragma clang diagnostic ignored "-Wshift-negative-value"
 #pragma clang diagnostic ignored "-Wshorten-64-to-32"
 #include <CGAL/Exact_predicates_inexact_constructions_kernel.h>
-#include <CGAL/Triangulation_vertex_base_with_info_2.h>
-#include <CGAL/Delaunay_triangulation_2.h>
 #pragma clang diagnostic pop
 
-struct CoefficientTriple {
-    CGFloat k;
-    CGFloat l;
-    CGFloat m;
-};
-
 typedef CGAL::Exact_predicates_inexact_constructions_kernel K;
-typedef CGAL::Triangulation_vertex_base_with_info_2<CoefficientTriple, K> Vb;
-typedef CGAL::Triangulation_face_base_2<K> Fb;
-typedef CGAL::Triangulation_data_structure_2<Vb, Fb> TDS;
-typedef CGAL::Delaunay_triangulation_2<K, TDS> Triangulation;
-
-struct Coefficients {
-    CoefficientTriple c0;
-    CoefficientTriple c1;
-    CoefficientTriple c2;
-    CoefficientTriple c3;
-    bool flip;
-};
-
-struct CubicCurve {
-    CGPoint p0;
-    CGPoint p1;
-    CGPoint p2;
-    CGPoint p3;
-    Coefficients c;
-};
-
-static Coefficients lineOrPoint(CGFloat d1, CGFloat d2, CGFloat d3) {
-    return {
-        { 0, 0, 0 },
-        { 0, 0, 0 },
-        { 0, 0, 0 },
-        { 0, 0, 0 },
-        false
-    };
-}
 
 static Coefficients quadratic(CGFloat d1, CGFloat d2, CGFloat d3) {
     return {
@@ -87,7 +54,7 @@ static inline CGFloat roundToZero(CGFloat x) {
     return x;
 }
 
-static inline boost::optional<std::array<CGFloat, 3>> computeDs(CGPoint p0, CGPoint p1, CGPoint p2, CGPoint p3) {
+static inline boost::optional<std::tuple<CGFloat, CGFloat, CGFloat>> computeDs(CGPoint p0, CGPoint p1, CGPoint p2, CGPoint p3) {
     CGAL::Vector_3<K> b0(p0.x, p0.y, 1);
     CGAL::Vector_3<K> b1(p1.x, p1.y, 1);
     CGAL::Vector_3<K> b2(p2.x, p2.y, 1);
@@ -101,7 +68,7 @@ static inline boost::optional<std::array<CGFloat, 3>> computeDs(CGPoint p0, CGPo
     CGFloat d3 = 3 * a3;
 
     if (roundToZero(d1) == 0 && roundToZero(d2) == 0 && roundToZero(d3) == 0)
-        return boost::none_t();
+        return boost::none;
 
     CGAL::Vector_3<K> u(d1, d2, d3);
     u = u / std::sqrt(u.squared_length());
@@ -113,7 +80,7 @@ static inline boost::optional<std::array<CGFloat, 3>> computeDs(CGPoint p0, CGPo
     d2 = roundToZero(d2);
     d3 = roundToZero(d3);
 
-    return { { d1, d2, d3 } };
+    return std::make_tuple(d1, d2, d3);
 }
 
 static inline CGPoint subdivide(CGFloat t, CGPoint a, CGPoint b) {
@@ -131,13 +98,16 @@ static inline std::array<std::array<CGPoint, 4>, 2> subdivide(CGFloat t, CGPoint
     return {{ { p0, ab, abc, abcd }, { abcd, bcd, cd, p3 } }};
 }
 
-static inline std::array<CGFloat, 4> loopParameters(CGFloat d1, CGFloat d2, CGFloat d3) {
-    CGFloat ls = d2 - std::sqrt(4 * d1 * d3 - 3 * d2 * d2);
+static inline std::tuple<CGFloat, CGFloat, CGFloat, CGFloat> loopParameters(CGFloat d1, CGFloat d2, CGFloat d3) {
+    // Positive for a loop, but a nearly straight half of one can round (see roundToZero()) to just below zero, which
+    // would make every coefficient NaN. Zero is the cusp it's closest to.
+    CGFloat root = std::sqrt(std::max<CGFloat>(4 * d1 * d3 - 3 * d2 * d2, 0));
+    CGFloat ls = d2 - root;
     CGFloat lt = 2 * d1;
-    CGFloat ms = d2 + std::sqrt(4 * d1 * d3 - 3 * d2 * d2);
+    CGFloat ms = d2 + root;
     CGFloat mt = 2 * d1;
 
-    return { ls, lt, ms, mt };
+    return std::make_tuple(ls, lt, ms, mt);
 }
 
 template <typename T>
@@ -157,7 +127,7 @@ static inline Coefficients loopCoefficients(CGFloat d1, CGFloat ls, CGFloat lt,
     return result;
 }
 
-static std::vector<CubicCurve> loop(CGFloat d1, CGFloat d2, CGFloat d3, CGPoint p0, CGPoint p1, CGPoint p2, CGPoint p3, CubicFaceReceiver receiver) {
+static unsigned loop(CGFloat d1, CGFloat d2, CGFloat d3, CGPoint p0, CGPoint p1, CGPoint p2, CGPoint p3, std::array<CubicCurve, 2>& curves) {
     CGFloat ls, lt, ms, mt;
     std::tie(ls, lt, ms, mt) = loopParameters(d1, d2, d3);
 
@@ -168,20 +138,25 @@ static std::vector<CubicCurve> loop(CGFloat d1, CGFloat d2, CGFloat d3, CGPoint
     if (c0 || c1) {
         // We need to subdivide.
         // This is a huge layering violation, but I think it's better than recursion. Maybe we should pass a signal up instead?
+        countTriangulation(&TriangulationStats::subdivisions);
         auto t = c0 ? t0 : t1;
         auto subdivided = subdivide(t, p0, p1, p2, p3);
-        std::tie(d1, d2, d3) = computeDs(subdivided[0][0], subdivided[0][1], subdivided[0][2], subdivided[0][3]).value();
-        std::tie(ls, lt, ms, mt) = loopParameters(d1, d2, d3);
-        auto coefficients1 = loopCoefficients(d1, ls, lt, ms, mt);
-        std::tie(d1, d2, d3) = computeDs(subdivided[1][0], subdivided[1][1], subdivided[1][2], subdivided[1][3]).value();
-        std::tie(ls, lt, ms, mt) = loopParameters(d1, d2, d3);
-        auto coefficients2 = loopCoefficients(d1, ls, lt, ms, mt);
-
-        return { { subdivided[0][0], subdivided[0][1], subdivided[0][2], subdivided[0][3], coefficients1 },
-            { subdivided[1][0], subdivided[1][1], subdivided[1][2], subdivided[1][3], coefficients2 } };
+        // A half can come out with all its control points on a line, say when two of them coincide. It has nothing
+        // to draw, so it's dropped.
+        unsigned count = 0;
+        for (auto& half : subdivided) {
+            auto ds = computeDs(half[0], half[1], half[2], half[3]);
+            if (!ds)
+                continue;
+            std::tie(d1, d2, d3) = ds.value();
+            std::tie(ls, lt, ms, mt) = loopParameters(d1, d2, d3);
+            curves[count++] = { half[0], half[1], half[2], half[3], loopCoefficients(d1, ls, lt, ms, mt) };
+        }
+        return count;
     }
 
-    return { { p0, p1, p2, p3, loopCoefficients(d1, ls, lt, ms, mt) } };
+    curves[0] = { p0, p1, p2, p3, loopCoefficients(d1, ls, lt, ms, mt) };
+    return 1;
 }
 
 static Coefficients cusp(CGFloat d1, CGFloat d2, CGFloat d3) {
@@ -196,76 +171,156 @@ static Coefficients cusp(CGFloat d1, CGFloat d2, CGFloat d3) {
     };
 }
 
-static inline CubicVertex convertTriangulatedVertex(Triangulation::Vertex& v) {
-    auto& point = v.point();
-    auto& info = v.info();
-    return { CGPointMake(point.x(), point.y()),
-        { static_cast<float>(info.k), static_cast<float>(info.l), static_cast<float>(info.m) },
-        -1 };
+static inline CGFloat orientation(CGPoint a, CGPoint b, CGPoint c) {
+    return (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
 }
 
-// FIXME: This might not work if some points are duplicated.
-static inline Triangulation::Vertex_handle toInside(Triangulation::Vertex_handle initial, Triangulation::Vertex_handle v1, Triangulation::Vertex_handle v2, Triangulation::Vertex_handle v3) {
-    auto circulatorBase = initial->incident_edges();
-    auto circulator = circulatorBase;
-    do {
-        auto neighbor = circulator->first->vertex((circulator->second + 1) % 3);
-        assert(circulator->first->vertex((circulator->second + 2) % 3) == initial);
-        assert(neighbor != initial);
-        auto k = neighbor->info().k;
-        auto l = neighbor->info().l;
-        auto m = neighbor->info().m;
-        if (k * k * k - l * m > 0) {
-            ++circulator;
-            continue;
-        }
-        if (neighbor == v1 || neighbor == v2)
-            return neighbor;
-        ++circulator;
-    } while (circulator != circulatorBase);
-    return v3;
+// Positive if d is inside the circumcircle of the counterclockwise triangle abc.
+static inline CGFloat inCircle(CGPoint a, CGPoint b, CGPoint c, CGPoint d) {
+    CGFloat adx = a.x - d.x, ady = a.y - d.y;
+    CGFloat bdx = b.x - d.x, bdy = b.y - d.y;
+    CGFloat cdx = c.x - d.x, cdy = c.y - d.y;
+    return (adx * adx + ady * ady) * (bdx * cdy - cdx * bdy)
+        + (bdx * bdx + bdy * bdy) * (cdx * ady - adx * cdy)
+        + (cdx * cdx + cdy * cdy) * (adx * bdy - bdx * ady);
 }
 
-static inline int index(std::vector<Triangulation::Vertex_handle>& order, Triangulation::Vertex_handle test) {
-    for (int i = 0; i < order.size(); ++i) {
-        if (order[i] == test)
-            return i;
+// The Delaunay triangulation of the control points, worked out directly instead of by building a CGAL
+// triangulation for every curve. Nothing here touches the heap. It matches CGAL's Delaunay_triangulation_2 vertex for
+// vertex (TriangulationBenchmark checks), including how CGAL merges duplicate points (the later point's coefficients
+// win). The two places CGAL's answer depends on its internals are reported through ambiguous: four cocircular points,
+// where either diagonal is Delaunay, and two inside neighbors of a border vertex, where CGAL takes whichever its edge
+// circulator reaches first. alternative makes the other choice at each of those: bit 0 for the diagonal, and bits 1
+// and 2 for the first and second steps of the inside border walk.
+HullTriangulation triangulateHull(const CubicCurve& s, bool* ambiguous, unsigned alternative) {
+    assert(!s.c.flip);
+
+    const std::array<CGPoint, 4> inputPoints = {{ s.p0, s.p1, s.p2, s.p3 }};
+    const std::array<CoefficientTriple, 4> inputInfo = {{ s.c.c0, s.c.c1, s.c.c2, s.c.c3 }};
+    std::array<CGPoint, 4> points;
+    std::array<CoefficientTriple, 4> info;
+    std::array<unsigned, 4> handle;
+    unsigned vertexCount = 0;
+    for (unsigned i = 0; i < 4; ++i) {
+        unsigned j = 0;
+        while (j < vertexCount && !CGPointEqualToPoint(points[j], inputPoints[i]))
+            ++j;
+        if (j == vertexCount)
+            points[vertexCount++] = inputPoints[i];
+        info[j] = inputInfo[i];
+        handle[i] = j;
     }
-    return -1;
-}
 
-static inline std::vector<std::array<CubicVertex, 3>> triangulate(CubicCurve s) {
-    assert(!s.c.flip);
+    std::array<std::array<unsigned, 3>, 3> faces;
+    unsigned faceCount = 0;
+    std::array<std::array<unsigned char, 4>, 4> edgeFaceCount = {};
+    auto addFace = [&](unsigned a, unsigned b, unsigned c) {
+        CGFloat o = orientation(points[a], points[b], points[c]);
+        if (o == 0)
+            return;
+        if (o < 0)
+            std::swap(b, c);
+        faces[faceCount++] = {{ a, b, c }};
+        ++edgeFaceCount[a][b]; ++edgeFaceCount[b][a];
+        ++edgeFaceCount[b][c]; ++edgeFaceCount[c][b];
+        ++edgeFaceCount[c][a]; ++edgeFaceCount[a][c];
+    };
 
-    Triangulation t;
-    auto v0 = t.insert(Triangulation::Point(s.p0.x, s.p0.y));
-    v0->info() = { s.c.c0.k, s.c.c0.l, s.c.c0.m };
-    auto v1 = t.insert(Triangulation::Point(s.p1.x, s.p1.y));
-    v1->info() = { s.c.c1.k, s.c.c1.l, s.c.c1.m };
-    auto v2 = t.insert(Triangulation::Point(s.p2.x, s.p2.y));
-    v2->info() = { s.c.c2.k, s.c.c2.l, s.c.c2.m };
-    auto v3 = t.insert(Triangulation::Point(s.p3.x, s.p3.y));
-    v3->info() = { s.c.c3.k, s.c.c3.l, s.c.c3.m };
-
-    std::vector<Triangulation::Vertex_handle> insideBorder = { v0 };
-    auto nextInside = toInside(v0, v1, v2, v3);
-    insideBorder.push_back(nextInside);
-    if (nextInside != v3) {
-        nextInside = toInside(nextInside, v1, v2, v3);
-        insideBorder.push_back(nextInside);
-        if (nextInside != v3)
-            insideBorder.push_back(v3);
+    if (vertexCount == 3)
+        addFace(0, 1, 2);
+    else if (vertexCount == 4) {
+        // If one point is inside (or on an edge of) the triangle of the other three, the only triangulation is the
+        // fan around it. This also covers three collinear points.
+        bool fanned = false;
+        for (unsigned i = 0; i < 4 && !fanned; ++i) {
+            unsigned j = (i + 1) % 4, k = (i + 2) % 4, l = (i + 3) % 4;
+            CGFloat o = orientation(points[j], points[k], points[l]);
+            if (o == 0)
+                continue;
+            if (orientation(points[j], points[k], points[i]) * o < 0 || orientation(points[k], points[l], points[i]) * o < 0 || orientation(points[l], points[j], points[i]) * o < 0)
+                continue;
+            addFace(i, j, k);
+            addFace(i, k, l);
+            addFace(i, l, j);
+            fanned = true;
+        }
+
+        // Otherwise the points are in convex position, and the Delaunay diagonal is the one whose opposite point
+        // is outside the other triangle's circumcircle. If all four are collinear, neither loop adds anything.
+        static const unsigned cycles[3][4] = { { 0, 1, 2, 3 }, { 0, 2, 1, 3 }, { 0, 1, 3, 2 } };
+        for (unsigned i = 0; i < 3 && !fanned; ++i) {
+            unsigned a = cycles[i][0], b = cycles[i][1], c = cycles[i][2], d = cycles[i][3];
+            if (orientation(points[a], points[c], points[b]) * orientation(points[a], points[c], points[d]) >= 0
+                || orientation(points[b], points[d], points[a]) * orientation(points[b], points[d], points[c]) >= 0)
+                continue;
+            if (orientation(points[a], points[b], points[c]) < 0)
+                std::swap(b, d);
+            CGFloat circle = inCircle(points[a], points[b], points[c], points[d]);
+            if (circle == 0 && ambiguous)
+                *ambiguous = true;
+            if (circle == 0 && (alternative & HullAlternativeDiagonal))
+                circle = 1;
+            if (circle > 0) {
+                addFace(a, b, d);
+                addFace(b, c, d);
+            } else {
+                addFace(a, b, c);
+                addFace(a, c, d);
+            }
+            fanned = true;
+        }
     }
 
-    std::vector<std::array<CubicVertex, 3>> result;
-    for (auto i = t.finite_faces_begin(); i != t.finite_faces_end(); ++i) {
-        auto resultV0 = convertTriangulatedVertex(*i->vertex(0));
-        auto resultV1 = convertTriangulatedVertex(*i->vertex(1));
-        auto resultV2 = convertTriangulatedVertex(*i->vertex(2));
-        resultV0.order = index(insideBorder, i->vertex(0));
-        resultV1.order = index(insideBorder, i->vertex(1));
-        resultV2.order = index(insideBorder, i->vertex(2));
-        result.push_back({ resultV0, resultV1, resultV2 });
+    // Steps from initial to a neighbor among p1 and p2 with k^3 <= lm, or to p3 if there isn't one, the way the CGAL
+    // version in TriangulationBenchmark circulates its edges.
+    auto toInside = [&](unsigned initial, bool otherCandidate) {
+        std::array<unsigned, 2> candidates;
+        unsigned candidateCount = 0;
+        for (unsigned i = 1; i <= 2; ++i) {
+            unsigned v = handle[i];
+            auto& c = info[v];
+            if (!edgeFaceCount[initial][v] || c.k * c.k * c.k - c.l * c.m > 0 || (candidateCount && candidates[0] == v))
+                continue;
+            candidates[candidateCount++] = v;
+        }
+        if (!candidateCount)
+            return handle[3];
+        if (candidateCount == 2) {
+            if (ambiguous)
+                *ambiguous = true;
+            // Prefer walking along the hull.
+            bool second = edgeFaceCount[initial][candidates[0]] != 1 && edgeFaceCount[initial][candidates[1]] == 1;
+            return candidates[second != otherCandidate];
+        }
+        return candidates[0];
+    };
+
+    std::array<unsigned, 4> insideBorder;
+    unsigned insideBorderLength = 0;
+    insideBorder[insideBorderLength++] = handle[0];
+    auto nextInside = toInside(handle[0], alternative & HullAlternativeFirstStep);
+    insideBorder[insideBorderLength++] = nextInside;
+    if (nextInside != handle[3]) {
+        nextInside = toInside(nextInside, alternative & HullAlternativeSecondStep);
+        insideBorder[insideBorderLength++] = nextInside;
+        if (nextInside != handle[3])
+            insideBorder[insideBorderLength++] = handle[3];
+    }
+
+    HullTriangulation result;
+    result.count = faceCount;
+    for (unsigned i = 0; i < faceCount; ++i) {
+        for (unsigned j = 0; j < 3; ++j) {
+            unsigned v = faces[i][j];
+            int order = -1;
+            for (unsigned k = 0; k < insideBorderLength && order < 0; ++k) {
+                if (insideBorder[k] == v)
+                    order = k;
+            }
+            result.triangles[i][j] = { points[v],
+                { static_cast<float>(info[v].k), static_cast<float>(info[v].l), static_cast<float>(info[v].m) },
+                order };
+        }
     }
     return result;
 }
@@ -285,48 +340,106 @@ static inline void flipCoefficients(Coefficients& coefficients) {
     coefficients.flip = false;
 }
 
-bool cubic(CGPoint p0, CGPoint p1, CGPoint p2, CGPoint p3, CubicFaceReceiver receiver) {
+unsigned classifyCubic(CGPoint p0, CGPoint p1, CGPoint p2, CGPoint p3, std::array<CubicCurve, 2>& curves) {
     CGFloat d1, d2, d3;
     if (auto ds = computeDs(p0, p1, p2, p3))
         std::tie(d1, d2, d3) = ds.value();
-    else
-        return true;
+    else {
+        countCurve(CubicType::Degenerate);
+        return 0;
+    }
 
     Coefficients result;
     CGFloat discr = d1 * d1 * (3 * d2 * d2 - 4 * d1 * d3);
 
-    if (CGPointEqualToPoint(p0, p1) && CGPointEqualToPoint(p0, p2) && CGPointEqualToPoint(p0, p3))
-        return true;
-    else if (d1 == 0 && d2 == 0 && d3 == 0)
-        return true;
-    else if (d1 == 0 && d2 == 0)
+    if (CGPointEqualToPoint(p0, p1) && CGPointEqualToPoint(p0, p2) && CGPointEqualToPoint(p0, p3)) {
+        countCurve(CubicType::Degenerate);
+        return 0;
+    } else if (d1 == 0 && d2 == 0 && d3 == 0) {
+        countCurve(CubicType::Degenerate);
+        return 0;
+    } else if (d1 == 0 && d2 == 0) {
+        countCurve(CubicType::Quadratic);
         result = quadratic(d1, d2, d3);
-    else if (discr > 0)
+    } else if (discr > 0) {
+        countCurve(CubicType::Serpentine);
         result = serpentine(d1, d2, d3);
-    else if (discr < 0) {
-        auto maxIndex = 0;
-        for (auto subdivision : loop(d1, d2, d3, p0, p1, p2, p3, receiver)) {
-            flipCoefficients(subdivision.c);
-            auto localMaxIndex = 0;
-            for (auto triangle : triangulate(subdivision)) {
-                localMaxIndex = std::max(localMaxIndex, triangle[0].order);
-                localMaxIndex = std::max(localMaxIndex, triangle[1].order);
-                localMaxIndex = std::max(localMaxIndex, triangle[2].order);
-                triangle[0].order += maxIndex;
-                triangle[1].order += maxIndex;
-                triangle[2].order += maxIndex;
-                receiver(triangle[0], triangle[1], triangle[2]);
-            }
-            maxIndex += localMaxIndex + 1;
-        }
-        return false;
-    } else
+    } else if (discr < 0) {
+        countCurve(CubicType::Loop);
+        unsigned count = loop(d1, d2, d3, p0, p1, p2, p3, curves);
+        for (unsigned i = 0; i < count; ++i)
+            flipCoefficients(curves[i].c);
+        return count;
+    } else {
+        countCurve(CubicType::Cusp);
         result = cusp(d1, d2, d3);
+    }
 
     flipCoefficients(result);
+    curves[0] = { p0, p1, p2, p3, result };
+    return 1;
+}
 
-    for (auto triangle : triangulate({ p0, p1, p2, p3, result }))
-        receiver(triangle[0], triangle[1], triangle[2]);
+static bool emitCurves(const std::array<CubicCurve, 2>& curves, unsigned curveCount, CubicFaceReceiver receiver) {
+    if (!curveCount)
+        return true;
 
+    auto maxIndex = 0;
+    for (unsigned i = 0; i < curveCount; ++i) {
+        auto hull = triangulateHull(curves[i]);
+        auto localMaxIndex = 0;
+        for (unsigned j = 0; j < hull.count; ++j) {
+            auto& triangle = hull.triangles[j];
+            localMaxIndex = std::max(localMaxIndex, triangle[0].order);
+            localMaxIndex = std::max(localMaxIndex, triangle[1].order);
+            localMaxIndex = std::max(localMaxIndex, triangle[2].order);
+            triangle[0].order += maxIndex;
+            triangle[1].order += maxIndex;
+            triangle[2].order += maxIndex;
+            receiver(triangle[0], triangle[1], triangle[2]);
+        }
+        maxIndex += localMaxIndex + 1;
+    }
     return false;
 }
+
+bool cubic(CGPoint p0, CGPoint p1, CGPoint p2, CGPoint p3, CubicFaceReceiver receiver) {
+    std::array<CubicCurve, 2> curves;
+    unsigned curveCount = classifyCubic(p0, p1, p2, p3, curves);
+    return emitCurves(curves, curveCount, receiver);
+}
+
+bool cubic(const CubicBatch& batch, size_t index, CubicFaceReceiver receiver) {
+    CGPoint p0 = CGPointMake(batch.x[0][index], batch.y[0][index]);
+    CGPoint p1 = CGPointMake(batch.x[1][index], batch.y[1][index]);
+    CGPoint p2 = CGPointMake(batch.x[2][index], batch.y[2][index]);
+    CGPoint p3 = CGPointMake(batch.x[3][index], batch.y[3][index]);
+    CGFloat d1 = batch.d[0][index];
+    CGFloat d2 = batch.d[1][index];
+    CGFloat d3 = batch.d[2][index];
+
+    countCurve(batch.types[index]);
+    std::array<CubicCurve, 2> curves;
+    unsigned curveCount = 0;
+    switch (batch.types[index]) {
+    case CubicType::Degenerate:
+        break;
+    case CubicType::Loop:
+        curveCount = loop(d1, d2, d3, p0, p1, p2, p3, curves);
+        for (unsigned i = 0; i < curveCount; ++i)
+            flipCoefficients(curves[i].c);
+        break;
+    case CubicType::Quadratic:
+    case CubicType::Serpentine:
+    case CubicType::Cusp:
+        curves[0] = { p0, p1, p2, p3, {
+            { batch.k[0][index], batch.l[0][index], batch.m[0][index] },
+            { batch.k[1][index], batch.l[1][index], batch.m[1][index] },
+            { batch.k[2][index], batch.l[2][index], batch.m[2][index] },
+            { batch.k[3][index], batch.l[3][index], batch.m[3][index] },
+            false } };
+        curveCount = 1;
+        break;
+    }
+    return emitCurves(curves, curveCount, receiver);
+}
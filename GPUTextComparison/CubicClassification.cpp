@@ -0,0 +1,221 @@
+//
+//  CubicClassification.cpp
+//  GPUTextComparison
+//
+//  Created by Litherum on 5/17/16.
+//  Copyright © 2016 Litherum. All rights reserved.
+//
+
+#include "CubicClassification.h"
+#include "SIMDLanes.h"
+
+#include <algorithm>
+
+static_assert(sizeof(CGFloat) == sizeof(double), "classifyCubics() works on doubles");
+
+void CubicBatch::append(CGPoint p0, CGPoint p1, CGPoint p2, CGPoint p3) {
+    x[0].push_back(p0.x);
+    y[0].push_back(p0.y);
+    x[1].push_back(p1.x);
+    y[1].push_back(p1.y);
+    x[2].push_back(p2.x);
+    y[2].push_back(p2.y);
+    x[3].push_back(p3.x);
+    y[3].push_back(p3.y);
+}
+
+void CubicBatch::clear() {
+    for (size_t i = 0; i < 4; ++i) {
+        x[i].clear();
+        y[i].clear();
+        k[i].clear();
+        l[i].clear();
+        m[i].clear();
+    }
+    for (auto& component : d)
+        component.clear();
+    for (auto& bucket : buckets)
+        bucket.clear();
+    types.clear();
+}
+
+// The last chunk of an array is usually short; it gets padded with zeros, which classify as degenerate.
+static inline SIMD::DoubleLanes load(const std::vector<CGFloat>& source, size_t begin, size_t count) {
+    if (count == SIMD::laneCount)
+        return SIMD::load(source.data() + begin);
+    double lanes[SIMD::laneCount] = {};
+    std::copy(source.begin() + begin, source.begin() + begin + count, lanes);
+    return SIMD::load(lanes);
+}
+
+static inline void store(std::vector<CGFloat>& destination, size_t begin, size_t count, SIMD::DoubleLanes value) {
+    if (count == SIMD::laneCount)
+        return store(destination.data() + begin, value);
+    double lanes[SIMD::laneCount];
+    store(lanes, value);
+    std::copy(lanes, lanes + count, destination.begin() + begin);
+}
+
+static inline SIMD::DoubleLanes gather(const std::vector<CGFloat>& source, const uint32_t* indices, size_t count) {
+    double lanes[SIMD::laneCount] = {};
+    for (size_t i = 0; i < count; ++i)
+        lanes[i] = source[indices[i]];
+    return SIMD::load(lanes);
+}
+
+static inline void scatter(std::vector<CGFloat>& destination, const uint32_t* indices, size_t count, SIMD::DoubleLanes value) {
+    double lanes[SIMD::laneCount];
+    store(lanes, value);
+    for (size_t i = 0; i < count; ++i)
+        destination[indices[i]] = lanes[i];
+}
+
+struct LaneCoefficients {
+    std::array<SIMD::DoubleLanes, 4> k;
+    std::array<SIMD::DoubleLanes, 4> l;
+    std::array<SIMD::DoubleLanes, 4> m;
+    SIMD::LaneMask flip;
+};
+
+// These mirror quadratic(), serpentine() and cusp() in CubicBeziers.cpp operation for operation, so the results are
+// bit-identical to the scalar path.
+
+static inline LaneCoefficients quadraticLanes(SIMD::DoubleLanes d1, SIMD::DoubleLanes d2, SIMD::DoubleLanes d3) {
+    auto zero = SIMD::broadcast(0);
+    auto one = SIMD::broadcast(1);
+    auto third = SIMD::broadcast(CGFloat(1) / 3);
+    auto twoThirds = SIMD::broadcast(CGFloat(2) / 3);
+    return {
+        {{ zero, third, twoThirds, one }},
+        {{ zero, zero, third, one }},
+        {{ zero, third, twoThirds, one }},
+        d3 > zero
+    };
+}
+
+static inline LaneCoefficients serpentineLanes(SIMD::DoubleLanes d1, SIMD::DoubleLanes d2, SIMD::DoubleLanes d3) {
+    auto two = SIMD::broadcast(2);
+    auto three = SIMD::broadcast(3);
+    auto six = SIMD::broadcast(6);
+    auto root = sqrt(SIMD::broadcast(9) * d2 * d2 - SIMD::broadcast(12) * d1 * d3);
+    auto ls = three * d2 - root;
+    auto lt = six * d1;
+    auto ms = three * d2 + root;
+    auto mt = six * d1;
+    return {
+        {{ ls * ms, (three * ls * ms - ls * mt - lt * ms) / three, (lt * (mt - two * ms) + ls * (three * ms - two * mt)) / three, (lt - ls) * (mt - ms) }},
+        {{ ls * ls * ls, ls * ls * (ls - lt), (lt - ls) * (lt - ls) * ls, -(lt - ls) * (lt - ls) * (lt - ls) }},
+        {{ ms * ms * ms, ms * ms * (ms - mt), (mt - ms) * (mt - ms) * ms, -(mt - ms) * (mt - ms) * (mt - ms) }},
+        d1 > SIMD::broadcast(0)
+    };
+}
+
+static inline LaneCoefficients cuspLanes(SIMD::DoubleLanes d1, SIMD::DoubleLanes d2, SIMD::DoubleLanes d3) {
+    auto one = SIMD::broadcast(1);
+    auto three = SIMD::broadcast(3);
+    auto ls = d3;
+    auto lt = three * d2;
+    return {
+        {{ ls, ls - lt / three, ls - SIMD::broadcast(2) * lt / three, ls - lt }},
+        {{ ls * ls * ls, ls * ls * (ls - lt), (ls - lt) * (ls - lt) * ls, (ls - lt) * (ls - lt) * (ls - lt) }},
+        {{ one, one, one, one }},
+        one == one
+    };
+}
+
+template <typename Function>
+static void computeCoefficients(CubicBatch& batch, const std::vector<uint32_t>& bucket, Function function) {
+    auto negative = SIMD::broadcast(-1);
+    auto positive = SIMD::broadcast(1);
+    for (size_t begin = 0; begin < bucket.size(); begin += SIMD::laneCount) {
+        size_t count = std::min(SIMD::laneCount, bucket.size() - begin);
+        const uint32_t* indices = bucket.data() + begin;
+        auto coefficients = function(gather(batch.d[0], indices, count), gather(batch.d[1], indices, count), gather(batch.d[2], indices, count));
+        // Same as flipCoefficients(): multiplying by 1 changes nothing, and multiplying by -1 is what it does.
+        auto sign = select(coefficients.flip, negative, positive);
+        for (size_t i = 0; i < 4; ++i) {
+            scatter(batch.k[i], indices, count, coefficients.k[i] * sign);
+            scatter(batch.l[i], indices, count, coefficients.l[i] * sign);
+            scatter(batch.m[i], indices, count, coefficients.m[i]);
+        }
+    }
+}
+
+void classifyCubics(CubicBatch& batch) {
+    size_t size = batch.size();
+    batch.types.resize(size);
+    for (auto& bucket : batch.buckets)
+        bucket.clear();
+    for (auto& component : batch.d)
+        component.resize(size);
+    for (size_t i = 0; i < 4; ++i) {
+        batch.k[i].assign(size, 0);
+        batch.l[i].assign(size, 0);
+        batch.m[i].assign(size, 0);
+    }
+
+    auto zero = SIMD::broadcast(0);
+    auto two = SIMD::broadcast(2);
+    auto three = SIMD::broadcast(3);
+    auto four = SIMD::broadcast(4);
+    auto epsilon = SIMD::broadcast(0.0001);
+    for (size_t begin = 0; begin < size; begin += SIMD::laneCount) {
+        size_t count = std::min(SIMD::laneCount, size - begin);
+        auto x0 = load(batch.x[0], begin, count);
+        auto y0 = load(batch.y[0], begin, count);
+        auto x1 = load(batch.x[1], begin, count);
+        auto y1 = load(batch.y[1], begin, count);
+        auto x2 = load(batch.x[2], begin, count);
+        auto y2 = load(batch.y[2], begin, count);
+        auto x3 = load(batch.x[3], begin, count);
+        auto y3 = load(batch.y[3], begin, count);
+
+        // computeDs(), with CGAL's cross and dot products written out. The z components are all 1.
+        auto a1 = x0 * (y3 - y2) + y0 * (x2 - x3) + (x3 * y2 - y3 * x2);
+        auto a2 = x1 * (y0 - y3) + y1 * (x3 - x0) + (x0 * y3 - y0 * x3);
+        auto a3 = x2 * (y1 - y0) + y2 * (x0 - x1) + (x1 * y0 - y1 * x0);
+        auto d1 = a1 - two * a2 + three * a3;
+        auto d2 = -a2 + three * a3;
+        auto d3 = three * a3;
+
+        auto degenerate = (abs(d1) < epsilon) & (abs(d2) < epsilon) & (abs(d3) < epsilon);
+        auto length = sqrt(d1 * d1 + d2 * d2 + d3 * d3);
+        d1 = d1 / length;
+        d2 = d2 / length;
+        d3 = d3 / length;
+        d1 = select((abs(d1) < epsilon) | degenerate, zero, d1);
+        d2 = select((abs(d2) < epsilon) | degenerate, zero, d2);
+        d3 = select((abs(d3) < epsilon) | degenerate, zero, d3);
+        store(batch.d[0], begin, count, d1);
+        store(batch.d[1], begin, count, d2);
+        store(batch.d[2], begin, count, d3);
+
+        auto discriminant = d1 * d1 * (three * d2 * d2 - four * d1 * d3);
+        auto quadratic = (d1 == zero) & (d2 == zero);
+        unsigned degenerateBits = bits(degenerate | (quadratic & (d3 == zero)));
+        unsigned quadraticBits = bits(quadratic);
+        unsigned serpentineBits = bits(discriminant > zero);
+        unsigned loopBits = bits(discriminant < zero);
+
+        for (size_t i = 0; i < count; ++i) {
+            unsigned bit = 1 << i;
+            CubicType type;
+            if (degenerateBits & bit)
+                type = CubicType::Degenerate;
+            else if (quadraticBits & bit)
+                type = CubicType::Quadratic;
+            else if (serpentineBits & bit)
+                type = CubicType::Serpentine;
+            else if (loopBits & bit)
+                type = CubicType::Loop;
+            else
+                type = CubicType::Cusp;
+            batch.types[begin + i] = type;
+            batch.buckets[static_cast<size_t>(type)].push_back(static_cast<uint32_t>(begin + i));
+        }
+    }
+
+    computeCoefficients(batch, batch.buckets[static_cast<size_t>(CubicType::Quadratic)], quadraticLanes);
+    computeCoefficients(batch, batch.buckets[static_cast<size_t>(CubicType::Serpentine)], serpentineLanes);
+    computeCoefficients(batch, batch.buckets[static_cast<size_t>(CubicType::Cusp)], cuspLanes);
+}
@@ -0,0 +1,60 @@
+//
+//  CubicClassification.h
+//  GPUTextComparison
+//
+//  Created by Litherum on 5/17/16.
+//  Copyright © 2016 Litherum. All rights reserved.
+//
+
+#ifndef CubicClassification_h
+#define CubicClassification_h
+
+#include "CubicBeziers.h"
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+enum class CubicType : uint8_t {
+    Degenerate,
+    Quadratic,
+    Serpentine,
+    Loop,
+    Cusp
+};
+
+static const size_t cubicTypeCount = 5;
+
+// Many curves' control points, stored structure-of-arrays so classifyCubics() can work on several curves per
+// instruction, along with what it found out about them.
+struct CubicBatch {
+    void append(CGPoint p0, CGPoint p1, CGPoint p2, CGPoint p3);
+    void clear();
+    size_t size() const {
+        return x[0].size();
+    }
+
+    std::array<std::vector<CGFloat>, 4> x;
+    std::array<std::vector<CGFloat>, 4> y;
+
+    // Everything below is filled in by classifyCubics().
+    std::vector<CubicType> types;
+    // The indices of every curve of each type, in order.
+    std::array<std::vector<uint32_t>, cubicTypeCount> buckets;
+    // Normalized, like computeDs().
+    std::array<std::vector<CGFloat>, 3> d;
+    // Loop-Blinn coefficients of each control point, already flipped. Loops and degenerate curves are left at zero;
+    // loops get theirs from cubic() once it knows whether to subdivide.
+    std::array<std::vector<CGFloat>, 4> k;
+    std::array<std::vector<CGFloat>, 4> l;
+    std::array<std::vector<CGFloat>, 4> m;
+};
+
+// Classifies every curve in the batch the same way cubic() does, but a few curves at a time with SIMD, and then
+// computes coefficients one bucket at a time so that all the curves in a group go down the same path.
+void classifyCubics(CubicBatch&);
+
+// cubic(), for a curve that classifyCubics() has already looked at.
+bool cubic(const CubicBatch&, size_t index, CubicFaceReceiver);
+
+#endif /* CubicClassification_h */
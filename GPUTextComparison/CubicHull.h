@@ -0,0 +1,60 @@
+//
+//  CubicHull.h
+//  GPUTextComparison
+//
+//  Created by Litherum on 6/4/16.
+//  Copyright © 2016 Litherum. All rights reserved.
+//
+
+#ifndef CubicHull_h
+#define CubicHull_h
+
+#include "CubicBeziers.h"
+
+#include <array>
+
+// The steps cubic() goes through, for TriangulationBenchmark to check against CGAL. Not part of the bridging header.
+
+struct CoefficientTriple {
+    CGFloat k;
+    CGFloat l;
+    CGFloat m;
+};
+
+struct Coefficients {
+    CoefficientTriple c0;
+    CoefficientTriple c1;
+    CoefficientTriple c2;
+    CoefficientTriple c3;
+    bool flip;
+};
+
+struct CubicCurve {
+    CGPoint p0;
+    CGPoint p1;
+    CGPoint p2;
+    CGPoint p3;
+    Coefficients c;
+};
+
+// Four points triangulate into at most three triangles.
+struct HullTriangulation {
+    std::array<std::array<CubicVertex, 3>, 3> triangles;
+    unsigned count;
+};
+
+// Where triangulateHull() had to guess what CGAL would do, these make it guess the other way.
+enum HullAlternative : unsigned {
+    HullAlternativeDiagonal = 1 << 0,
+    HullAlternativeFirstStep = 1 << 1,
+    HullAlternativeSecondStep = 1 << 2,
+    HullAlternativeCount = 1 << 3
+};
+
+// Fills in the (already flipped) pieces of the curve to draw, and returns how many there are. Loops may be split in two.
+unsigned classifyCubic(CGPoint, CGPoint, CGPoint, CGPoint, std::array<CubicCurve, 2>&);
+
+// The Delaunay triangulation of a curve's control points. ambiguous is set if CGAL could have answered differently.
+HullTriangulation triangulateHull(const CubicCurve&, bool* ambiguous = nullptr, unsigned alternative = 0);
+
+#endif /* CubicHull_h */
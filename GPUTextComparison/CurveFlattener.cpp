@@ -0,0 +1,181 @@
+//
+//  CurveFlattener.cpp
+//  GPUTextComparison
+//
+//  Created by Litherum on 5/29/16.
+//  Copyright © 2016 Litherum. All rights reserved.
+//
+
+#include "CurveFlattener.h"
+
+#include "PathSource.h"
+#include "SIMDLanes.h"
+
+#include <algorithm>
+#include <cmath>
+
+static unsigned curveSegmentCount(PathElementType type, CGPoint p0, const CGPoint* points, CGFloat tolerance, unsigned fixedSegmentCount) {
+    if (fixedSegmentCount)
+        return fixedSegmentCount;
+    if (!(tolerance > 0))
+        return MaximumCurveSegmentCount;
+    double d;
+    double constant;
+    if (type == PathElementAddQuadCurveToPoint) {
+        d = std::hypot(p0.x - 2 * points[0].x + points[1].x, p0.y - 2 * points[0].y + points[1].y);
+        constant = 0.25;
+    } else {
+        double d0 = std::hypot(p0.x - 2 * points[0].x + points[1].x, p0.y - 2 * points[0].y + points[1].y);
+        double d1 = std::hypot(points[0].x - 2 * points[1].x + points[2].x, points[0].y - 2 * points[1].y + points[2].y);
+        d = std::max(d0, d1);
+        constant = 0.75;
+    }
+    double segments = std::ceil(std::sqrt(constant * d / tolerance));
+    return static_cast<unsigned>(std::min(std::max(segments, 1.0), static_cast<double>(MaximumCurveSegmentCount)));
+}
+
+// Walks the path's edges, flattened, calling edge(from, to) for each. Closing a subpath makes an edge back to its
+// start unless it's already there; edges before the first move have nowhere to start from, and are skipped.
+template <typename LineFunction, typename CurveFunction>
+static void forEachEdge(CGPathRef path, CGFloat tolerance, unsigned fixedSegmentCount, LineFunction line, CurveFunction curve) {
+    CGPoint current = CGPointZero;
+    CGPoint subpathBegin = CGPointZero;
+    bool hasCurrent = false;
+    CGPathSource(path).iterate([&](PathElement element) {
+        switch (element.type) {
+        case PathElementMoveToPoint:
+            current = subpathBegin = element.points[0];
+            hasCurrent = true;
+            return;
+        case PathElementAddLineToPoint:
+            if (hasCurrent)
+                line(current, element.points[0]);
+            current = element.points[0];
+            return;
+        case PathElementAddQuadCurveToPoint:
+        case PathElementAddCurveToPoint: {
+            unsigned pointCount = pathElementPointCount(element.type);
+            if (hasCurrent)
+                curve(element.type, current, element.points, curveSegmentCount(element.type, current, element.points, tolerance, fixedSegmentCount));
+            current = element.points[pointCount - 1];
+            return;
+        }
+        case PathElementCloseSubpath:
+            if (hasCurrent && (current.x != subpathBegin.x || current.y != subpathBegin.y))
+                line(current, subpathBegin);
+            current = subpathBegin;
+            return;
+        }
+    });
+}
+
+size_t stencilFanVertexCount(CGPathRef path, CGFloat tolerance, unsigned fixedSegmentCount) {
+    size_t edges = 0;
+    forEachEdge(path, tolerance, fixedSegmentCount, [&](CGPoint, CGPoint) {
+        ++edges;
+    }, [&](PathElementType, CGPoint, const CGPoint*, unsigned segments) {
+        edges += segments;
+    });
+    return edges * 3;
+}
+
+namespace {
+
+class FanWriter {
+public:
+    FanWriter(float* vertices) : vertices(vertices) {
+    }
+
+    void addEdge(double fromX, double fromY, double toX, double toY) {
+        *vertices++ = 0;
+        *vertices++ = 0;
+        *vertices++ = static_cast<float>(fromX);
+        *vertices++ = static_cast<float>(fromY);
+        *vertices++ = static_cast<float>(toX);
+        *vertices++ = static_cast<float>(toY);
+    }
+
+    // The curve in power basis is a t^3 + b t^2 + c t + d. Lane k starts at point k + 1 of segments, and every step
+    // moves all the lanes laneCount points along, so the differences are for a step of laneCount / segments.
+    void addCurve(PathElementType type, CGPoint p0, const CGPoint* points, unsigned segments) {
+        CGPoint p3 = points[pathElementPointCount(type) - 1];
+        double ax, ay, bx, by, cx, cy;
+        if (type == PathElementAddQuadCurveToPoint) {
+            ax = ay = 0;
+            bx = p0.x - 2 * points[0].x + points[1].x;
+            by = p0.y - 2 * points[0].y + points[1].y;
+            cx = 2 * (points[0].x - p0.x);
+            cy = 2 * (points[0].y - p0.y);
+        } else {
+            ax = p3.x - p0.x + 3 * (points[0].x - points[1].x);
+            ay = p3.y - p0.y + 3 * (points[0].y - points[1].y);
+            bx = 3 * (p0.x - 2 * points[0].x + points[1].x);
+            by = 3 * (p0.y - 2 * points[0].y + points[1].y);
+            cx = 3 * (points[0].x - p0.x);
+            cy = 3 * (points[0].y - p0.y);
+        }
+
+        double step = static_cast<double>(SIMD::laneCount) / segments;
+        double starts[SIMD::laneCount];
+        for (size_t k = 0; k < SIMD::laneCount; ++k)
+            starts[k] = static_cast<double>(k + 1) / segments;
+        SIMD::DoubleLanes t = SIMD::load(starts);
+        SIMD::DoubleLanes h = SIMD::broadcast(step);
+        SIMD::DoubleLanes h2 = h * h;
+        SIMD::DoubleLanes h3 = h2 * h;
+        SIMD::DoubleLanes three = SIMD::broadcast(3);
+        SIMD::DoubleLanes six = SIMD::broadcast(6);
+        SIMD::DoubleLanes two = SIMD::broadcast(2);
+
+        auto differences = [&](double a, double b, double c, double d, SIMD::DoubleLanes& position, SIMD::DoubleLanes& first, SIMD::DoubleLanes& second, SIMD::DoubleLanes& third) {
+            SIMD::DoubleLanes av = SIMD::broadcast(a);
+            SIMD::DoubleLanes bv = SIMD::broadcast(b);
+            SIMD::DoubleLanes cv = SIMD::broadcast(c);
+            position = ((av * t + bv) * t + cv) * t + SIMD::broadcast(d);
+            first = av * (three * t * t * h + three * t * h2 + h3) + bv * (two * t * h + h2) + cv * h;
+            second = av * (six * t * h2 + six * h3) + bv * (two * h2);
+            third = six * av * h3;
+        };
+        SIMD::DoubleLanes x, x1, x2, x3, y, y1, y2, y3;
+        differences(ax, bx, cx, p0.x, x, x1, x2, x3);
+        differences(ay, by, cy, p0.y, y, y1, y2, y3);
+
+        double previousX = p0.x;
+        double previousY = p0.y;
+        double xs[SIMD::laneCount];
+        double ys[SIMD::laneCount];
+        for (unsigned first = 1; first <= segments; first += SIMD::laneCount) {
+            store(xs, x);
+            store(ys, y);
+            unsigned count = std::min<unsigned>(SIMD::laneCount, segments - first + 1);
+            for (unsigned k = 0; k < count; ++k) {
+                // The last point is exactly the end point, so contours still close.
+                double nextX = first + k == segments ? p3.x : xs[k];
+                double nextY = first + k == segments ? p3.y : ys[k];
+                addEdge(previousX, previousY, nextX, nextY);
+                previousX = nextX;
+                previousY = nextY;
+            }
+            x = x + x1;
+            x1 = x1 + x2;
+            x2 = x2 + x3;
+            y = y + y1;
+            y1 = y1 + y2;
+            y2 = y2 + y3;
+        }
+    }
+
+private:
+    float* vertices;
+};
+
+}
+
+void writeStencilFan(CGPathRef path, CGFloat tolerance, unsigned fixedSegmentCount, float* vertices) {
+    FanWriter writer(vertices);
+    forEachEdge(path, tolerance, fixedSegmentCount, [&](CGPoint from, CGPoint to) {
+        writer.addEdge(from.x, from.y, to.x, to.y);
+    }, [&](PathElementType type, CGPoint p0, const CGPoint* points, unsigned segments) {
+        writer.addCurve(type, p0, points, segments);
+    });
+}
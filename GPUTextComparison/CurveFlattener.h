@@ -0,0 +1,36 @@
+//
+//  CurveFlattener.h
+//  GPUTextComparison
+//
+//  Created by Litherum on 5/29/16.
+//  Copyright © 2016 Litherum. All rights reserved.
+//
+
+#ifndef CurveFlattener_h
+#define CurveFlattener_h
+
+#include <CoreGraphics/CoreGraphics.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Geometry for the stencil pass of NaiveStencilViewController: the path's curves become line segments, and every
+// segment from a to b becomes the triangle (origin, a, b), three float2 vertices. Counting coverage with the stencil
+// across all the triangles gives the winding number.
+//
+// Each curve gets as few segments as Wang's formula says keep it within tolerance, in path units, up to
+// MaximumCurveSegmentCount. fixedSegmentCount, if it isn't 0, gives every curve exactly that many instead.
+#define MaximumCurveSegmentCount 256
+
+// How many vertices writeStencilFan() writes, so the caller can allocate exactly that much.
+size_t stencilFanVertexCount(CGPathRef, CGFloat tolerance, unsigned fixedSegmentCount);
+// Writes stencilFanVertexCount() vertices, as x, y pairs. Curves are evaluated by forward differencing, several points
+// at a time.
+void writeStencilFan(CGPathRef, CGFloat tolerance, unsigned fixedSegmentCount, float* vertices);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CurveFlattener_h */
@@ -13,21 +13,6 @@ let MaxBuffers = 3
 let VertexBufferSize = 1024*1024
 let TextureCoordinateBufferSize = 1024*1024
 
-extension DisplayViewController.GlyphCacheKey: Hashable {
-    var hashValue: Int {
-        let a = glyphID.hashValue
-        let b = subpixelPosition.x.hashValue
-        let c = subpixelPosition.y.hashValue
-        let d = Int(CFHash(CTFontDescriptorCopyAttributes(CTFontCopyFontDescriptor(font))))
-        //let d = Int(CFHash(font))
-        return a ^ b ^ c ^ d
-    }
-}
-
-func ==(lhs: DisplayViewController.GlyphCacheKey, rhs: DisplayViewController.GlyphCacheKey) -> Bool {
-    return lhs.glyphID == rhs.glyphID && CFEqual(lhs.font, rhs.font) && lhs.subpixelPosition == rhs.subpixelPosition
-}
-
 class DisplayViewController: TextViewController, MTKViewDelegate {
     
     var device: MTLDevice! = nil
@@ -36,28 +21,14 @@ class DisplayViewController: TextViewController, MTKViewDelegate {
     var pipelineState: MTLRenderPipelineState! = nil
     var vertexBuffers: [MTLBuffer] = []
     var textureCoordinateBuffers: [MTLBuffer] = []
-    var texture: MTLTexture! = nil
 
     let inflightSemaphore = dispatch_semaphore_create(MaxBuffers)
     var bufferIndex = 0
 
     var frameCounter = 0
 
-    struct GlyphCacheKey {
-        let glyphID: CGGlyph
-        let font: CTFont
-        let subpixelPosition: CGPoint
-    }
-
     var glyphAtlas: GlyphAtlas! = nil
 
-    struct GlyphCacheValue {
-        var texture: MTLTexture
-        var space: CGRect
-    }
-
-    var cache: [GlyphCacheKey : GlyphCacheValue] = [:]
-
     override func viewDidLoad() {
         
         super.viewDidLoad()
@@ -109,14 +80,7 @@ class DisplayViewController: TextViewController, MTKViewDelegate {
             fatalError("Failed to create pipeline state, error \(error)")
         }
 
-        let textureWidth = 4096
-        let textureHeight = 4096
-        let textureDescriptor = MTLTextureDescriptor.texture2DDescriptorWithPixelFormat(.R8Unorm, width: textureWidth, height: textureHeight, mipmapped: false)
-        texture = device.newTextureWithDescriptor(textureDescriptor)
-        let newData = Array<UInt8>(count: textureWidth * textureHeight, repeatedValue: UInt8(255))
-        texture.replaceRegion(MTLRegionMake2D(0, 0, textureWidth, textureHeight), mipmapLevel: 0, withBytes: newData, bytesPerRow: 4096)
-
-        glyphAtlas = GlyphAtlas(texture: texture)
+        glyphAtlas = GlyphAtlas(device: device, pageWidth: 4096, pageHeight: 4096, maximumPageCount: 4, protectedFrameCount: MaxBuffers)
     }
 
     private func acquireVertexBuffer(inout usedBuffers: [MTLBuffer]) -> MTLBuffer {
@@ -189,7 +153,7 @@ class DisplayViewController: TextViewController, MTKViewDelegate {
         textureCoordinateBufferUtilization = textureCoordinateBufferUtilization + sizeofValue(newTextureCoordinates[0]) * 2 * 3 * 2
     }
 
-    private func issueDraw(renderEncoder: MTLRenderCommandEncoder, inout vertexBuffer: MTLBuffer, inout vertexBufferUtilization: Int, inout usedVertexBuffers: [MTLBuffer], inout textureCoordinateBuffer: MTLBuffer, inout textureCoordinateBufferUtilization: Int, inout usedTextureCoordinateBuffers: [MTLBuffer], vertexCount: Int) {
+    private func issueDraw(renderEncoder: MTLRenderCommandEncoder, inout vertexBuffer: MTLBuffer, inout vertexBufferUtilization: Int, inout usedVertexBuffers: [MTLBuffer], inout textureCoordinateBuffer: MTLBuffer, inout textureCoordinateBufferUtilization: Int, inout usedTextureCoordinateBuffers: [MTLBuffer], texture: MTLTexture, vertexCount: Int) {
         renderEncoder.setVertexBuffer(vertexBuffer, offset: 0, atIndex: 0)
         renderEncoder.setVertexBuffer(textureCoordinateBuffer, offset:0, atIndex: 1)
         renderEncoder.setFragmentTexture(texture, atIndex: 0)
@@ -202,14 +166,13 @@ class DisplayViewController: TextViewController, MTKViewDelegate {
     }
     
     func drawInMTKView(view: MTKView) {
-        if frames.count == 0 {
-            return
-        }
         let slowness = 1
-        if frameCounter >= frames.count * slowness {
+        if let frameCount = frames?.frameCount where frameCounter >= frameCount * slowness {
             frameCounter = 0
         }
-        let frame = frames[frameCounter / slowness]
+        guard let frame = frames?.loopingFrame(frameCounter / slowness) else {
+            return
+        }
 
         var usedVertexBuffers: [MTLBuffer] = []
         var usedTextureCoordinateBuffers: [MTLBuffer] = []
@@ -226,7 +189,10 @@ class DisplayViewController: TextViewController, MTKViewDelegate {
         var vertexBufferUtilization = 0
         var textureCoordinateBuffer = acquireTextureCoordinateBuffer(&usedTextureCoordinateBuffers)
         var textureCoordinateBufferUtilization = 0
+        // Glyphs on different atlas pages need separate draws.
+        var batchTexture: MTLTexture? = nil
 
+        glyphAtlas.beginFrame()
         for glyph in frame {
             // FIXME: Gracefully handle full geometry buffers
 
@@ -234,18 +200,9 @@ class DisplayViewController: TextViewController, MTKViewDelegate {
             var subpixelPosition = CGSizeMake(modf(glyph.position.x).1, modf(glyph.position.y).1)
             subpixelPosition = CGSizeMake(subpixelPosition.width * subpixelRoundFactor, subpixelPosition.height * subpixelRoundFactor)
             subpixelPosition = CGSizeMake(floor(subpixelPosition.width), floor(subpixelPosition.height))
+            // The atlas decides what stays cached; each subpixel position is its own variant of the glyph.
+            let atlasKey = glyphCacheKey(glyph.fontID, glyph.glyphID, UInt16(subpixelPosition.width * subpixelRoundFactor + subpixelPosition.height))
             subpixelPosition = CGSizeMake(subpixelPosition.width / subpixelRoundFactor, subpixelPosition.height / subpixelRoundFactor)
-            let key = GlyphCacheKey(glyphID: glyph.glyphID, font: glyph.font, subpixelPosition: CGPointMake(subpixelPosition.width, subpixelPosition.height))
-            var box = CGRectZero
-            if let cacheLookup = cache[key] {
-                box = cacheLookup.space
-            } else {
-                guard let rect = glyphAtlas.put(key.font, glyph: key.glyphID, subpixelPosition: key.subpixelPosition) else {
-                    fatalError()
-                }
-                box = rect
-                cache[key] = GlyphCacheValue(texture: texture, space: rect)
-            }
 
             var localGlyph = glyph.glyphID
             var boundingRect = CGRectZero;
@@ -255,9 +212,20 @@ class DisplayViewController: TextViewController, MTKViewDelegate {
                 continue
             }
 
+            // The atlas is full of glyphs that frames in flight still need, so this one has to wait for a later frame.
+            guard let (texture, box) = glyphAtlas.get(atlasKey, font: glyph.font, glyph: glyph.glyphID, subpixelPosition: CGPointMake(subpixelPosition.width, subpixelPosition.height)) else {
+                continue
+            }
+            if let currentTexture = batchTexture where currentTexture !== texture && vertexBufferUtilization > 0 {
+                issueDraw(renderEncoder, vertexBuffer: &vertexBuffer, vertexBufferUtilization: &vertexBufferUtilization, usedVertexBuffers: &usedVertexBuffers, textureCoordinateBuffer: &textureCoordinateBuffer, textureCoordinateBufferUtilization: &textureCoordinateBufferUtilization, usedTextureCoordinateBuffers: &usedTextureCoordinateBuffers, texture: currentTexture, vertexCount: vertexBufferUtilization / (sizeof(Float) * 2))
+            }
+            batchTexture = texture
+
             appendQuad(boundingRect.offsetBy(dx: glyph.position.x, dy: glyph.position.y), textureRect: box, vertexBuffer: vertexBuffer, vertexBufferUtilization: &vertexBufferUtilization, textureCoordinateBuffer: textureCoordinateBuffer, textureCoordinateBufferUtilization: &textureCoordinateBufferUtilization)
         }
-        issueDraw(renderEncoder, vertexBuffer: &vertexBuffer, vertexBufferUtilization: &vertexBufferUtilization, usedVertexBuffers: &usedVertexBuffers, textureCoordinateBuffer: &textureCoordinateBuffer, textureCoordinateBufferUtilization: &textureCoordinateBufferUtilization, usedTextureCoordinateBuffers: &usedTextureCoordinateBuffers, vertexCount: vertexBufferUtilization / (sizeof(Float) * 2))
+        if let currentTexture = batchTexture where vertexBufferUtilization > 0 {
+            issueDraw(renderEncoder, vertexBuffer: &vertexBuffer, vertexBufferUtilization: &vertexBufferUtilization, usedVertexBuffers: &usedVertexBuffers, textureCoordinateBuffer: &textureCoordinateBuffer, textureCoordinateBufferUtilization: &textureCoordinateBufferUtilization, usedTextureCoordinateBuffers: &usedTextureCoordinateBuffers, texture: currentTexture, vertexCount: vertexBufferUtilization / (sizeof(Float) * 2))
+        }
 
         renderEncoder.endEncoding()
         commandBuffer.presentDrawable(currentDrawable)
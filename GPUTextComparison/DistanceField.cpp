@@ -0,0 +1,540 @@
+//
+//  DistanceField.cpp
+//  GPUTextComparison
+//
+//  Created by Litherum on 5/25/16.
+//  Copyright © 2016 Litherum. All rights reserved.
+//
+
+#include "DistanceField.h"
+
+#include "ParallelFor.h"
+#include "PathSource.h"
+#include "SIMDLanes.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+#include <vector>
+
+namespace {
+
+// Which of red, green and blue an edge counts toward.
+enum EdgeColor : uint8_t {
+    EdgeColorBlack = 0,
+    EdgeColorRed = 1,
+    EdgeColorGreen = 2,
+    EdgeColorYellow = 3,
+    EdgeColorBlue = 4,
+    EdgeColorMagenta = 5,
+    EdgeColorCyan = 6,
+    EdgeColorWhite = 7,
+};
+
+enum SegmentFlags : uint8_t {
+    SegmentStartsEdge = 1,
+    SegmentEndsEdge = 2,
+};
+
+// Moves to the next of cyan, magenta and yellow, avoiding banned if that leaves a choice, as msdfgen's
+// edgeColoringSimple() does with a seed of 0.
+void switchColor(EdgeColor& color, EdgeColor banned = EdgeColorBlack) {
+    auto combined = static_cast<EdgeColor>(color & banned);
+    if (combined == EdgeColorRed || combined == EdgeColorGreen || combined == EdgeColorBlue) {
+        color = static_cast<EdgeColor>(combined ^ EdgeColorWhite);
+        return;
+    }
+    if (color == EdgeColorBlack || color == EdgeColorWhite) {
+        color = EdgeColorCyan;
+        return;
+    }
+    int shifted = color << 1;
+    color = static_cast<EdgeColor>((shifted | shifted >> 3) & EdgeColorWhite);
+}
+
+// The path as line segments, as arrays of each coordinate so one segment broadcasts across lanes of pixels.
+struct Outline {
+    void clear() {
+        ax.clear();
+        ay.clear();
+        bx.clear();
+        by.clear();
+        colors.clear();
+        flags.clear();
+        edges.clear();
+        minX = minY = std::numeric_limits<double>::infinity();
+        maxX = maxY = -std::numeric_limits<double>::infinity();
+        area = 0;
+    }
+
+    size_t size() const {
+        return ax.size();
+    }
+
+    bool empty() const {
+        return ax.empty();
+    }
+
+    // Nonzero winding of the path around (x, y).
+    int winding(double x, double y) const {
+        int result = 0;
+        for (size_t i = 0; i < size(); ++i) {
+            if ((ay[i] <= y) != (by[i] <= y) && x < ax[i] + (y - ay[i]) * (bx[i] - ax[i]) / (by[i] - ay[i]))
+                result += by[i] > ay[i] ? 1 : -1;
+        }
+        return result;
+    }
+
+    double distanceSquared(double x, double y) const {
+        double result = std::numeric_limits<double>::infinity();
+        for (size_t i = 0; i < size(); ++i) {
+            double dx = bx[i] - ax[i];
+            double dy = by[i] - ay[i];
+            double t = std::max(0.0, std::min(1.0, ((x - ax[i]) * dx + (y - ay[i]) * dy) / (dx * dx + dy * dy)));
+            double qx = x - ax[i] - t * dx;
+            double qy = y - ay[i] - t * dy;
+            result = std::min(result, qx * qx + qy * qy);
+        }
+        return result;
+    }
+
+    std::vector<double> ax;
+    std::vector<double> ay;
+    std::vector<double> bx;
+    std::vector<double> by;
+    std::vector<EdgeColor> colors;
+    std::vector<uint8_t> flags;
+    // Each of the path's edges, as a range of segments, for the contour being built.
+    struct Edge {
+        size_t begin;
+        size_t end;
+    };
+    std::vector<Edge> edges;
+    // Of the control points.
+    double minX;
+    double minY;
+    double maxX;
+    double maxY;
+    // Twice the signed area. Positive means counterclockwise, so the inside is to the left of each segment.
+    double area;
+};
+
+class OutlineBuilder {
+public:
+    OutlineBuilder(Outline& outline, double tolerance, bool colorEdges) : outline(outline), tolerance(tolerance), colorEdges(colorEdges) {
+        outline.clear();
+    }
+
+    void operator()(PathElement element) {
+        for (unsigned i = 0; i < pathElementPointCount(element.type); ++i) {
+            outline.minX = std::min(outline.minX, static_cast<double>(element.points[i].x));
+            outline.minY = std::min(outline.minY, static_cast<double>(element.points[i].y));
+            outline.maxX = std::max(outline.maxX, static_cast<double>(element.points[i].x));
+            outline.maxY = std::max(outline.maxY, static_cast<double>(element.points[i].y));
+        }
+        switch (element.type) {
+        case PathElementMoveToPoint:
+            finishContour();
+            currentX = beginX = element.points[0].x;
+            currentY = beginY = element.points[0].y;
+            break;
+        case PathElementAddLineToPoint:
+            addLine(element.points[0].x, element.points[0].y);
+            break;
+        case PathElementAddQuadCurveToPoint: {
+            double cx = element.points[0].x;
+            double cy = element.points[0].y;
+            double x = element.points[1].x;
+            double y = element.points[1].y;
+            addCubic(currentX + 2 * (cx - currentX) / 3, currentY + 2 * (cy - currentY) / 3, x + 2 * (cx - x) / 3, y + 2 * (cy - y) / 3, x, y);
+            break;
+        }
+        case PathElementAddCurveToPoint:
+            addCubic(element.points[0].x, element.points[0].y, element.points[1].x, element.points[1].y, element.points[2].x, element.points[2].y);
+            break;
+        case PathElementCloseSubpath:
+            finishContour();
+            currentX = beginX;
+            currentY = beginY;
+            break;
+        }
+    }
+
+    // Fills close open contours, so this does too.
+    void finish() {
+        finishContour();
+    }
+
+private:
+    void addSegment(double x, double y) {
+        if (x == currentX && y == currentY)
+            return;
+        outline.ax.push_back(currentX);
+        outline.ay.push_back(currentY);
+        outline.bx.push_back(x);
+        outline.by.push_back(y);
+        outline.colors.push_back(EdgeColorWhite);
+        outline.flags.push_back(0);
+        outline.area += currentX * y - x * currentY;
+        currentX = x;
+        currentY = y;
+    }
+
+    void beginEdge() {
+        edgeBegin = outline.size();
+    }
+
+    void endEdge() {
+        if (outline.size() > edgeBegin)
+            outline.edges.push_back({ edgeBegin, outline.size() });
+    }
+
+    void addLine(double x, double y) {
+        beginEdge();
+        addSegment(x, y);
+        endEdge();
+    }
+
+    // As many segments as Wang's formula says keep the curve within tolerance.
+    void addCubic(double x1, double y1, double x2, double y2, double x3, double y3) {
+        double x0 = currentX;
+        double y0 = currentY;
+        double d0 = std::hypot(x0 - 2 * x1 + x2, y0 - 2 * y1 + y2);
+        double d1 = std::hypot(x1 - 2 * x2 + x3, y1 - 2 * y2 + y3);
+        unsigned segments = std::min(256u, std::max(1u, static_cast<unsigned>(std::ceil(std::sqrt(0.75 * std::max(d0, d1) / tolerance)))));
+        beginEdge();
+        for (unsigned i = 1; i < segments; ++i) {
+            double t = static_cast<double>(i) / segments;
+            double s = 1 - t;
+            addSegment(s * s * s * x0 + 3 * s * s * t * x1 + 3 * s * t * t * x2 + t * t * t * x3, s * s * s * y0 + 3 * s * s * t * y1 + 3 * s * t * t * y2 + t * t * t * y3);
+        }
+        addSegment(x3, y3);
+        endEdge();
+    }
+
+    void finishContour() {
+        addLine(beginX, beginY);
+        if (!outline.edges.empty()) {
+            if (colorEdges)
+                colorContour();
+            for (auto& edge : outline.edges) {
+                outline.flags[edge.begin] |= SegmentStartsEdge;
+                outline.flags[edge.end - 1] |= SegmentEndsEdge;
+            }
+        }
+        outline.edges.clear();
+        beginX = currentX;
+        beginY = currentY;
+    }
+
+    // Where two edges meet at more than about 8 degrees, or turn back.
+    bool isCorner(const Outline::Edge& incoming, const Outline::Edge& outgoing) const {
+        size_t i = incoming.end - 1;
+        size_t j = outgoing.begin;
+        double ax = outline.bx[i] - outline.ax[i];
+        double ay = outline.by[i] - outline.ay[i];
+        double bx = outline.bx[j] - outline.ax[j];
+        double by = outline.by[j] - outline.ay[j];
+        double lengths = std::hypot(ax, ay) * std::hypot(bx, by);
+        return ax * bx + ay * by <= 0 || std::abs(ax * by - ay * bx) > std::sin(3.0) * lengths;
+    }
+
+    void setColor(const Outline::Edge& edge, EdgeColor color) {
+        std::fill(outline.colors.begin() + edge.begin, outline.colors.begin() + edge.end, color);
+    }
+
+    // msdfgen's edgeColoringSimple(): every corner gets two edges that share only one channel.
+    void colorContour() {
+        auto& edges = outline.edges;
+        size_t edgeCount = edges.size();
+        corners.clear();
+        for (size_t i = 0; i < edgeCount; ++i) {
+            if (isCorner(edges[(i + edgeCount - 1) % edgeCount], edges[i]))
+                corners.push_back(i);
+        }
+
+        if (corners.empty()) {
+            for (auto& edge : edges)
+                setColor(edge, EdgeColorWhite);
+            return;
+        }
+
+        if (corners.size() == 1) {
+            // A teardrop needs three edges to color. With fewer, split the contour's segments into thirds.
+            if (edgeCount < 3) {
+                size_t begin = edges.front().begin;
+                size_t count = edges.back().end - begin;
+                if (count < 3) {
+                    for (auto& edge : edges)
+                        setColor(edge, EdgeColorWhite);
+                    return;
+                }
+                edges = { { begin, begin + count / 3 }, { begin + count / 3, begin + 2 * count / 3 }, { begin + 2 * count / 3, begin + count } };
+                corners[0] = 0;
+                edgeCount = 3;
+            }
+            EdgeColor colors[3] = { EdgeColorWhite, EdgeColorWhite, EdgeColorWhite };
+            switchColor(colors[0]);
+            colors[2] = colors[0];
+            switchColor(colors[2]);
+            for (size_t i = 0; i < edgeCount; ++i) {
+                int third = static_cast<int>(3 + 2.875 * i / (edgeCount - 1) - 1.4375 + 0.5) - 2;
+                setColor(edges[(corners[0] + i) % edgeCount], colors[third]);
+            }
+            return;
+        }
+
+        size_t spline = 0;
+        EdgeColor color = EdgeColorWhite;
+        switchColor(color);
+        EdgeColor initialColor = color;
+        for (size_t i = 0; i < edgeCount; ++i) {
+            size_t index = (corners[0] + i) % edgeCount;
+            if (spline + 1 < corners.size() && corners[spline + 1] == index) {
+                ++spline;
+                switchColor(color, spline == corners.size() - 1 ? initialColor : EdgeColorBlack);
+            }
+            setColor(edges[index], color);
+        }
+    }
+
+    Outline& outline;
+    double tolerance;
+    bool colorEdges;
+    double currentX { 0 };
+    double currentY { 0 };
+    double beginX { 0 };
+    double beginY { 0 };
+    size_t edgeBegin { 0 };
+    std::vector<size_t> corners;
+};
+
+uint8_t encodeDistance(double distance, double range) {
+    double value = std::max(0.0, std::min(1.0, distance / range + 0.5));
+    return static_cast<uint8_t>(value * 255 + 0.5);
+}
+
+double median(double a, double b, double c) {
+    return std::max(std::min(a, b), std::min(std::max(a, b), c));
+}
+
+// Reused across glyphs by each worker.
+struct DistanceFieldBuilder {
+    void build(CGPathRef path, DistanceFieldType type, CGFloat pixelsPerPathUnit, CGFloat range, GlyphDistanceField* field);
+
+    // The closest segment so far for one channel, across a lane of pixels.
+    struct Closest {
+        SIMD::DoubleLanes distanceSquared;
+        SIMD::DoubleLanes orthogonality;
+        SIMD::DoubleLanes segment;
+    };
+
+    Outline outline;
+    std::vector<double> crossingX;
+    std::vector<double> crossingDirection;
+};
+
+void DistanceFieldBuilder::build(CGPathRef path, DistanceFieldType type, CGFloat pixelsPerPathUnit, CGFloat range, GlyphDistanceField* field) {
+    bool multi = type == DistanceFieldTypeMulti;
+    *field = { nullptr, 0, 0, multi ? 4u : 1u, CGPointZero, 1 / pixelsPerPathUnit, range };
+    // A sixty-fourth of a field pixel is far below what 8 bits per texel can tell apart.
+    OutlineBuilder builder(outline, 1 / (64 * pixelsPerPathUnit), multi);
+    CGPathSource(path).iterate([&](PathElement element) {
+        builder(element);
+    });
+    builder.finish();
+    if (outline.empty())
+        return;
+
+    double scale = pixelsPerPathUnit;
+    double padding = std::ceil(range / 2) + 1;
+    field->width = static_cast<uint32_t>(std::ceil((outline.maxX - outline.minX) * scale + 2 * padding));
+    field->height = static_cast<uint32_t>(std::ceil((outline.maxY - outline.minY) * scale + 2 * padding));
+    field->origin = CGPointMake(outline.minX - padding / scale, outline.minY - padding / scale);
+    field->pixels = static_cast<uint8_t*>(malloc(static_cast<size_t>(field->width) * field->height * field->channelCount));
+
+    double orientation = outline.area >= 0 ? 1 : -1;
+    unsigned channelCount = multi ? 3 : 1;
+    size_t segmentCount = outline.size();
+    const double epsilon = 1e-9;
+    auto infinity = SIMD::broadcast(std::numeric_limits<double>::infinity());
+    auto zero = SIMD::broadcast(0);
+    auto one = SIMD::broadcast(1);
+    auto lower = SIMD::broadcast(1 - epsilon);
+    auto upper = SIMD::broadcast(1 + epsilon);
+    SIMD::DoubleLanes offsets;
+    {
+        double lanes[SIMD::laneCount];
+        for (size_t i = 0; i < SIMD::laneCount; ++i)
+            lanes[i] = (i + 0.5) / scale;
+        offsets = SIMD::load(lanes);
+    }
+
+    for (uint32_t row = 0; row < field->height; ++row) {
+        double y = field->origin.y + (row + 0.5) / scale;
+        // The segments a rightward ray from this row crosses, and which way.
+        crossingX.clear();
+        crossingDirection.clear();
+        for (size_t i = 0; i < segmentCount; ++i) {
+            if ((outline.ay[i] <= y) != (outline.by[i] <= y)) {
+                crossingX.push_back(outline.ax[i] + (y - outline.ay[i]) * (outline.bx[i] - outline.ax[i]) / (outline.by[i] - outline.ay[i]));
+                crossingDirection.push_back(outline.by[i] > outline.ay[i] ? 1 : -1);
+            }
+        }
+
+        for (uint32_t column = 0; column < field->width; column += static_cast<uint32_t>(SIMD::laneCount)) {
+            auto x = SIMD::broadcast(field->origin.x + column / scale) + offsets;
+            auto py = SIMD::broadcast(y);
+            auto winding = zero;
+            for (size_t i = 0; i < crossingX.size(); ++i)
+                winding = winding + select(x < SIMD::broadcast(crossingX[i]), SIMD::broadcast(crossingDirection[i]), zero);
+
+            Closest closest[3];
+            for (unsigned c = 0; c < channelCount; ++c)
+                closest[c] = { infinity, zero, zero };
+            for (size_t i = 0; i < segmentCount; ++i) {
+                double dx = outline.bx[i] - outline.ax[i];
+                double dy = outline.by[i] - outline.ay[i];
+                double inverseLengthSquared = 1 / (dx * dx + dy * dy);
+                auto sdx = SIMD::broadcast(dx);
+                auto sdy = SIMD::broadcast(dy);
+                auto px = x - SIMD::broadcast(outline.ax[i]);
+                auto pyRelative = py - SIMD::broadcast(outline.ay[i]);
+                auto t = (px * sdx + pyRelative * sdy) * SIMD::broadcast(inverseLengthSquared);
+                t = select(t < zero, zero, select(t > one, one, t));
+                auto qx = px - t * sdx;
+                auto qy = pyRelative - t * sdy;
+                auto distanceSquared = qx * qx + qy * qy;
+                if (!multi) {
+                    closest[0].distanceSquared = select(distanceSquared < closest[0].distanceSquared, distanceSquared, closest[0].distanceSquared);
+                    continue;
+                }
+                // Where two segments are equally close, as around a shared endpoint, the one the pixel is more nearly
+                // perpendicular to decides the pseudo-distance.
+                auto cross = sdx * pyRelative - sdy * px;
+                auto orthogonality = cross * cross * SIMD::broadcast(inverseLengthSquared) / (distanceSquared + SIMD::broadcast(std::numeric_limits<double>::min()));
+                auto index = SIMD::broadcast(static_cast<double>(i));
+                for (unsigned c = 0; c < 3; ++c) {
+                    if (!(outline.colors[i] & (1 << c)))
+                        continue;
+                    auto& best = closest[c];
+                    auto closer = (distanceSquared < best.distanceSquared * lower) | ((distanceSquared < best.distanceSquared * upper) & (orthogonality > best.orthogonality));
+                    best.distanceSquared = select(closer, distanceSquared, best.distanceSquared);
+                    best.orthogonality = select(closer, orthogonality, best.orthogonality);
+                    best.segment = select(closer, index, best.segment);
+                }
+            }
+
+            double windings[SIMD::laneCount];
+            store(windings, winding);
+            double distances[3][SIMD::laneCount];
+            double segments[3][SIMD::laneCount];
+            for (unsigned c = 0; c < channelCount; ++c) {
+                store(distances[c], closest[c].distanceSquared);
+                store(segments[c], closest[c].segment);
+            }
+            double xs[SIMD::laneCount];
+            store(xs, x);
+            uint32_t count = std::min(static_cast<uint32_t>(SIMD::laneCount), field->width - column);
+            for (uint32_t lane = 0; lane < count; ++lane) {
+                uint8_t* texel = field->pixels + (static_cast<size_t>(row) * field->width + column + lane) * field->channelCount;
+                double sign = windings[lane] ? 1 : -1;
+                double nearest = distances[0][lane];
+                for (unsigned c = 1; c < channelCount; ++c)
+                    nearest = std::min(nearest, distances[c][lane]);
+                double trueDistance = sign * std::sqrt(nearest) * scale;
+                if (!multi) {
+                    texel[0] = encodeDistance(trueDistance, range);
+                    continue;
+                }
+
+                double channels[3];
+                for (unsigned c = 0; c < 3; ++c) {
+                    auto i = static_cast<size_t>(segments[c][lane]);
+                    double dx = outline.bx[i] - outline.ax[i];
+                    double dy = outline.by[i] - outline.ay[i];
+                    double px = xs[lane] - outline.ax[i];
+                    double pyRelative = y - outline.ay[i];
+                    double t = (px * dx + pyRelative * dy) / (dx * dx + dy * dy);
+                    double cross = (dx * pyRelative - dy * px) * orientation;
+                    // Past the ends of an edge, the distance is to the edge's tangent line, which is what keeps
+                    // corners sharp.
+                    if ((t < 0 && (outline.flags[i] & SegmentStartsEdge)) || (t > 1 && (outline.flags[i] & SegmentEndsEdge)))
+                        channels[c] = cross / std::sqrt(dx * dx + dy * dy) * scale;
+                    else
+                        channels[c] = (cross >= 0 ? 1 : -1) * std::sqrt(distances[c][lane]) * scale;
+                }
+                if ((median(channels[0], channels[1], channels[2]) > 0) != (trueDistance > 0))
+                    channels[0] = channels[1] = channels[2] = trueDistance;
+                for (unsigned c = 0; c < 3; ++c)
+                    texel[c] = encodeDistance(channels[c], range);
+                texel[3] = encodeDistance(trueDistance, range);
+            }
+        }
+    }
+}
+
+}
+
+void createGlyphDistanceField(CGPathRef path, DistanceFieldType type, CGFloat pixelsPerPathUnit, CGFloat range, GlyphDistanceField* field) {
+    DistanceFieldBuilder().build(path, type, pixelsPerPathUnit, range, field);
+}
+
+void createGlyphDistanceFields(const CGPathRef* paths, const CGFloat* emSizes, size_t count, DistanceFieldType type, CGFloat pixelsPerEm, CGFloat range, unsigned threadCount, GlyphDistanceField* fields) {
+    std::vector<DistanceFieldBuilder> builders(resolveThreadCount(threadCount));
+    parallelFor(count, threadCount, [&](size_t i, unsigned worker) {
+        builders[worker].build(paths[i], type, pixelsPerEm / emSizes[i], range, &fields[i]);
+    });
+}
+
+void destroyGlyphDistanceField(GlyphDistanceField field) {
+    free(field.pixels);
+}
+
+DistanceFieldError measureDistanceFieldError(CGPathRef path, const GlyphDistanceField& field, CGFloat pixelsPerPathUnit) {
+    DistanceFieldError error;
+    if (!field.pixels)
+        return error;
+    Outline outline;
+    double outputPixel = 1 / pixelsPerPathUnit;
+    OutlineBuilder builder(outline, std::min(outputPixel, static_cast<double>(field.pathUnitsPerPixel)) / 64, false);
+    CGPathSource(path).iterate([&](PathElement element) {
+        builder(element);
+    });
+    builder.finish();
+
+    auto texel = [&](int x, int y, unsigned channel) {
+        x = std::max(0, std::min(static_cast<int>(field.width) - 1, x));
+        y = std::max(0, std::min(static_cast<int>(field.height) - 1, y));
+        return field.pixels[(static_cast<size_t>(y) * field.width + x) * field.channelCount + channel] / 255.0;
+    };
+    double width = field.width * field.pathUnitsPerPixel;
+    double height = field.height * field.pathUnitsPerPixel;
+    auto columns = static_cast<size_t>(std::ceil(width / outputPixel));
+    auto rows = static_cast<size_t>(std::ceil(height / outputPixel));
+    for (size_t row = 0; row < rows; ++row) {
+        for (size_t column = 0; column < columns; ++column) {
+            double x = field.origin.x + (column + 0.5) * outputPixel;
+            double y = field.origin.y + (row + 0.5) * outputPixel;
+            // Bilinear, as a sampler with linear filtering reads it.
+            double u = (x - field.origin.x) / field.pathUnitsPerPixel - 0.5;
+            double v = (y - field.origin.y) / field.pathUnitsPerPixel - 0.5;
+            int u0 = static_cast<int>(std::floor(u));
+            int v0 = static_cast<int>(std::floor(v));
+            double fu = u - u0;
+            double fv = v - v0;
+            double channels[3];
+            for (unsigned c = 0; c < std::min(field.channelCount, 3u); ++c)
+                channels[c] = (texel(u0, v0, c) * (1 - fu) + texel(u0 + 1, v0, c) * fu) * (1 - fv) + (texel(u0, v0 + 1, c) * (1 - fu) + texel(u0 + 1, v0 + 1, c) * fu) * fv;
+            double value = field.channelCount == 1 ? channels[0] : median(channels[0], channels[1], channels[2]);
+
+            ++error.samples;
+            if ((value > 0.5) == (outline.winding(x, y) != 0))
+                continue;
+            ++error.mismatches;
+            error.maximumMismatchDistance = std::max(error.maximumMismatchDistance, std::sqrt(outline.distanceSquared(x, y)) * pixelsPerPathUnit);
+        }
+    }
+    return error;
+}
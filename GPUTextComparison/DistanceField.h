@@ -0,0 +1,74 @@
+//
+//  DistanceField.h
+//  GPUTextComparison
+//
+//  Created by Litherum on 5/25/16.
+//  Copyright © 2016 Litherum. All rights reserved.
+//
+
+#ifndef DistanceField_h
+#define DistanceField_h
+
+#include <CoreGraphics/CoreGraphics.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Signed distance fields of glyph outlines, made straight from the path rather than from a rasterized bitmap. One
+// field, sampled with bilinear filtering and thresholded at 0.5, draws the glyph at any size near or above its own
+// resolution and at any subpixel offset, so an atlas needs one entry per glyph instead of one per size and offset.
+//
+// A texel stores the signed distance from its center to the outline, in field pixels, as d / range + 0.5, clamped to
+// [0, 1] and scaled to a byte. Inside is above 0.5. Which points are inside follows the nonzero rule.
+//
+// - Single: one channel, the true distance. Corners come out rounded once a texel covers several output pixels.
+// - Multi: four channels. RGB hold distances to differently colored sets of edges, as in Chlumsky's multi-channel
+//   distance fields, and the median of the three keeps corners sharp. Alpha holds the true distance. Where the RGB
+//   median would land on the wrong side of the outline, all four channels hold the true distance.
+typedef enum DistanceFieldType {
+    DistanceFieldTypeSingle,
+    DistanceFieldTypeMulti,
+} DistanceFieldType;
+
+typedef struct GlyphDistanceField {
+    // Rows go up, so row 0 is the bottom, matching CoreGraphics.
+    uint8_t* pixels;
+    uint32_t width;
+    uint32_t height;
+    uint32_t channelCount;
+    // The path coordinates of the field's bottom-left corner, and of a texel's size.
+    CGPoint origin;
+    CGFloat pathUnitsPerPixel;
+    // The distance, in field pixels, between the values 0 and 1.
+    CGFloat range;
+} GlyphDistanceField;
+
+// pixelsPerPathUnit sets the field's resolution. The field extends range / 2 pixels past the path's control points,
+// and more, so distances stay unclamped all the way out to the edge. An empty path makes an empty field.
+// Must be released with destroyGlyphDistanceField().
+void createGlyphDistanceField(CGPathRef, DistanceFieldType, CGFloat pixelsPerPathUnit, CGFloat range, GlyphDistanceField*);
+
+// Makes every glyph's field at pixelsPerEm, given each path's em size, with one worker per core if threadCount is 0.
+void createGlyphDistanceFields(const CGPathRef* paths, const CGFloat* emSizes, size_t count, DistanceFieldType, CGFloat pixelsPerEm, CGFloat range, unsigned threadCount, GlyphDistanceField* fields);
+
+void destroyGlyphDistanceField(GlyphDistanceField);
+
+#ifdef __cplusplus
+}
+
+struct DistanceFieldError {
+    size_t samples { 0 };
+    // Output pixels whose center the field puts on the wrong side of the outline.
+    size_t mismatches { 0 };
+    // The farthest any mismatch is from the outline, in output pixels.
+    double maximumMismatchDistance { 0 };
+};
+
+// Draws field at pixelsPerPathUnit the way a shader would, with bilinear filtering and a 0.5 threshold on the median of
+// the RGB channels, and checks every output pixel center against the path itself.
+DistanceFieldError measureDistanceFieldError(CGPathRef, const GlyphDistanceField&, CGFloat pixelsPerPathUnit);
+#endif
+
+#endif /* DistanceField_h */
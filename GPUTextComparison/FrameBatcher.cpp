@@ -0,0 +1,223 @@
+//
+//  FrameBatcher.cpp
+//  GPUTextComparison
+//
+//  Created by Litherum on 5/26/16.
+//  Copyright © 2016 Litherum. All rights reserved.
+//
+
+#include "FrameBatcher.h"
+
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+struct Page {
+    void clear() {
+        vertexCount = 0;
+        indexCount = 0;
+        keys.clear();
+    }
+
+    uint32_t vertexCount { 0 };
+    uint32_t indexCount { 0 };
+    std::vector<uint64_t> keys;
+    uint64_t lastUsedFrame { 0 };
+};
+
+struct Mesh {
+    FrameBatchMeshPlacement placement;
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    float scale;
+    // This frame's instances, and where they start once grouped. Only meaningful if lastUsedFrame is this frame.
+    uint64_t lastUsedFrame;
+    uint32_t instanceCount;
+    uint32_t firstInstance;
+};
+
+// An instance before grouping. Mesh pointers stay put, because unordered_map never moves its values.
+struct PendingInstance {
+    Mesh* mesh;
+    float x;
+    float y;
+};
+
+}
+
+struct FrameBatcher {
+    void evict(Page& page) {
+        for (auto key : page.keys)
+            meshes.erase(key);
+        evictedMeshes += page.keys.size();
+        ++evictedPages;
+        page.clear();
+        page.lastUsedFrame = 0;
+    }
+
+    uint32_t pageVertexCapacity;
+    uint32_t pageIndexCapacity;
+    uint32_t maximumPageCount;
+    uint32_t instancesPerChunk;
+    uint32_t protectedFrameCount;
+    std::vector<Page> pages;
+    std::unordered_map<uint64_t, Mesh> meshes;
+    uint64_t frame { 1 };
+    std::vector<PendingInstance> pending;
+    // Meshes with an instance this frame, in the order they first appeared.
+    std::vector<Mesh*> usedMeshes;
+    std::vector<FrameBatchInstance> instances;
+    std::vector<FrameBatchDraw> draws;
+    size_t meshesAdded { 0 };
+    size_t evictedMeshes { 0 };
+    size_t evictedPages { 0 };
+};
+
+FrameBatcherRef createFrameBatcher(uint32_t pageVertexCapacity, uint32_t pageIndexCapacity, uint32_t maximumPageCount, uint32_t instancesPerChunk, uint32_t protectedFrameCount) {
+    if (!pageVertexCapacity || !maximumPageCount || !instancesPerChunk)
+        return nullptr;
+    auto result = new FrameBatcher;
+    result->pageVertexCapacity = pageVertexCapacity;
+    result->pageIndexCapacity = pageIndexCapacity;
+    result->maximumPageCount = maximumPageCount;
+    result->instancesPerChunk = instancesPerChunk;
+    result->protectedFrameCount = std::max(protectedFrameCount, 1u);
+    return result;
+}
+
+void destroyFrameBatcher(FrameBatcherRef batcher) {
+    delete batcher;
+}
+
+void frameBatcherBeginFrame(FrameBatcherRef batcher) {
+    ++batcher->frame;
+    batcher->pending.clear();
+    batcher->usedMeshes.clear();
+    batcher->instances.clear();
+    batcher->draws.clear();
+}
+
+bool frameBatcherAddInstance(FrameBatcherRef batcher, uint64_t key, float x, float y) {
+    auto iterator = batcher->meshes.find(key);
+    if (iterator == batcher->meshes.end())
+        return false;
+    auto& mesh = iterator->second;
+    if (mesh.lastUsedFrame != batcher->frame) {
+        mesh.lastUsedFrame = batcher->frame;
+        mesh.instanceCount = 0;
+        batcher->usedMeshes.push_back(&mesh);
+        batcher->pages[mesh.placement.page].lastUsedFrame = batcher->frame;
+    }
+    ++mesh.instanceCount;
+    batcher->pending.push_back({ &mesh, x, y });
+    return true;
+}
+
+FrameBatchMeshResult frameBatcherAddMesh(FrameBatcherRef batcher, uint64_t key, uint32_t vertexCount, uint32_t indexCount, float scale, FrameBatchMeshPlacement* placement) {
+    if (vertexCount > batcher->pageVertexCapacity || indexCount > batcher->pageIndexCapacity)
+        return FrameBatchMeshTooLarge;
+
+    // Metal wants index buffer offsets 4-byte aligned, which for 16-bit indices means an even first index.
+    auto firstIndex = [](const Page& page) {
+        return (page.indexCount + 1) & ~1u;
+    };
+    Page* page = nullptr;
+    for (auto& candidate : batcher->pages) {
+        if (candidate.vertexCount + vertexCount <= batcher->pageVertexCapacity && firstIndex(candidate) + indexCount <= batcher->pageIndexCapacity) {
+            page = &candidate;
+            break;
+        }
+    }
+    if (!page) {
+        if (batcher->pages.size() < batcher->maximumPageCount) {
+            batcher->pages.emplace_back();
+            page = &batcher->pages.back();
+        } else {
+            for (auto& candidate : batcher->pages) {
+                if (candidate.lastUsedFrame + batcher->protectedFrameCount <= batcher->frame && (!page || candidate.lastUsedFrame < page->lastUsedFrame))
+                    page = &candidate;
+            }
+            if (!page)
+                return FrameBatchFull;
+            batcher->evict(*page);
+        }
+    }
+
+    Mesh mesh;
+    mesh.placement = { static_cast<uint32_t>(page - batcher->pages.data()), page->vertexCount, firstIndex(*page) };
+    mesh.vertexCount = vertexCount;
+    mesh.indexCount = indexCount;
+    mesh.scale = scale;
+    mesh.lastUsedFrame = 0;
+    mesh.instanceCount = 0;
+    mesh.firstInstance = 0;
+    page->vertexCount += vertexCount;
+    page->indexCount = mesh.placement.firstIndex + indexCount;
+    page->keys.push_back(key);
+    page->lastUsedFrame = std::max(page->lastUsedFrame, batcher->frame);
+    batcher->meshes[key] = mesh;
+    ++batcher->meshesAdded;
+    *placement = mesh.placement;
+    return FrameBatchMeshAdded;
+}
+
+uint32_t frameBatcherPageCount(FrameBatcherRef batcher) {
+    return static_cast<uint32_t>(batcher->pages.size());
+}
+
+void frameBatcherFinishFrame(FrameBatcherRef batcher) {
+    // Draws from the same page go together, so the caller binds each page's buffers once.
+    std::stable_sort(batcher->usedMeshes.begin(), batcher->usedMeshes.end(), [](const Mesh* a, const Mesh* b) {
+        return a->placement.page < b->placement.page;
+    });
+
+    // A counting sort by mesh. A mesh whose instances cross a chunk boundary gets a draw on each side of it.
+    uint32_t chunkSize = batcher->instancesPerChunk;
+    size_t cursor = 0;
+    batcher->draws.clear();
+    for (auto* mesh : batcher->usedMeshes) {
+        mesh->firstInstance = static_cast<uint32_t>(cursor);
+        size_t remaining = mesh->instanceCount;
+        while (remaining) {
+            auto baseInstance = static_cast<uint32_t>(cursor % chunkSize);
+            auto count = static_cast<uint32_t>(std::min<size_t>(remaining, chunkSize - baseInstance));
+            batcher->draws.push_back({ mesh->placement.page, mesh->placement.firstVertex, mesh->vertexCount, mesh->placement.firstIndex, mesh->indexCount, static_cast<uint32_t>(cursor / chunkSize), baseInstance, count });
+            cursor += count;
+            remaining -= count;
+        }
+    }
+    batcher->instances.resize(cursor);
+    for (auto& instance : batcher->pending)
+        batcher->instances[instance.mesh->firstInstance++] = { instance.x, instance.y, instance.mesh->scale };
+}
+
+const FrameBatchDraw* frameBatcherDraws(FrameBatcherRef batcher, size_t* count) {
+    *count = batcher->draws.size();
+    return batcher->draws.data();
+}
+
+const FrameBatchInstance* frameBatcherInstances(FrameBatcherRef batcher, size_t* count) {
+    *count = batcher->instances.size();
+    return batcher->instances.data();
+}
+
+size_t frameBatcherChunkCount(FrameBatcherRef batcher) {
+    return (batcher->instances.size() + batcher->instancesPerChunk - 1) / batcher->instancesPerChunk;
+}
+
+FrameBatcherStatistics frameBatcherGetStatistics(FrameBatcherRef batcher) {
+    FrameBatcherStatistics result;
+    result.meshCount = batcher->meshes.size();
+    result.residentVertices = 0;
+    result.residentIndices = 0;
+    for (auto& page : batcher->pages) {
+        result.residentVertices += page.vertexCount;
+        result.residentIndices += page.indexCount;
+    }
+    result.meshesAdded = batcher->meshesAdded;
+    result.evictedMeshes = batcher->evictedMeshes;
+    result.evictedPages = batcher->evictedPages;
+    return result;
+}
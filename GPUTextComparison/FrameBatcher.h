@@ -0,0 +1,109 @@
+//
+//  FrameBatcher.h
+//  GPUTextComparison
+//
+//  Created by Litherum on 5/26/16.
+//  Copyright © 2016 Litherum. All rights reserved.
+//
+
+#ifndef FrameBatcher_h
+#define FrameBatcher_h
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Turns a frame's glyphs into instanced draws, so the vertices of a glyph are written once, when it first appears,
+// instead of once per glyph per frame.
+//
+// Meshes live in pages the caller owns, such as one set of vertex and index buffers each, and the batcher only decides
+// where they go, the way GlyphAtlasAllocator does for bitmaps. Pages fill up front to back. When none has room and
+// there are maximumPageCount of them, the page used least recently is evicted whole, except that pages used in the
+// last protectedFrameCount frames, counting the current one, are never evicted, since frames in flight may still be
+// drawing from them.
+//
+// Each frame, every glyph adds an instance: a translation and a scale. finishing the frame groups the instances by
+// mesh and splits them into chunks of at most instancesPerChunk, one instance buffer each, so a frame of any size fits
+// in fixed-size buffers. None of this touches a vertex, so it costs the same for an ampersand as for a period.
+//
+// Meshes are identified by a caller-chosen 64-bit key.
+typedef struct FrameBatcher* FrameBatcherRef;
+
+// One per-instance vertex attribute: scene position = mesh position * scale + (x, y).
+typedef struct FrameBatchInstance {
+    float x;
+    float y;
+    float scale;
+} FrameBatchInstance;
+
+typedef struct FrameBatchMeshPlacement {
+    uint32_t page;
+    uint32_t firstVertex;
+    uint32_t firstIndex;
+} FrameBatchMeshPlacement;
+
+// Draws every instance of one mesh in one chunk. Indices are relative to the mesh, so baseVertex is firstVertex; a mesh
+// without indices draws vertexCount vertices from firstVertex. Instances are baseInstance onward within the chunk.
+typedef struct FrameBatchDraw {
+    uint32_t page;
+    uint32_t firstVertex;
+    uint32_t vertexCount;
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    uint32_t chunk;
+    uint32_t baseInstance;
+    uint32_t instanceCount;
+} FrameBatchDraw;
+
+FrameBatcherRef createFrameBatcher(uint32_t pageVertexCapacity, uint32_t pageIndexCapacity, uint32_t maximumPageCount, uint32_t instancesPerChunk, uint32_t protectedFrameCount);
+void destroyFrameBatcher(FrameBatcherRef);
+
+// Starts a new frame, dropping the last one's instances and draws.
+void frameBatcherBeginFrame(FrameBatcherRef);
+
+// Returns false if key was never added or has been evicted, in which case the caller should add its mesh and try again.
+bool frameBatcherAddInstance(FrameBatcherRef, uint64_t key, float x, float y);
+
+typedef enum FrameBatchMeshResult {
+    FrameBatchMeshAdded,
+    // More vertices or indices than a page holds.
+    FrameBatchMeshTooLarge,
+    // Every page is protected. Allowing more pages, or larger ones, fixes this.
+    FrameBatchFull,
+} FrameBatchMeshResult;
+
+// key must not already be resident. The caller copies the mesh to placement: its vertices to the page's vertex storage
+// at firstVertex, its indices, unchanged, to the page's index storage at firstIndex. firstIndex is always even, so 16-bit
+// indices start 4-byte aligned. scale goes in every instance. A mesh may have no indices. A new page's index is always
+// the current page count.
+FrameBatchMeshResult frameBatcherAddMesh(FrameBatcherRef, uint64_t key, uint32_t vertexCount, uint32_t indexCount, float scale, FrameBatchMeshPlacement*);
+
+uint32_t frameBatcherPageCount(FrameBatcherRef);
+
+// Groups the instances into draws. Both arrays stay valid until the next frameBatcherBeginFrame(). Chunk i is
+// instances[i * instancesPerChunk] onward, and every chunk but the last is full.
+void frameBatcherFinishFrame(FrameBatcherRef);
+const FrameBatchDraw* frameBatcherDraws(FrameBatcherRef, size_t* count);
+const FrameBatchInstance* frameBatcherInstances(FrameBatcherRef, size_t* count);
+size_t frameBatcherChunkCount(FrameBatcherRef);
+
+typedef struct FrameBatcherStatistics {
+    size_t meshCount;
+    size_t residentVertices;
+    size_t residentIndices;
+    size_t meshesAdded;
+    size_t evictedMeshes;
+    size_t evictedPages;
+} FrameBatcherStatistics;
+
+FrameBatcherStatistics frameBatcherGetStatistics(FrameBatcherRef);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FrameBatcher_h */
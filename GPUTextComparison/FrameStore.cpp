@@ -0,0 +1,332 @@
+//
+//  FrameStore.cpp
+//  GPUTextComparison
+//
+//  Created by Litherum on 6/1/16.
+//  Copyright © 2016 Litherum. All rights reserved.
+//
+
+#include "FrameStore.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static inline uint64_t roundUp(uint64_t value, uint64_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+// A frame's block is the same in memory as in the file, so both kinds of store read frames the same way.
+static inline size_t frameBlockWordCount(size_t runCount, size_t glyphCount) {
+    return 2 + runCount * (sizeof(FrameRun) / sizeof(uint32_t)) + (glyphCount + 1) / 2 + glyphCount * 2;
+}
+
+// A file may be truncated or corrupt, so every run has to name a font the store has and glyphs the frame has.
+static bool frameViewFromBlock(const uint32_t* block, size_t wordCount, size_t fontCount, FrameView* result) {
+    if (wordCount < 2)
+        return false;
+    size_t runCount = block[0];
+    size_t glyphCount = block[1];
+    if (frameBlockWordCount(runCount, glyphCount) > wordCount)
+        return false;
+    auto runs = reinterpret_cast<const FrameRun*>(block + 2);
+    for (size_t i = 0; i < runCount; ++i) {
+        if (runs[i].font >= fontCount || runs[i].firstGlyph > glyphCount || runs[i].glyphCount > glyphCount - runs[i].firstGlyph)
+            return false;
+    }
+    auto glyphIDs = reinterpret_cast<const uint32_t*>(runs + runCount);
+    auto x = reinterpret_cast<const float*>(glyphIDs + (glyphCount + 1) / 2);
+    result->runs = runs;
+    result->runCount = runCount;
+    result->glyphIDs = reinterpret_cast<const CGGlyph*>(glyphIDs);
+    result->x = x;
+    result->y = x + glyphCount;
+    result->glyphCount = glyphCount;
+    return true;
+}
+
+struct FrameStore {
+    // Built stores.
+    size_t retainedFrameCount { 0 };
+    std::deque<std::vector<uint32_t>> retainedFrames;
+    size_t firstRetainedFrame { 0 };
+    size_t frameCount { 0 };
+    bool complete { false };
+    std::unordered_map<std::string, uint32_t> fontIndices;
+    // The frame being built.
+    std::vector<FrameRun> runs;
+    std::vector<CGGlyph> glyphIDs;
+    std::vector<float> x;
+    std::vector<float> y;
+    // The layout file being written.
+    FILE* file { nullptr };
+    std::string path;
+    std::string temporaryPath;
+    std::vector<uint64_t> frameOffsets;
+    uint64_t sourceKey { 0 };
+
+    // Stores read from a file.
+    const uint8_t* data { nullptr };
+    size_t size { 0 };
+    const uint64_t* frameTable { nullptr };
+
+    std::vector<std::string> fontIdentities;
+};
+
+uint64_t frameStoreSourceKey(const char* source) {
+    // FNV-1a
+    uint64_t result = 14695981039346656037ULL;
+    for (auto c = reinterpret_cast<const unsigned char*>(source); *c; ++c) {
+        result ^= *c;
+        result *= 1099511628211ULL;
+    }
+    return result;
+}
+
+FrameStoreRef createFrameStore(size_t retainedFrameCount, const char* layoutPath, uint64_t sourceKey) {
+    auto store = new FrameStore;
+    store->retainedFrameCount = std::max(retainedFrameCount, static_cast<size_t>(1));
+    store->sourceKey = sourceKey;
+    if (!layoutPath)
+        return store;
+
+    // Write to a temporary file and rename it into place once it's complete, so a launch that quits halfway through
+    // the document never leaves behind a layout that looks finished.
+    store->path = layoutPath;
+    store->temporaryPath = store->path + ".tmp";
+    store->file = fopen(store->temporaryPath.c_str(), "wb");
+    if (!store->file)
+        return store;
+    // The header is filled in at the end.
+    FrameStoreFileHeader header;
+    memset(&header, 0, sizeof(header));
+    if (fwrite(&header, sizeof(header), 1, store->file) != 1) {
+        fclose(store->file);
+        store->file = nullptr;
+        remove(store->temporaryPath.c_str());
+        return store;
+    }
+    store->frameOffsets.push_back(sizeof(header));
+    return store;
+}
+
+FrameStoreRef createFrameStoreFromFile(const char* path, uint64_t sourceKey) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return nullptr;
+    struct stat status;
+    if (fstat(fd, &status) || status.st_size < static_cast<off_t>(sizeof(FrameStoreFileHeader))) {
+        close(fd);
+        return nullptr;
+    }
+    size_t size = static_cast<size_t>(status.st_size);
+    void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED)
+        return nullptr;
+
+    auto data = static_cast<const uint8_t*>(mapping);
+    auto header = reinterpret_cast<const FrameStoreFileHeader*>(data);
+    if (memcmp(header->magic, FrameStoreFileMagic, sizeof(header->magic))
+        || header->version != FrameStoreFileVersion
+        || header->sourceKey != sourceKey
+        || header->fileSize != size
+        || header->frameTableOffset % sizeof(uint64_t)
+        || header->frameTableOffset > size
+        // Nothing is added to frameCount, which comes from the file and may be as large as it likes.
+        || header->frameCount >= (size - header->frameTableOffset) / sizeof(uint64_t)
+        || header->frameTableOffset + (header->frameCount + 1) * sizeof(uint64_t) > header->fontTableOffset
+        || header->fontTableOffset > size) {
+        munmap(mapping, size);
+        return nullptr;
+    }
+
+    auto store = new FrameStore;
+    store->data = data;
+    store->size = size;
+    store->frameTable = reinterpret_cast<const uint64_t*>(data + header->frameTableOffset);
+    store->frameCount = header->frameCount;
+    store->complete = true;
+    auto font = reinterpret_cast<const char*>(data + header->fontTableOffset);
+    auto end = reinterpret_cast<const char*>(data + size);
+    for (uint32_t i = 0; i < header->fontCount; ++i) {
+        auto terminator = static_cast<const char*>(memchr(font, 0, end - font));
+        if (!terminator) {
+            destroyFrameStore(store);
+            return nullptr;
+        }
+        store->fontIdentities.emplace_back(font, terminator);
+        font = terminator + 1;
+    }
+    return store;
+}
+
+static void abandonLayoutFile(FrameStoreRef store) {
+    if (!store->file)
+        return;
+    fclose(store->file);
+    store->file = nullptr;
+    remove(store->temporaryPath.c_str());
+}
+
+void destroyFrameStore(FrameStoreRef store) {
+    if (!store)
+        return;
+    abandonLayoutFile(store);
+    if (store->data)
+        munmap(const_cast<uint8_t*>(store->data), store->size);
+    delete store;
+}
+
+uint32_t frameStoreAddFont(FrameStoreRef store, const char* fontIdentity) {
+    auto result = store->fontIndices.emplace(fontIdentity, static_cast<uint32_t>(store->fontIdentities.size()));
+    if (result.second)
+        store->fontIdentities.push_back(fontIdentity);
+    return result.first->second;
+}
+
+size_t frameStoreFontCount(FrameStoreRef store) {
+    return store->fontIdentities.size();
+}
+
+const char* frameStoreFontIdentity(FrameStoreRef store, uint32_t font) {
+    if (font >= store->fontIdentities.size())
+        return nullptr;
+    return store->fontIdentities[font].c_str();
+}
+
+void frameStoreBeginFrame(FrameStoreRef store) {
+    store->runs.clear();
+    store->glyphIDs.clear();
+    store->x.clear();
+    store->y.clear();
+}
+
+void frameStoreAppendRun(FrameStoreRef store, uint32_t font, const CGGlyph* glyphs, const CGPoint* positions, size_t count, CGPoint origin) {
+    if (!count)
+        return;
+    uint32_t first = static_cast<uint32_t>(store->glyphIDs.size());
+    // Positions are absolute, so consecutive runs in one font, even on different lines, can be one.
+    if (!store->runs.empty() && store->runs.back().font == font)
+        store->runs.back().glyphCount += static_cast<uint32_t>(count);
+    else
+        store->runs.push_back({ font, first, static_cast<uint32_t>(count) });
+    store->glyphIDs.insert(store->glyphIDs.end(), glyphs, glyphs + count);
+    for (size_t i = 0; i < count; ++i) {
+        store->x.push_back(static_cast<float>(origin.x + positions[i].x));
+        store->y.push_back(static_cast<float>(origin.y + positions[i].y));
+    }
+}
+
+void frameStoreFinishFrame(FrameStoreRef store) {
+    size_t runCount = store->runs.size();
+    size_t glyphCount = store->glyphIDs.size();
+    std::vector<uint32_t> block(frameBlockWordCount(runCount, glyphCount), 0);
+    block[0] = static_cast<uint32_t>(runCount);
+    block[1] = static_cast<uint32_t>(glyphCount);
+    auto destination = reinterpret_cast<uint8_t*>(block.data() + 2);
+    memcpy(destination, store->runs.data(), runCount * sizeof(FrameRun));
+    destination += runCount * sizeof(FrameRun);
+    memcpy(destination, store->glyphIDs.data(), glyphCount * sizeof(CGGlyph));
+    destination += roundUp(glyphCount * sizeof(CGGlyph), sizeof(uint32_t));
+    memcpy(destination, store->x.data(), glyphCount * sizeof(float));
+    destination += glyphCount * sizeof(float);
+    memcpy(destination, store->y.data(), glyphCount * sizeof(float));
+
+    if (store->file) {
+        if (fwrite(block.data(), sizeof(uint32_t), block.size(), store->file) == block.size())
+            store->frameOffsets.push_back(store->frameOffsets.back() + block.size() * sizeof(uint32_t));
+        else
+            abandonLayoutFile(store);
+    }
+
+    store->retainedFrames.push_back(std::move(block));
+    if (store->retainedFrames.size() > store->retainedFrameCount) {
+        store->retainedFrames.pop_front();
+        ++store->firstRetainedFrame;
+    }
+    ++store->frameCount;
+}
+
+bool frameStoreFinish(FrameStoreRef store) {
+    store->complete = true;
+    if (!store->file)
+        return false;
+
+    FrameStoreFileHeader header;
+    memcpy(header.magic, FrameStoreFileMagic, sizeof(header.magic));
+    header.version = FrameStoreFileVersion;
+    header.fontCount = static_cast<uint32_t>(store->fontIdentities.size());
+    header.sourceKey = store->sourceKey;
+    header.frameCount = store->frameCount;
+    uint64_t position = store->frameOffsets.back();
+    header.frameTableOffset = roundUp(position, sizeof(uint64_t));
+    header.fontTableOffset = header.frameTableOffset + store->frameOffsets.size() * sizeof(uint64_t);
+    header.fileSize = header.fontTableOffset;
+    for (auto& identity : store->fontIdentities)
+        header.fileSize += identity.size() + 1;
+
+    const uint32_t padding = 0;
+    bool success = fwrite(&padding, 1, header.frameTableOffset - position, store->file) == header.frameTableOffset - position
+        && fwrite(store->frameOffsets.data(), sizeof(uint64_t), store->frameOffsets.size(), store->file) == store->frameOffsets.size();
+    for (auto& identity : store->fontIdentities) {
+        if (success)
+            success = fwrite(identity.c_str(), 1, identity.size() + 1, store->file) == identity.size() + 1;
+    }
+    success = success
+        && !fseek(store->file, 0, SEEK_SET)
+        && fwrite(&header, sizeof(header), 1, store->file) == 1;
+    success = !fclose(store->file) && success;
+    store->file = nullptr;
+    if (!success || rename(store->temporaryPath.c_str(), store->path.c_str())) {
+        remove(store->temporaryPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+size_t frameStoreFrameCount(FrameStoreRef store) {
+    return store->frameCount;
+}
+
+bool frameStoreIsComplete(FrameStoreRef store) {
+    return store->complete;
+}
+
+bool frameStoreGetFrame(FrameStoreRef store, size_t frame, FrameView* result) {
+    if (frame >= store->frameCount)
+        return false;
+    if (store->data) {
+        uint64_t begin = store->frameTable[frame];
+        uint64_t end = store->frameTable[frame + 1];
+        // Blocks lie between the header and the frame table.
+        uint64_t blocksEnd = reinterpret_cast<const uint8_t*>(store->frameTable) - store->data;
+        if (begin < sizeof(FrameStoreFileHeader) || begin % sizeof(uint32_t) || begin > end || end > blocksEnd)
+            return false;
+        return frameViewFromBlock(reinterpret_cast<const uint32_t*>(store->data + begin), (end - begin) / sizeof(uint32_t), store->fontIdentities.size(), result);
+    }
+    if (frame < store->firstRetainedFrame)
+        return false;
+    auto& block = store->retainedFrames[frame - store->firstRetainedFrame];
+    return frameViewFromBlock(block.data(), block.size(), store->fontIdentities.size(), result);
+}
+
+size_t frameStoreMemoryBytes(FrameStoreRef store) {
+    size_t result = 0;
+    for (auto& block : store->retainedFrames)
+        result += block.capacity() * sizeof(uint32_t);
+    result += store->runs.capacity() * sizeof(FrameRun);
+    result += store->glyphIDs.capacity() * sizeof(CGGlyph);
+    result += (store->x.capacity() + store->y.capacity()) * sizeof(float);
+    result += store->frameOffsets.capacity() * sizeof(uint64_t);
+    return result;
+}
@@ -0,0 +1,107 @@
+//
+//  FrameStore.h
+//  GPUTextComparison
+//
+//  Created by Litherum on 6/1/16.
+//  Copyright © 2016 Litherum. All rights reserved.
+//
+
+#ifndef FrameStore_h
+#define FrameStore_h
+
+#include <CoreGraphics/CoreGraphics.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Laid out frames of text, as runs of glyphs in one font. A frame's glyphs are structure-of-arrays: glyph IDs, then x
+// and y positions as floats, with each run naming its font by an index into the store's font table. Fonts are
+// identified the way fontIdentity() in Layout.swift does it, so whoever draws keeps the actual fonts.
+//
+// A store is either built in memory, a frame at a time as layout produces them, or read from a layout file that such a
+// store wrote. A built store only keeps its last retainedFrameCount frames, so memory follows the frames in flight
+// rather than the document. A file is mapped, so frames cost nothing until they're read and the system can drop them
+// again after.
+//
+// On-disk layout, in native byte order:
+// - A FrameStoreFileHeader.
+// - One block per frame: uint32_t run count and glyph count, the FrameRuns, the glyph IDs padded to 4 bytes, then the x
+//   and y positions.
+// - The frame table: frameCount + 1 uint64_t offsets of each block, and of the end of the last one.
+// - The font table: fontCount NUL-terminated font identities.
+#define FrameStoreFileMagic "GTLAYOUT"
+#define FrameStoreFileVersion 1
+
+typedef struct FrameStoreFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t fontCount;
+    // What the layout was made from; see frameStoreSourceKey().
+    uint64_t sourceKey;
+    uint64_t frameCount;
+    uint64_t frameTableOffset;
+    uint64_t fontTableOffset;
+    uint64_t fileSize;
+} FrameStoreFileHeader;
+
+typedef struct FrameRun {
+    uint32_t font;
+    // Into the frame's arrays.
+    uint32_t firstGlyph;
+    uint32_t glyphCount;
+} FrameRun;
+
+// Points into the store, and stays valid until the store is destroyed or, for a built store, until retainedFrameCount
+// more frames have been added after it.
+typedef struct FrameView {
+    const FrameRun* runs;
+    size_t runCount;
+    const CGGlyph* glyphIDs;
+    const float* x;
+    const float* y;
+    size_t glyphCount;
+} FrameView;
+
+typedef struct FrameStore* FrameStoreRef;
+
+// If layoutPath isn't NULL, every frame is also written there as it's finished, and frameStoreFinish() completes the
+// file. sourceKey goes in the file, to be checked when it's read back.
+FrameStoreRef createFrameStore(size_t retainedFrameCount, const char* layoutPath, uint64_t sourceKey);
+// Returns NULL if the file is missing, truncated, written by a different version, or not made from sourceKey.
+FrameStoreRef createFrameStoreFromFile(const char* path, uint64_t sourceKey);
+void destroyFrameStore(FrameStoreRef);
+
+// A hash of whatever the layout depends on, such as the text and the font.
+uint64_t frameStoreSourceKey(const char* source);
+
+// Returns the font's index, adding it if it's new. Only for built stores.
+uint32_t frameStoreAddFont(FrameStoreRef, const char* fontIdentity);
+size_t frameStoreFontCount(FrameStoreRef);
+// NULL if font isn't below frameStoreFontCount().
+const char* frameStoreFontIdentity(FrameStoreRef, uint32_t font);
+
+// Building. positions are relative to origin, as CTRunGetPositions() gives them relative to the line's origin.
+void frameStoreBeginFrame(FrameStoreRef);
+void frameStoreAppendRun(FrameStoreRef, uint32_t font, const CGGlyph*, const CGPoint* positions, size_t count, CGPoint origin);
+void frameStoreFinishFrame(FrameStoreRef);
+// No frames will be added after this. Returns whether the layout file was written; false if there is none.
+bool frameStoreFinish(FrameStoreRef);
+
+// Frames added so far. Final once the store is complete, which a store read from a file always is.
+size_t frameStoreFrameCount(FrameStoreRef);
+bool frameStoreIsComplete(FrameStoreRef);
+// Returns false if frame hasn't been added yet, a built store has already let it go, or the frame is malformed, as a
+// corrupt file's might be: a run naming a font the store doesn't have, or glyphs beyond the frame's.
+bool frameStoreGetFrame(FrameStoreRef, size_t frame, FrameView*);
+// Heap bytes the frames take up. A mapped file's pages are the system's to drop, so they aren't counted.
+size_t frameStoreMemoryBytes(FrameStoreRef);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FrameStore_h */
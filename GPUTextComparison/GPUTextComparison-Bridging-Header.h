@@ -5,3 +5,18 @@
 #include "CGPathIterator.h"
 #include "Triangulator.h"
 #include "CubicBeziers.h"
+#include "GlyphMeshCache.h"
+#include "OutlineCorpus.h"
+#include "GlyphAtlasAllocator.h"
+#include "GlyphCache.h"
+#include "GlyphStream.h"
+#include "IndexedMesh.h"
+#include "CompactMesh.h"
+#include "SoftwareRasterizer.h"
+#include "DistanceField.h"
+#include "FrameBatcher.h"
+#include "TriangulationPipeline.h"
+#include "CurveFlattener.h"
+#include "BandedCurves.h"
+#include "FrameStore.h"
+#include "WindingReference.h"
@@ -9,58 +9,75 @@
 import CoreGraphics
 import Metal
 
+// Pages are square plots of this many pixels; see GlyphAtlasAllocator.h.
+let GlyphAtlasPlotSize = 512
+
 class GlyphAtlas {
-    // FIXME: Let the atlas grow larger than a single texture
-    // FIXME: Evict stuff we don't need
-    private let texture: MTLTexture
+    private let device: MTLDevice
+    private let pageWidth: Int
+    private let pageHeight: Int
+    private var textures: [MTLTexture] = []
+    private let allocator: GlyphAtlasAllocatorRef
     private let bitmapContext: CGContext
     private let backgroundColor: CGColor
     private let foregroundColor: CGColor
 
-    private var minRow = 0
-    private var maxRow = 0
-    private var column = 0
-
-    init(texture: MTLTexture) {
-        self.texture = texture
-        guard let bitmapContext = CGBitmapContextCreate(nil, texture.width, texture.height, 8, 0, CGColorSpaceCreateDeviceGray(), CGImageAlphaInfo.None.rawValue) else {
+    // Glyphs drawn in the last protectedFrameCount frames are never evicted, so frames still in flight keep sampling
+    // the right pixels.
+    init(device: MTLDevice, pageWidth: Int, pageHeight: Int, maximumPageCount: Int, protectedFrameCount: Int) {
+        self.device = device
+        self.pageWidth = pageWidth
+        self.pageHeight = pageHeight
+        // One pixel between glyphs, because the sampler filters linearly.
+        allocator = createGlyphAtlasAllocator(UInt32(pageWidth), UInt32(pageHeight), UInt32(GlyphAtlasPlotSize), UInt32(maximumPageCount), 1, UInt32(protectedFrameCount))
+        guard let bitmapContext = CGBitmapContextCreate(nil, pageWidth, pageHeight, 8, 0, CGColorSpaceCreateDeviceGray(), CGImageAlphaInfo.None.rawValue) else {
             fatalError()
         }
         backgroundColor = CGColorCreateGenericGray(0.0, 1.0)
         foregroundColor = CGColorCreateGenericGray(1.0, 1.0)
         CGContextSetFillColorWithColor(bitmapContext, backgroundColor)
-        CGContextFillRect(bitmapContext, CGRectMake(0, 0, CGFloat(texture.width), CGFloat(texture.height)))
+        CGContextFillRect(bitmapContext, CGRectMake(0, 0, CGFloat(pageWidth), CGFloat(pageHeight)))
         self.bitmapContext = bitmapContext
     }
 
-    private func findLocation(width: Int, height: Int) -> MTLRegion? {
-        if column + width < texture.width {
-            let result = MTLRegionMake2D(column, minRow, width, height)
-            column = column + width
-            maxRow = max(maxRow, minRow + height)
-            return result
-        } else if maxRow + height < texture.height {
-            let result = MTLRegionMake2D(0, maxRow, width, height)
-            column = width
-            minRow = maxRow
-            maxRow = minRow + height
-            return result
+    deinit {
+        destroyGlyphAtlasAllocator(allocator)
+    }
+
+    func beginFrame() {
+        glyphAtlasBeginFrame(allocator)
+    }
+
+    private func page(index: Int) -> MTLTexture {
+        while textures.count <= index {
+            let textureDescriptor = MTLTextureDescriptor.texture2DDescriptorWithPixelFormat(.R8Unorm, width: pageWidth, height: pageHeight, mipmapped: false)
+            let texture = device.newTextureWithDescriptor(textureDescriptor)
+            let newData = Array<UInt8>(count: pageWidth * pageHeight, repeatedValue: UInt8(0))
+            texture.replaceRegion(MTLRegionMake2D(0, 0, pageWidth, pageHeight), mipmapLevel: 0, withBytes: newData, bytesPerRow: pageWidth)
+            textures.append(texture)
         }
-        return nil
+        return textures[index]
+    }
+
+    private func placement(region: GlyphAtlasRegion, bounds: GlyphAtlasBounds) -> (MTLTexture, CGRect) {
+        return (page(Int(region.page)), CGRectMake(CGFloat(region.x) + CGFloat(bounds.x), CGFloat(region.y) + CGFloat(bounds.y), CGFloat(bounds.width), CGFloat(bounds.height)))
     }
 
-    // Returns the rect of the bounding box of the glyph in texture coordinates
-    // Returns nil iff the atlas is full
-    func put(font: CTFont, glyph: CGGlyph, subpixelPosition: CGPoint) -> CGRect? {
+    // key identifies the glyph and subpixel position, and is chosen by the caller. Returns the page the glyph is on,
+    // and the rect of the bounding box of the glyph in texture coordinates on it.
+    // Returns nil iff every page is full of glyphs drawn in the last few frames
+    func get(key: UInt64, font: CTFont, glyph: CGGlyph, subpixelPosition: CGPoint) -> (MTLTexture, CGRect)? {
+        var region = GlyphAtlasRegion()
+        var bounds = GlyphAtlasBounds()
+        if glyphAtlasLookup(allocator, key, &region, &bounds) {
+            return placement(region, bounds: bounds)
+        }
+
         var localGlyph = glyph
         var boundingRect = CGRectZero;
         CTFontGetBoundingRectsForGlyphs(font, .Default, &localGlyph, &boundingRect, 1)
 
-        if boundingRect == CGRectZero {
-            return CGRectZero
-        }
-
-        let boundingRectOffset = CGSizeMake((CGFloat(texture.width) - boundingRect.width) / 2, (CGFloat(texture.height) - boundingRect.height) / 2)
+        let boundingRectOffset = CGSizeMake((CGFloat(pageWidth) - boundingRect.width) / 2, (CGFloat(pageHeight) - boundingRect.height) / 2)
         let origin = CGPointMake(floor(boundingRectOffset.width - boundingRect.origin.x), floor(boundingRectOffset.height - boundingRect.origin.y))
         var adjustedOrigin = CGPointMake(origin.x + subpixelPosition.x, origin.y + subpixelPosition.y)
 
@@ -68,22 +85,30 @@ class GlyphAtlas {
         let affectedPixelsMinCorner = CGPointMake(floor(adjustedBoundingRect.origin.x), floor(adjustedBoundingRect.origin.y))
         let affectedPixelsMaxCorner = CGPointMake(ceil(adjustedBoundingRect.maxX), ceil(adjustedBoundingRect.maxY))
         let affectedPixelsSize = CGSizeMake(affectedPixelsMaxCorner.x - affectedPixelsMinCorner.x, affectedPixelsMaxCorner.y - affectedPixelsMinCorner.y)
-        guard let textureLocation = findLocation(Int(affectedPixelsSize.width), height: Int(affectedPixelsSize.height)) else {
+        // Where the bounding box sits within the region, which depends on the subpixel position.
+        let pixelSnappingAmount = adjustedBoundingRect.offsetBy(dx: -affectedPixelsMinCorner.x, dy: -affectedPixelsMinCorner.y)
+        bounds = GlyphAtlasBounds(x: Float(pixelSnappingAmount.origin.x), y: Float(pixelSnappingAmount.origin.y), width: Float(pixelSnappingAmount.width), height: Float(pixelSnappingAmount.height))
+        guard glyphAtlasAllocate(allocator, key, UInt32(affectedPixelsSize.width), UInt32(affectedPixelsSize.height), bounds, &region) == GlyphAtlasAllocated else {
             return nil
         }
 
         CGContextSetFillColorWithColor(bitmapContext, foregroundColor)
         CTFontDrawGlyphs(font, &localGlyph, &adjustedOrigin, 1, bitmapContext)
 
+        // Upload a pixel of the cleared background all around too, to wipe whatever an evicted glyph left in the gap
+        // the sampler reads from. The neighbors' own gaps keep this from touching their pixels.
+        let left = min(Int(region.x), 1)
+        let bottom = min(Int(region.y), 1)
+        let right = min(pageWidth - Int(region.x + region.width), 1)
+        let top = min(pageHeight - Int(region.y + region.height), 1)
+        let textureLocation = MTLRegionMake2D(Int(region.x) - left, Int(region.y) - bottom, Int(region.width) + left + right, Int(region.height) + bottom + top)
         let bitmapData = UnsafeMutablePointer<UInt8>(CGBitmapContextGetData(bitmapContext))
-        let localBitmapData = bitmapData + Int(affectedPixelsMinCorner.y) * CGBitmapContextGetBytesPerRow(bitmapContext) + Int(affectedPixelsMinCorner.x)
-        texture.replaceRegion(textureLocation, mipmapLevel: 0, withBytes: localBitmapData, bytesPerRow: CGBitmapContextGetBytesPerRow(bitmapContext))
+        let localBitmapData = bitmapData + (Int(affectedPixelsMinCorner.y) - bottom) * CGBitmapContextGetBytesPerRow(bitmapContext) + Int(affectedPixelsMinCorner.x) - left
+        page(Int(region.page)).replaceRegion(textureLocation, mipmapLevel: 0, withBytes: localBitmapData, bytesPerRow: CGBitmapContextGetBytesPerRow(bitmapContext))
 
         CGContextSetFillColorWithColor(bitmapContext, backgroundColor)
         CGContextFillRect(bitmapContext, CGRectMake(affectedPixelsMinCorner.x, affectedPixelsMinCorner.y, affectedPixelsSize.width, affectedPixelsSize.height))
 
-        let pixelSnappingAmount = adjustedBoundingRect.offsetBy(dx: -affectedPixelsMinCorner.x, dy: -affectedPixelsMinCorner.y)
-        return pixelSnappingAmount.offsetBy(dx: CGFloat(textureLocation.origin.x), dy: CGFloat(textureLocation.origin.y))
-        
+        return placement(region, bounds: bounds)
     }
-}
\ No newline at end of file
+}
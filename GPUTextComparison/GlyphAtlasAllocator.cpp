@@ -0,0 +1,326 @@
+//
+//  GlyphAtlasAllocator.cpp
+//  GPUTextComparison
+//
+//  Created by Litherum on 5/24/16.
+//  Copyright © 2016 Litherum. All rights reserved.
+//
+
+#include "GlyphAtlasAllocator.h"
+
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+// A run of the skyline: everything in [x, x + width) is taken up to y.
+struct SkylineSegment {
+    uint32_t x;
+    uint32_t y;
+    uint32_t width;
+};
+
+struct Plot {
+    void clear(uint32_t size) {
+        skyline.assign(1, SkylineSegment { 0, 0, size });
+        keys.clear();
+        area = 0;
+    }
+
+    // Where the bottom-left rule puts a width by height rectangle, and the top edge it would leave. found is false if
+    // it doesn't fit.
+    struct Placement {
+        bool found { false };
+        uint32_t x { 0 };
+        uint32_t y { 0 };
+        uint32_t top { 0 };
+    };
+
+    Placement fit(uint32_t width, uint32_t height, uint32_t size) const {
+        Placement result;
+        for (size_t i = 0; i < skyline.size(); ++i) {
+            uint32_t left = skyline[i].x;
+            if (left + width > size)
+                break;
+            uint32_t bottom = 0;
+            uint32_t covered = 0;
+            for (size_t j = i; covered < width; ++j) {
+                bottom = std::max(bottom, skyline[j].y);
+                covered += skyline[j].width;
+            }
+            if (bottom + height > size)
+                continue;
+            if (!result.found || bottom + height < result.top) {
+                result.found = true;
+                result.x = left;
+                result.y = bottom;
+                result.top = bottom + height;
+            }
+        }
+        return result;
+    }
+
+    void insert(uint32_t x, uint32_t y, uint32_t width, uint32_t height) {
+        uint32_t right = x + width;
+        std::vector<SkylineSegment> result;
+        result.reserve(skyline.size() + 2);
+        // Whatever sticks out on either side of the new rectangle stays.
+        for (auto& segment : skyline) {
+            if (segment.x < x)
+                result.push_back({ segment.x, segment.y, std::min(segment.x + segment.width, x) - segment.x });
+        }
+        result.push_back({ x, y + height, width });
+        for (auto& segment : skyline) {
+            uint32_t segmentRight = segment.x + segment.width;
+            if (segmentRight > right) {
+                uint32_t left = std::max(segment.x, right);
+                result.push_back({ left, segment.y, segmentRight - left });
+            }
+        }
+        // Merge neighbors at the same height, so fit() has fewer segments to walk.
+        skyline.clear();
+        for (auto& segment : result) {
+            if (!skyline.empty() && skyline.back().y == segment.y)
+                skyline.back().width += segment.width;
+            else
+                skyline.push_back(segment);
+        }
+    }
+
+    std::vector<SkylineSegment> skyline;
+    std::vector<uint64_t> keys;
+    uint64_t area { 0 };
+    uint64_t lastUsedFrame { 0 };
+};
+
+struct Entry {
+    uint32_t plot;
+    uint32_t x;
+    uint32_t y;
+    uint32_t width;
+    uint32_t height;
+    GlyphAtlasBounds bounds;
+    uint64_t lastUsedFrame;
+};
+
+}
+
+struct GlyphAtlasAllocator {
+    GlyphAtlasRegion region(const Entry& entry) const {
+        uint32_t plotInPage = entry.plot % plotsPerPage;
+        return { entry.plot / plotsPerPage, plotInPage % plotsAcross * plotSize + entry.x, plotInPage / plotsAcross * plotSize + entry.y, entry.width, entry.height };
+    }
+
+    // Finds room in the plots that already exist: the best fit among plots in use, else the first empty plot.
+    bool place(uint32_t width, uint32_t height, Entry& entry) {
+        uint32_t paddedWidth = width + padding;
+        uint32_t paddedHeight = height + padding;
+        bool found = false;
+        uint32_t bestTop = 0;
+        size_t emptyPlot = plots.size();
+        for (size_t i = 0; i < plots.size(); ++i) {
+            auto& plot = plots[i];
+            if (plot.keys.empty()) {
+                emptyPlot = std::min(emptyPlot, i);
+                continue;
+            }
+            auto placement = plot.fit(paddedWidth, paddedHeight, plotSize);
+            if (placement.found && (!found || placement.top < bestTop)) {
+                found = true;
+                bestTop = placement.top;
+                entry.plot = static_cast<uint32_t>(i);
+                entry.x = placement.x;
+                entry.y = placement.y;
+            }
+        }
+        if (!found && emptyPlot < plots.size()) {
+            found = true;
+            entry.plot = static_cast<uint32_t>(emptyPlot);
+            entry.x = 0;
+            entry.y = 0;
+        }
+        if (!found)
+            return false;
+        entry.width = width;
+        entry.height = height;
+        return true;
+    }
+
+    void commit(uint64_t key, Entry& entry) {
+        auto& plot = plots[entry.plot];
+        plot.insert(entry.x, entry.y, entry.width + padding, entry.height + padding);
+        plot.keys.push_back(key);
+        plot.area += static_cast<uint64_t>(entry.width) * entry.height;
+        plot.lastUsedFrame = std::max(plot.lastUsedFrame, entry.lastUsedFrame);
+        entries[key] = entry;
+    }
+
+    void evict(Plot& plot) {
+        for (auto key : plot.keys)
+            entries.erase(key);
+        evictedGlyphs += plot.keys.size();
+        ++evictedPlots;
+        plot.clear(plotSize);
+        plot.lastUsedFrame = 0;
+    }
+
+    uint32_t pageWidth;
+    uint32_t pageHeight;
+    uint32_t plotSize;
+    uint32_t maximumPageCount;
+    uint32_t padding;
+    uint32_t protectedFrameCount;
+    uint32_t plotsAcross;
+    uint32_t plotsPerPage;
+    uint32_t pageCount { 0 };
+    std::vector<Plot> plots;
+    std::unordered_map<uint64_t, Entry> entries;
+    uint64_t frame { 1 };
+    size_t allocations { 0 };
+    size_t evictedGlyphs { 0 };
+    size_t evictedPlots { 0 };
+};
+
+GlyphAtlasAllocatorRef createGlyphAtlasAllocator(uint32_t pageWidth, uint32_t pageHeight, uint32_t plotSize, uint32_t maximumPageCount, uint32_t padding, uint32_t protectedFrameCount) {
+    if (!plotSize || pageWidth % plotSize || pageHeight % plotSize || !pageWidth || !pageHeight || !maximumPageCount)
+        return nullptr;
+    auto result = new GlyphAtlasAllocator;
+    result->pageWidth = pageWidth;
+    result->pageHeight = pageHeight;
+    result->plotSize = plotSize;
+    result->maximumPageCount = maximumPageCount;
+    result->padding = padding;
+    result->protectedFrameCount = std::max(protectedFrameCount, 1u);
+    result->plotsAcross = pageWidth / plotSize;
+    result->plotsPerPage = result->plotsAcross * (pageHeight / plotSize);
+    return result;
+}
+
+void destroyGlyphAtlasAllocator(GlyphAtlasAllocatorRef allocator) {
+    delete allocator;
+}
+
+void glyphAtlasBeginFrame(GlyphAtlasAllocatorRef allocator) {
+    ++allocator->frame;
+}
+
+bool glyphAtlasLookup(GlyphAtlasAllocatorRef allocator, uint64_t key, GlyphAtlasRegion* region, GlyphAtlasBounds* bounds) {
+    auto iterator = allocator->entries.find(key);
+    if (iterator == allocator->entries.end())
+        return false;
+    auto& entry = iterator->second;
+    entry.lastUsedFrame = allocator->frame;
+    allocator->plots[entry.plot].lastUsedFrame = allocator->frame;
+    *region = allocator->region(entry);
+    if (bounds)
+        *bounds = entry.bounds;
+    return true;
+}
+
+GlyphAtlasAllocationResult glyphAtlasAllocate(GlyphAtlasAllocatorRef allocator, uint64_t key, uint32_t width, uint32_t height, GlyphAtlasBounds bounds, GlyphAtlasRegion* region) {
+    if (width + allocator->padding > allocator->plotSize || height + allocator->padding > allocator->plotSize)
+        return GlyphAtlasTooLarge;
+
+    Entry entry;
+    entry.bounds = bounds;
+    entry.lastUsedFrame = allocator->frame;
+    if (!allocator->place(width, height, entry)) {
+        if (allocator->pageCount < allocator->maximumPageCount) {
+            entry.plot = static_cast<uint32_t>(allocator->plots.size());
+            ++allocator->pageCount;
+            allocator->plots.resize(allocator->plots.size() + allocator->plotsPerPage);
+            for (auto i = entry.plot; i < allocator->plots.size(); ++i)
+                allocator->plots[i].clear(allocator->plotSize);
+        } else {
+            Plot* victim = nullptr;
+            for (auto& plot : allocator->plots) {
+                if (plot.lastUsedFrame + allocator->protectedFrameCount <= allocator->frame && (!victim || plot.lastUsedFrame < victim->lastUsedFrame))
+                    victim = &plot;
+            }
+            if (!victim)
+                return GlyphAtlasFull;
+            allocator->evict(*victim);
+            entry.plot = static_cast<uint32_t>(victim - allocator->plots.data());
+        }
+        entry.x = 0;
+        entry.y = 0;
+        entry.width = width;
+        entry.height = height;
+    }
+    allocator->commit(key, entry);
+    ++allocator->allocations;
+    *region = allocator->region(entry);
+    return GlyphAtlasAllocated;
+}
+
+uint32_t glyphAtlasPageCount(GlyphAtlasAllocatorRef allocator) {
+    return allocator->pageCount;
+}
+
+size_t glyphAtlasDefragment(GlyphAtlasAllocatorRef allocator, uint32_t maximumAge, GlyphAtlasMoveBlock move) {
+    struct Kept {
+        uint64_t key;
+        Entry entry;
+    };
+    std::vector<Kept> kept;
+    kept.reserve(allocator->entries.size());
+    for (auto& keyAndEntry : allocator->entries) {
+        if (keyAndEntry.second.lastUsedFrame + maximumAge >= allocator->frame)
+            kept.push_back({ keyAndEntry.first, keyAndEntry.second });
+        else
+            ++allocator->evictedGlyphs;
+    }
+    // Tallest first packs a skyline tightly. The key breaks ties, so the layout doesn't depend on hash order.
+    std::sort(kept.begin(), kept.end(), [](const Kept& a, const Kept& b) {
+        if (a.entry.height != b.entry.height)
+            return a.entry.height > b.entry.height;
+        if (a.entry.width != b.entry.width)
+            return a.entry.width > b.entry.width;
+        return a.key < b.key;
+    });
+
+    allocator->entries.clear();
+    for (auto& plot : allocator->plots) {
+        plot.clear(allocator->plotSize);
+        plot.lastUsedFrame = 0;
+    }
+    size_t moved = 0;
+    for (auto& glyph : kept) {
+        Entry entry;
+        entry.bounds = glyph.entry.bounds;
+        entry.lastUsedFrame = glyph.entry.lastUsedFrame;
+        // Tallest first can still, rarely, need more room than the old layout did; whatever doesn't fit is evicted.
+        if (!allocator->place(glyph.entry.width, glyph.entry.height, entry)) {
+            ++allocator->evictedGlyphs;
+            continue;
+        }
+        allocator->commit(glyph.key, entry);
+        if (entry.plot == glyph.entry.plot && entry.x == glyph.entry.x && entry.y == glyph.entry.y)
+            continue;
+        ++moved;
+        if (move)
+            move(glyph.key, allocator->region(glyph.entry), allocator->region(entry));
+    }
+    return moved;
+}
+
+GlyphAtlasStatistics glyphAtlasGetStatistics(GlyphAtlasAllocatorRef allocator) {
+    GlyphAtlasStatistics result;
+    result.glyphCount = allocator->entries.size();
+    result.usedPlotCount = 0;
+    result.plotCount = allocator->plots.size();
+    uint64_t area = 0;
+    for (auto& plot : allocator->plots) {
+        if (plot.keys.empty())
+            continue;
+        ++result.usedPlotCount;
+        area += plot.area;
+    }
+    uint64_t plotArea = static_cast<uint64_t>(allocator->plotSize) * allocator->plotSize;
+    result.packingEfficiency = result.usedPlotCount ? static_cast<double>(area) / (result.usedPlotCount * plotArea) : 0;
+    result.allocations = allocator->allocations;
+    result.evictedGlyphs = allocator->evictedGlyphs;
+    result.evictedPlots = allocator->evictedPlots;
+    return result;
+}
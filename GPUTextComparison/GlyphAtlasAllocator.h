@@ -0,0 +1,99 @@
+//
+//  GlyphAtlasAllocator.h
+//  GPUTextComparison
+//
+//  Created by Litherum on 5/24/16.
+//  Copyright © 2016 Litherum. All rights reserved.
+//
+
+#ifndef GlyphAtlasAllocator_h
+#define GlyphAtlasAllocator_h
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Decides where glyph bitmaps go in a set of atlas pages, without knowing what a page is; the caller owns the
+// textures and the pixels.
+//
+// Each page is split into square plots, and each plot packs rectangles with a skyline, bottom-left first, so glyphs
+// of different heights share rows. A glyph goes in the plot where it leaves the lowest skyline. When no plot has room,
+// an empty plot is used, then a new page is added, up to maximumPageCount. After that, the plot used least recently
+// is evicted whole, along with every glyph in it. Plots used in the last protectedFrameCount frames, counting the
+// current one, are never evicted, since frames in flight may still be sampling them.
+//
+// Glyphs are identified by a caller-chosen 64-bit key.
+typedef struct GlyphAtlasAllocator* GlyphAtlasAllocatorRef;
+
+typedef struct GlyphAtlasRegion {
+    uint32_t page;
+    uint32_t x;
+    uint32_t y;
+    uint32_t width;
+    uint32_t height;
+} GlyphAtlasRegion;
+
+// Where the glyph's own bounding box sits within its region, in pixels. It depends on the subpixel position the glyph
+// was drawn at, so the caller passes it to glyphAtlasAllocate, and it is kept with the glyph until the glyph is evicted.
+typedef struct GlyphAtlasBounds {
+    float x;
+    float y;
+    float width;
+    float height;
+} GlyphAtlasBounds;
+
+// plotSize must divide both page dimensions. Rectangles are kept padding pixels apart.
+GlyphAtlasAllocatorRef createGlyphAtlasAllocator(uint32_t pageWidth, uint32_t pageHeight, uint32_t plotSize, uint32_t maximumPageCount, uint32_t padding, uint32_t protectedFrameCount);
+void destroyGlyphAtlasAllocator(GlyphAtlasAllocatorRef);
+
+// Starts a new frame. Everything looked up or allocated after this counts as used in it.
+void glyphAtlasBeginFrame(GlyphAtlasAllocatorRef);
+
+// Returns false if key was never allocated or has been evicted, in which case the caller should draw it again.
+// bounds may be null.
+bool glyphAtlasLookup(GlyphAtlasAllocatorRef, uint64_t key, GlyphAtlasRegion*, GlyphAtlasBounds* bounds);
+
+typedef enum GlyphAtlasAllocationResult {
+    GlyphAtlasAllocated,
+    // Wider or taller than a plot.
+    GlyphAtlasTooLarge,
+    // Every plot is protected. Drawing fewer glyphs per frame, or allowing more pages, fixes this.
+    GlyphAtlasFull,
+} GlyphAtlasAllocationResult;
+
+// key must not already be in the atlas. A new page's index is always the current page count.
+GlyphAtlasAllocationResult glyphAtlasAllocate(GlyphAtlasAllocatorRef, uint64_t key, uint32_t width, uint32_t height, GlyphAtlasBounds, GlyphAtlasRegion*);
+
+uint32_t glyphAtlasPageCount(GlyphAtlasAllocatorRef);
+
+// Called for each glyph that defragmenting moves. Moves can overlap each other, so copy every source before writing
+// any destination, or draw the moved glyphs again.
+typedef void (^GlyphAtlasMoveBlock)(uint64_t key, GlyphAtlasRegion from, GlyphAtlasRegion to);
+
+// Evicts glyphs not used in the last maximumAge frames and packs the rest again, tallest first, into as few plots as
+// possible. Unlike eviction, this moves glyphs that frames in flight may be sampling, so only call it when the GPU is
+// done with the atlas. Returns how many glyphs moved.
+size_t glyphAtlasDefragment(GlyphAtlasAllocatorRef, uint32_t maximumAge, GlyphAtlasMoveBlock);
+
+typedef struct GlyphAtlasStatistics {
+    size_t glyphCount;
+    // Rectangle area, without padding, over the area of plots holding at least one glyph.
+    double packingEfficiency;
+    size_t usedPlotCount;
+    size_t plotCount;
+    size_t allocations;
+    size_t evictedGlyphs;
+    size_t evictedPlots;
+} GlyphAtlasStatistics;
+
+GlyphAtlasStatistics glyphAtlasGetStatistics(GlyphAtlasAllocatorRef);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GlyphAtlasAllocator_h */
@@ -0,0 +1,219 @@
+//
+//  GlyphCache.cpp
+//  GPUTextComparison
+//
+//  Created by Litherum on 5/28/16.
+//  Copyright © 2016 Litherum. All rights reserved.
+//
+
+#include "GlyphCache.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+uint32_t glyphCacheFontID(const char* fontIdentity) {
+    static std::mutex mutex;
+    static std::unordered_map<std::string, uint32_t> fontIDs;
+    std::lock_guard<std::mutex> lock(mutex);
+    return fontIDs.emplace(fontIdentity, static_cast<uint32_t>(fontIDs.size())).first->second;
+}
+
+uint64_t glyphCacheKey(uint32_t fontID, CGGlyph glyphID, uint16_t variant) {
+    return static_cast<uint64_t>(fontID) << 32 | static_cast<uint64_t>(variant) << 16 | glyphID;
+}
+
+namespace {
+
+// A value's bytes follow its entry in the same allocation, aligned for anything.
+struct alignas(16) Entry {
+    std::atomic<unsigned> references;
+    size_t length;
+
+    void* bytes() {
+        return this + 1;
+    }
+
+    static Entry* create(size_t length) {
+        void* memory = malloc(sizeof(Entry) + length);
+        auto entry = new (memory) Entry;
+        entry->references = 1;
+        entry->length = length;
+        return entry;
+    }
+
+    void release() {
+        if (references.fetch_sub(1) == 1) {
+            this->~Entry();
+            free(this);
+        }
+    }
+
+    // What a value costs against the budget, with its slot and its map node.
+    size_t charge() const {
+        return sizeof(Entry) + length + 4 * sizeof(void*);
+    }
+};
+
+struct Slot {
+    uint64_t key;
+    // nullptr for a free slot.
+    Entry* entry;
+    bool referenced;
+};
+
+struct Shard {
+    std::mutex mutex;
+    std::unordered_map<uint64_t, size_t> slotIndices;
+    std::vector<Slot> slots;
+    std::vector<size_t> freeSlots;
+    size_t hand { 0 };
+    size_t bytes { 0 };
+    size_t hits { 0 };
+    size_t misses { 0 };
+    size_t insertions { 0 };
+    size_t evictions { 0 };
+
+    void remove(size_t index) {
+        auto& slot = slots[index];
+        bytes -= slot.entry->charge();
+        slotIndices.erase(slot.key);
+        slot.entry->release();
+        slot.entry = nullptr;
+        freeSlots.push_back(index);
+    }
+
+    // Evicts until charge more bytes fit in budget. Must hold mutex.
+    void makeRoom(size_t charge, size_t budget) {
+        while (bytes + charge > budget && !slotIndices.empty()) {
+            if (hand >= slots.size())
+                hand = 0;
+            auto& slot = slots[hand];
+            if (slot.entry && slot.referenced)
+                slot.referenced = false;
+            else if (slot.entry) {
+                remove(hand);
+                ++evictions;
+            }
+            ++hand;
+        }
+    }
+};
+
+GlyphCacheValue valueForEntry(Entry* entry) {
+    GlyphCacheValue value;
+    value.bytes = entry->bytes();
+    value.length = entry->length;
+    value.entry = entry;
+    return value;
+}
+
+}
+
+struct GlyphCache {
+    GlyphCache(size_t byteBudget, unsigned shardCount) : byteBudget(byteBudget), shardBudget(byteBudget / shardCount), shards(new Shard[shardCount]), shardCount(shardCount) {
+    }
+
+    ~GlyphCache() {
+        for (unsigned i = 0; i < shardCount; ++i) {
+            for (auto& slot : shards[i].slots) {
+                if (slot.entry)
+                    slot.entry->release();
+            }
+        }
+    }
+
+    // Packed keys differ mostly in their low bits, so mix them before picking a shard.
+    Shard& shardForKey(uint64_t key) {
+        return shards[((key * 0x9E3779B97F4A7C15ull) >> 32) % shardCount];
+    }
+
+    size_t byteBudget;
+    size_t shardBudget;
+    std::unique_ptr<Shard[]> shards;
+    unsigned shardCount;
+};
+
+GlyphCacheRef createGlyphCache(size_t byteBudget, unsigned shardCount) {
+    return new GlyphCache(byteBudget, shardCount ? shardCount : 16);
+}
+
+void destroyGlyphCache(GlyphCacheRef cache) {
+    delete cache;
+}
+
+bool glyphCacheLookup(GlyphCacheRef cache, uint64_t key, GlyphCacheValue* value) {
+    auto& shard = cache->shardForKey(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto iterator = shard.slotIndices.find(key);
+    if (iterator == shard.slotIndices.end()) {
+        ++shard.misses;
+        return false;
+    }
+    ++shard.hits;
+    auto& slot = shard.slots[iterator->second];
+    slot.referenced = true;
+    ++slot.entry->references;
+    *value = valueForEntry(slot.entry);
+    return true;
+}
+
+bool glyphCacheInsert(GlyphCacheRef cache, uint64_t key, size_t length, GlyphCacheWriteBlock write, GlyphCacheValue* value) {
+    auto entry = Entry::create(length);
+    if (entry->charge() > cache->shardBudget) {
+        entry->release();
+        return false;
+    }
+    write(entry->bytes());
+
+    auto& shard = cache->shardForKey(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto existing = shard.slotIndices.find(key);
+    if (existing != shard.slotIndices.end())
+        shard.remove(existing->second);
+    shard.makeRoom(entry->charge(), cache->shardBudget);
+
+    size_t index;
+    if (shard.freeSlots.empty()) {
+        index = shard.slots.size();
+        shard.slots.push_back(Slot());
+    } else {
+        index = shard.freeSlots.back();
+        shard.freeSlots.pop_back();
+    }
+    // Not referenced, so something inserted and never looked up is the first to go.
+    shard.slots[index] = { key, entry, false };
+    shard.slotIndices.emplace(key, index);
+    shard.bytes += entry->charge();
+    ++shard.insertions;
+    if (value) {
+        ++entry->references;
+        *value = valueForEntry(entry);
+    }
+    return true;
+}
+
+void glyphCacheReleaseValue(GlyphCacheValue value) {
+    static_cast<Entry*>(const_cast<void*>(value.entry))->release();
+}
+
+GlyphCacheStatistics glyphCacheGetStatistics(GlyphCacheRef cache) {
+    GlyphCacheStatistics result = { };
+    result.byteBudget = cache->byteBudget;
+    for (unsigned i = 0; i < cache->shardCount; ++i) {
+        auto& shard = cache->shards[i];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        result.entryCount += shard.slotIndices.size();
+        result.bytes += shard.bytes;
+        result.hits += shard.hits;
+        result.misses += shard.misses;
+        result.insertions += shard.insertions;
+        result.evictions += shard.evictions;
+    }
+    return result;
+}
@@ -0,0 +1,76 @@
+//
+//  GlyphCache.h
+//  GPUTextComparison
+//
+//  Created by Litherum on 5/28/16.
+//  Copyright © 2016 Litherum. All rights reserved.
+//
+
+#ifndef GlyphCache_h
+#define GlyphCache_h
+
+#include <CoreGraphics/CoreGraphics.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// A small number for a font, the same for every call with the same identity (see fontIdentity() in Layout.swift) for
+// the life of the process. Intern each font once, when laying out, so drawing never hashes a CTFont.
+uint32_t glyphCacheFontID(const char* fontIdentity);
+
+// variant tells apart different renderings of one glyph, such as level-of-detail levels or subpixel positions.
+uint64_t glyphCacheKey(uint32_t fontID, CGGlyph, uint16_t variant);
+
+// Per-glyph data, such as meshes or geometry, that any number of threads can look up and insert at once. Keys are
+// spread over shards, each with its own lock and an equal share of the byte budget. When a shard is over budget, it
+// evicts with CLOCK: looking a value up marks it, and the hand sweeps past marked values, clearing them, until it finds
+// one that hasn't been looked up since the last sweep.
+//
+// Values are immutable bytes. A value that has been looked up stays valid until it's released, even if it's evicted
+// or replaced meanwhile.
+typedef struct GlyphCache* GlyphCacheRef;
+
+// byteBudget counts every value's bytes, and a little bookkeeping per value. 0 shards means 16.
+GlyphCacheRef createGlyphCache(size_t byteBudget, unsigned shardCount);
+void destroyGlyphCache(GlyphCacheRef);
+
+typedef struct GlyphCacheValue {
+    const void* bytes;
+    size_t length;
+    const void* entry;
+} GlyphCacheValue;
+
+// Returns false if key was never inserted or has been evicted. Otherwise, value must be released with
+// glyphCacheReleaseValue().
+bool glyphCacheLookup(GlyphCacheRef, uint64_t key, GlyphCacheValue*);
+
+// Fills in a new value's bytes, without holding any lock.
+typedef void (^GlyphCacheWriteBlock)(void* bytes);
+
+// Stores length bytes for key, written by write, replacing any value it had. If value isn't NULL, it's filled in as
+// if by glyphCacheLookup(). Returns false, without calling write, if the value alone is over a shard's budget.
+bool glyphCacheInsert(GlyphCacheRef, uint64_t key, size_t length, GlyphCacheWriteBlock write, GlyphCacheValue* value);
+
+void glyphCacheReleaseValue(GlyphCacheValue);
+
+typedef struct GlyphCacheStatistics {
+    size_t entryCount;
+    size_t bytes;
+    size_t byteBudget;
+    size_t hits;
+    size_t misses;
+    size_t insertions;
+    size_t evictions;
+} GlyphCacheStatistics;
+
+GlyphCacheStatistics glyphCacheGetStatistics(GlyphCacheRef);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GlyphCache_h */
@@ -0,0 +1,123 @@
+//
+//  GlyphMeshBatch.swift
+//  GPUTextComparison
+//
+//  Created by Litherum on 5/26/16.
+//  Copyright © 2016 Litherum. All rights reserved.
+//
+
+import CoreGraphics
+import Metal
+
+// See FrameBatcher.h. A page is evicted whole, so many small pages evict less text at a time than a few big ones.
+// With baseVertex, indices stay relative to their mesh, so a page can hold more vertices than 16 bits reach.
+let MeshPageVertexCount = 64*1024
+let MeshPageIndexCount = 128*1024
+let MaximumMeshPageCount = 16
+let InstanceBufferSize = 64*1024
+
+class GlyphMeshBatch {
+    private let device: MTLDevice
+    private let batcher: FrameBatcherRef
+    private let vertexStrides: [Int]
+    private let indexed: Bool
+    // Per page, one buffer per vertex stream.
+    private var pageVertexBuffers: [[MTLBuffer]] = []
+    private var pageIndexBuffers: [MTLBuffer] = []
+    private var instanceBuffers: [MTLBuffer] = []
+    private let instancesPerBuffer = InstanceBufferSize / sizeof(FrameBatchInstance)
+
+    // The vertex descriptor's buffer for FrameBatchInstance, which steps per instance.
+    var instanceBufferIndex: Int {
+        return vertexStrides.count
+    }
+
+    // Vertex streams are bound to buffers 0 onward in order. Meshes used in the last protectedFrameCount frames are
+    // never evicted, so frames still in flight keep drawing the right vertices.
+    init(device: MTLDevice, vertexStrides: [Int], indexed: Bool, maximumPageCount: Int, protectedFrameCount: Int) {
+        self.device = device
+        self.vertexStrides = vertexStrides
+        self.indexed = indexed
+        batcher = createFrameBatcher(UInt32(MeshPageVertexCount), indexed ? UInt32(MeshPageIndexCount) : 0, UInt32(maximumPageCount), UInt32(instancesPerBuffer), UInt32(protectedFrameCount))
+    }
+
+    deinit {
+        destroyFrameBatcher(batcher)
+    }
+
+    func beginFrame() {
+        frameBatcherBeginFrame(batcher)
+    }
+
+    // Returns false if key's mesh isn't resident, in which case call addMesh() first.
+    func addInstance(key: UInt64, position: CGPoint) -> Bool {
+        return frameBatcherAddInstance(batcher, key, Float(position.x), Float(position.y))
+    }
+
+    // write gets where each vertex stream and the indices go, and must fill in exactly vertexCount vertices and
+    // indexCount indices. Returns false if there's no room for the mesh this frame.
+    func addMesh(key: UInt64, vertexCount: Int, indexCount: Int, scale: Float, write: (vertices: [UnsafeMutablePointer<Void>], indices: UnsafeMutablePointer<UInt16>) -> ()) -> Bool {
+        var placement = FrameBatchMeshPlacement()
+        guard frameBatcherAddMesh(batcher, key, UInt32(vertexCount), UInt32(indexCount), scale, &placement) == FrameBatchMeshAdded else {
+            return false
+        }
+        let page = Int(placement.page)
+        while pageVertexBuffers.count <= page {
+            pageVertexBuffers.append(vertexStrides.map { device.newBufferWithLength(MeshPageVertexCount * $0, options: []) })
+            if indexed {
+                pageIndexBuffers.append(device.newBufferWithLength(MeshPageIndexCount * sizeof(UInt16), options: []))
+            }
+        }
+        let vertices = (0 ..< vertexStrides.count).map { pageVertexBuffers[page][$0].contents() + Int(placement.firstVertex) * vertexStrides[$0] }
+        let indices = indexed ? UnsafeMutablePointer<UInt16>(pageIndexBuffers[page].contents()) + Int(placement.firstIndex) : nil
+        write(vertices: vertices, indices: indices)
+        return true
+    }
+
+    // Draws the frame's instances, one draw per mesh per instance buffer.
+    func encode(renderEncoder: MTLRenderCommandEncoder, commandBuffer: MTLCommandBuffer) {
+        frameBatcherFinishFrame(batcher)
+        var instanceCount = 0
+        let instances = frameBatcherInstances(batcher, &instanceCount)
+        var drawCount = 0
+        let draws = frameBatcherDraws(batcher, &drawCount)
+
+        var usedInstanceBuffers: [MTLBuffer] = []
+        for chunk in 0 ..< frameBatcherChunkCount(batcher) {
+            let buffer = instanceBuffers.isEmpty ? device.newBufferWithLength(InstanceBufferSize, options: []) : instanceBuffers.removeLast()
+            let first = chunk * instancesPerBuffer
+            memcpy(buffer.contents(), instances + first, min(instancesPerBuffer, instanceCount - first) * sizeof(FrameBatchInstance))
+            usedInstanceBuffers.append(buffer)
+        }
+
+        var boundPage = -1
+        var boundChunk = -1
+        for i in 0 ..< drawCount {
+            let draw = draws[i]
+            let page = Int(draw.page)
+            if page != boundPage {
+                for (index, buffer) in pageVertexBuffers[page].enumerate() {
+                    renderEncoder.setVertexBuffer(buffer, offset: 0, atIndex: index)
+                }
+                boundPage = page
+            }
+            if Int(draw.chunk) != boundChunk {
+                boundChunk = Int(draw.chunk)
+                renderEncoder.setVertexBuffer(usedInstanceBuffers[boundChunk], offset: 0, atIndex: instanceBufferIndex)
+            }
+            if indexed {
+                renderEncoder.drawIndexedPrimitives(.Triangle, indexCount: Int(draw.indexCount), indexType: .UInt16, indexBuffer: pageIndexBuffers[page], indexBufferOffset: Int(draw.firstIndex) * sizeof(UInt16), instanceCount: Int(draw.instanceCount), baseVertex: Int(draw.firstVertex), baseInstance: Int(draw.baseInstance))
+            } else {
+                renderEncoder.drawPrimitives(.Triangle, vertexStart: Int(draw.firstVertex), vertexCount: Int(draw.vertexCount), instanceCount: Int(draw.instanceCount), baseInstance: Int(draw.baseInstance))
+            }
+        }
+
+        commandBuffer.addCompletedHandler{ [weak self] commandBuffer in
+            dispatch_async(dispatch_get_main_queue(), { [weak self] in
+                if let strongSelf = self {
+                    strongSelf.instanceBuffers.appendContentsOf(usedInstanceBuffers)
+                }
+            })
+        }
+    }
+}
@@ -0,0 +1,161 @@
+//
+//  GlyphMeshCache.cpp
+//  GPUTextComparison
+//
+//  Created by Litherum on 5/15/16.
+//  Copyright © 2016 Litherum. All rights reserved.
+//
+
+#include "GlyphMeshCache.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static inline uint64_t roundUp(uint64_t value, uint64_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+uint64_t glyphMeshCacheFontKey(const char* fontIdentity) {
+    // FNV-1a
+    uint64_t result = 14695981039346656037ULL;
+    for (auto c = reinterpret_cast<const unsigned char*>(fontIdentity); *c; ++c) {
+        result ^= *c;
+        result *= 1099511628211ULL;
+    }
+    return result;
+}
+
+struct GlyphMeshCache {
+    const uint8_t* data;
+    size_t size;
+    const GlyphMeshCacheHeader* header;
+    const GlyphMeshCacheIndexEntry* index;
+};
+
+GlyphMeshCacheRef openGlyphMeshCache(const char* path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return nullptr;
+    struct stat status;
+    if (fstat(fd, &status) || status.st_size < static_cast<off_t>(sizeof(GlyphMeshCacheHeader))) {
+        close(fd);
+        return nullptr;
+    }
+    size_t size = static_cast<size_t>(status.st_size);
+    void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED)
+        return nullptr;
+
+    auto data = static_cast<const uint8_t*>(mapping);
+    auto header = reinterpret_cast<const GlyphMeshCacheHeader*>(data);
+    if (memcmp(header->magic, GlyphMeshCacheMagic, sizeof(header->magic))
+        || header->version != GlyphMeshCacheVersion
+        || header->fileSize != size
+        || header->indexOffset + header->entryCount * sizeof(GlyphMeshCacheIndexEntry) > header->dataOffset
+        || header->dataOffset > size) {
+        munmap(mapping, size);
+        return nullptr;
+    }
+
+    return new GlyphMeshCache { data, size, header, reinterpret_cast<const GlyphMeshCacheIndexEntry*>(data + header->indexOffset) };
+}
+
+void closeGlyphMeshCache(GlyphMeshCacheRef cache) {
+    if (!cache)
+        return;
+    munmap(const_cast<uint8_t*>(cache->data), cache->size);
+    delete cache;
+}
+
+size_t glyphMeshCacheEntryCount(GlyphMeshCacheRef cache) {
+    return cache->header->entryCount;
+}
+
+bool glyphMeshCacheLookup(GlyphMeshCacheRef cache, uint64_t fontKey, CGGlyph glyphID, GlyphMeshView* result) {
+    auto key = std::make_pair(fontKey, static_cast<uint32_t>(glyphID));
+    auto end = cache->index + cache->header->entryCount;
+    auto entry = std::lower_bound(cache->index, end, key, [](const GlyphMeshCacheIndexEntry& entry, std::pair<uint64_t, uint32_t> key) {
+        return std::make_pair(entry.fontKey, entry.glyphID) < key;
+    });
+    if (entry == end || entry->fontKey != fontKey || entry->glyphID != glyphID)
+        return false;
+    if (entry->coefficientsOffset + entry->vertexCount * sizeof(vector_float4) > cache->size)
+        return false;
+    result->positions = reinterpret_cast<const vector_float2*>(cache->data + entry->positionsOffset);
+    result->coefficients = reinterpret_cast<const vector_float4*>(cache->data + entry->coefficientsOffset);
+    result->vertexCount = entry->vertexCount;
+    return true;
+}
+
+bool writeGlyphMeshCache(const char* path, const GlyphMeshCacheEntry* entries, size_t count) {
+    std::vector<const GlyphMeshCacheEntry*> sorted;
+    for (size_t i = 0; i < count; ++i)
+        sorted.push_back(entries + i);
+    std::stable_sort(sorted.begin(), sorted.end(), [](const GlyphMeshCacheEntry* a, const GlyphMeshCacheEntry* b) {
+        return std::make_pair(a->fontKey, a->glyphID) < std::make_pair(b->fontKey, b->glyphID);
+    });
+    sorted.erase(std::unique(sorted.begin(), sorted.end(), [](const GlyphMeshCacheEntry* a, const GlyphMeshCacheEntry* b) {
+        return a->fontKey == b->fontKey && a->glyphID == b->glyphID;
+    }), sorted.end());
+
+    GlyphMeshCacheHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, GlyphMeshCacheMagic, sizeof(header.magic));
+    header.version = GlyphMeshCacheVersion;
+    header.entryCount = static_cast<uint32_t>(sorted.size());
+    header.indexOffset = GlyphMeshCachePageSize;
+    header.dataOffset = roundUp(header.indexOffset + sorted.size() * sizeof(GlyphMeshCacheIndexEntry), GlyphMeshCachePageSize);
+
+    std::vector<GlyphMeshCacheIndexEntry> index;
+    uint64_t offset = header.dataOffset;
+    for (auto entry : sorted) {
+        GlyphMeshCacheIndexEntry indexEntry;
+        indexEntry.fontKey = entry->fontKey;
+        indexEntry.glyphID = entry->glyphID;
+        indexEntry.vertexCount = static_cast<uint32_t>(entry->mesh.vertexCount);
+        indexEntry.positionsOffset = offset;
+        offset = roundUp(offset + entry->mesh.vertexCount * sizeof(vector_float2), sizeof(vector_float4));
+        indexEntry.coefficientsOffset = offset;
+        offset += entry->mesh.vertexCount * sizeof(vector_float4);
+        index.push_back(indexEntry);
+    }
+    header.fileSize = offset;
+
+    // Write to a temporary file and rename it into place, so a concurrent reader never maps a half-written cache.
+    std::string temporaryPath = std::string(path) + ".tmp";
+    FILE* file = fopen(temporaryPath.c_str(), "wb");
+    if (!file)
+        return false;
+    std::vector<uint8_t> padding(GlyphMeshCachePageSize);
+    bool success = fwrite(&header, sizeof(header), 1, file) == 1
+        && fwrite(padding.data(), 1, header.indexOffset - sizeof(header), file) == header.indexOffset - sizeof(header)
+        && fwrite(index.data(), sizeof(GlyphMeshCacheIndexEntry), index.size(), file) == index.size();
+    uint64_t position = header.indexOffset + index.size() * sizeof(GlyphMeshCacheIndexEntry);
+    for (size_t i = 0; success && i < sorted.size(); ++i) {
+        auto& mesh = sorted[i]->mesh;
+        success = fwrite(padding.data(), 1, index[i].positionsOffset - position, file) == index[i].positionsOffset - position
+            && fwrite(mesh.positions, sizeof(vector_float2), mesh.vertexCount, file) == mesh.vertexCount;
+        position = index[i].positionsOffset + mesh.vertexCount * sizeof(vector_float2);
+        success = success
+            && fwrite(padding.data(), 1, index[i].coefficientsOffset - position, file) == index[i].coefficientsOffset - position
+            && fwrite(mesh.coefficients, sizeof(vector_float4), mesh.vertexCount, file) == mesh.vertexCount;
+        position = index[i].coefficientsOffset + mesh.vertexCount * sizeof(vector_float4);
+    }
+    if (success && position < header.dataOffset)
+        success = fwrite(padding.data(), 1, header.dataOffset - position, file) == header.dataOffset - position;
+    success = !fclose(file) && success;
+    if (!success || rename(temporaryPath.c_str(), path)) {
+        remove(temporaryPath.c_str());
+        return false;
+    }
+    return true;
+}
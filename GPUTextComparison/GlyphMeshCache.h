@@ -0,0 +1,76 @@
+//
+//  GlyphMeshCache.h
+//  GPUTextComparison
+//
+//  Created by Litherum on 5/15/16.
+//  Copyright © 2016 Litherum. All rights reserved.
+//
+
+#ifndef GlyphMeshCache_h
+#define GlyphMeshCache_h
+
+#include <CoreGraphics/CoreGraphics.h>
+#include <simd/simd.h>
+
+#include "Triangulator.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// On-disk layout, all little-endian:
+// - A header, padded out to glyphMeshCachePageSize.
+// - The index: entryCount GlyphMeshCacheIndexEntry records sorted by (fontKey, glyphID), padded out to a page boundary.
+// - The vertex data: for each entry, vertexCount float2 positions followed by vertexCount float4 coefficients.
+// Everything is usable in place after mmap(); a lookup is a binary search over the index.
+#define GlyphMeshCacheMagic "LBMESHC"
+#define GlyphMeshCacheVersion 1
+#define GlyphMeshCachePageSize 16384
+
+typedef struct GlyphMeshCacheHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t entryCount;
+    uint64_t indexOffset;
+    uint64_t dataOffset;
+    uint64_t fileSize;
+} GlyphMeshCacheHeader;
+
+typedef struct GlyphMeshCacheIndexEntry {
+    uint64_t fontKey;
+    uint32_t glyphID;
+    uint32_t vertexCount;
+    uint64_t positionsOffset;
+    uint64_t coefficientsOffset;
+} GlyphMeshCacheIndexEntry;
+
+// Fonts are identified by a caller-chosen string, such as the PostScript name and the point size.
+uint64_t glyphMeshCacheFontKey(const char* fontIdentity);
+
+typedef struct GlyphMeshCache* GlyphMeshCacheRef;
+
+// Returns NULL if the file is missing, truncated, or was written by a different version.
+GlyphMeshCacheRef openGlyphMeshCache(const char* path);
+void closeGlyphMeshCache(GlyphMeshCacheRef);
+size_t glyphMeshCacheEntryCount(GlyphMeshCacheRef);
+
+// The returned pointers point into the mapping, and stay valid until the cache is closed.
+typedef struct GlyphMeshView {
+    const vector_float2* positions;
+    const vector_float4* coefficients;
+    size_t vertexCount;
+} GlyphMeshView;
+bool glyphMeshCacheLookup(GlyphMeshCacheRef, uint64_t fontKey, CGGlyph, GlyphMeshView*);
+
+typedef struct GlyphMeshCacheEntry {
+    uint64_t fontKey;
+    CGGlyph glyphID;
+    CubicTriangleMesh mesh;
+} GlyphMeshCacheEntry;
+bool writeGlyphMeshCache(const char* path, const GlyphMeshCacheEntry*, size_t count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GlyphMeshCache_h */
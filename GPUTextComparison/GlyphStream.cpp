@@ -0,0 +1,71 @@
+//
+//  GlyphStream.cpp
+//  GPUTextComparison
+//
+//  Created by Litherum on 5/24/16.
+//  Copyright © 2016 Litherum. All rights reserved.
+//
+
+#include "GlyphStream.h"
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <unordered_map>
+
+struct GlyphStreamWriter {
+    FILE* file;
+    bool failed;
+};
+
+GlyphStreamWriterRef createGlyphStreamWriter(const char* path) {
+    FILE* file = fopen(path, "w");
+    if (!file)
+        return nullptr;
+    return new GlyphStreamWriter { file, false };
+}
+
+void glyphStreamWriterBeginFrame(GlyphStreamWriterRef writer) {
+    if (fprintf(writer->file, "frame\n") < 0)
+        writer->failed = true;
+}
+
+void glyphStreamWriterAppend(GlyphStreamWriterRef writer, const char* fontIdentity, CGGlyph glyph, CGPoint position) {
+    if (fprintf(writer->file, "%s %u %.17g %.17g\n", fontIdentity, static_cast<unsigned>(glyph), position.x, position.y) < 0)
+        writer->failed = true;
+}
+
+bool destroyGlyphStreamWriter(GlyphStreamWriterRef writer) {
+    bool success = !writer->failed && !fclose(writer->file);
+    delete writer;
+    return success;
+}
+
+bool readGlyphStream(const char* path, GlyphStream& result) {
+    std::ifstream stream(path);
+    if (!stream)
+        return false;
+
+    std::unordered_map<std::string, uint32_t> fonts;
+    std::string line;
+    while (std::getline(stream, line)) {
+        if (line.empty() || line[0] == '#')
+            continue;
+        if (line == "frame") {
+            result.frames.emplace_back();
+            continue;
+        }
+        std::istringstream lineStream(line);
+        std::string fontIdentity;
+        unsigned glyphID;
+        CGFloat x;
+        CGFloat y;
+        if (result.frames.empty() || !(lineStream >> fontIdentity >> glyphID >> x >> y))
+            return false;
+        auto font = fonts.emplace(fontIdentity, static_cast<uint32_t>(result.fontIdentities.size()));
+        if (font.second)
+            result.fontIdentities.push_back(fontIdentity);
+        result.frames.back().push_back({ font.first->second, static_cast<CGGlyph>(glyphID), CGPointMake(x, y) });
+    }
+    return stream.eof();
+}
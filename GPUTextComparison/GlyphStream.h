@@ -0,0 +1,53 @@
+//
+//  GlyphStream.h
+//  GPUTextComparison
+//
+//  Created by Litherum on 5/24/16.
+//  Copyright © 2016 Litherum. All rights reserved.
+//
+
+#ifndef GlyphStream_h
+#define GlyphStream_h
+
+#include <CoreGraphics/CoreGraphics.h>
+
+// A glyph stream is a text file of every glyph the app draws, frame by frame, so caching policies can be replayed
+// without CoreText:
+//     frame
+//     <font identity> <glyph ID> <x> <y>
+// Lines starting with # are comments. Font identities must not contain whitespace, and match the ones in outline
+// corpora (see OutlineCorpus.h), so a stream's glyph shapes can be looked up in a corpus.
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct GlyphStreamWriter* GlyphStreamWriterRef;
+GlyphStreamWriterRef createGlyphStreamWriter(const char* path);
+void glyphStreamWriterBeginFrame(GlyphStreamWriterRef);
+void glyphStreamWriterAppend(GlyphStreamWriterRef, const char* fontIdentity, CGGlyph, CGPoint position);
+// Returns false if anything failed to write.
+bool destroyGlyphStreamWriter(GlyphStreamWriterRef);
+
+#ifdef __cplusplus
+}
+
+#include <string>
+#include <vector>
+
+struct StreamGlyph {
+    // Into GlyphStream::fontIdentities.
+    uint32_t font;
+    CGGlyph glyphID;
+    CGPoint position;
+};
+
+struct GlyphStream {
+    std::vector<std::string> fontIdentities;
+    std::vector<std::vector<StreamGlyph>> frames;
+};
+
+bool readGlyphStream(const char* path, GlyphStream&);
+#endif
+
+#endif /* GlyphStream_h */
@@ -0,0 +1,279 @@
+//
+//  HullSeparation.cpp
+//  GPUTextComparison
+//
+//  Created by Litherum on 5/31/16.
+//  Copyright © 2016 Litherum. All rights reserved.
+//
+
+#include "HullSeparation.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+HullSeparationStats& HullSeparationStats::operator+=(const HullSeparationStats& other) {
+    curves += other.curves;
+    candidatePairs += other.candidatePairs;
+    overlaps += other.overlaps;
+    subdivisions += other.subdivisions;
+    unresolvedOverlaps += other.unresolvedOverlaps;
+    passes += other.passes;
+    return *this;
+}
+
+void CurveHullSeparator::clear() {
+    edges.clear();
+    contours.clear();
+    pieceCounts.clear();
+    contourStart = CGPointZero;
+    contourOpen = false;
+}
+
+void CurveHullSeparator::moveTo(CGPoint point) {
+    contourOpen = false;
+    contourStart = point;
+    beginContourIfNeeded();
+}
+
+void CurveHullSeparator::beginContourIfNeeded() {
+    if (contourOpen)
+        return;
+    uint32_t begin = static_cast<uint32_t>(edges.size());
+    contours.push_back({ begin, begin });
+    contourOpen = true;
+}
+
+void CurveHullSeparator::addLine(CGPoint from, CGPoint to) {
+    if (CGPointEqualToPoint(from, to))
+        return;
+    beginContourIfNeeded();
+    edges.push_back({ {{ from, to, to, to }}, noCurve, static_cast<uint32_t>(contours.size() - 1), 0, false });
+    contours.back().end = static_cast<uint32_t>(edges.size());
+}
+
+void CurveHullSeparator::addCurve(size_t curve, CGPoint p0, CGPoint p1, CGPoint p2, CGPoint p3) {
+    beginContourIfNeeded();
+    edges.push_back({ {{ p0, p1, p2, p3 }}, static_cast<uint32_t>(curve), static_cast<uint32_t>(contours.size() - 1), 0, false });
+    contours.back().end = static_cast<uint32_t>(edges.size());
+    if (pieceCounts.size() <= curve)
+        pieceCounts.resize(curve + 1, 1);
+}
+
+void CurveHullSeparator::closeContour(CGPoint current) {
+    if (!contourOpen)
+        return;
+    addLine(current, contourStart);
+    contourOpen = false;
+}
+
+CurveHullSeparator::Box CurveHullSeparator::edgeBounds(const Edge& edge) {
+    Box box = { edge.points[0].x, edge.points[0].y, edge.points[0].x, edge.points[0].y };
+    for (unsigned i = 1; i < (edge.curve == noCurve ? 2u : 4u); ++i)
+        box.add(edge.points[i]);
+    return box;
+}
+
+bool CurveHullSeparator::boundsOverlap(const Box& a, const Box& b) {
+    return a.minX <= b.maxX && b.minX <= a.maxX && a.minY <= b.maxY && b.minY <= a.maxY;
+}
+
+// Looks for an axis the hulls' projections don't overlap on. Every edge of a hull joins some pair of its points, so
+// trying the normal of every pair finds one whenever the hulls are apart. Touching counts as apart.
+static bool hullsSeparated(const CGPoint* a, unsigned aCount, const CGPoint* b, unsigned bCount, CGFloat size) {
+    auto separatedAlong = [&](CGFloat axisX, CGFloat axisY) {
+        CGFloat length = std::hypot(axisX, axisY);
+        if (!(length > 0))
+            return false;
+        CGFloat aMin = std::numeric_limits<CGFloat>::infinity();
+        CGFloat aMax = -aMin;
+        CGFloat bMin = aMin;
+        CGFloat bMax = -aMin;
+        for (unsigned i = 0; i < aCount; ++i) {
+            CGFloat projection = a[i].x * axisX + a[i].y * axisY;
+            aMin = std::min(aMin, projection);
+            aMax = std::max(aMax, projection);
+        }
+        for (unsigned i = 0; i < bCount; ++i) {
+            CGFloat projection = b[i].x * axisX + b[i].y * axisY;
+            bMin = std::min(bMin, projection);
+            bMax = std::max(bMax, projection);
+        }
+        CGFloat tolerance = 1e-9 * length * size;
+        return aMax <= bMin + tolerance || bMax <= aMin + tolerance;
+    };
+    auto separatedByPairs = [&](const CGPoint* points, unsigned count) {
+        for (unsigned i = 0; i < count; ++i) {
+            for (unsigned j = i + 1; j < count; ++j) {
+                if (separatedAlong(points[i].y - points[j].y, points[j].x - points[i].x))
+                    return true;
+            }
+        }
+        return false;
+    };
+    return separatedByPairs(a, aCount) || separatedByPairs(b, bCount);
+}
+
+void CurveHullSeparator::testPair(uint32_t a, uint32_t b, HullSeparationStats& stats, size_t& overlaps, size_t& unresolved) {
+    auto& first = edges[a];
+    auto& second = edges[b];
+    // Neighboring edges always share an end point, but that's all they may share: hullsSeparated() lets hulls touch, so
+    // a curve whose hull only meets the next edge there passes, and one whose control points cross it doesn't.
+    if ((first.curve == noCurve && second.curve == noCurve) || !boundsOverlap(bounds[a], bounds[b]))
+        return;
+    ++stats.candidatePairs;
+    unsigned firstCount = first.curve == noCurve ? 2 : 4;
+    unsigned secondCount = second.curve == noCurve ? 2 : 4;
+    auto size = [](const Box& box) {
+        return std::max(box.maxX - box.minX, box.maxY - box.minY);
+    };
+    if (hullsSeparated(first.points.data(), firstCount, second.points.data(), secondCount, size(bounds[a]) + size(bounds[b])))
+        return;
+    ++overlaps;
+
+    // The bigger hull is likelier to be the one in the way.
+    auto splittable = [](const Edge& edge) {
+        return edge.curve != noCurve && edge.depth < MaximumHullSplitDepth;
+    };
+    Edge* split = nullptr;
+    if (splittable(first) && (!splittable(second) || size(bounds[a]) >= size(bounds[b])))
+        split = &first;
+    else if (splittable(second))
+        split = &second;
+    if (split)
+        split->split = true;
+    else
+        ++unresolved;
+}
+
+void CurveHullSeparator::findOverlaps(bool allPairs, HullSeparationStats& stats, size_t& overlaps, size_t& unresolved) {
+    uint32_t count = static_cast<uint32_t>(edges.size());
+    bounds.resize(count);
+    if (count < 2)
+        return;
+    for (uint32_t i = 0; i < count; ++i)
+        bounds[i] = edgeBounds(edges[i]);
+    Box all = bounds[0];
+    for (auto& box : bounds) {
+        all.add({ box.minX, box.minY });
+        all.add({ box.maxX, box.maxY });
+    }
+    if (allPairs) {
+        for (uint32_t a = 0; a < count; ++a) {
+            for (uint32_t b = a + 1; b < count; ++b)
+                testPair(a, b, stats, overlaps, unresolved);
+        }
+        return;
+    }
+
+    // About one cell per edge.
+    unsigned gridSize = static_cast<unsigned>(std::min(std::max(std::ceil(std::sqrt(static_cast<double>(count))), 1.0), 1024.0));
+    CGFloat cellWidth = all.maxX > all.minX ? (all.maxX - all.minX) / gridSize : 1;
+    CGFloat cellHeight = all.maxY > all.minY ? (all.maxY - all.minY) / gridSize : 1;
+    auto column = [&](CGFloat x) {
+        return static_cast<unsigned>(std::min(std::max((x - all.minX) / cellWidth, CGFloat(0)), CGFloat(gridSize - 1)));
+    };
+    auto row = [&](CGFloat y) {
+        return static_cast<unsigned>(std::min(std::max((y - all.minY) / cellHeight, CGFloat(0)), CGFloat(gridSize - 1)));
+    };
+    // Counting sort the edges into the cells their boxes touch.
+    cellStarts.assign(gridSize * gridSize + 1, 0);
+    for (uint32_t i = 0; i < count; ++i) {
+        auto& box = bounds[i];
+        for (unsigned y = row(box.minY); y <= row(box.maxY); ++y) {
+            for (unsigned x = column(box.minX); x <= column(box.maxX); ++x)
+                ++cellStarts[y * gridSize + x + 1];
+        }
+    }
+    for (size_t i = 1; i < cellStarts.size(); ++i)
+        cellStarts[i] += cellStarts[i - 1];
+    cellEdges.resize(cellStarts.back());
+    for (uint32_t i = 0; i < count; ++i) {
+        auto& box = bounds[i];
+        for (unsigned y = row(box.minY); y <= row(box.maxY); ++y) {
+            for (unsigned x = column(box.minX); x <= column(box.maxX); ++x)
+                cellEdges[cellStarts[y * gridSize + x]++] = i;
+        }
+    }
+    // Filling moved each start up to the next cell's start.
+    for (size_t i = cellStarts.size() - 1; i > 0; --i)
+        cellStarts[i] = cellStarts[i - 1];
+    cellStarts[0] = 0;
+
+    // A pair can share many cells, so only the one holding the lower left corner of the boxes' overlap tests it.
+    for (unsigned cell = 0; cell < gridSize * gridSize; ++cell) {
+        for (uint32_t i = cellStarts[cell]; i < cellStarts[cell + 1]; ++i) {
+            for (uint32_t j = i + 1; j < cellStarts[cell + 1]; ++j) {
+                uint32_t a = cellEdges[i];
+                uint32_t b = cellEdges[j];
+                CGFloat overlapX = std::max(bounds[a].minX, bounds[b].minX);
+                CGFloat overlapY = std::max(bounds[a].minY, bounds[b].minY);
+                if (row(overlapY) * gridSize + column(overlapX) == cell)
+                    testPair(a, b, stats, overlaps, unresolved);
+            }
+        }
+    }
+}
+
+// Halves every marked curve with de Casteljau's algorithm, keeping each contour's edges together and in order.
+void CurveHullSeparator::splitMarked(HullSeparationStats& stats) {
+    auto midpoint = [](CGPoint a, CGPoint b) {
+        return CGPointMake((a.x + b.x) / 2, (a.y + b.y) / 2);
+    };
+    nextEdges.clear();
+    for (auto& contour : contours) {
+        uint32_t begin = static_cast<uint32_t>(nextEdges.size());
+        for (uint32_t i = contour.begin; i < contour.end; ++i) {
+            auto edge = edges[i];
+            if (!edge.split) {
+                nextEdges.push_back(edge);
+                continue;
+            }
+            auto& p = edge.points;
+            CGPoint p01 = midpoint(p[0], p[1]);
+            CGPoint p12 = midpoint(p[1], p[2]);
+            CGPoint p23 = midpoint(p[2], p[3]);
+            CGPoint p012 = midpoint(p01, p12);
+            CGPoint p123 = midpoint(p12, p23);
+            CGPoint p0123 = midpoint(p012, p123);
+            uint8_t depth = edge.depth + 1;
+            nextEdges.push_back({ {{ p[0], p01, p012, p0123 }}, edge.curve, edge.contour, depth, false });
+            nextEdges.push_back({ {{ p0123, p123, p23, p[3] }}, edge.curve, edge.contour, depth, false });
+            ++pieceCounts[edge.curve];
+            ++stats.subdivisions;
+        }
+        contour.begin = begin;
+        contour.end = static_cast<uint32_t>(nextEdges.size());
+    }
+    edges.swap(nextEdges);
+}
+
+HullSeparationStats CurveHullSeparator::separate(CubicBatch& curves, bool allPairs) {
+    HullSeparationStats stats;
+    pieceCounts.resize(curves.size(), 1);
+    for (auto& edge : edges) {
+        if (edge.curve != noCurve)
+            ++stats.curves;
+    }
+    for (;;) {
+        ++stats.passes;
+        size_t overlaps = 0;
+        size_t unresolved = 0;
+        findOverlaps(allPairs, stats, overlaps, unresolved);
+        if (stats.passes == 1)
+            stats.overlaps = overlaps;
+        stats.unresolvedOverlaps = unresolved;
+        if (overlaps == unresolved)
+            break;
+        splitMarked(stats);
+    }
+    if (!stats.subdivisions)
+        return stats;
+
+    curves.clear();
+    for (auto& edge : edges) {
+        if (edge.curve != noCurve)
+            curves.append(edge.points[0], edge.points[1], edge.points[2], edge.points[3]);
+    }
+    return stats;
+}
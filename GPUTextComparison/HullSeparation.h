@@ -0,0 +1,170 @@
+//
+//  HullSeparation.h
+//  GPUTextComparison
+//
+//  Created by Litherum on 5/31/16.
+//  Copyright © 2016 Litherum. All rights reserved.
+//
+
+#ifndef HullSeparation_h
+#define HullSeparation_h
+
+#include <CoreGraphics/CoreGraphics.h>
+
+#include "CubicClassification.h"
+#include "PathSource.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <vector>
+
+// Loop-Blinn draws each curve as triangles covering its control points' hull, so no curve's hull may overlap any other
+// edge's: otherwise the triangulator makes faces that overlap, or an interior that pokes through a curve. Outlines
+// break this all the time, at thin stems, tight joins, and contours that cross. Splitting a curve in half shrinks its
+// hull, so splitting just the curves involved in an overlap, again and again, separates everything that doesn't
+// actually touch.
+//
+// Overlaps are found with a uniform grid over the edges' bounding boxes, about one cell per edge, so each pass costs
+// roughly linear time instead of testing every pair. Boxes that share a cell are tested exactly, by looking for a
+// separating axis. Hulls that only touch don't count, which is what lets neighboring edges of a contour share their
+// end point, while a curve whose hull crosses the next edge at a tight join is still split. Straight edges are never
+// split, and two straight edges are never tested; crossing lines are the interior triangulation's problem.
+//
+// A curve that really crosses another edge never separates, so no piece is split more than MaximumHullSplitDepth
+// times.
+#define MaximumHullSplitDepth 5
+
+struct HullSeparationStats {
+    HullSeparationStats& operator+=(const HullSeparationStats&);
+
+    size_t curves { 0 };
+    // Pairs of edges whose boxes overlap, tested exactly, over every pass.
+    size_t candidatePairs { 0 };
+    // Overlapping pairs in the outline as it came in.
+    size_t overlaps { 0 };
+    // Curves split in half.
+    size_t subdivisions { 0 };
+    // Overlapping pairs left once every curve in them was as split as it may get.
+    size_t unresolvedOverlaps { 0 };
+    unsigned passes { 0 };
+};
+
+// Keeps its buffers across outlines, like the rest of TriangulationScratch.
+class CurveHullSeparator {
+public:
+    void clear();
+
+    // Edges in path order. curve is the curve's index in the CubicBatch it was appended to.
+    void moveTo(CGPoint);
+    void addLine(CGPoint from, CGPoint to);
+    void addCurve(size_t curve, CGPoint p0, CGPoint p1, CGPoint p2, CGPoint p3);
+    void closeContour(CGPoint current);
+
+    // Splits curves until nothing overlaps, then, if anything was split, replaces the control points in curves with
+    // every curve's pieces in order. curves must hold just this outline's curves, not yet classified. allPairs tests
+    // every pair of edges instead of using the grid, for comparison.
+    HullSeparationStats separate(CubicBatch& curves, bool allPairs = false);
+
+    // How many curves in the batch curve became. Valid after separate().
+    uint32_t pieceCount(size_t curve) const {
+        return pieceCounts[curve];
+    }
+
+private:
+    static const uint32_t noCurve = UINT32_MAX;
+
+    struct Box {
+        void add(CGPoint point) {
+            minX = std::min(minX, point.x);
+            minY = std::min(minY, point.y);
+            maxX = std::max(maxX, point.x);
+            maxY = std::max(maxY, point.y);
+        }
+
+        CGFloat minX;
+        CGFloat minY;
+        CGFloat maxX;
+        CGFloat maxY;
+    };
+
+    struct Edge {
+        std::array<CGPoint, 4> points;
+        // The curve this is a piece of, or noCurve for a straight edge, which only uses points[0] and points[1].
+        uint32_t curve;
+        uint32_t contour;
+        uint8_t depth;
+        bool split;
+    };
+
+    struct Contour {
+        uint32_t begin;
+        uint32_t end;
+    };
+
+    static Box edgeBounds(const Edge&);
+    static bool boundsOverlap(const Box&, const Box&);
+
+    void beginContourIfNeeded();
+    void testPair(uint32_t, uint32_t, HullSeparationStats&, size_t& overlaps, size_t& unresolved);
+    void findOverlaps(bool allPairs, HullSeparationStats&, size_t& overlaps, size_t& unresolved);
+    void splitMarked(HullSeparationStats&);
+
+    std::vector<Edge> edges;
+    std::vector<Edge> nextEdges;
+    std::vector<Contour> contours;
+    std::vector<Box> bounds;
+    // The grid, as one list per cell: cell i's edges are cellEdges[cellStarts[i] ..< cellStarts[i + 1]].
+    std::vector<uint32_t> cellStarts;
+    std::vector<uint32_t> cellEdges;
+    std::vector<uint32_t> pieceCounts;
+    CGPoint contourStart { 0, 0 };
+    bool contourOpen { false };
+};
+
+static inline std::array<CGPoint, 2> quadraticToCubic(CGPoint source, CGPoint control, CGPoint destination) {
+    return {{ CGPointMake(source.x + 2 * (control.x - source.x) / 3, source.y + 2 * (control.y - source.y) / 3),
+        CGPointMake(destination.x + 2 * (control.x - destination.x) / 3, destination.y + 2 * (control.y - destination.y) / 3) }};
+}
+
+// Appends every curve in the path to curves, quadratics raised to cubics, and tells separator, if there is one, about
+// every edge.
+template <typename PathSource>
+void collectCurves(const PathSource& source, CubicBatch& curves, CurveHullSeparator* separator) {
+    CGPoint current = CGPointZero;
+    CGPoint begin = CGPointZero;
+    source.iterate([&](PathElement element) {
+        switch (element.type) {
+        case PathElementMoveToPoint:
+            current = begin = element.points[0];
+            if (separator)
+                separator->moveTo(current);
+            break;
+        case PathElementAddLineToPoint:
+            if (separator)
+                separator->addLine(current, element.points[0]);
+            current = element.points[0];
+            break;
+        case PathElementAddQuadCurveToPoint: {
+            auto controlPoints = quadraticToCubic(current, element.points[0], element.points[1]);
+            if (separator)
+                separator->addCurve(curves.size(), current, controlPoints[0], controlPoints[1], element.points[1]);
+            curves.append(current, controlPoints[0], controlPoints[1], element.points[1]);
+            current = element.points[1];
+            break;
+        }
+        case PathElementAddCurveToPoint:
+            if (separator)
+                separator->addCurve(curves.size(), current, element.points[0], element.points[1], element.points[2]);
+            curves.append(current, element.points[0], element.points[1], element.points[2]);
+            current = element.points[2];
+            break;
+        case PathElementCloseSubpath:
+            if (separator)
+                separator->closeContour(current);
+            current = begin;
+        }
+    });
+}
+
+#endif /* HullSeparation_h */
@@ -0,0 +1,250 @@
+//
+//  IndexedMesh.cpp
+//  GPUTextComparison
+//
+//  Created by Litherum on 5/21/16.
+//  Copyright © 2016 Litherum. All rights reserved.
+//
+
+#include "IndexedMesh.h"
+
+#include "ParallelFor.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+static uint32_t hashVertex(const vector_float2& position, const vector_float4& coefficient) {
+    uint32_t words[6];
+    memcpy(words, &position, 2 * sizeof(uint32_t));
+    memcpy(words + 2, &coefficient, 4 * sizeof(uint32_t));
+    // FNV-1a, a word at a time.
+    uint32_t hash = 2166136261u;
+    for (auto word : words)
+        hash = (hash ^ word) * 16777619u;
+    return hash ^ (hash >> 15);
+}
+
+static bool equalVertices(const vector_float2* positions, const vector_float4* coefficients, uint32_t a, uint32_t b) {
+    return !memcmp(&positions[a], &positions[b], 2 * sizeof(float)) && !memcmp(&coefficients[a], &coefficients[b], 4 * sizeof(float));
+}
+
+bool indexCubicTriangles(const vector_float2* positions, const vector_float4* coefficients, size_t vertexCount, std::vector<vector_float2>& indexedPositions, std::vector<vector_float4>& indexedCoefficients, std::vector<uint16_t>& indices, MeshIndexingScratch& scratch) {
+    // Open addressing, at most half full. A slot holds a distinct vertex's number plus one, or 0 when empty.
+    size_t slotCount = 16;
+    while (slotCount < vertexCount * 2)
+        slotCount *= 2;
+    scratch.slots.assign(slotCount, 0);
+    scratch.uniqueVertices.clear();
+    scratch.indices.clear();
+    for (size_t i = 0; i < vertexCount; ++i) {
+        size_t slot = hashVertex(positions[i], coefficients[i]) & (slotCount - 1);
+        while (scratch.slots[slot] && !equalVertices(positions, coefficients, scratch.uniqueVertices[scratch.slots[slot] - 1], static_cast<uint32_t>(i)))
+            slot = (slot + 1) & (slotCount - 1);
+        if (!scratch.slots[slot]) {
+            if (scratch.uniqueVertices.size() == IndexedCubicTriangleMeshMaximumVertexCount)
+                return false;
+            scratch.uniqueVertices.push_back(static_cast<uint32_t>(i));
+            scratch.slots[slot] = static_cast<uint32_t>(scratch.uniqueVertices.size());
+        }
+        scratch.indices.push_back(static_cast<uint16_t>(scratch.slots[slot] - 1));
+    }
+
+    size_t uniqueCount = scratch.uniqueVertices.size();
+    optimizeVertexCacheOrder(scratch.indices.data(), scratch.indices.size(), uniqueCount, scratch);
+
+    // Number the vertices in the order the reordered triangles first use them, so vertex fetch walks forward too.
+    const uint32_t unnumbered = ~0u;
+    scratch.renumbering.assign(uniqueCount, unnumbered);
+    uint32_t nextNumber = 0;
+    for (auto index : scratch.indices) {
+        if (scratch.renumbering[index] == unnumbered) {
+            scratch.renumbering[index] = nextNumber++;
+            uint32_t source = scratch.uniqueVertices[index];
+            indexedPositions.push_back(positions[source]);
+            indexedCoefficients.push_back(coefficients[source]);
+        }
+        indices.push_back(static_cast<uint16_t>(scratch.renumbering[index]));
+    }
+    return true;
+}
+
+// The tuning constants from Forsyth's article.
+static const unsigned forsythCacheSize = 32;
+
+static float forsythVertexScore(int cachePosition, uint32_t liveTriangles) {
+    if (!liveTriangles)
+        return -1;
+    float score = 0;
+    if (cachePosition >= 0) {
+        // The three vertices of the triangle just emitted score the same, so emitting them in any order is as good.
+        if (cachePosition < 3)
+            score = 0.75f;
+        else
+            score = std::pow(1 - static_cast<float>(cachePosition - 3) / (forsythCacheSize - 3), 1.5f);
+    }
+    // Favor vertices with few triangles left, so they are finished off rather than left stranded.
+    return score + 2 * std::pow(static_cast<float>(liveTriangles), -0.5f);
+}
+
+void optimizeVertexCacheOrder(uint16_t* indices, size_t indexCount, size_t vertexCount, MeshIndexingScratch& scratch) {
+    size_t triangleCount = indexCount / 3;
+    if (triangleCount < 2)
+        return;
+
+    // Every vertex's triangles, as ranges of vertexTriangles. The first liveTriangles[v] of v's range are unemitted.
+    scratch.liveTriangles.assign(vertexCount, 0);
+    for (size_t i = 0; i < triangleCount * 3; ++i)
+        ++scratch.liveTriangles[indices[i]];
+    scratch.triangleOffsets.resize(vertexCount + 1);
+    scratch.triangleOffsets[0] = 0;
+    for (size_t v = 0; v < vertexCount; ++v)
+        scratch.triangleOffsets[v + 1] = scratch.triangleOffsets[v] + scratch.liveTriangles[v];
+    scratch.vertexTriangles.resize(triangleCount * 3);
+    scratch.liveTriangles.assign(vertexCount, 0);
+    for (size_t t = 0; t < triangleCount; ++t) {
+        for (unsigned j = 0; j < 3; ++j) {
+            auto v = indices[t * 3 + j];
+            scratch.vertexTriangles[scratch.triangleOffsets[v] + scratch.liveTriangles[v]++] = static_cast<uint32_t>(t);
+        }
+    }
+
+    scratch.cachePositions.assign(vertexCount, -1);
+    scratch.vertexScores.resize(vertexCount);
+    for (size_t v = 0; v < vertexCount; ++v)
+        scratch.vertexScores[v] = forsythVertexScore(-1, scratch.liveTriangles[v]);
+    scratch.triangleScores.resize(triangleCount);
+    for (size_t t = 0; t < triangleCount; ++t)
+        scratch.triangleScores[t] = scratch.vertexScores[indices[t * 3]] + scratch.vertexScores[indices[t * 3 + 1]] + scratch.vertexScores[indices[t * 3 + 2]];
+    scratch.emitted.assign(triangleCount, false);
+    scratch.reordered.clear();
+
+    // Three extra entries hold what the emitted triangle pushes out, until those vertices are rescored.
+    std::array<uint32_t, forsythCacheSize + 3> cache;
+    std::array<uint32_t, forsythCacheSize + 3> newCache;
+    size_t cacheCount = 0;
+    size_t best = std::max_element(scratch.triangleScores.begin(), scratch.triangleScores.end()) - scratch.triangleScores.begin();
+    size_t nextUnemitted = 0;
+    for (size_t emittedCount = 0; emittedCount < triangleCount; ++emittedCount) {
+        // Nothing in the cache has a triangle left; start again from the first unemitted triangle rather than
+        // scanning every triangle for the best score.
+        if (best == triangleCount) {
+            while (scratch.emitted[nextUnemitted])
+                ++nextUnemitted;
+            best = nextUnemitted;
+        }
+        scratch.emitted[best] = true;
+        const uint16_t* triangle = indices + best * 3;
+        scratch.reordered.insert(scratch.reordered.end(), triangle, triangle + 3);
+
+        size_t newCacheCount = 0;
+        for (unsigned j = 0; j < 3; ++j) {
+            uint32_t v = triangle[j];
+            auto begin = scratch.vertexTriangles.begin() + scratch.triangleOffsets[v];
+            auto end = begin + scratch.liveTriangles[v];
+            std::iter_swap(std::find(begin, end, static_cast<uint32_t>(best)), end - 1);
+            --scratch.liveTriangles[v];
+            // A degenerate triangle can name a vertex twice.
+            if (std::find(newCache.begin(), newCache.begin() + newCacheCount, v) == newCache.begin() + newCacheCount)
+                newCache[newCacheCount++] = v;
+        }
+        for (size_t i = 0; i < cacheCount; ++i) {
+            uint32_t v = cache[i];
+            if (v != triangle[0] && v != triangle[1] && v != triangle[2])
+                newCache[newCacheCount++] = v;
+        }
+        std::swap(cache, newCache);
+        cacheCount = newCacheCount;
+
+        for (size_t i = 0; i < cacheCount; ++i) {
+            uint32_t v = cache[i];
+            scratch.cachePositions[v] = i < forsythCacheSize ? static_cast<int>(i) : -1;
+            scratch.vertexScores[v] = forsythVertexScore(scratch.cachePositions[v], scratch.liveTriangles[v]);
+        }
+        cacheCount = std::min<size_t>(cacheCount, forsythCacheSize);
+
+        // Only triangles touching the cache changed score, and the best of them is the next one out.
+        best = triangleCount;
+        float bestScore = -1;
+        for (size_t i = 0; i < newCacheCount; ++i) {
+            uint32_t v = cache[i];
+            auto begin = scratch.triangleOffsets[v];
+            for (auto k = begin; k < begin + scratch.liveTriangles[v]; ++k) {
+                uint32_t t = scratch.vertexTriangles[k];
+                float score = scratch.vertexScores[indices[t * 3]] + scratch.vertexScores[indices[t * 3 + 1]] + scratch.vertexScores[indices[t * 3 + 2]];
+                scratch.triangleScores[t] = score;
+                if (score > bestScore) {
+                    bestScore = score;
+                    best = t;
+                }
+            }
+        }
+    }
+    std::copy(scratch.reordered.begin(), scratch.reordered.end(), indices);
+}
+
+double averageCacheMissRatio(const uint16_t* indices, size_t indexCount, size_t vertexCount, unsigned cacheSize) {
+    size_t triangleCount = indexCount / 3;
+    if (!triangleCount)
+        return 0;
+    // A vertex is cached if fewer than cacheSize misses have happened since its own. Hits don't reorder a FIFO.
+    std::vector<size_t> missedAt(vertexCount, 0);
+    size_t misses = 0;
+    for (size_t i = 0; i < triangleCount * 3; ++i) {
+        auto v = indices[i];
+        if (!missedAt[v] || misses - missedAt[v] >= cacheSize)
+            missedAt[v] = ++misses;
+    }
+    return static_cast<double>(misses) / triangleCount;
+}
+
+namespace {
+
+// Owns the intermediate vectors as well as the scratch, so a worker indexing many meshes reuses all of them.
+struct IndexedMeshBuilder {
+    bool build(const vector_float2* positions, const vector_float4* coefficients, size_t vertexCount, IndexedCubicTriangleMesh* result) {
+        indexedPositions.clear();
+        indexedCoefficients.clear();
+        indices.clear();
+        *result = { nullptr, nullptr, 0, nullptr, 0 };
+        if (!indexCubicTriangles(positions, coefficients, vertexCount, indexedPositions, indexedCoefficients, indices, scratch))
+            return false;
+        if (indices.empty())
+            return true;
+        result->positions = static_cast<vector_float2*>(malloc(indexedPositions.size() * sizeof(vector_float2)));
+        result->coefficients = static_cast<vector_float4*>(malloc(indexedCoefficients.size() * sizeof(vector_float4)));
+        result->vertexCount = indexedPositions.size();
+        result->indices = static_cast<uint16_t*>(malloc(indices.size() * sizeof(uint16_t)));
+        result->indexCount = indices.size();
+        memcpy(result->positions, indexedPositions.data(), indexedPositions.size() * sizeof(vector_float2));
+        memcpy(result->coefficients, indexedCoefficients.data(), indexedCoefficients.size() * sizeof(vector_float4));
+        memcpy(result->indices, indices.data(), indices.size() * sizeof(uint16_t));
+        return true;
+    }
+
+    MeshIndexingScratch scratch;
+    std::vector<vector_float2> indexedPositions;
+    std::vector<vector_float4> indexedCoefficients;
+    std::vector<uint16_t> indices;
+};
+
+}
+
+bool createIndexedCubicTriangleMesh(const vector_float2* positions, const vector_float4* coefficients, size_t vertexCount, IndexedCubicTriangleMesh* result) {
+    return IndexedMeshBuilder().build(positions, coefficients, vertexCount, result);
+}
+
+void createIndexedCubicTriangleMeshes(const CubicTriangleMesh* meshes, size_t count, unsigned threadCount, IndexedCubicTriangleMesh* indexedMeshes) {
+    std::vector<IndexedMeshBuilder> builders(resolveThreadCount(threadCount));
+    parallelFor(count, threadCount, [&](size_t i, unsigned worker) {
+        builders[worker].build(meshes[i].positions, meshes[i].coefficients, meshes[i].vertexCount, &indexedMeshes[i]);
+    });
+}
+
+void destroyIndexedCubicTriangleMesh(IndexedCubicTriangleMesh mesh) {
+    free(mesh.positions);
+    free(mesh.coefficients);
+    free(mesh.indices);
+}
@@ -0,0 +1,81 @@
+//
+//  IndexedMesh.h
+//  GPUTextComparison
+//
+//  Created by Litherum on 5/21/16.
+//  Copyright © 2016 Litherum. All rights reserved.
+//
+
+#ifndef IndexedMesh_h
+#define IndexedMesh_h
+
+#include <simd/simd.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "Triangulator.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// The triangle soup from Triangulator, with each distinct (position, coefficient) pair stored once. Triangles are
+// reordered so consecutive ones share vertices, which keeps the GPU's post-transform vertex cache warm, and vertices
+// are numbered in the order the triangles first use them.
+typedef struct IndexedCubicTriangleMesh {
+    vector_float2* positions;
+    vector_float4* coefficients;
+    size_t vertexCount;
+    uint16_t* indices;
+    size_t indexCount;
+} IndexedCubicTriangleMesh;
+
+// 16-bit indices can't address more than this many vertices.
+#define IndexedCubicTriangleMeshMaximumVertexCount 65536
+
+// Returns false, and an empty mesh, if the soup has more distinct vertices than 16 bits can index. The result must be
+// released with destroyIndexedCubicTriangleMesh().
+bool createIndexedCubicTriangleMesh(const vector_float2* positions, const vector_float4* coefficients, size_t vertexCount, IndexedCubicTriangleMesh*);
+// Indexes meshes[i] into indexedMeshes[i] across threadCount threads (0 means one per core). meshes are left alone.
+void createIndexedCubicTriangleMeshes(const CubicTriangleMesh* meshes, size_t count, unsigned threadCount, IndexedCubicTriangleMesh* indexedMeshes);
+void destroyIndexedCubicTriangleMesh(IndexedCubicTriangleMesh);
+
+#ifdef __cplusplus
+}
+
+#include <vector>
+
+// Scratch for indexing one mesh after another without reallocating.
+struct MeshIndexingScratch {
+    // Deduplication.
+    std::vector<uint32_t> slots;
+    std::vector<uint32_t> uniqueVertices;
+    std::vector<uint16_t> indices;
+    std::vector<uint32_t> renumbering;
+    // Vertex cache ordering.
+    std::vector<uint32_t> triangleOffsets;
+    std::vector<uint32_t> vertexTriangles;
+    std::vector<uint32_t> liveTriangles;
+    std::vector<int> cachePositions;
+    std::vector<float> vertexScores;
+    std::vector<float> triangleScores;
+    std::vector<bool> emitted;
+    std::vector<uint16_t> reordered;
+};
+
+// Appends the distinct vertices of the soup to indexedPositions and indexedCoefficients, and the soup's triangles, in
+// optimizeVertexCacheOrder() order, to indices. Indices are relative to the first appended vertex. Vertices are equal
+// only if every bit is. Returns false, and appends nothing, if there are more than
+// IndexedCubicTriangleMeshMaximumVertexCount distinct vertices.
+bool indexCubicTriangles(const vector_float2* positions, const vector_float4* coefficients, size_t vertexCount, std::vector<vector_float2>& indexedPositions, std::vector<vector_float4>& indexedCoefficients, std::vector<uint16_t>& indices, MeshIndexingScratch&);
+
+// Forsyth's "Linear-Speed Vertex Cache Optimisation": repeatedly emits the triangle whose vertices score highest,
+// where a vertex scores for being recently used and for having few triangles left.
+void optimizeVertexCacheOrder(uint16_t* indices, size_t indexCount, size_t vertexCount, MeshIndexingScratch&);
+
+// Average cache miss ratio (vertex shader runs per triangle) for a FIFO post-transform cache of cacheSize entries.
+// A triangle soup scores 3; 0.5 is the best any mesh can do.
+double averageCacheMissRatio(const uint16_t* indices, size_t indexCount, size_t vertexCount, unsigned cacheSize);
+#endif
+
+#endif /* IndexedMesh_h */
@@ -0,0 +1,368 @@
+//
+//  InteriorTriangulator.cpp
+//  GPUTextComparison
+//
+//  Created by Litherum on 5/16/16.
+//  Copyright © 2016 Litherum. All rights reserved.
+//
+
+#include "InteriorTriangulator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+
+enum class Containment {
+    Outside,
+    Inside,
+    Boundary
+};
+
+static inline CGFloat cross(CGPoint a, CGPoint b, CGPoint c) {
+    return (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+}
+
+static CGFloat signedArea(const CGPoint* begin, const CGPoint* end) {
+    CGFloat result = 0;
+    for (auto i = begin, j = end - 1; i != end; j = i++)
+        result += (j->x - i->x) * (i->y + j->y);
+    return result / 2;
+}
+
+static Containment contains(const CGPoint* begin, const CGPoint* end, CGPoint point) {
+    bool inside = false;
+    for (auto i = begin, j = end - 1; i != end; j = i++) {
+        if (cross(*j, *i, point) == 0
+            && point.x >= std::min(i->x, j->x) && point.x <= std::max(i->x, j->x)
+            && point.y >= std::min(i->y, j->y) && point.y <= std::max(i->y, j->y))
+            return Containment::Boundary;
+        if ((i->y > point.y) != (j->y > point.y) && point.x < (j->x - i->x) * (point.y - i->y) / (j->y - i->y) + i->x)
+            inside = !inside;
+    }
+    return inside ? Containment::Inside : Containment::Outside;
+}
+
+static inline bool pointInTriangle(CGFloat ax, CGFloat ay, CGFloat bx, CGFloat by, CGFloat cx, CGFloat cy, CGFloat px, CGFloat py) {
+    return (cx - px) * (ay - py) >= (ax - px) * (cy - py)
+        && (ax - px) * (by - py) >= (bx - px) * (ay - py)
+        && (bx - px) * (cy - py) >= (cx - px) * (by - py);
+}
+
+// Outer rings are counterclockwise and holes are clockwise. Nodes never move once they are in the array,
+// and removing one just unlinks it, so the whole polygon is one allocation no matter how many times it's split.
+class EarClipper {
+public:
+    EarClipper(std::vector<CGPoint>& triangles, InteriorTriangulationScratch& scratch) : nodes(scratch.nodes), holeQueue(scratch.holeQueue), triangles(triangles) {
+    }
+
+    bool clip(const CGPoint* outerBegin, const CGPoint* outerEnd, const std::vector<std::pair<const CGPoint*, const CGPoint*>>& holes) {
+        nodes.clear();
+        int outer = link(outerBegin, outerEnd, true);
+        if (outer < 0 || next(outer) == prev(outer))
+            return true;
+
+        holeQueue.clear();
+        for (auto& hole : holes) {
+            int list = link(hole.first, hole.second, false);
+            if (list >= 0)
+                holeQueue.push_back(leftmost(list));
+        }
+        std::sort(holeQueue.begin(), holeQueue.end(), [&](int a, int b) {
+            return x(a) < x(b) || (x(a) == x(b) && y(a) < y(b));
+        });
+        for (auto hole : holeQueue) {
+            outer = eliminateHole(hole, outer);
+            if (outer < 0)
+                return false;
+        }
+
+        return clipLinked(outer, false);
+    }
+
+private:
+    typedef InteriorTriangulationScratch::Node Node;
+
+    CGFloat x(int i) const { return nodes[i].point.x; }
+    CGFloat y(int i) const { return nodes[i].point.y; }
+    int next(int i) const { return nodes[i].next; }
+    int prev(int i) const { return nodes[i].prev; }
+    CGFloat cross(int a, int b, int c) const { return ::cross(nodes[a].point, nodes[b].point, nodes[c].point); }
+    bool equals(int a, int b) const { return x(a) == x(b) && y(a) == y(b); }
+
+    int insertNode(CGPoint point, int last) {
+        int index = static_cast<int>(nodes.size());
+        if (last < 0)
+            nodes.push_back({ point, index, index });
+        else {
+            nodes.push_back({ point, last, next(last) });
+            nodes[next(last)].prev = index;
+            nodes[last].next = index;
+        }
+        return index;
+    }
+
+    void removeNode(int i) {
+        nodes[next(i)].prev = prev(i);
+        nodes[prev(i)].next = next(i);
+    }
+
+    int link(const CGPoint* begin, const CGPoint* end, bool counterclockwise) {
+        int last = -1;
+        if (counterclockwise == (signedArea(begin, end) > 0)) {
+            for (auto i = begin; i != end; ++i)
+                last = insertNode(*i, last);
+        } else {
+            for (auto i = end; i != begin; --i)
+                last = insertNode(*(i - 1), last);
+        }
+        if (last >= 0 && equals(last, next(last))) {
+            int duplicate = last;
+            last = next(last);
+            removeNode(duplicate);
+        }
+        return last;
+    }
+
+    int leftmost(int start) const {
+        int result = start;
+        int p = start;
+        do {
+            if (x(p) < x(result) || (x(p) == x(result) && y(p) < y(result)))
+                result = p;
+            p = next(p);
+        } while (p != start);
+        return result;
+    }
+
+    // Removes duplicate and collinear points between start and end.
+    int filterPoints(int start, int end) {
+        if (end < 0)
+            end = start;
+        int p = start;
+        bool again;
+        do {
+            again = false;
+            if (equals(p, next(p)) || cross(prev(p), p, next(p)) == 0) {
+                removeNode(p);
+                p = end = prev(p);
+                if (p == next(p))
+                    break;
+                again = true;
+            } else
+                p = next(p);
+        } while (again || p != end);
+        return end;
+    }
+
+    bool isEar(int ear) const {
+        int a = prev(ear);
+        int b = ear;
+        int c = next(ear);
+        if (cross(a, b, c) <= 0)
+            return false;
+
+        for (int p = next(c); p != a; p = next(p)) {
+            if (!equals(p, a) && pointInTriangle(x(a), y(a), x(b), y(b), x(c), y(c), x(p), y(p)) && cross(prev(p), p, next(p)) <= 0)
+                return false;
+        }
+        return true;
+    }
+
+    bool clipLinked(int ear, bool filtered) {
+        int stop = ear;
+        while (prev(ear) != next(ear)) {
+            int previous = prev(ear);
+            int following = next(ear);
+            if (isEar(ear)) {
+                triangles.push_back(nodes[previous].point);
+                triangles.push_back(nodes[ear].point);
+                triangles.push_back(nodes[following].point);
+                removeNode(ear);
+                // Skipping the next vertex leads to fewer sliver triangles.
+                ear = next(following);
+                stop = ear;
+                continue;
+            }
+
+            ear = following;
+            if (ear == stop) {
+                if (!filtered)
+                    return clipLinked(filterPoints(ear, -1), true);
+                // CGAL handles whatever is left (self-intersections, and so on).
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool locallyInside(int a, int b) const {
+        if (cross(prev(a), a, next(a)) > 0)
+            return cross(a, b, next(a)) <= 0 && cross(a, prev(a), b) <= 0;
+        return cross(a, b, prev(a)) > 0 || cross(a, next(a), b) > 0;
+    }
+
+    bool sectorContainsSector(int m, int p) const {
+        return cross(prev(m), m, prev(p)) > 0 && cross(next(p), m, next(m)) > 0;
+    }
+
+    // Finds a vertex of the outer ring which can see the hole's leftmost vertex.
+    int findHoleBridge(int hole, int outer) const {
+        CGFloat hx = x(hole);
+        CGFloat hy = y(hole);
+        CGFloat qx = -std::numeric_limits<CGFloat>::infinity();
+        int m = -1;
+        int p = outer;
+        do {
+            int q = next(p);
+            if (hy <= y(p) && hy >= y(q) && y(q) != y(p)) {
+                CGFloat intersection = x(p) + (hy - y(p)) * (x(q) - x(p)) / (y(q) - y(p));
+                if (intersection <= hx && intersection > qx) {
+                    qx = intersection;
+                    m = x(p) < x(q) ? p : q;
+                    if (intersection == hx)
+                        return m;
+                }
+            }
+            p = q;
+        } while (p != outer);
+        if (m < 0)
+            return m;
+
+        // If any vertices are inside the triangle formed by the hole vertex, the intersection, and m, connect to
+        // the one making the smallest angle with the ray instead.
+        int stop = m;
+        CGFloat mx = x(m);
+        CGFloat my = y(m);
+        CGFloat tanMin = std::numeric_limits<CGFloat>::infinity();
+        p = m;
+        do {
+            if (hx >= x(p) && x(p) >= mx && hx != x(p)
+                && pointInTriangle(hy < my ? hx : qx, hy, mx, my, hy < my ? qx : hx, hy, x(p), y(p))) {
+                CGFloat tan = std::abs(hy - y(p)) / (hx - x(p));
+                if (locallyInside(p, hole)
+                    && (tan < tanMin || (tan == tanMin && (x(p) > x(m) || (x(p) == x(m) && sectorContainsSector(m, p)))))) {
+                    m = p;
+                    tanMin = tan;
+                }
+            }
+            p = next(p);
+        } while (p != stop);
+        return m;
+    }
+
+    // Joins a and b with a pair of coincident edges, turning two rings into one.
+    int splitPolygon(int a, int b) {
+        int a2 = static_cast<int>(nodes.size());
+        nodes.push_back(nodes[a]);
+        int b2 = static_cast<int>(nodes.size());
+        nodes.push_back(nodes[b]);
+        int an = next(a);
+        int bp = prev(b);
+
+        nodes[a].next = b;
+        nodes[b].prev = a;
+        nodes[a2].next = an;
+        nodes[an].prev = a2;
+        nodes[b2].next = a2;
+        nodes[a2].prev = b2;
+        nodes[bp].next = b2;
+        nodes[b2].prev = bp;
+        return b2;
+    }
+
+    int eliminateHole(int hole, int outer) {
+        int bridge = findHoleBridge(hole, outer);
+        if (bridge < 0)
+            return bridge;
+        int bridgeReverse = splitPolygon(bridge, hole);
+        filterPoints(bridgeReverse, next(bridgeReverse));
+        return filterPoints(bridge, next(bridge));
+    }
+
+    std::vector<Node>& nodes;
+    std::vector<int>& holeQueue;
+    std::vector<CGPoint>& triangles;
+};
+
+}
+
+bool triangulateInterior(const InnerBorder& border, TriangulationFillRule fillRule, std::vector<CGPoint>& triangles, InteriorTriangulationScratch& scratch) {
+    auto& contours = scratch.contours;
+    contours.clear();
+    size_t contourBegin = 0;
+    for (auto contourEnd : border.contourEnds) {
+        if (contourEnd - contourBegin >= 3) {
+            auto begin = border.points.data() + contourBegin;
+            auto end = border.points.data() + contourEnd;
+            auto area = signedArea(begin, end);
+            contours.push_back({ begin, end, std::abs(area), area > 0, 0, -1 });
+        }
+        contourBegin = contourEnd;
+    }
+
+    // Even-odd: a contour inside an even number of others is an outer ring, and otherwise it's a hole in the
+    // innermost contour around it.
+    for (size_t i = 0; i < contours.size(); ++i) {
+        for (size_t j = 0; j < contours.size(); ++j) {
+            if (i == j)
+                continue;
+            switch (contains(contours[j].begin, contours[j].end, *contours[i].begin)) {
+            case Containment::Boundary:
+                return false;
+            case Containment::Inside:
+                ++contours[i].depth;
+                break;
+            case Containment::Outside:
+                break;
+            }
+        }
+    }
+    for (size_t i = 0; i < contours.size(); ++i) {
+        if (contours[i].depth % 2 == 0)
+            continue;
+        for (size_t j = 0; j < contours.size(); ++j) {
+            if (contours[j].depth + 1 == contours[i].depth && contains(contours[j].begin, contours[j].end, *contours[i].begin) == Containment::Inside) {
+                contours[i].parent = static_cast<int>(j);
+                break;
+            }
+        }
+        if (contours[i].parent < 0)
+            return false;
+        // Winding the same way as its parent makes it part of the fill instead of a hole.
+        if (fillRule == TriangulationFillRuleNonZero && contours[i].counterclockwise == contours[contours[i].parent].counterclockwise)
+            return false;
+    }
+
+    auto originalSize = triangles.size();
+    EarClipper clipper(triangles, scratch);
+    CGFloat expectedArea = 0;
+    auto& holes = scratch.holes;
+    for (size_t i = 0; i < contours.size(); ++i) {
+        if (contours[i].depth % 2)
+            continue;
+        holes.clear();
+        expectedArea += contours[i].area;
+        for (auto& hole : contours) {
+            if (hole.parent == static_cast<int>(i)) {
+                holes.push_back(std::make_pair(hole.begin, hole.end));
+                expectedArea -= hole.area;
+            }
+        }
+        if (!clipper.clip(contours[i].begin, contours[i].end, holes)) {
+            triangles.resize(originalSize);
+            return false;
+        }
+    }
+
+    // Crossing contours and other inputs that slip past the checks above show up as a mismatch in area.
+    CGFloat actualArea = 0;
+    for (auto i = originalSize; i < triangles.size(); i += 3)
+        actualArea += std::abs(cross(triangles[i], triangles[i + 1], triangles[i + 2])) / 2;
+    if (std::abs(actualArea - expectedArea) > std::max(expectedArea, CGFloat(1)) * 1e-9) {
+        triangles.resize(originalSize);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,58 @@
+//
+//  InteriorTriangulator.h
+//  GPUTextComparison
+//
+//  Created by Litherum on 5/16/16.
+//  Copyright © 2016 Litherum. All rights reserved.
+//
+
+#ifndef InteriorTriangulator_h
+#define InteriorTriangulator_h
+
+#include <CoreGraphics/CoreGraphics.h>
+
+#include "PathSource.h"
+
+#include <utility>
+#include <vector>
+
+// The polygon left over once every curve has been replaced by the inside edge of its hull. Contour i is
+// points[contourEnds[i - 1] ..< contourEnds[i]], and is implicitly closed.
+struct InnerBorder {
+    std::vector<CGPoint> points;
+    std::vector<size_t> contourEnds;
+};
+
+// The buffers triangulateInterior() works in. Passing the same one to every call means nothing is allocated once
+// they have grown to fit the largest border seen.
+struct InteriorTriangulationScratch {
+    struct Node {
+        CGPoint point;
+        int prev;
+        int next;
+    };
+
+    struct Contour {
+        const CGPoint* begin;
+        const CGPoint* end;
+        CGFloat area;
+        bool counterclockwise;
+        unsigned depth;
+        int parent;
+    };
+
+    std::vector<Node> nodes;
+    std::vector<int> holeQueue;
+    std::vector<Contour> contours;
+    std::vector<std::pair<const CGPoint*, const CGPoint*>> holes;
+};
+
+// Ear clipping with hole bridging, over an index-linked array of vertices. Loop-Blinn doesn't need Delaunay
+// triangles, just some triangulation of the inside, so this skips everything CGAL does to maintain the
+// Delaunay property. Contours are nested by even-odd depth; under the nonzero rule that gives the same answer as long
+// as every hole winds the opposite way from the contour around it, and otherwise this gives up.
+// Appends three points per triangle to triangles. Returns false, leaving triangles untouched, if the input
+// has touching or crossing contours or otherwise can't be clipped cleanly; the caller should fall back to CGAL.
+bool triangulateInterior(const InnerBorder&, TriangulationFillRule, std::vector<CGPoint>& triangles, InteriorTriangulationScratch&);
+
+#endif /* InteriorTriangulator_h */
@@ -11,49 +11,275 @@ import Cocoa
 struct Glyph {
     let glyphID: CGGlyph
     let font: CTFont
+    // See glyphCacheFontID(). Caches key on this, rather than hashing font.
+    let fontID: UInt32
     let position : CGPoint
 }
 
-typealias Frame = [Glyph]
+// Identifies a font (and size) across launches, for GlyphMeshCache and outline corpus files.
+func fontIdentity(font: CTFont) -> String {
+    return "\(CTFontCopyPostScriptName(font))-\(CTFontGetSize(font))"
+}
 
-func layout() -> [Frame] {
-    let path = NSBundle.mainBundle().pathForResource("shakespeare", ofType: "txt")!
-    var encoding = UInt(0)
-    var string = ""
-    do {
-        string = try NSString(contentsOfFile: path, usedEncoding: &encoding) as String
-    } catch {
+// Writes every distinct glyph in frames out as an outline corpus, for MeshBaker to triangulate offline.
+func exportOutlineCorpus(frames: FrameSource, path: String) {
+    let writer = createOutlineCorpusWriter(path)
+    guard writer != nil else {
+        fatalError()
+    }
+    var written = Set<String>()
+    var index = 0
+    while let frame = frames.frame(index) {
+        index = index + 1
+        for glyph in frame {
+            let identity = fontIdentity(glyph.font)
+            let key = "\(identity) \(glyph.glyphID)"
+            if written.contains(key) {
+                continue
+            }
+            written.insert(key)
+            outlineCorpusWriterAppend(writer, identity, glyph.glyphID, CTFontCreatePathForGlyph(glyph.font, glyph.glyphID, nil))
+        }
+    }
+    guard destroyOutlineCorpusWriter(writer) else {
         fatalError()
     }
+}
 
-    /*var endIndex = string.startIndex
-    for _ in 0 ..< 2000 {
-        endIndex = endIndex.successor()
+// Writes every glyph every frame draws, in order, as a glyph stream, to replay the atlas against without CoreText.
+func exportGlyphStream(frames: FrameSource, path: String) {
+    let writer = createGlyphStreamWriter(path)
+    guard writer != nil else {
+        fatalError()
+    }
+    var index = 0
+    while let frame = frames.frame(index) {
+        index = index + 1
+        glyphStreamWriterBeginFrame(writer)
+        for glyph in frame {
+            glyphStreamWriterAppend(writer, fontIdentity(glyph.font), glyph.glyphID, glyph.position)
+        }
     }
-    string = string.substringToIndex(endIndex)*/
-    guard let font = CTFontCreateUIFontForLanguage(.System, 50, nil) else {
+    guard destroyGlyphStreamWriter(writer) else {
         fatalError()
     }
-    let attributedString = CFAttributedStringCreate(kCFAllocatorDefault, string, [kCTFontAttributeName as String : font])
-    let framesetter = CTFramesetterCreateWithAttributedString(attributedString)
-    var frameStart = CFIndex(0)
-    var result : [Frame] = []
-    while true {
+}
+
+
+// The inverse of fontIdentity(), for fonts named in a layout file laid out with baseFont. CTFontCreateWithName() doesn't
+// find every font by its PostScript name (the hidden ".SFNS" system fonts, for one), so baseFont and the fonts CoreText
+// falls back to from it are tried first. nil if none of them has that identity.
+private func fontWithIdentity(identity: String, baseFont: CTFont) -> CTFont? {
+    guard let separator = identity.rangeOfString("-", options: .BackwardsSearch), size = Double(identity.substringFromIndex(separator.endIndex)) else {
+        return nil
+    }
+    let base = CTFontCreateCopyWithAttributes(baseFont, CGFloat(size), nil, nil)
+    if fontIdentity(base) == identity {
+        return base
+    }
+    if let cascade = CTFontCopyDefaultCascadeListForLanguages(baseFont, nil) as NSArray? {
+        for descriptor in cascade {
+            let font = CTFontCreateWithFontDescriptor(descriptor as! CTFontDescriptor, CGFloat(size), nil)
+            if fontIdentity(font) == identity {
+                return font
+            }
+        }
+    }
+    let font = CTFontCreateWithName(identity.substringToIndex(separator.startIndex), CGFloat(size), nil)
+    return fontIdentity(font) == identity ? font : nil
+}
+
+// How many frames a FrameSource keeps while it's still laying out. Drawing looks at most LookAheadFrameCount frames
+// ahead of the one on screen, so this only has to cover that with room to spare.
+let RetainedFrameCount = 32
+
+// Keeps a FrameStore alive while any Frame still points into it.
+private class FrameStoreHandle {
+    let store: FrameStoreRef
+
+    init(_ store: FrameStoreRef) {
+        self.store = store
+    }
+
+    deinit {
+        destroyFrameStore(store)
+    }
+}
+
+// One frame's glyphs. They stay packed in the FrameStore; each Glyph is only made as it's iterated.
+struct Frame : SequenceType {
+    private let view: FrameView
+    private let handle: FrameStoreHandle
+    private let fonts: [CTFont]
+    private let fontIDs: [UInt32]
+
+    var count: Int {
+        return view.glyphCount
+    }
+
+    func generate() -> FrameGenerator {
+        return FrameGenerator(frame: self)
+    }
+}
+
+struct FrameGenerator : GeneratorType {
+    private let frame: Frame
+    private var run = 0
+    private var index = 0
+
+    private init(frame: Frame) {
+        self.frame = frame
+    }
+
+    mutating func next() -> Glyph? {
+        let view = frame.view
+        while run < view.runCount && index >= Int(view.runs[run].firstGlyph + view.runs[run].glyphCount) {
+            run = run + 1
+        }
+        guard run < view.runCount else {
+            return nil
+        }
+        let font = Int(view.runs[run].font)
+        let result = Glyph(glyphID: view.glyphIDs[index], font: frame.fonts[font], fontID: frame.fontIDs[font], position: CGPointMake(CGFloat(view.x[index]), CGFloat(view.y[index])))
+        index = index + 1
+        return result
+    }
+}
+
+// The document's frames, laid out the first time they're asked for instead of all at launch, so drawing starts right
+// away. Laying out keeps only the last RetainedFrameCount frames in memory, and writes every frame to a layout file;
+// once the end of the document is reached, and at every later launch, frames are read from that file instead.
+class FrameSource {
+    private let framesetter: CTFramesetter
+    private let layoutPath: String
+    private let sourceKey: UInt64
+    private var handle: FrameStoreHandle
+    // Indexed like the store's font table.
+    private var fonts: [CTFont] = []
+    private var fontIDs: [UInt32] = []
+    private var frameStart = CFIndex(0)
+    // Known once the whole document has been laid out.
+    private(set) var frameCount: Int? = nil
+
+    init() {
+        let path = NSBundle.mainBundle().pathForResource("shakespeare", ofType: "txt")!
+        var encoding = UInt(0)
+        var string = ""
+        do {
+            string = try NSString(contentsOfFile: path, usedEncoding: &encoding) as String
+        } catch {
+            fatalError()
+        }
+
+        guard let font = CTFontCreateUIFontForLanguage(.System, 50, nil) else {
+            fatalError()
+        }
+        let attributedString = CFAttributedStringCreate(kCFAllocatorDefault, string, [kCTFontAttributeName as String : font])
+        framesetter = CTFramesetterCreateWithAttributedString(attributedString)
+
+        layoutPath = NSProcessInfo.processInfo().environment["LAYOUT_CACHE_PATH"] ?? (NSTemporaryDirectory() as NSString).stringByAppendingPathComponent("shakespeare.layout")
+        sourceKey = frameStoreSourceKey("\(fontIdentity(font)) 800x600\n\(string)")
+        var fileStore = createFrameStoreFromFile(layoutPath, sourceKey)
+        var fileFonts: [CTFont] = []
+        for i in 0 ..< (fileStore != nil ? frameStoreFontCount(fileStore) : 0) {
+            let identity = String.fromCString(frameStoreFontIdentity(fileStore, UInt32(i)))!
+            guard let fileFont = fontWithIdentity(identity, baseFont: font) else {
+                // Its glyph IDs would be drawn from some other font, so the file is laid out again.
+                NSLog("Laying out again, because %@ can't be found", identity)
+                destroyFrameStore(fileStore)
+                fileStore = nil
+                fileFonts = []
+                break
+            }
+            fileFonts.append(fileFont)
+        }
+        handle = FrameStoreHandle(fileStore != nil ? fileStore : createFrameStore(RetainedFrameCount, layoutPath, sourceKey))
+        if fileStore != nil {
+            frameCount = frameStoreFrameCount(fileStore)
+            fonts = fileFonts
+            fontIDs = fileFonts.map { glyphCacheFontID(fontIdentity($0)) }
+        }
+    }
+
+    // nil past the end of the document.
+    func frame(index: Int) -> Frame? {
+        if let frameCount = frameCount where index >= frameCount {
+            return nil
+        }
+        var view = FrameView()
+        if !frameStoreGetFrame(handle.store, index, &view) {
+            if index < frameStoreFrameCount(handle.store) {
+                restartLayout()
+            }
+            while frameStoreFrameCount(handle.store) <= index {
+                if !layoutNextFrame() {
+                    return nil
+                }
+            }
+            guard frameStoreGetFrame(handle.store, index, &view) else {
+                fatalError()
+            }
+        }
+        return Frame(view: view, handle: handle, fonts: fonts, fontIDs: fontIDs)
+    }
+
+    // Goes back to the start after the last frame.
+    func loopingFrame(index: Int) -> Frame? {
+        if frameCount == nil {
+            if let result = frame(index) {
+                return result
+            }
+        }
+        // If it wasn't yet, frame() just found the end.
+        guard let frameCount = frameCount where frameCount > 0 else {
+            return nil
+        }
+        return frame(index % frameCount)
+    }
+
+    private func fontIndex(font: CTFont) -> UInt32 {
+        let identity = fontIdentity(font)
+        let result = frameStoreAddFont(handle.store, identity)
+        if Int(result) == fonts.count {
+            fonts.append(font)
+            fontIDs.append(glyphCacheFontID(identity))
+        }
+        return result
+    }
+
+    // For a frame the store has already dropped, which only happens if the layout file couldn't be written. If layout
+    // is still going, the new store starts the file over.
+    private func restartLayout() {
+        let store = frameCount == nil ? createFrameStore(RetainedFrameCount, layoutPath, sourceKey) : createFrameStore(RetainedFrameCount, nil, sourceKey)
+        for font in fonts {
+            frameStoreAddFont(store, fontIdentity(font))
+        }
+        handle = FrameStoreHandle(store)
+        frameStart = 0
+    }
+
+    // Returns false, after finishing the store, at the end of the document.
+    private func layoutNextFrame() -> Bool {
+        let store = handle.store
         let frame = CTFramesetterCreateFrame(framesetter, CFRangeMake(frameStart, 0), CGPathCreateWithRect(CGRectMake(0, 0, 800, 600), nil), nil)
         let visibleRange = CTFrameGetVisibleStringRange(frame)
         if visibleRange.length == 0 {
-            break
+            frameCount = frameStoreFrameCount(store)
+            if frameStoreFinish(store) {
+                let fileStore = createFrameStoreFromFile(layoutPath, sourceKey)
+                if fileStore != nil {
+                    handle = FrameStoreHandle(fileStore)
+                }
+            }
+            return false
         }
         let lines = CTFrameGetLines(frame) as NSArray
         var lineOrigins = Array<CGPoint>(count: lines.count, repeatedValue: CGPointZero)
         CTFrameGetLineOrigins(frame, CFRangeMake(0, lines.count), &lineOrigins)
 
-        var resultFrame = Frame()
-
+        frameStoreBeginFrame(store)
         for i in 0 ..< lines.count {
             let line = lines[i] as! CTLine
-            let lineOrigin = lineOrigins[i]
-
             let runs = CTLineGetGlyphRuns(line) as NSArray
             for run in runs {
                 let run = run as! CTRun
@@ -64,13 +290,11 @@ func layout() -> [Frame] {
                 CTRunGetPositions(run, CFRangeMake(0, glyphCount), &positions)
                 let attributes = CTRunGetAttributes(run) as NSDictionary
                 let usedFont = attributes[kCTFontAttributeName as String] as! CTFont
-                for j in 0 ..< glyphCount {
-                    resultFrame.append(Glyph(glyphID: glyphs[j], font: usedFont, position: CGPointMake(positions[j].x + lineOrigin.x, positions[j].y + lineOrigin.y)))
-                }
+                frameStoreAppendRun(store, fontIndex(usedFont), &glyphs, &positions, glyphCount, lineOrigins[i])
             }
         }
-        result.append(resultFrame)
+        frameStoreFinishFrame(store)
         frameStart = visibleRange.location + visibleRange.length
+        return true
     }
-    return result
 }
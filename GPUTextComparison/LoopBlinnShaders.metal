@@ -20,11 +20,34 @@ struct LoopBlinnVertexInOut
     float4 coefficient;
 };
 
+// Compact positions in font units, moved into the scene per instance. See FrameBatcher.h.
+struct LoopBlinnInstancedVertexIn {
+    short2 position [[ attribute(0) ]];
+    float4 coefficient [[ attribute(1) ]];
+    // Translation, then scale; a FrameBatchInstance.
+    float3 instance [[ attribute(2) ]];
+};
+
+static float4 loopBlinnScenePosition(float2 position)
+{
+    return float4x4(float4(2.0 / 800.0, 0, 0, 0), float4(0, 2.0 / 600.0, 0, 0), float4(0, 0, 1, 0), float4(-1, -1, 0, 1)) * float4(position, 0, 1);
+}
+
 vertex LoopBlinnVertexInOut loopBlinnVertex(LoopBlinnVertexIn vertexIn [[ stage_in ]])
 {
     LoopBlinnVertexInOut outVertex;
     
-    outVertex.position = float4x4(float4(2.0 / 800.0, 0, 0, 0), float4(0, 2.0 / 600.0, 0, 0), float4(0, 0, 1, 0), float4(-1, -1, 0, 1)) * float4(vertexIn.position, 0, 1);
+    outVertex.position = loopBlinnScenePosition(vertexIn.position);
+    outVertex.coefficient = vertexIn.coefficient;
+    
+    return outVertex;
+};
+
+vertex LoopBlinnVertexInOut loopBlinnInstancedVertex(LoopBlinnInstancedVertexIn vertexIn [[ stage_in ]])
+{
+    LoopBlinnVertexInOut outVertex;
+    
+    outVertex.position = loopBlinnScenePosition(float2(vertexIn.position) * vertexIn.instance.z + vertexIn.instance.xy);
     outVertex.coefficient = vertexIn.coefficient;
     
     return outVertex;
@@ -9,19 +9,17 @@
 import Cocoa
 import MetalKit
 
-let CoefficientBufferSize = 1024*1024
+// How far, in pixels, a small-text LOD mesh may stray from the real outline.
+let LODPixelTolerance: Float = 0.25
+// How many frames, counting the one being drawn, the triangulation pipeline works ahead.
+let LookAheadFrameCount = 8
 
-extension LoopBlinnViewController.GlyphCacheKey: Hashable {
-    var hashValue: Int {
-        let a = glyphID.hashValue
-        let b = Int(CFHash(CTFontDescriptorCopyAttributes(CTFontCopyFontDescriptor(font))))
-        //let b = Int(CFHash(font))
-        return a ^ b
-    }
-}
-
-func ==(lhs: LoopBlinnViewController.GlyphCacheKey, rhs: LoopBlinnViewController.GlyphCacheKey) -> Bool {
-    return lhs.glyphID == rhs.glyphID && CFEqual(lhs.font, rhs.font)
+// Starts each mesh in the glyph cache. Its positions, coefficients and indices follow, as CompactCubicTriangleMesh has
+// them.
+struct CachedMeshHeader {
+    var vertexCount: UInt32
+    var indexCount: UInt32
+    var unitsPerPathUnit: Float
 }
 
 class LoopBlinnViewController: TextViewController, MTKViewDelegate {
@@ -30,26 +28,37 @@ class LoopBlinnViewController: TextViewController, MTKViewDelegate {
     
     var commandQueue: MTLCommandQueue! = nil
     var pipelineState: MTLRenderPipelineState! = nil
-    var vertexBuffers: [MTLBuffer] = []
-    var coefficientBuffers: [MTLBuffer] = []
+    var meshBatch: GlyphMeshBatch! = nil
     
     let inflightSemaphore = dispatch_semaphore_create(MaxBuffers)
     var bufferIndex = 0
     
     var frameCounter = 0
     
-    struct GlyphCacheKey {
-        let glyphID: CGGlyph
-        let font: CTFont
-    }
-    
-    struct GlyphCacheValue {
-        var positions: [Float]
-        var coefficients: [Float]
+    // Meshes, keyed by glyphCacheKey() with the LOD level (see glyphLODLevelForPixelsPerEm()) as the variant. The
+    // pipeline and the batch use the same keys; the batch decides what stays on the GPU.
+    var cache: GlyphCacheRef = nil
+    // Handed to the pipeline, and not yet moved into the cache, with the point size each was requested at.
+    var requested = [UInt64 : CGFloat]()
+    // Glyphs whose meshes can't be cached: too many vertices for 16-bit indices, or over the cache's budget. Each is
+    // logged once and then skipped, instead of being triangulated again every frame.
+    var uncachable = Set<UInt64>()
+    var pipeline: TriangulationPipelineRef = nil
+    // Unlike frameCounter, never wraps, so it orders the pipeline's deadlines.
+    var frameNumber: UInt64 = 0
+    // The last frame number whose glyphs have been handed to the pipeline.
+    var prefetchedFrameNumber: UInt64? = nil
+    // Baked offline by MeshBaker. Glyphs found here are never triangulated.
+    var meshCache: GlyphMeshCacheRef = nil
+    // In pixels. LOD levels are picked for it.
+    var drawableWidth: CGFloat = 0
+
+    deinit {
+        destroyTriangulationPipeline(pipeline)
+        destroyGlyphCache(cache)
+        closeGlyphMeshCache(meshCache)
     }
     
-    var cache: [GlyphCacheKey : GlyphCacheValue] = [:]
-    
     override func viewDidLoad() {
         
         super.viewDidLoad()
@@ -64,6 +73,12 @@ class LoopBlinnViewController: TextViewController, MTKViewDelegate {
         view.delegate = self
         view.device = device
         view.sampleCount = 1
+        drawableWidth = view.drawableSize.width
+        if let meshCachePath = NSBundle.mainBundle().pathForResource("glyphs", ofType: "meshcache") {
+            meshCache = openGlyphMeshCache(meshCachePath)
+        }
+        pipeline = createTriangulationPipeline(0, TriangulationFillRuleNonZero)
+        cache = createGlyphCache(GlyphCacheByteBudget, 0)
         loadAssets()
     }
     
@@ -75,17 +90,24 @@ class LoopBlinnViewController: TextViewController, MTKViewDelegate {
         
         let defaultLibrary = device.newDefaultLibrary()!
         let fragmentProgram = defaultLibrary.newFunctionWithName("loopBlinnFragment")!
-        let vertexProgram = defaultLibrary.newFunctionWithName("loopBlinnVertex")!
+        let vertexProgram = defaultLibrary.newFunctionWithName("loopBlinnInstancedVertex")!
         
+        // See CompactCubicTriangleMesh: 12 bytes per vertex. Positions stay in font units; each instance moves them.
+        meshBatch = GlyphMeshBatch(device: device, vertexStrides: [sizeof(Int16) * 2, sizeof(UInt16) * 4], indexed: true, maximumPageCount: MaximumMeshPageCount, protectedFrameCount: MaxBuffers)
         let vertexDescriptor = MTLVertexDescriptor()
-        vertexDescriptor.layouts[0].stride = sizeof(Float) * 2
-        vertexDescriptor.layouts[1].stride = sizeof(Float) * 4
-        vertexDescriptor.attributes[0].format = .Float2
+        vertexDescriptor.layouts[0].stride = sizeof(Int16) * 2
+        vertexDescriptor.layouts[1].stride = sizeof(UInt16) * 4
+        vertexDescriptor.layouts[meshBatch.instanceBufferIndex].stride = sizeof(FrameBatchInstance)
+        vertexDescriptor.layouts[meshBatch.instanceBufferIndex].stepFunction = .PerInstance
+        vertexDescriptor.attributes[0].format = .Short2
         vertexDescriptor.attributes[0].offset = 0
         vertexDescriptor.attributes[0].bufferIndex = 0
-        vertexDescriptor.attributes[1].format = .Float4
+        vertexDescriptor.attributes[1].format = .Half4
         vertexDescriptor.attributes[1].offset = 0
         vertexDescriptor.attributes[1].bufferIndex = 1
+        vertexDescriptor.attributes[2].format = .Float3
+        vertexDescriptor.attributes[2].offset = 0
+        vertexDescriptor.attributes[2].bufferIndex = meshBatch.instanceBufferIndex
         
         let pipelineStateDescriptor = MTLRenderPipelineDescriptor()
         pipelineStateDescriptor.vertexFunction = vertexProgram
@@ -101,87 +123,152 @@ class LoopBlinnViewController: TextViewController, MTKViewDelegate {
         }
     }
     
-    private func acquireVertexBuffer(inout usedBuffers: [MTLBuffer]) -> MTLBuffer {
-        if vertexBuffers.isEmpty {
-            let newBuffer = device.newBufferWithLength(VertexBufferSize, options: [])
-            usedBuffers.append(newBuffer)
-            return newBuffer
-        } else {
-            let buffer = vertexBuffers.removeLast()
-            usedBuffers.append(buffer)
-            return buffer
+    var t = 0
+
+    private func lodLevel(pointSize: CGFloat, drawableWidth: CGFloat) -> Int {
+        // The scene is 800 points across; see loopBlinnVertex.
+        let pixelsPerPoint = Float(drawableWidth) / 800
+        return Int(glyphLODLevelForPixelsPerEm(Float(pointSize) * pixelsPerPoint))
+    }
+
+    private func lodLevel(font: CTFont) -> Int {
+        return lodLevel(CTFontGetSize(font), drawableWidth: drawableWidth)
+    }
+
+    private func glyphKey(glyph: Glyph) -> UInt64 {
+        return glyphCacheKey(glyph.fontID, glyph.glyphID, UInt16(lodLevel(glyph.font)))
+    }
+
+    private func markUncachable(key: UInt64, font: CTFont, reason: String) {
+        uncachable.insert(key)
+        NSLog("Not drawing a glyph of %@, because %@", CTFontCopyFullName(font) as String, reason)
+    }
+
+    // Compacts the mesh, with positions in the font's units, stores it in the cache, and releases it. If indexing
+    // failed, or the mesh doesn't fit in the cache, marks key uncachable instead.
+    private func storeIndexedMesh(mesh: IndexedCubicTriangleMesh, indexed: Bool, font: CTFont, key: UInt64) {
+        guard indexed else {
+            destroyIndexedCubicTriangleMesh(mesh)
+            markUncachable(key, font: font, reason: "its mesh has more vertices than 16-bit indices can address")
+            return
+        }
+        var indexedMesh = mesh
+        var compactMesh = CompactCubicTriangleMesh(positions: nil, coefficients: nil, vertexCount: 0, indices: nil, indexCount: 0, unitsPerPathUnit: 0)
+        createCompactCubicTriangleMesh(&indexedMesh, Float(CTFontGetUnitsPerEm(font)) / Float(CTFontGetSize(font)), &compactMesh)
+        destroyIndexedCubicTriangleMesh(mesh)
+        let positionBytes = sizeof(Int16) * 2 * compactMesh.vertexCount
+        let coefficientBytes = sizeof(UInt16) * 4 * compactMesh.vertexCount
+        let indexBytes = sizeof(UInt16) * compactMesh.indexCount
+        let stored = glyphCacheInsert(cache, key, sizeof(CachedMeshHeader) + positionBytes + coefficientBytes + indexBytes, { bytes in
+            UnsafeMutablePointer<CachedMeshHeader>(bytes).memory = CachedMeshHeader(vertexCount: UInt32(compactMesh.vertexCount), indexCount: UInt32(compactMesh.indexCount), unitsPerPathUnit: compactMesh.unitsPerPathUnit)
+            let positions = bytes + sizeof(CachedMeshHeader)
+            memcpy(positions, compactMesh.positions, positionBytes)
+            memcpy(positions + positionBytes, compactMesh.coefficients, coefficientBytes)
+            memcpy(positions + positionBytes + coefficientBytes, compactMesh.indices, indexBytes)
+        }, nil)
+        destroyCompactCubicTriangleMesh(compactMesh)
+        if !stored {
+            markUncachable(key, font: font, reason: "its mesh is over the glyph cache's budget")
         }
     }
-    
-    private func acquireCoefficientBuffer(inout usedBuffers: [MTLBuffer]) -> MTLBuffer {
-        if coefficientBuffers.isEmpty {
-            let newBuffer = device.newBufferWithLength(CoefficientBufferSize, options: [])
-            usedBuffers.append(newBuffer)
-            return newBuffer
-        } else {
-            let buffer = coefficientBuffers.removeLast()
-            usedBuffers.append(buffer)
-            return buffer
+
+    // Indexes the meshes across every core, stores them in the cache, and releases them. meshes[i] was made from a
+    // glyph of fonts[i].
+    private func storeMeshes(meshes: [CubicTriangleMesh], fonts: [CTFont], keys: [UInt64]) {
+        var indexedMeshes = Array<IndexedCubicTriangleMesh>(count: meshes.count, repeatedValue: IndexedCubicTriangleMesh(positions: nil, coefficients: nil, vertexCount: 0, indices: nil, indexCount: 0))
+        createIndexedCubicTriangleMeshes(meshes, meshes.count, 0, &indexedMeshes)
+        for i in 0 ..< meshes.count {
+            // Indexing fails with an empty mesh.
+            storeIndexedMesh(indexedMeshes[i], indexed: indexedMeshes[i].indexCount > 0 || meshes[i].vertexCount == 0, font: fonts[i], key: keys[i])
+        }
+        for mesh in meshes {
+            destroyCubicTriangleMesh(mesh)
         }
     }
-    
-    private func canAppendVertices(verticesCount: Int, coefficientsCount: Int, vertexBuffer: MTLBuffer, vertexBufferUtilization: Int, coefficientBuffer: MTLBuffer, coefficientBufferUtilization: Int) -> Bool {
-        if vertexBufferUtilization + sizeof(Float) * verticesCount > vertexBuffer.length {
-            return false
+
+    // Finds glyph's mesh in the baked mesh cache, or has the pipeline triangulate it, due at frame number deadline.
+    private func request(glyph: Glyph, key: UInt64, deadline: UInt64) {
+        let level = lodLevel(glyph.font)
+        let fullLevel = Int(GlyphLODLevelCount) - 1
+        var meshView = GlyphMeshView(positions: nil, coefficients: nil, vertexCount: 0)
+        if level == fullLevel && meshCache != nil && glyphMeshCacheLookup(meshCache, glyphMeshCacheFontKey(fontIdentity(glyph.font)), glyph.glyphID, &meshView) {
+            var indexedMesh = IndexedCubicTriangleMesh(positions: nil, coefficients: nil, vertexCount: 0, indices: nil, indexCount: 0)
+            let indexed = createIndexedCubicTriangleMesh(meshView.positions, meshView.coefficients, meshView.vertexCount, &indexedMesh)
+            storeIndexedMesh(indexedMesh, indexed: indexed, font: glyph.font, key: key)
+            return
         }
-        if coefficientBufferUtilization + sizeof(Float) * coefficientsCount > coefficientBuffer.length {
-            return false
+        var tolerance: CGFloat = 0
+        if level != fullLevel {
+            tolerance = CGFloat(LODPixelTolerance) * CTFontGetSize(glyph.font) / CGFloat(glyphLODMaximumPixelsPerEm(UInt32(level)))
         }
-        return true
+        triangulationPipelineRequest(pipeline, key, CTFontCreatePathForGlyph(glyph.font, glyph.glyphID, nil), tolerance, deadline)
+        requested[key] = CTFontGetSize(glyph.font)
     }
 
-    private func appendVertices(glyph: Glyph, positions: [Float], coefficients: [Float], vertexBuffer: MTLBuffer, inout vertexBufferUtilization: Int, coefficientBuffer: MTLBuffer, inout coefficientBufferUtilization: Int) {
-        assert(canAppendVertices(positions.count, coefficientsCount: coefficients.count, vertexBuffer: vertexBuffer, vertexBufferUtilization: vertexBufferUtilization, coefficientBuffer: coefficientBuffer, coefficientBufferUtilization: coefficientBufferUtilization))
-        
-        let pVertexData = vertexBuffer.contents()
-        let vVertexData = UnsafeMutablePointer<Float>(pVertexData + vertexBufferUtilization)
-        
-        assert(positions.count % 2 == 0)
-        for i in 0 ..< positions.count / 2 {
-            vVertexData[i * 2] = positions[i * 2] + Float(glyph.position.x)
-            vVertexData[i * 2 + 1] = positions[i * 2 + 1] + Float(glyph.position.y)
+    // Hands the glyphs of frames up to LookAheadFrameCount ahead which aren't in the cache yet to the pipeline, so
+    // they're triangulated across the other cores while this thread draws. Each frame is only looked at once, when it
+    // comes into range.
+    private func prefetch(frameIndex: Int) {
+        guard let frames = frames else {
+            return
         }
-        vertexBufferUtilization = vertexBufferUtilization + sizeofValue(positions[0]) * positions.count
-        
-        let pCoefficientData = coefficientBuffer.contents()
-        let vCoefficientData = UnsafeMutablePointer<Float>(pCoefficientData + coefficientBufferUtilization)
-        
-        assert(coefficients.count % 2 == 0)
-        for i in 0 ..< coefficients.count {
-            vCoefficientData[i] = coefficients[i]
+        let lastFrameNumber = frameNumber + UInt64(min(LookAheadFrameCount, frames.frameCount ?? LookAheadFrameCount)) - 1
+        var n = prefetchedFrameNumber.map { max($0 + 1, frameNumber) } ?? frameNumber
+        while n <= lastFrameNumber {
+            guard let frame = frames.loopingFrame(frameIndex + Int(n - frameNumber)) else {
+                break
+            }
+            for glyph in frame {
+                let key = glyphKey(glyph)
+                if requested[key] != nil || uncachable.contains(key) {
+                    continue
+                }
+                var value = GlyphCacheValue(bytes: nil, length: 0, entry: nil)
+                if glyphCacheLookup(cache, key, &value) {
+                    glyphCacheReleaseValue(value)
+                    continue
+                }
+                request(glyph, key: key, deadline: n)
+            }
+            n = n + 1
         }
-        coefficientBufferUtilization = coefficientBufferUtilization + sizeofValue(coefficients[0]) * coefficients.count
+        prefetchedFrameNumber = lastFrameNumber
     }
-    
-    private func issueDraw(renderEncoder: MTLRenderCommandEncoder, inout vertexBuffer: MTLBuffer, inout vertexBufferUtilization: Int, inout usedVertexBuffers: [MTLBuffer], inout coefficientBuffer: MTLBuffer, inout coefficientBufferUtilization: Int, inout usedCoefficientBuffers: [MTLBuffer], vertexCount: Int) {
-        renderEncoder.setVertexBuffer(vertexBuffer, offset: 0, atIndex: 0)
-        renderEncoder.setVertexBuffer(coefficientBuffer, offset:0, atIndex: 1)
-        renderEncoder.drawPrimitives(.Triangle, vertexStart: 0, vertexCount: vertexCount, instanceCount: 1)
-        
-        vertexBuffer = acquireVertexBuffer(&usedVertexBuffers)
-        vertexBufferUtilization = 0
-        coefficientBuffer = acquireCoefficientBuffer(&usedCoefficientBuffers)
-        coefficientBufferUtilization = 0
+
+    // Moves the glyphs' meshes from the pipeline into the cache, waiting only for the ones which aren't done yet.
+    private func collect<Glyphs : SequenceType where Glyphs.Generator.Element == Glyph>(glyphs: Glyphs) {
+        var keys: [UInt64] = []
+        var fonts: [CTFont] = []
+        var meshes: [CubicTriangleMesh] = []
+        for glyph in glyphs {
+            let key = glyphKey(glyph)
+            guard requested[key] != nil else {
+                continue
+            }
+            var mesh = CubicTriangleMesh(positions: nil, coefficients: nil, vertexCount: 0)
+            if triangulationPipelineTake(pipeline, key, &mesh) != TriangulationPipelineReady && !triangulationPipelineWait(pipeline, key, &mesh) {
+                continue
+            }
+            requested.removeValueForKey(key)
+            keys.append(key)
+            fonts.append(glyph.font)
+            meshes.append(mesh)
+        }
+        if !keys.isEmpty {
+            storeMeshes(meshes, fonts: fonts, keys: keys)
+        }
     }
-    var t = 0
 
     func drawInMTKView(view: MTKView) {
-        if frames.count == 0 {
-            return
-        }
         let slowness = 1
-        if frameCounter >= frames.count * slowness {
+        if let frameCount = frames?.frameCount where frameCounter >= frameCount * slowness {
             frameCounter = 0
         }
-        let frame = frames[frameCounter / slowness]
-        
-        var usedVertexBuffers: [MTLBuffer] = []
-        var usedCoefficientBuffers: [MTLBuffer] = []
+        guard let frame = frames?.loopingFrame(frameCounter / slowness) else {
+            return
+        }
+        prefetch(frameCounter / slowness)
+        collect(frame)
         
         let commandBuffer = commandQueue.commandBuffer()
         
@@ -192,74 +279,59 @@ class LoopBlinnViewController: TextViewController, MTKViewDelegate {
         let renderEncoder = commandBuffer.renderCommandEncoderWithDescriptor(renderPassDescriptor)
         renderEncoder.setRenderPipelineState(pipelineState)
         
-        var vertexBuffer = acquireVertexBuffer(&usedVertexBuffers)
-        var vertexBufferUtilization = 0
-        var coefficientBuffer = acquireCoefficientBuffer(&usedCoefficientBuffers)
-        var coefficientBufferUtilization = 0
-        
+        meshBatch.beginFrame()
         for glyph in frame {
-            // FIXME: Gracefully handle full geometry buffers
+            let key = glyphKey(glyph)
+            if meshBatch.addInstance(key, position: glyph.position) || uncachable.contains(key) {
+                continue
+            }
 
-            let key = GlyphCacheKey(glyphID: glyph.glyphID, font: glyph.font)
-            var positions : [Float] = []
-            var coefficients : [Float] = []
-            if let cacheLookup = cache[key] {
-                positions = cacheLookup.positions
-                coefficients = cacheLookup.coefficients
-            } else {
-                if let path = CTFontCreatePathForGlyph(glyph.font, glyph.glyphID, nil) {
-                    triangulate(path) { (vertex0, vertex1, vertex2) in
-                        positions.append(Float(vertex0.point.x))
-                        positions.append(Float(vertex0.point.y))
-                        positions.append(Float(vertex1.point.x))
-                        positions.append(Float(vertex1.point.y))
-                        positions.append(Float(vertex2.point.x))
-                        positions.append(Float(vertex2.point.y))
-                        coefficients.append(vertex0.coefficient.x)
-                        coefficients.append(vertex0.coefficient.y)
-                        coefficients.append(vertex0.coefficient.z)
-                        coefficients.append(0)
-                        coefficients.append(vertex1.coefficient.x)
-                        coefficients.append(vertex1.coefficient.y)
-                        coefficients.append(vertex1.coefficient.z)
-                        coefficients.append(0)
-                        coefficients.append(vertex2.coefficient.x)
-                        coefficients.append(vertex2.coefficient.y)
-                        coefficients.append(vertex2.coefficient.z)
-                        coefficients.append(0)
-                    }
+            // Only the first time the glyph is drawn, or after it's been evicted.
+            var value = GlyphCacheValue(bytes: nil, length: 0, entry: nil)
+            if !glyphCacheLookup(cache, key, &value) {
+                // Evicted from the cache since it was prefetched.
+                request(glyph, key: key, deadline: frameNumber)
+                collect([glyph])
+                guard glyphCacheLookup(cache, key, &value) else {
+                    continue
                 }
-                cache[key] = GlyphCacheValue(positions: positions, coefficients: coefficients)
             }
-            
-            if positions.isEmpty || coefficients.isEmpty {
-                continue
+            let header = UnsafePointer<CachedMeshHeader>(value.bytes).memory
+            let positionBytes = sizeof(Int16) * 2 * Int(header.vertexCount)
+            let coefficientBytes = sizeof(UInt16) * 4 * Int(header.vertexCount)
+            let indexBytes = sizeof(UInt16) * Int(header.indexCount)
+            if header.indexCount > 0 && meshBatch.addMesh(key, vertexCount: Int(header.vertexCount), indexCount: Int(header.indexCount), scale: 1 / header.unitsPerPathUnit, write: { vertices, indices in
+                // Already half floats.
+                let positions = value.bytes + sizeof(CachedMeshHeader)
+                memcpy(vertices[0], positions, positionBytes)
+                memcpy(vertices[1], positions + positionBytes, coefficientBytes)
+                memcpy(indices, positions + positionBytes + coefficientBytes, indexBytes)
+            }) {
+                meshBatch.addInstance(key, position: glyph.position)
             }
-
-            appendVertices(glyph, positions: positions, coefficients: coefficients, vertexBuffer: vertexBuffer, vertexBufferUtilization: &vertexBufferUtilization, coefficientBuffer: coefficientBuffer, coefficientBufferUtilization: &coefficientBufferUtilization)
+            glyphCacheReleaseValue(value)
         }
-        
-        issueDraw(renderEncoder, vertexBuffer: &vertexBuffer, vertexBufferUtilization: &vertexBufferUtilization, usedVertexBuffers: &usedVertexBuffers, coefficientBuffer: &coefficientBuffer, coefficientBufferUtilization: &coefficientBufferUtilization, usedCoefficientBuffers: &usedCoefficientBuffers, vertexCount: vertexBufferUtilization / (sizeof(Float) * 2))
+        meshBatch.encode(renderEncoder, commandBuffer: commandBuffer)
         
         renderEncoder.endEncoding()
         commandBuffer.presentDrawable(currentDrawable)
         
-        commandBuffer.addCompletedHandler{ [weak self] commandBuffer in
-            dispatch_async(dispatch_get_main_queue(), { [weak self] in
-                if let strongSelf = self {
-                    strongSelf.vertexBuffers.appendContentsOf(usedVertexBuffers)
-                    strongSelf.coefficientBuffers.appendContentsOf(usedCoefficientBuffers)
-                }
-            })
-        }
-        
         commandBuffer.commit()
         
         frameCounter = frameCounter + 1
+        frameNumber = frameNumber + 1
     }
 
     func mtkView(view: MTKView, drawableSizeWillChange size: CGSize) {
-        
+        // Glyphs whose LOD level changes with the size get new keys, so meshes still on their way for the old ones
+        // would never be drawn. The frames ahead are prefetched again at the new levels.
+        let oldDrawableWidth = drawableWidth
+        drawableWidth = size.width
+        for (key, pointSize) in requested where lodLevel(pointSize, drawableWidth: oldDrawableWidth) != lodLevel(pointSize, drawableWidth: drawableWidth) {
+            triangulationPipelineCancel(pipeline, key)
+            requested.removeValueForKey(key)
+        }
+        prefetchedFrameNumber = nil
     }
 }
 
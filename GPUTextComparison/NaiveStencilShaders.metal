@@ -13,6 +13,13 @@ struct StencilVertexIn {
     float2 position [[ attribute(0) ]];
 };
 
+// Path coordinates, moved into the scene per instance. See FrameBatcher.h.
+struct StencilInstancedVertexIn {
+    float2 position [[ attribute(0) ]];
+    // Translation, then scale; a FrameBatchInstance.
+    float3 instance [[ attribute(1) ]];
+};
+
 struct StencilVertexInOut
 {
     float4 position [[ position ]];
@@ -27,6 +34,15 @@ vertex StencilVertexInOut stencilVertex(StencilVertexIn vertexIn [[ stage_in ]])
     return outVertex;
 };
 
+vertex StencilVertexInOut stencilInstancedVertex(StencilInstancedVertexIn vertexIn [[ stage_in ]])
+{
+    StencilVertexInOut outVertex;
+    
+    outVertex.position = float4x4(float4(2.0 / 800.0, 0, 0, 0), float4(0, 2.0 / 600.0, 0, 0), float4(0, 0, 1, 0), float4(-1, -1, 0, 1)) * float4(vertexIn.position * vertexIn.instance.z + vertexIn.instance.xy, 0, 1);
+    
+    return outVertex;
+};
+
 fragment half4 stencilFragment(StencilVertexInOut inFrag [[ stage_in ]])
 {
     return half4(1, 1, 1, 1);
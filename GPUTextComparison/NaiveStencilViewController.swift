@@ -9,18 +9,8 @@
 import Cocoa
 import MetalKit
 
-extension NaiveStencilViewController.GlyphCacheKey: Hashable {
-    var hashValue: Int {
-        let a = glyphID.hashValue
-        let b = Int(CFHash(CTFontDescriptorCopyAttributes(CTFontCopyFontDescriptor(font))))
-        //let b = Int(CFHash(font))
-        return a ^ b
-    }
-}
-
-func ==(lhs: NaiveStencilViewController.GlyphCacheKey, rhs: NaiveStencilViewController.GlyphCacheKey) -> Bool {
-    return lhs.glyphID == rhs.glyphID && CFEqual(lhs.font, rhs.font)
-}
+// How far, in pixels, the flattened outline may stray from the real one.
+let StencilPixelTolerance: CGFloat = 0.2
 
 class NaiveStencilViewController: TextViewController, MTKViewDelegate {
 
@@ -28,9 +18,10 @@ class NaiveStencilViewController: TextViewController, MTKViewDelegate {
     
     var commandQueue: MTLCommandQueue! = nil
     var pipelineState: MTLRenderPipelineState! = nil
+    var countPipelineState: MTLRenderPipelineState! = nil
     var countDepthStencilState: MTLDepthStencilState! = nil
     var fillDepthStencilState: MTLDepthStencilState! = nil
-    var vertexBuffers: [MTLBuffer] = []
+    var meshBatch: GlyphMeshBatch! = nil
     var fillVertexBuffer: MTLBuffer! = nil
 
     let inflightSemaphore = dispatch_semaphore_create(MaxBuffers)
@@ -38,17 +29,13 @@ class NaiveStencilViewController: TextViewController, MTKViewDelegate {
 
     var frameCounter = 0
 
-    struct GlyphCacheKey {
-        let glyphID: CGGlyph
-        let font: CTFont
-    }
+    // Each glyph's triangles, as float2 positions. The batch decides what stays on the GPU, and uses the same keys.
+    var cache: GlyphCacheRef = nil
 
-    struct GlyphCacheValue {
-        var geometry: [Float]
+    deinit {
+        destroyGlyphCache(cache)
     }
 
-    var cache: [GlyphCacheKey : GlyphCacheValue] = [:]
-
     override func viewDidLoad() {
         
         super.viewDidLoad()
@@ -65,6 +52,7 @@ class NaiveStencilViewController: TextViewController, MTKViewDelegate {
         view.sampleCount = 1
         view.depthStencilPixelFormat = .Depth32Float_Stencil8
         view.clearStencil = 0
+        cache = createGlyphCache(GlyphCacheByteBudget, 0)
         loadAssets()
     }
     
@@ -99,6 +87,22 @@ class NaiveStencilViewController: TextViewController, MTKViewDelegate {
             fatalError("Failed to create pipeline state, error \(error)")
         }
 
+        // Counting draws every glyph's fan as an instance of its mesh, in path coordinates. Filling is one quad.
+        meshBatch = GlyphMeshBatch(device: device, vertexStrides: [sizeof(Float) * 2], indexed: false, maximumPageCount: MaximumMeshPageCount, protectedFrameCount: MaxBuffers)
+        vertexDescriptor.layouts[meshBatch.instanceBufferIndex].stride = sizeof(FrameBatchInstance)
+        vertexDescriptor.layouts[meshBatch.instanceBufferIndex].stepFunction = .PerInstance
+        vertexDescriptor.attributes[1].format = .Float3
+        vertexDescriptor.attributes[1].offset = 0
+        vertexDescriptor.attributes[1].bufferIndex = meshBatch.instanceBufferIndex
+        pipelineStateDescriptor.vertexFunction = defaultLibrary.newFunctionWithName("stencilInstancedVertex")!
+        pipelineStateDescriptor.vertexDescriptor = vertexDescriptor
+
+        do {
+            try countPipelineState = device.newRenderPipelineStateWithDescriptor(pipelineStateDescriptor)
+        } catch let error {
+            fatalError("Failed to create pipeline state, error \(error)")
+        }
+
         let countFrontFaceStencil = MTLStencilDescriptor()
         countFrontFaceStencil.stencilCompareFunction = .Never
         countFrontFaceStencil.stencilFailureOperation = .IncrementWrap
@@ -132,140 +136,23 @@ class NaiveStencilViewController: TextViewController, MTKViewDelegate {
         fillVertexBuffer = device.newBufferWithBytes(fillVertexData, length: sizeofValue(fillVertexData[0]) * fillVertexData.count, options: .StorageModeManaged)
     }
 
-    private func acquireVertexBuffer(inout usedBuffers: [MTLBuffer]) -> MTLBuffer {
-        if vertexBuffers.isEmpty {
-            let newBuffer = device.newBufferWithLength(VertexBufferSize, options: [])
-            usedBuffers.append(newBuffer)
-            return newBuffer
-        } else {
-            let buffer = vertexBuffers.removeLast()
-            usedBuffers.append(buffer)
-            return buffer
-        }
+    // Curves are flattened for the scale the scene is drawn at, rounded up to a power of two so that resizing within a
+    // factor of two keeps the cached geometry. Each scale level is its own variant of the glyph. Below a pixel per
+    // scene unit, level 0 flattens finer than it has to.
+    private func flatteningScaleLevel() -> Int {
+        // The scene is 800 units across; see stencilVertex.
+        let pixelsPerUnit = (self.view as! MTKView).drawableSize.width / 800
+        return max(0, Int(ceil(log2(pixelsPerUnit))))
     }
 
-    private func canAppendVertices(vertices: [Float], vertexBuffer: MTLBuffer, vertexBufferUtilization: Int) -> Bool {
-        if vertexBufferUtilization + sizeof(Float) * vertices.count > vertexBuffer.length {
-            return false
-        }
-        return true
-    }
-
-    private func issueDraw(renderEncoder: MTLRenderCommandEncoder, inout vertexBuffer: MTLBuffer, inout vertexBufferUtilization: Int, inout usedVertexBuffers: [MTLBuffer], vertexCount: Int) {
-        renderEncoder.setVertexBuffer(vertexBuffer, offset: 0, atIndex: 0)
-        renderEncoder.drawPrimitives(.Triangle, vertexStart: 0, vertexCount: vertexCount, instanceCount: 1)
-
-        vertexBuffer = acquireVertexBuffer(&usedVertexBuffers)
-        vertexBufferUtilization = 0
-    }
-
-    private class func interpolate(t: CGFloat, p0: CGPoint, p1: CGPoint) -> CGPoint {
-        return CGPointMake(t * p1.x + (1 - t) * p0.x, t * p1.y + (1 - t) * p0.y)
-    }
-
-    private class func interpolateQuadraticBezier(t: CGFloat, p0: CGPoint, p1: CGPoint, p2: CGPoint) -> CGPoint {
-        let ab = NaiveStencilViewController.interpolate(t, p0: p0, p1: p1)
-        let bc = NaiveStencilViewController.interpolate(t, p0: p1, p1: p2)
-        return NaiveStencilViewController.interpolate(t, p0: ab, p1: bc)
-    }
-
-    private class func interpolateCubicBezier(t: CGFloat, p0: CGPoint, p1: CGPoint, p2: CGPoint, p3: CGPoint) -> CGPoint {
-        let ab = NaiveStencilViewController.interpolate(t, p0: p0, p1: p1)
-        let bc = NaiveStencilViewController.interpolate(t, p0: p1, p1: p2)
-        let cd = NaiveStencilViewController.interpolate(t, p0: p2, p1: p3)
-        let abc = NaiveStencilViewController.interpolate(t, p0: ab, p1: bc)
-        let bcd = NaiveStencilViewController.interpolate(t, p0: bc, p1: cd)
-        return NaiveStencilViewController.interpolate(t, p0: abc, p1: bcd)
-    }
-
-    private class func approximatePath(path: CGPath) -> CGPath
-    {
-        let result = CGPathCreateMutable()
-        var currentPoint = CGPointZero
-        var subpathBegin = CGPointZero
-        let definition = 10
-        iterateCGPath(path) {(element : CGPathElement) in
-            switch element.type {
-            case .MoveToPoint:
-                CGPathMoveToPoint(result, nil, element.points[0].x, element.points[0].y)
-                currentPoint = element.points[0]
-                subpathBegin = currentPoint
-            case .AddLineToPoint:
-                CGPathAddLineToPoint(result, nil, element.points[0].x, element.points[0].y)
-                currentPoint = element.points[0]
-            case .AddQuadCurveToPoint:
-                for i in 1 ... definition {
-                    let intermediate = NaiveStencilViewController.interpolateQuadraticBezier(CGFloat(i) / CGFloat(definition), p0: currentPoint, p1: element.points[0], p2: element.points[1])
-                    CGPathAddLineToPoint(result, nil, intermediate.x, intermediate.y)
-                }
-                currentPoint = element.points[1]
-            case .AddCurveToPoint:
-                for i in 1 ... definition {
-                    let intermediate = NaiveStencilViewController.interpolateCubicBezier(CGFloat(i) / CGFloat(definition), p0: currentPoint, p1: element.points[0], p2: element.points[1], p3: element.points[2])
-                    CGPathAddLineToPoint(result, nil, intermediate.x, intermediate.y)
-                }
-                currentPoint = element.points[2]
-            case .CloseSubpath:
-                CGPathAddLineToPoint(result, nil, subpathBegin.x, subpathBegin.y)
-                currentPoint = subpathBegin
-            }
-        }
-        return result
-    }
-
-    private class func generateGeometry(path: CGPath) -> [Float] {
-        var result: [Float] = []
-        var previousPoint : CGPoint?
-        var subpathBegin = CGPointZero
-        iterateCGPath(path) {(element : CGPathElement) in
-            switch element.type {
-            case .MoveToPoint:
-                subpathBegin = element.points[0]
-                previousPoint = subpathBegin
-            case .AddLineToPoint:
-                if let p = previousPoint {
-                    result.append(0)
-                    result.append(0)
-
-                    result.append(Float(p.x))
-                    result.append(Float(p.y))
-
-                    result.append(Float(element.points[0].x))
-                    result.append(Float(element.points[0].y))
-                }
-                previousPoint = element.points[0]
-            case .AddQuadCurveToPoint:
-                fatalError()
-            case .AddCurveToPoint:
-                fatalError()
-            case .CloseSubpath:
-                if let p = previousPoint {
-                    result.append(0)
-                    result.append(0)
-
-                    result.append(Float(p.x))
-                    result.append(Float(p.y))
-
-                    result.append(Float(subpathBegin.x))
-                    result.append(Float(subpathBegin.y))
-                }
-                previousPoint = subpathBegin
-            }
-        }
-        return result
-    }
-    
     func drawInMTKView(view: MTKView) {
-        if frames.count == 0 {
-            return
-        }
         let slowness = 1
-        if frameCounter >= frames.count * slowness {
+        if let frameCount = frames?.frameCount where frameCounter >= frameCount * slowness {
             frameCounter = 0
         }
-        let frame = frames[frameCounter / slowness]
-
-        var usedVertexBuffers: [MTLBuffer] = []
+        guard let frame = frames?.loopingFrame(frameCounter / slowness) else {
+            return
+        }
 
         let commandBuffer = commandQueue.commandBuffer()
 
@@ -274,46 +161,43 @@ class NaiveStencilViewController: TextViewController, MTKViewDelegate {
         }
 
         let renderEncoder = commandBuffer.renderCommandEncoderWithDescriptor(renderPassDescriptor)
-        renderEncoder.setRenderPipelineState(pipelineState)
+        renderEncoder.setRenderPipelineState(countPipelineState)
         renderEncoder.setDepthStencilState(countDepthStencilState)
 
-        var vertexBuffer = acquireVertexBuffer(&usedVertexBuffers)
-        var vertexBufferUtilization = 0
-
+        let scaleLevel = flatteningScaleLevel()
+        let tolerance = StencilPixelTolerance / CGFloat(1 << scaleLevel)
+        meshBatch.beginFrame()
         for glyph in frame {
-            // FIXME: Gracefully handle full geometry buffers
-
-            let key = GlyphCacheKey(glyphID: glyph.glyphID, font: glyph.font)
-            var geometry : [Float] = []
-            if let cacheLookup = cache[key] {
-                geometry = cacheLookup.geometry
-            } else {
-                if let glyphPath = CTFontCreatePathForGlyph(glyph.font, glyph.glyphID, nil) {
-                    let approximatedPath = NaiveStencilViewController.approximatePath(glyphPath)
-                    geometry = NaiveStencilViewController.generateGeometry(approximatedPath)
-                }
-                cache[key] = GlyphCacheValue(geometry: geometry)
-            }
-
-            if geometry.isEmpty {
+            let key = glyphCacheKey(glyph.fontID, glyph.glyphID, UInt16(scaleLevel))
+            if meshBatch.addInstance(key, position: glyph.position) {
                 continue
             }
 
-            assert(canAppendVertices(geometry, vertexBuffer: vertexBuffer, vertexBufferUtilization: vertexBufferUtilization))
-
-            let pVertexData = vertexBuffer.contents()
-            let vVertexData = UnsafeMutablePointer<Float>(pVertexData + vertexBufferUtilization)
-
-            assert(geometry.count % 2 == 0)
-            for i in 0 ..< geometry.count / 2 {
-                vVertexData[i * 2] = geometry[i * 2] + Float(glyph.position.x)
-                vVertexData[i * 2 + 1] = geometry[i * 2 + 1] + Float(glyph.position.y)
+            // Only the first time the glyph is drawn, or after it's been evicted.
+            var value = GlyphCacheValue(bytes: nil, length: 0, entry: nil)
+            if !glyphCacheLookup(cache, key, &value) {
+                // Written straight into the cache.
+                let glyphPath = CTFontCreatePathForGlyph(glyph.font, glyph.glyphID, nil)
+                let fanVertexCount = glyphPath == nil ? 0 : stencilFanVertexCount(glyphPath, tolerance, 0)
+                guard glyphCacheInsert(cache, key, sizeof(Float) * 2 * fanVertexCount, { bytes in
+                    if fanVertexCount > 0 {
+                        writeStencilFan(glyphPath, tolerance, 0, UnsafeMutablePointer<Float>(bytes))
+                    }
+                }, &value) else {
+                    continue
+                }
+            }
+            let vertexCount = value.length / (sizeof(Float) * 2)
+            if vertexCount > 0 && meshBatch.addMesh(key, vertexCount: vertexCount, indexCount: 0, scale: 1, write: { vertices, indices in
+                memcpy(vertices[0], value.bytes, value.length)
+            }) {
+                meshBatch.addInstance(key, position: glyph.position)
             }
-            vertexBufferUtilization = vertexBufferUtilization + sizeofValue(geometry[0]) * geometry.count
+            glyphCacheReleaseValue(value)
         }
+        meshBatch.encode(renderEncoder, commandBuffer: commandBuffer)
 
-        issueDraw(renderEncoder, vertexBuffer: &vertexBuffer, vertexBufferUtilization: &vertexBufferUtilization, usedVertexBuffers: &usedVertexBuffers, vertexCount: vertexBufferUtilization / (sizeof(Float) * 2))
-
+        renderEncoder.setRenderPipelineState(pipelineState)
         renderEncoder.setDepthStencilState(fillDepthStencilState)
         renderEncoder.setVertexBuffer(fillVertexBuffer, offset: 0, atIndex: 0)
         renderEncoder.drawPrimitives(.Triangle, vertexStart: 0, vertexCount: 6, instanceCount: 1)
@@ -321,14 +205,6 @@ class NaiveStencilViewController: TextViewController, MTKViewDelegate {
         renderEncoder.endEncoding()
         commandBuffer.presentDrawable(currentDrawable)
 
-        commandBuffer.addCompletedHandler{ [weak self] commandBuffer in
-            dispatch_async(dispatch_get_main_queue(), { [weak self] in
-                if let strongSelf = self {
-                    strongSelf.vertexBuffers.appendContentsOf(usedVertexBuffers)
-                }
-            })
-        }
-
         commandBuffer.commit()
 
         frameCounter = frameCounter + 1
@@ -0,0 +1,115 @@
+//
+//  OutlineCorpus.cpp
+//  GPUTextComparison
+//
+//  Created by Litherum on 5/15/16.
+//  Copyright © 2016 Litherum. All rights reserved.
+//
+
+#include "OutlineCorpus.h"
+#include "PathSource.h"
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+struct OutlineCorpusWriter {
+    FILE* file;
+    bool failed;
+};
+
+OutlineCorpusWriterRef createOutlineCorpusWriter(const char* path) {
+    FILE* file = fopen(path, "w");
+    if (!file)
+        return nullptr;
+    return new OutlineCorpusWriter { file, false };
+}
+
+void outlineCorpusWriterAppend(OutlineCorpusWriterRef writer, const char* fontIdentity, CGGlyph glyph, CGPathRef path) {
+    FILE* file = writer->file;
+    if (fprintf(file, "glyph %s %u\n", fontIdentity, static_cast<unsigned>(glyph)) < 0)
+        writer->failed = true;
+    if (path) {
+        CGPathSource(path).iterate([&](PathElement element) {
+            int result = 0;
+            switch (element.type) {
+            case PathElementMoveToPoint:
+                result = fprintf(file, "M %.17g %.17g\n", element.points[0].x, element.points[0].y);
+                break;
+            case PathElementAddLineToPoint:
+                result = fprintf(file, "L %.17g %.17g\n", element.points[0].x, element.points[0].y);
+                break;
+            case PathElementAddQuadCurveToPoint:
+                result = fprintf(file, "Q %.17g %.17g %.17g %.17g\n", element.points[0].x, element.points[0].y, element.points[1].x, element.points[1].y);
+                break;
+            case PathElementAddCurveToPoint:
+                result = fprintf(file, "C %.17g %.17g %.17g %.17g %.17g %.17g\n", element.points[0].x, element.points[0].y, element.points[1].x, element.points[1].y, element.points[2].x, element.points[2].y);
+                break;
+            case PathElementCloseSubpath:
+                result = fprintf(file, "Z\n");
+                break;
+            }
+            if (result < 0)
+                writer->failed = true;
+        });
+    }
+    if (fprintf(file, "end\n") < 0)
+        writer->failed = true;
+}
+
+bool destroyOutlineCorpusWriter(OutlineCorpusWriterRef writer) {
+    bool success = !writer->failed && !fclose(writer->file);
+    delete writer;
+    return success;
+}
+
+bool readOutlineCorpus(const char* path, std::vector<CorpusOutline>& result) {
+    std::ifstream stream(path);
+    if (!stream)
+        return false;
+
+    CGMutablePathRef currentPath = nullptr;
+    std::string fontIdentity;
+    unsigned glyphID = 0;
+    std::string line;
+    while (std::getline(stream, line)) {
+        if (line.empty() || line[0] == '#')
+            continue;
+        std::istringstream lineStream(line);
+        std::string command;
+        lineStream >> command;
+        if (command == "glyph") {
+            if (currentPath || !(lineStream >> fontIdentity >> glyphID))
+                break;
+            currentPath = CGPathCreateMutable();
+            continue;
+        }
+        if (!currentPath)
+            break;
+        if (command == "end") {
+            result.push_back({ fontIdentity, static_cast<CGGlyph>(glyphID), adopt(static_cast<CGPathRef>(currentPath)) });
+            currentPath = nullptr;
+            continue;
+        }
+
+        CGFloat p[6];
+        if (command == "M" && lineStream >> p[0] >> p[1])
+            CGPathMoveToPoint(currentPath, nullptr, p[0], p[1]);
+        else if (command == "L" && lineStream >> p[0] >> p[1])
+            CGPathAddLineToPoint(currentPath, nullptr, p[0], p[1]);
+        else if (command == "Q" && lineStream >> p[0] >> p[1] >> p[2] >> p[3])
+            CGPathAddQuadCurveToPoint(currentPath, nullptr, p[0], p[1], p[2], p[3]);
+        else if (command == "C" && lineStream >> p[0] >> p[1] >> p[2] >> p[3] >> p[4] >> p[5])
+            CGPathAddCurveToPoint(currentPath, nullptr, p[0], p[1], p[2], p[3], p[4], p[5]);
+        else if (command == "Z")
+            CGPathCloseSubpath(currentPath);
+        else
+            break;
+    }
+
+    if (currentPath) {
+        CGPathRelease(currentPath);
+        return false;
+    }
+    return stream.eof();
+}
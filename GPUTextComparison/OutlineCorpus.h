@@ -0,0 +1,51 @@
+//
+//  OutlineCorpus.h
+//  GPUTextComparison
+//
+//  Created by Litherum on 5/15/16.
+//  Copyright © 2016 Litherum. All rights reserved.
+//
+
+#ifndef OutlineCorpus_h
+#define OutlineCorpus_h
+
+#include <CoreGraphics/CoreGraphics.h>
+
+// A corpus is a text file of glyph outlines, so the triangulator can be fed without CoreText:
+//     glyph <font identity> <glyph ID>
+//     M x y
+//     L x y
+//     Q cx cy x y
+//     C c1x c1y c2x c2y x y
+//     Z
+//     end
+// Lines starting with # are comments. Font identities must not contain whitespace.
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct OutlineCorpusWriter* OutlineCorpusWriterRef;
+OutlineCorpusWriterRef createOutlineCorpusWriter(const char* path);
+void outlineCorpusWriterAppend(OutlineCorpusWriterRef, const char* fontIdentity, CGGlyph, CGPathRef);
+// Returns false if anything failed to write.
+bool destroyOutlineCorpusWriter(OutlineCorpusWriterRef);
+
+#ifdef __cplusplus
+}
+
+#include <string>
+#include <vector>
+
+#include "RetainPtr.h"
+
+struct CorpusOutline {
+    std::string fontIdentity;
+    CGGlyph glyphID;
+    RetainPtr<CGPathRef> path;
+};
+
+bool readOutlineCorpus(const char* path, std::vector<CorpusOutline>&);
+#endif
+
+#endif /* OutlineCorpus_h */
@@ -0,0 +1,96 @@
+//
+//  ParallelFor.h
+//  GPUTextComparison
+//
+//  Created by Litherum on 5/14/16.
+//  Copyright © 2016 Litherum. All rights reserved.
+//
+
+#ifndef ParallelFor_h
+#define ParallelFor_h
+
+#include <algorithm>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work items are dealt round-robin into one deque per worker. A worker pops from the back of its own deque,
+// and when that runs dry it steals from the front of everyone else's. Glyphs vary wildly in cost (a period
+// versus an ampersand) so a static partition leaves most of the cores idle at the end of a batch.
+class WorkStealingQueues {
+public:
+    WorkStealingQueues(size_t count, unsigned workerCount) : queues(workerCount) {
+        for (auto& queue : queues)
+            queue.reset(new Queue);
+        for (size_t i = 0; i < count; ++i)
+            queues[i % workerCount]->items.push_back(i);
+    }
+
+    bool take(unsigned worker, size_t& item) {
+        if (popBack(*queues[worker], item))
+            return true;
+        for (unsigned i = 1; i < queues.size(); ++i) {
+            if (popFront(*queues[(worker + i) % queues.size()], item))
+                return true;
+        }
+        return false;
+    }
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<size_t> items;
+    };
+
+    static bool popBack(Queue& queue, size_t& item) {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.items.empty())
+            return false;
+        item = queue.items.back();
+        queue.items.pop_back();
+        return true;
+    }
+
+    static bool popFront(Queue& queue, size_t& item) {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.items.empty())
+            return false;
+        item = queue.items.front();
+        queue.items.pop_front();
+        return true;
+    }
+
+    std::vector<std::unique_ptr<Queue>> queues;
+};
+
+inline unsigned resolveThreadCount(unsigned threadCount) {
+    if (threadCount)
+        return threadCount;
+    return std::max(1U, std::thread::hardware_concurrency());
+}
+
+// Calls function(index, worker) exactly once for every index in [0, count). A threadCount of 0 means one worker per core.
+// The calling thread is worker 0.
+template <typename Function>
+void parallelFor(size_t count, unsigned threadCount, Function function) {
+    if (!count)
+        return;
+    unsigned workerCount = static_cast<unsigned>(std::min<size_t>(resolveThreadCount(threadCount), count));
+    WorkStealingQueues queues(count, workerCount);
+    auto work = [&](unsigned worker) {
+        size_t item;
+        while (queues.take(worker, item))
+            function(item, worker);
+    };
+
+    std::vector<std::thread> threads;
+    for (unsigned i = 1; i < workerCount; ++i)
+        threads.emplace_back(work, i);
+    work(0);
+    for (auto& thread : threads)
+        thread.join();
+}
+
+#endif /* ParallelFor_h */
@@ -0,0 +1,272 @@
+//
+//  PathSource.cpp
+//  GPUTextComparison
+//
+//  Created by Litherum on 5/20/16.
+//  Copyright © 2016 Litherum. All rights reserved.
+//
+
+#include "PathSource.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <string>
+
+namespace {
+
+class SVGPathParser {
+public:
+    SVGPathParser(const char* data, FlatPath& path) : cursor(data), path(path) {
+    }
+
+    bool parse() {
+        skipSpace();
+        while (*cursor) {
+            char command = *cursor++;
+            bool relative = command >= 'a' && command <= 'z';
+            char absolute = relative ? command - 'a' + 'A' : command;
+            if (path.types.empty() && absolute != 'M')
+                return false;
+            skipSpace();
+            if (absolute == 'Z') {
+                path.append(PathElementCloseSubpath, nullptr);
+                current = subpathBegin;
+                previousCommand = absolute;
+                continue;
+            }
+            // A command's arguments can repeat, as if the command letter were written again each time.
+            do {
+                if (!segment(absolute, relative))
+                    return false;
+                // After a moveto, further pairs are linetos.
+                if (absolute == 'M')
+                    absolute = 'L';
+            } while (startsNumber());
+        }
+        return true;
+    }
+
+private:
+    void skipSpace() {
+        while (*cursor == ' ' || *cursor == '\t' || *cursor == '\n' || *cursor == '\r' || *cursor == '\f')
+            ++cursor;
+    }
+
+    void skipSeparator() {
+        skipSpace();
+        if (*cursor == ',') {
+            ++cursor;
+            skipSpace();
+        }
+    }
+
+    bool startsNumber() const {
+        return (*cursor >= '0' && *cursor <= '9') || *cursor == '-' || *cursor == '+' || *cursor == '.';
+    }
+
+    static bool isDigit(char c) {
+        return c >= '0' && c <= '9';
+    }
+
+    // SVG's number grammar, which is stricter than strtod(): no hex, infinities or NaNs.
+    bool number(CGFloat& result) {
+        const char* end = cursor;
+        if (*end == '-' || *end == '+')
+            ++end;
+        size_t digits = 0;
+        for (; isDigit(*end); ++end)
+            ++digits;
+        if (*end == '.') {
+            for (++end; isDigit(*end); ++end)
+                ++digits;
+        }
+        if (!digits)
+            return false;
+        if (*end == 'e' || *end == 'E') {
+            const char* exponent = end + 1;
+            if (*exponent == '-' || *exponent == '+')
+                ++exponent;
+            if (isDigit(*exponent)) {
+                for (end = exponent; isDigit(*end); ++end) {
+                }
+            }
+        }
+        result = strtod(std::string(cursor, end).c_str(), nullptr);
+        cursor = end;
+        skipSeparator();
+        return true;
+    }
+
+    // Flags are a single digit, and need no separator after them.
+    bool flag(bool& result) {
+        if (*cursor != '0' && *cursor != '1')
+            return false;
+        result = *cursor++ == '1';
+        skipSeparator();
+        return true;
+    }
+
+    bool point(CGPoint& result, bool relative) {
+        CGFloat x, y;
+        if (!number(x) || !number(y))
+            return false;
+        result = relative ? CGPointMake(current.x + x, current.y + y) : CGPointMake(x, y);
+        return true;
+    }
+
+    static CGPoint reflect(CGPoint control, CGPoint around) {
+        return CGPointMake(2 * around.x - control.x, 2 * around.y - control.y);
+    }
+
+    void lineTo(CGPoint destination) {
+        path.append(PathElementAddLineToPoint, &destination);
+        current = destination;
+    }
+
+    void quadCurveTo(CGPoint control, CGPoint destination) {
+        CGPoint points[] = { control, destination };
+        path.append(PathElementAddQuadCurveToPoint, points);
+        lastControl = control;
+        current = destination;
+    }
+
+    void curveTo(CGPoint control1, CGPoint control2, CGPoint destination) {
+        CGPoint points[] = { control1, control2, destination };
+        path.append(PathElementAddCurveToPoint, points);
+        lastControl = control2;
+        current = destination;
+    }
+
+    bool segment(char command, bool relative) {
+        CGPoint p0, p1, p2;
+        CGFloat value;
+        switch (command) {
+        case 'M':
+            if (!point(p0, relative))
+                return false;
+            path.append(PathElementMoveToPoint, &p0);
+            current = subpathBegin = p0;
+            break;
+        case 'L':
+            if (!point(p0, relative))
+                return false;
+            lineTo(p0);
+            break;
+        case 'H':
+            if (!number(value))
+                return false;
+            lineTo(CGPointMake(relative ? current.x + value : value, current.y));
+            break;
+        case 'V':
+            if (!number(value))
+                return false;
+            lineTo(CGPointMake(current.x, relative ? current.y + value : value));
+            break;
+        case 'C':
+            if (!point(p0, relative) || !point(p1, relative) || !point(p2, relative))
+                return false;
+            curveTo(p0, p1, p2);
+            break;
+        case 'S':
+            if (!point(p1, relative) || !point(p2, relative))
+                return false;
+            curveTo(previousCommand == 'C' || previousCommand == 'S' ? reflect(lastControl, current) : current, p1, p2);
+            break;
+        case 'Q':
+            if (!point(p0, relative) || !point(p1, relative))
+                return false;
+            quadCurveTo(p0, p1);
+            break;
+        case 'T':
+            if (!point(p1, relative))
+                return false;
+            quadCurveTo(previousCommand == 'Q' || previousCommand == 'T' ? reflect(lastControl, current) : current, p1);
+            break;
+        case 'A': {
+            CGFloat rx, ry, rotation;
+            bool largeArc, sweep;
+            if (!number(rx) || !number(ry) || !number(rotation) || !flag(largeArc) || !flag(sweep) || !point(p0, relative))
+                return false;
+            arcTo(rx, ry, rotation, largeArc, sweep, p0);
+            break;
+        }
+        default:
+            return false;
+        }
+        previousCommand = command;
+        return true;
+    }
+
+    static CGFloat angle(CGFloat ux, CGFloat uy, CGFloat vx, CGFloat vy) {
+        return atan2(ux * vy - uy * vx, ux * vx + uy * vy);
+    }
+
+    // Endpoint to center parameterization, from the SVG spec's implementation notes, then one cubic per quarter turn.
+    void arcTo(CGFloat rx, CGFloat ry, CGFloat rotation, bool largeArc, bool sweep, CGPoint destination) {
+        if (CGPointEqualToPoint(current, destination))
+            return;
+        rx = std::abs(rx);
+        ry = std::abs(ry);
+        if (!rx || !ry) {
+            lineTo(destination);
+            return;
+        }
+
+        CGFloat phi = rotation * M_PI / 180;
+        CGFloat cosPhi = cos(phi);
+        CGFloat sinPhi = sin(phi);
+        CGFloat dx = (current.x - destination.x) / 2;
+        CGFloat dy = (current.y - destination.y) / 2;
+        CGFloat x1 = cosPhi * dx + sinPhi * dy;
+        CGFloat y1 = -sinPhi * dx + cosPhi * dy;
+
+        CGFloat lambda = x1 * x1 / (rx * rx) + y1 * y1 / (ry * ry);
+        if (lambda > 1) {
+            rx *= sqrt(lambda);
+            ry *= sqrt(lambda);
+        }
+        CGFloat numerator = rx * rx * ry * ry - rx * rx * y1 * y1 - ry * ry * x1 * x1;
+        CGFloat denominator = rx * rx * y1 * y1 + ry * ry * x1 * x1;
+        CGFloat coefficient = sqrt(std::max<CGFloat>(0, numerator / denominator));
+        if (largeArc == sweep)
+            coefficient = -coefficient;
+        CGFloat centerX = coefficient * rx * y1 / ry;
+        CGFloat centerY = -coefficient * ry * x1 / rx;
+        CGFloat cx = cosPhi * centerX - sinPhi * centerY + (current.x + destination.x) / 2;
+        CGFloat cy = sinPhi * centerX + cosPhi * centerY + (current.y + destination.y) / 2;
+
+        CGFloat start = angle(1, 0, (x1 - centerX) / rx, (y1 - centerY) / ry);
+        CGFloat sweepAngle = angle((x1 - centerX) / rx, (y1 - centerY) / ry, (-x1 - centerX) / rx, (-y1 - centerY) / ry);
+        if (!sweep && sweepAngle > 0)
+            sweepAngle -= 2 * M_PI;
+        else if (sweep && sweepAngle < 0)
+            sweepAngle += 2 * M_PI;
+
+        auto map = [&](CGFloat x, CGFloat y) {
+            return CGPointMake(cx + rx * cosPhi * x - ry * sinPhi * y, cy + rx * sinPhi * x + ry * cosPhi * y);
+        };
+        unsigned segments = std::max(1u, static_cast<unsigned>(ceil(std::abs(sweepAngle) / (M_PI / 2) - 0.001)));
+        CGFloat delta = sweepAngle / segments;
+        CGFloat handle = 4 * tan(delta / 4) / 3;
+        for (unsigned i = 0; i < segments; ++i) {
+            CGFloat a = start + i * delta;
+            CGFloat b = a + delta;
+            CGPoint end = i + 1 == segments ? destination : map(cos(b), sin(b));
+            curveTo(map(cos(a) - handle * sin(a), sin(a) + handle * cos(a)), map(cos(b) + handle * sin(b), sin(b) - handle * cos(b)), end);
+        }
+    }
+
+    const char* cursor;
+    FlatPath& path;
+    CGPoint current { 0, 0 };
+    CGPoint subpathBegin { 0, 0 };
+    CGPoint lastControl { 0, 0 };
+    char previousCommand { 0 };
+};
+
+}
+
+SVGPathSource::SVGPathSource(const char* pathData) {
+    valid = SVGPathParser(pathData, path).parse();
+}
@@ -0,0 +1,145 @@
+//
+//  PathSource.h
+//  GPUTextComparison
+//
+//  Created by Litherum on 5/20/16.
+//  Copyright © 2016 Litherum. All rights reserved.
+//
+
+#ifndef PathSource_h
+#define PathSource_h
+
+#include <CoreGraphics/CoreGraphics.h>
+
+// The same verbs, in the same order, as CGPathElementType.
+typedef enum PathElementType {
+    PathElementMoveToPoint,
+    PathElementAddLineToPoint,
+    PathElementAddQuadCurveToPoint,
+    PathElementAddCurveToPoint,
+    PathElementCloseSubpath
+} PathElementType;
+
+typedef struct PathElement {
+    PathElementType type;
+    const CGPoint* points;
+} PathElement;
+
+// Which points a path covers. Font outlines are nonzero; their contours may overlap.
+typedef enum TriangulationFillRule {
+    TriangulationFillRuleEvenOdd,
+    TriangulationFillRuleNonZero
+} TriangulationFillRule;
+
+#ifdef __cplusplus
+
+#include <vector>
+
+// A path source is anything with
+//     template <typename Function> void iterate(Function) const;
+// that calls function(PathElement) once per element, in order, and can be iterated more than once. Triangulator is
+// templated on it, so each element reaches the triangulator through a direct, inlinable call.
+
+inline unsigned pathElementPointCount(PathElementType type) {
+    switch (type) {
+    case PathElementMoveToPoint:
+    case PathElementAddLineToPoint:
+        return 1;
+    case PathElementAddQuadCurveToPoint:
+        return 2;
+    case PathElementAddCurveToPoint:
+        return 3;
+    case PathElementCloseSubpath:
+        return 0;
+    }
+    return 0;
+}
+
+// CGPathApply() still makes one call through a function pointer per element, but it lands directly in function.
+class CGPathSource {
+public:
+    CGPathSource(CGPathRef path) : path(path) {
+    }
+
+    template <typename Function>
+    void iterate(Function function) const {
+        CGPathApply(path, &function, [](void* info, const CGPathElement* element) {
+            (*static_cast<Function*>(info))(PathElement { static_cast<PathElementType>(element->type), element->points });
+        });
+    }
+
+private:
+    CGPathRef path;
+};
+
+// Borrowed arrays: element i takes the next pathElementPointCount(types[i]) points.
+class FlatPathSource {
+public:
+    FlatPathSource(const PathElementType* types, size_t count, const CGPoint* points) : types(types), count(count), points(points) {
+    }
+
+    template <typename Function>
+    void iterate(Function function) const {
+        const CGPoint* elementPoints = points;
+        for (size_t i = 0; i < count; ++i) {
+            function(PathElement { types[i], elementPoints });
+            elementPoints += pathElementPointCount(types[i]);
+        }
+    }
+
+private:
+    const PathElementType* types;
+    size_t count;
+    const CGPoint* points;
+};
+
+// The same layout, owned.
+struct FlatPath {
+    void append(PathElementType type, const CGPoint* elementPoints) {
+        types.push_back(type);
+        points.insert(points.end(), elementPoints, elementPoints + pathElementPointCount(type));
+    }
+
+    void clear() {
+        types.clear();
+        points.clear();
+    }
+
+    FlatPathSource source() const {
+        return FlatPathSource(types.data(), types.size(), points.data());
+    }
+
+    template <typename Function>
+    void iterate(Function function) const {
+        source().iterate(function);
+    }
+
+    std::vector<PathElementType> types;
+    std::vector<CGPoint> points;
+};
+
+// Parses SVG path data (the "d" attribute) up front. Arcs become cubics, and relative, horizontal, vertical and
+// smooth commands become their absolute equivalents. Coordinates are taken as they are, so SVG's y-down data comes
+// out upside down compared to CoreGraphics unless it is flipped first.
+// As SVG renders it, malformed data keeps every element before the first error, and isValid() returns false.
+class SVGPathSource {
+public:
+    explicit SVGPathSource(const char* pathData);
+
+    bool isValid() const {
+        return valid;
+    }
+
+    template <typename Function>
+    void iterate(Function function) const {
+        path.iterate(function);
+    }
+
+private:
+    FlatPath path;
+    bool valid;
+};
+
+#endif
+
+#endif /* PathSource_h */
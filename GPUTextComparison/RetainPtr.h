@@ -23,6 +23,17 @@ public:
     RetainPtr(T t, AdoptFlag) : t(t) {
     }
 
+    RetainPtr(const RetainPtr& other) : t(other.t) {
+        CFRetain(t);
+    }
+
+    RetainPtr& operator=(const RetainPtr& other) {
+        CFRetain(other.t);
+        CFRelease(t);
+        t = other.t;
+        return *this;
+    }
+
     ~RetainPtr() {
         CFRelease(t);
     }
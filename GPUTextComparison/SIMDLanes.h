@@ -0,0 +1,126 @@
+//
+//  SIMDLanes.h
+//  GPUTextComparison
+//
+//  Created by Litherum on 5/17/16.
+//  Copyright © 2016 Litherum. All rights reserved.
+//
+
+#ifndef SIMDLanes_h
+#define SIMDLanes_h
+
+#include <cstddef>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#else
+#include <cmath>
+#endif
+
+// A handful of doubles operated on at once. SSE2 and NEON give two lanes, and anything else one.
+// The arithmetic is plain IEEE per lane, so it rounds exactly like the equivalent scalar code, as long as the compiler
+// doesn't contract that scalar code's a * b + c into fused multiply-adds; both builds pass -ffp-contract=off.
+// Comparisons produce a LaneMask, which select() consumes and bits() turns into one bit per lane.
+//
+// Everything is in namespace SIMD, so sqrt(), abs(), select() and friends don't collide with the C library's. The
+// functions taking lanes are found by argument-dependent lookup; load(), broadcast() and the types need qualifying.
+
+namespace SIMD {
+
+#if defined(__SSE2__)
+
+struct DoubleLanes {
+    __m128d value;
+};
+
+struct LaneMask {
+    __m128d value;
+};
+
+static const size_t laneCount = 2;
+
+static inline DoubleLanes load(const double* source) { return { _mm_loadu_pd(source) }; }
+static inline void store(double* destination, DoubleLanes a) { _mm_storeu_pd(destination, a.value); }
+static inline DoubleLanes broadcast(double x) { return { _mm_set1_pd(x) }; }
+static inline DoubleLanes operator+(DoubleLanes a, DoubleLanes b) { return { _mm_add_pd(a.value, b.value) }; }
+static inline DoubleLanes operator-(DoubleLanes a, DoubleLanes b) { return { _mm_sub_pd(a.value, b.value) }; }
+static inline DoubleLanes operator*(DoubleLanes a, DoubleLanes b) { return { _mm_mul_pd(a.value, b.value) }; }
+static inline DoubleLanes operator/(DoubleLanes a, DoubleLanes b) { return { _mm_div_pd(a.value, b.value) }; }
+static inline DoubleLanes operator-(DoubleLanes a) { return { _mm_xor_pd(a.value, _mm_set1_pd(-0.0)) }; }
+static inline DoubleLanes sqrt(DoubleLanes a) { return { _mm_sqrt_pd(a.value) }; }
+static inline DoubleLanes abs(DoubleLanes a) { return { _mm_andnot_pd(_mm_set1_pd(-0.0), a.value) }; }
+static inline LaneMask operator<(DoubleLanes a, DoubleLanes b) { return { _mm_cmplt_pd(a.value, b.value) }; }
+static inline LaneMask operator>(DoubleLanes a, DoubleLanes b) { return { _mm_cmpgt_pd(a.value, b.value) }; }
+static inline LaneMask operator==(DoubleLanes a, DoubleLanes b) { return { _mm_cmpeq_pd(a.value, b.value) }; }
+static inline LaneMask operator&(LaneMask a, LaneMask b) { return { _mm_and_pd(a.value, b.value) }; }
+static inline LaneMask operator|(LaneMask a, LaneMask b) { return { _mm_or_pd(a.value, b.value) }; }
+static inline DoubleLanes select(LaneMask mask, DoubleLanes a, DoubleLanes b) { return { _mm_or_pd(_mm_and_pd(mask.value, a.value), _mm_andnot_pd(mask.value, b.value)) }; }
+static inline unsigned bits(LaneMask mask) { return static_cast<unsigned>(_mm_movemask_pd(mask.value)); }
+
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+
+struct DoubleLanes {
+    float64x2_t value;
+};
+
+struct LaneMask {
+    uint64x2_t value;
+};
+
+static const size_t laneCount = 2;
+
+static inline DoubleLanes load(const double* source) { return { vld1q_f64(source) }; }
+static inline void store(double* destination, DoubleLanes a) { vst1q_f64(destination, a.value); }
+static inline DoubleLanes broadcast(double x) { return { vdupq_n_f64(x) }; }
+static inline DoubleLanes operator+(DoubleLanes a, DoubleLanes b) { return { vaddq_f64(a.value, b.value) }; }
+static inline DoubleLanes operator-(DoubleLanes a, DoubleLanes b) { return { vsubq_f64(a.value, b.value) }; }
+static inline DoubleLanes operator*(DoubleLanes a, DoubleLanes b) { return { vmulq_f64(a.value, b.value) }; }
+static inline DoubleLanes operator/(DoubleLanes a, DoubleLanes b) { return { vdivq_f64(a.value, b.value) }; }
+static inline DoubleLanes operator-(DoubleLanes a) { return { vnegq_f64(a.value) }; }
+static inline DoubleLanes sqrt(DoubleLanes a) { return { vsqrtq_f64(a.value) }; }
+static inline DoubleLanes abs(DoubleLanes a) { return { vabsq_f64(a.value) }; }
+static inline LaneMask operator<(DoubleLanes a, DoubleLanes b) { return { vcltq_f64(a.value, b.value) }; }
+static inline LaneMask operator>(DoubleLanes a, DoubleLanes b) { return { vcgtq_f64(a.value, b.value) }; }
+static inline LaneMask operator==(DoubleLanes a, DoubleLanes b) { return { vceqq_f64(a.value, b.value) }; }
+static inline LaneMask operator&(LaneMask a, LaneMask b) { return { vandq_u64(a.value, b.value) }; }
+static inline LaneMask operator|(LaneMask a, LaneMask b) { return { vorrq_u64(a.value, b.value) }; }
+static inline DoubleLanes select(LaneMask mask, DoubleLanes a, DoubleLanes b) { return { vbslq_f64(mask.value, a.value, b.value) }; }
+static inline unsigned bits(LaneMask mask) { return static_cast<unsigned>((vgetq_lane_u64(mask.value, 0) & 1) | ((vgetq_lane_u64(mask.value, 1) & 1) << 1)); }
+
+#else
+
+struct DoubleLanes {
+    double value;
+};
+
+struct LaneMask {
+    bool value;
+};
+
+static const size_t laneCount = 1;
+
+static inline DoubleLanes load(const double* source) { return { *source }; }
+static inline void store(double* destination, DoubleLanes a) { *destination = a.value; }
+static inline DoubleLanes broadcast(double x) { return { x }; }
+static inline DoubleLanes operator+(DoubleLanes a, DoubleLanes b) { return { a.value + b.value }; }
+static inline DoubleLanes operator-(DoubleLanes a, DoubleLanes b) { return { a.value - b.value }; }
+static inline DoubleLanes operator*(DoubleLanes a, DoubleLanes b) { return { a.value * b.value }; }
+static inline DoubleLanes operator/(DoubleLanes a, DoubleLanes b) { return { a.value / b.value }; }
+static inline DoubleLanes operator-(DoubleLanes a) { return { -a.value }; }
+static inline DoubleLanes sqrt(DoubleLanes a) { return { std::sqrt(a.value) }; }
+static inline DoubleLanes abs(DoubleLanes a) { return { std::abs(a.value) }; }
+static inline LaneMask operator<(DoubleLanes a, DoubleLanes b) { return { a.value < b.value }; }
+static inline LaneMask operator>(DoubleLanes a, DoubleLanes b) { return { a.value > b.value }; }
+static inline LaneMask operator==(DoubleLanes a, DoubleLanes b) { return { a.value == b.value }; }
+static inline LaneMask operator&(LaneMask a, LaneMask b) { return { a.value && b.value }; }
+static inline LaneMask operator|(LaneMask a, LaneMask b) { return { a.value || b.value }; }
+static inline DoubleLanes select(LaneMask mask, DoubleLanes a, DoubleLanes b) { return mask.value ? a : b; }
+static inline unsigned bits(LaneMask mask) { return mask.value ? 1 : 0; }
+
+#endif
+
+}
+
+#endif /* SIMDLanes_h */
@@ -0,0 +1,257 @@
+//
+//  SoftwareRasterizer.cpp
+//  GPUTextComparison
+//
+//  Created by Litherum on 5/23/16.
+//  Copyright © 2016 Litherum. All rights reserved.
+//
+
+#include "SoftwareRasterizer.h"
+
+#include "ParallelFor.h"
+#include "SIMDLanes.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace {
+
+const int64_t subpixelScale = 256;
+const double maximumCoordinate = 1 << 17;
+const int tileSize = 64;
+
+// E(X, Y) = a * (X - x0) + b * (Y - y0) in 1/256 pixel units, positive inside. Snapped coordinates stay below 2^26, so
+// every product and sum below stays under 2^53, and the double lanes compute edge values exactly, like integers would.
+struct Edge {
+    int64_t a;
+    int64_t b;
+    int64_t x0;
+    int64_t y0;
+    // 0 if the edge owns pixel centers exactly on it, and -1 if its neighbor across the edge does.
+    int64_t bias;
+};
+
+// The attribute at the center of pixel (x, y) is base + dx * x + dy * y.
+struct Plane {
+    double dx;
+    double dy;
+    double base;
+
+    double at(int x, int y) const {
+        return base + dx * x + dy * y;
+    }
+};
+
+struct TriangleSetup {
+    Edge edges[3];
+    Plane k;
+    Plane l;
+    Plane m;
+    // Inclusive, and clamped to the image.
+    int minX;
+    int maxX;
+    int minY;
+    int maxY;
+};
+
+int64_t floorDivide(int64_t numerator, int64_t denominator) {
+    return numerator >= 0 ? numerator / denominator : -((-numerator + denominator - 1) / denominator);
+}
+
+Plane plane(const double (&x)[3], const double (&y)[3], double v0, double v1, double v2) {
+    double determinant = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+    Plane result;
+    result.dx = ((v1 - v0) * (y[2] - y[0]) - (v2 - v0) * (y[1] - y[0])) / determinant;
+    result.dy = ((v2 - v0) * (x[1] - x[0]) - (v1 - v0) * (x[2] - x[0])) / determinant;
+    result.base = v0 + result.dx * (0.5 - x[0]) + result.dy * (0.5 - y[0]);
+    return result;
+}
+
+bool setUp(const vector_float2* positions, const vector_float4* coefficients, const uint32_t (&vertices)[3], int width, int height, TriangleSetup& setup) {
+    int64_t px[3];
+    int64_t py[3];
+    for (unsigned i = 0; i < 3; ++i) {
+        auto position = positions[vertices[i]];
+        if (!(std::abs(position.x) <= maximumCoordinate && std::abs(position.y) <= maximumCoordinate))
+            return false;
+        px[i] = static_cast<int64_t>(std::llround(position.x * subpixelScale));
+        py[i] = static_cast<int64_t>(std::llround(position.y * subpixelScale));
+    }
+    uint32_t order[3] = { vertices[0], vertices[1], vertices[2] };
+    int64_t area = (px[1] - px[0]) * (py[2] - py[0]) - (px[2] - px[0]) * (py[1] - py[0]);
+    if (!area)
+        return false;
+    // Counterclockwise, so the inside of every edge is positive.
+    if (area < 0) {
+        std::swap(px[1], px[2]);
+        std::swap(py[1], py[2]);
+        std::swap(order[1], order[2]);
+    }
+
+    for (unsigned i = 0; i < 3; ++i) {
+        unsigned j = (i + 1) % 3;
+        auto& edge = setup.edges[i];
+        edge.a = -(py[j] - py[i]);
+        edge.b = px[j] - px[i];
+        edge.x0 = px[i];
+        edge.y0 = py[i];
+        // The same edge walked the other way has both signs flipped, so exactly one of the two owns it.
+        edge.bias = edge.a > 0 || (!edge.a && edge.b > 0) ? 0 : -1;
+    }
+
+    int64_t minX = std::min(px[0], std::min(px[1], px[2]));
+    int64_t maxX = std::max(px[0], std::max(px[1], px[2]));
+    int64_t minY = std::min(py[0], std::min(py[1], py[2]));
+    int64_t maxY = std::max(py[0], std::max(py[1], py[2]));
+    // Pixel x's center is x * 256 + 128.
+    setup.minX = static_cast<int>(std::max<int64_t>(0, floorDivide(minX - subpixelScale / 2 + subpixelScale - 1, subpixelScale)));
+    setup.maxX = static_cast<int>(std::min<int64_t>(width - 1, floorDivide(maxX - subpixelScale / 2, subpixelScale)));
+    setup.minY = static_cast<int>(std::max<int64_t>(0, floorDivide(minY - subpixelScale / 2 + subpixelScale - 1, subpixelScale)));
+    setup.maxY = static_cast<int>(std::min<int64_t>(height - 1, floorDivide(maxY - subpixelScale / 2, subpixelScale)));
+    if (setup.minX > setup.maxX || setup.minY > setup.maxY)
+        return false;
+
+    double x[3];
+    double y[3];
+    for (unsigned i = 0; i < 3; ++i) {
+        x[i] = static_cast<double>(px[i]) / subpixelScale;
+        y[i] = static_cast<double>(py[i]) / subpixelScale;
+    }
+    auto& c0 = coefficients[order[0]];
+    auto& c1 = coefficients[order[1]];
+    auto& c2 = coefficients[order[2]];
+    setup.k = plane(x, y, c0.x, c1.x, c2.x);
+    setup.l = plane(x, y, c0.y, c1.y, c2.y);
+    setup.m = plane(x, y, c0.z, c1.z, c2.z);
+    return true;
+}
+
+SIMD::DoubleLanes laneIndices() {
+    double lanes[SIMD::laneCount];
+    for (size_t i = 0; i < SIMD::laneCount; ++i)
+        lanes[i] = static_cast<double>(i);
+    return SIMD::load(lanes);
+}
+
+unsigned popCount(unsigned bits) {
+    unsigned count = 0;
+    for (; bits; bits &= bits - 1)
+        ++count;
+    return count;
+}
+
+void drawTriangle(const TriangleSetup& triangle, int tileMinX, int tileMaxX, int tileMinY, int tileMaxY, bool antialias, uint8_t* pixels, size_t bytesPerRow, RasterizerStats& stats) {
+    int minX = std::max(triangle.minX, tileMinX);
+    int maxX = std::min(triangle.maxX, tileMaxX);
+    int minY = std::max(triangle.minY, tileMinY);
+    int maxY = std::min(triangle.maxY, tileMaxY);
+    if (minX > maxX || minY > maxY)
+        return;
+
+    auto indices = laneIndices();
+    SIMD::DoubleLanes edgeSteps[3];
+    for (unsigned i = 0; i < 3; ++i)
+        edgeSteps[i] = SIMD::broadcast(static_cast<double>(triangle.edges[i].a * subpixelScale)) * indices;
+    auto kSteps = SIMD::broadcast(triangle.k.dx) * indices;
+    auto lSteps = SIMD::broadcast(triangle.l.dx) * indices;
+    auto mSteps = SIMD::broadcast(triangle.m.dx) * indices;
+    auto zero = SIMD::broadcast(0);
+    auto one = SIMD::broadcast(1);
+    auto outside = SIMD::broadcast(-1);
+
+    for (int y = minY; y <= maxY; ++y) {
+        int64_t centerY = y * subpixelScale + subpixelScale / 2;
+        int64_t rowEdges[3];
+        for (unsigned i = 0; i < 3; ++i) {
+            auto& edge = triangle.edges[i];
+            rowEdges[i] = edge.a * (minX * subpixelScale + subpixelScale / 2 - edge.x0) + edge.b * (centerY - edge.y0) + edge.bias;
+        }
+        uint8_t* row = pixels + y * bytesPerRow;
+        for (int x = minX; x <= maxX; x += static_cast<int>(SIMD::laneCount)) {
+            int64_t offset = x - minX;
+            auto e0 = SIMD::broadcast(static_cast<double>(rowEdges[0] + triangle.edges[0].a * subpixelScale * offset)) + edgeSteps[0];
+            auto e1 = SIMD::broadcast(static_cast<double>(rowEdges[1] + triangle.edges[1].a * subpixelScale * offset)) + edgeSteps[1];
+            auto e2 = SIMD::broadcast(static_cast<double>(rowEdges[2] + triangle.edges[2].a * subpixelScale * offset)) + edgeSteps[2];
+            unsigned count = static_cast<unsigned>(std::min<int>(static_cast<int>(SIMD::laneCount), maxX - x + 1));
+            unsigned covered = bits((e0 > outside) & (e1 > outside) & (e2 > outside)) & ((1u << count) - 1);
+            stats.testedPixels += count;
+            if (!covered)
+                continue;
+            stats.coveredPixels += popCount(covered);
+
+            auto k = SIMD::broadcast(triangle.k.at(x, y)) + kSteps;
+            auto l = SIMD::broadcast(triangle.l.at(x, y)) + lSteps;
+            auto m = SIMD::broadcast(triangle.m.at(x, y)) + mSteps;
+            auto f = k * k * k - l * m;
+            auto coverage = select(f > zero, zero, one);
+            if (antialias) {
+                auto three = SIMD::broadcast(3);
+                auto gradientX = three * k * k * SIMD::broadcast(triangle.k.dx) - m * SIMD::broadcast(triangle.l.dx) - l * SIMD::broadcast(triangle.m.dx);
+                auto gradientY = three * k * k * SIMD::broadcast(triangle.k.dy) - m * SIMD::broadcast(triangle.l.dy) - l * SIMD::broadcast(triangle.m.dy);
+                auto length = sqrt(gradientX * gradientX + gradientY * gradientY);
+                auto ramp = SIMD::broadcast(0.5) - f / length;
+                ramp = select(ramp < zero, zero, select(ramp > one, one, ramp));
+                // Where k^3 - l*m is flat, such as across interior triangles, there is nothing to ramp.
+                coverage = select(length == zero, coverage, ramp);
+            }
+            double values[SIMD::laneCount];
+            store(values, coverage);
+            for (unsigned i = 0; i < count; ++i) {
+                if (covered & (1u << i))
+                    row[x + i] = static_cast<uint8_t>(values[i] * 255 + 0.5);
+            }
+        }
+    }
+}
+
+}
+
+RasterizerStats rasterizeCubicTrianglesWithStats(const vector_float2* positions, const vector_float4* coefficients, const uint16_t* indices, size_t count, bool antialias, unsigned threadCount, uint8_t* pixels, size_t width, size_t height, size_t bytesPerRow) {
+    RasterizerStats stats;
+    if (!width || !height)
+        return stats;
+    int tilesAcross = static_cast<int>((width + tileSize - 1) / tileSize);
+    int tilesDown = static_cast<int>((height + tileSize - 1) / tileSize);
+
+    // Setting up is cheap next to drawing, so it happens here, in order, and only the tiles run in parallel.
+    std::vector<TriangleSetup> triangles;
+    triangles.reserve(count / 3);
+    std::vector<std::vector<uint32_t>> bins(tilesAcross * tilesDown);
+    for (size_t i = 0; i + 2 < count; i += 3) {
+        ++stats.triangles;
+        uint32_t vertices[3];
+        for (unsigned j = 0; j < 3; ++j)
+            vertices[j] = indices ? indices[i + j] : static_cast<uint32_t>(i + j);
+        TriangleSetup setup;
+        if (!setUp(positions, coefficients, vertices, static_cast<int>(width), static_cast<int>(height), setup)) {
+            ++stats.skippedTriangles;
+            continue;
+        }
+        auto index = static_cast<uint32_t>(triangles.size());
+        triangles.push_back(setup);
+        for (int tileY = setup.minY / tileSize; tileY <= setup.maxY / tileSize; ++tileY) {
+            for (int tileX = setup.minX / tileSize; tileX <= setup.maxX / tileSize; ++tileX)
+                bins[tileY * tilesAcross + tileX].push_back(index);
+        }
+    }
+
+    std::vector<RasterizerStats> workerStats(resolveThreadCount(threadCount));
+    parallelFor(bins.size(), threadCount, [&](size_t tile, unsigned worker) {
+        int tileMinX = static_cast<int>(tile % tilesAcross) * tileSize;
+        int tileMinY = static_cast<int>(tile / tilesAcross) * tileSize;
+        for (auto index : bins[tile])
+            drawTriangle(triangles[index], tileMinX, tileMinX + tileSize - 1, tileMinY, tileMinY + tileSize - 1, antialias, pixels, bytesPerRow, workerStats[worker]);
+        workerStats[worker].binnedTriangles += bins[tile].size();
+    });
+    for (auto& worker : workerStats) {
+        stats.binnedTriangles += worker.binnedTriangles;
+        stats.testedPixels += worker.testedPixels;
+        stats.coveredPixels += worker.coveredPixels;
+    }
+    return stats;
+}
+
+void rasterizeCubicTriangles(const vector_float2* positions, const vector_float4* coefficients, const uint16_t* indices, size_t count, bool antialias, unsigned threadCount, uint8_t* pixels, size_t width, size_t height, size_t bytesPerRow) {
+    rasterizeCubicTrianglesWithStats(positions, coefficients, indices, count, antialias, threadCount, pixels, width, height, bytesPerRow);
+}
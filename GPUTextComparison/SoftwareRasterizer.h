@@ -0,0 +1,52 @@
+//
+//  SoftwareRasterizer.h
+//  GPUTextComparison
+//
+//  Created by Litherum on 5/23/16.
+//  Copyright © 2016 Litherum. All rights reserved.
+//
+
+#ifndef SoftwareRasterizer_h
+#define SoftwareRasterizer_h
+
+#include <simd/simd.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Draws Loop-Blinn triangles the way loopBlinnVertex and loopBlinnFragment do, on the CPU: every pixel whose center a
+// triangle covers gets 255 where k^3 - l*m <= 0 and 0 elsewhere, with no blending. Positions are in pixels, and row 0
+// of pixels is y = 0, so y goes up the image as it does in CoreGraphics.
+//
+// Edges are snapped to 1/256 pixel and follow a top-left style rule, so a pixel center on an edge two triangles share
+// is drawn by exactly one of them. The image is tiled and tiles are drawn in parallel, but each tile draws its
+// triangles in order, so the result is identical for any thread count.
+//
+// With antialias, pixels near the curve get partial coverage from their distance to it, approximated as
+// (k^3 - l*m) / |gradient of k^3 - l*m|, as in Loop and Blinn's paper. Straight edges stay aliased, as on the GPU.
+//
+// indices may be NULL, in which case count vertices make count / 3 triangles. Otherwise count indices do. Triangles
+// with a vertex more than 2^17 pixels from the origin are skipped.
+void rasterizeCubicTriangles(const vector_float2* positions, const vector_float4* coefficients, const uint16_t* indices, size_t count, bool antialias, unsigned threadCount, uint8_t* pixels, size_t width, size_t height, size_t bytesPerRow);
+
+#ifdef __cplusplus
+}
+
+struct RasterizerStats {
+    size_t triangles { 0 };
+    size_t skippedTriangles { 0 };
+    // Triangle and tile pairs drawn.
+    size_t binnedTriangles { 0 };
+    // Pixel centers tested against some triangle's edges, and how many of those it covered.
+    size_t testedPixels { 0 };
+    size_t coveredPixels { 0 };
+};
+
+RasterizerStats rasterizeCubicTrianglesWithStats(const vector_float2* positions, const vector_float4* coefficients, const uint16_t* indices, size_t count, bool antialias, unsigned threadCount, uint8_t* pixels, size_t width, size_t height, size_t bytesPerRow);
+#endif
+
+#endif /* SoftwareRasterizer_h */
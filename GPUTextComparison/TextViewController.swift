@@ -8,6 +8,9 @@
 
 import Cocoa
 
+// What each view controller's GlyphCache may hold before it starts evicting.
+let GlyphCacheByteBudget = 64*1024*1024
+
 class TextViewController : NSViewController {
-    var frames : [Frame] = []
+    var frames : FrameSource? = nil
 }
\ No newline at end of file
@@ -0,0 +1,269 @@
+//
+//  TriangulationPipeline.cpp
+//  GPUTextComparison
+//
+//  Created by Litherum on 5/27/16.
+//  Copyright © 2016 Litherum. All rights reserved.
+//
+
+#include "TriangulationPipeline.h"
+
+#include "ParallelFor.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+enum class RequestState {
+    Queued,
+    Running,
+    Ready,
+};
+
+struct Request {
+    RequestState state;
+    // Retained while queued or running.
+    CGPathRef path;
+    CGFloat flatteningTolerance;
+    uint64_t deadline;
+    CubicTriangleMesh mesh;
+    // Running, but cancelled since, so the mesh is released as soon as it's done.
+    bool cancelled;
+};
+
+// A queued key. Moving a request up pushes it again, so an item whose deadline no longer matches its request is stale.
+struct QueueItem {
+    uint64_t deadline;
+    uint64_t sequence;
+    uint64_t key;
+
+    bool operator<(const QueueItem& other) const {
+        // std::priority_queue pops the largest, so the earliest deadline, then the earliest request, is largest.
+        if (deadline != other.deadline)
+            return deadline > other.deadline;
+        return sequence > other.sequence;
+    }
+};
+
+}
+
+struct TriangulationPipeline {
+    TriangulationPipeline(unsigned threadCount, TriangulationFillRule fillRule) : fillRule(fillRule) {
+        for (unsigned i = 0; i < threadCount; ++i)
+            workers.emplace_back([this] { work(); });
+    }
+
+    ~TriangulationPipeline() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        workAvailable.notify_all();
+        for (auto& worker : workers)
+            worker.join();
+        for (auto& keyAndRequest : requests) {
+            auto& request = keyAndRequest.second;
+            if (request.state == RequestState::Ready)
+                destroyCubicTriangleMesh(request.mesh);
+            else
+                CGPathRelease(request.path);
+        }
+    }
+
+    // Takes the most urgent queued request and marks it running. Must hold mutex.
+    bool popQueued(uint64_t& key, Request*& request) {
+        while (!queue.empty()) {
+            auto item = queue.top();
+            queue.pop();
+            auto iterator = requests.find(item.key);
+            if (iterator == requests.end() || iterator->second.state != RequestState::Queued || iterator->second.deadline != item.deadline)
+                continue;
+            key = item.key;
+            request = &iterator->second;
+            request->state = RequestState::Running;
+            --queueDepth;
+            ++running;
+            return true;
+        }
+        return false;
+    }
+
+    // Triangulates request without holding mutex. unordered_map never moves its values, so request stays valid while
+    // other keys come and go, and nobody removes a running request. A request cancelled meanwhile is removed here.
+    void run(std::unique_lock<std::mutex>& lock, uint64_t key, Request& request) {
+        CGPathRef path = request.path;
+        TriangulationOptions options;
+        options.fillRule = fillRule;
+        options.flatteningTolerance = request.flatteningTolerance;
+        lock.unlock();
+        auto mesh = createCubicTriangleMesh(path, options);
+        CGPathRelease(path);
+        lock.lock();
+        --running;
+        ++completed;
+        if (request.cancelled) {
+            destroyCubicTriangleMesh(mesh);
+            requests.erase(key);
+            return;
+        }
+        request.path = nullptr;
+        request.mesh = mesh;
+        request.state = RequestState::Ready;
+        finished.notify_all();
+    }
+
+    void work() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            workAvailable.wait(lock, [this] { return stopping || queueDepth; });
+            if (stopping)
+                return;
+            uint64_t key;
+            Request* request;
+            if (popQueued(key, request))
+                run(lock, key, *request);
+        }
+    }
+
+    TriangulationFillRule fillRule;
+    std::mutex mutex;
+    std::condition_variable workAvailable;
+    std::condition_variable finished;
+    std::unordered_map<uint64_t, Request> requests;
+    std::priority_queue<QueueItem> queue;
+    std::vector<std::thread> workers;
+    bool stopping { false };
+    uint64_t sequence { 0 };
+    size_t queueDepth { 0 };
+    size_t running { 0 };
+    size_t requestCount { 0 };
+    size_t duplicateRequests { 0 };
+    size_t completed { 0 };
+    size_t missedDeadlines { 0 };
+    double stallSeconds { 0 };
+};
+
+TriangulationPipelineRef createTriangulationPipeline(unsigned threadCount, TriangulationFillRule fillRule) {
+    if (!threadCount)
+        threadCount = std::max(resolveThreadCount(0), 2u) - 1;
+    return new TriangulationPipeline(threadCount, fillRule);
+}
+
+void destroyTriangulationPipeline(TriangulationPipelineRef pipeline) {
+    delete pipeline;
+}
+
+bool triangulationPipelineRequest(TriangulationPipelineRef pipeline, uint64_t key, CGPathRef path, CGFloat flatteningTolerance, uint64_t deadline) {
+    std::lock_guard<std::mutex> lock(pipeline->mutex);
+    ++pipeline->requestCount;
+    auto iterator = pipeline->requests.find(key);
+    if (iterator != pipeline->requests.end()) {
+        auto& request = iterator->second;
+        if (request.cancelled) {
+            request.cancelled = false;
+            return true;
+        }
+        ++pipeline->duplicateRequests;
+        if (request.state == RequestState::Queued && deadline < request.deadline) {
+            request.deadline = deadline;
+            pipeline->queue.push({ deadline, pipeline->sequence++, key });
+        }
+        return false;
+    }
+
+    Request request = { RequestState::Ready, nullptr, flatteningTolerance, deadline, { nullptr, nullptr, 0 }, false };
+    if (!path) {
+        ++pipeline->completed;
+        pipeline->requests.emplace(key, request);
+        return true;
+    }
+    request.state = RequestState::Queued;
+    request.path = CGPathRetain(path);
+    pipeline->requests.emplace(key, request);
+    pipeline->queue.push({ deadline, pipeline->sequence++, key });
+    ++pipeline->queueDepth;
+    pipeline->workAvailable.notify_one();
+    return true;
+}
+
+TriangulationPipelineStatus triangulationPipelineTake(TriangulationPipelineRef pipeline, uint64_t key, CubicTriangleMesh* mesh) {
+    std::lock_guard<std::mutex> lock(pipeline->mutex);
+    auto iterator = pipeline->requests.find(key);
+    if (iterator == pipeline->requests.end() || iterator->second.cancelled)
+        return TriangulationPipelineUnknown;
+    if (iterator->second.state != RequestState::Ready)
+        return TriangulationPipelinePending;
+    *mesh = iterator->second.mesh;
+    pipeline->requests.erase(iterator);
+    return TriangulationPipelineReady;
+}
+
+bool triangulationPipelineWait(TriangulationPipelineRef pipeline, uint64_t key, CubicTriangleMesh* mesh) {
+    auto start = std::chrono::steady_clock::now();
+    std::unique_lock<std::mutex> lock(pipeline->mutex);
+    auto iterator = pipeline->requests.find(key);
+    if (iterator == pipeline->requests.end() || iterator->second.cancelled)
+        return false;
+    auto& request = iterator->second;
+    if (request.state != RequestState::Ready) {
+        ++pipeline->missedDeadlines;
+        // Nobody has started it, so the fastest way to get it is to do it here.
+        if (request.state == RequestState::Queued) {
+            request.state = RequestState::Running;
+            --pipeline->queueDepth;
+            ++pipeline->running;
+            pipeline->run(lock, key, request);
+        } else {
+            pipeline->finished.wait(lock, [&] { return request.state == RequestState::Ready; });
+        }
+        pipeline->stallSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+    *mesh = request.mesh;
+    // Running or waiting let go of mutex, and a request for another key may have rehashed requests since, which
+    // leaves request where it was but not iterator.
+    pipeline->requests.erase(key);
+    return true;
+}
+
+bool triangulationPipelineCancel(TriangulationPipelineRef pipeline, uint64_t key) {
+    std::lock_guard<std::mutex> lock(pipeline->mutex);
+    auto iterator = pipeline->requests.find(key);
+    if (iterator == pipeline->requests.end() || iterator->second.cancelled)
+        return false;
+    auto& request = iterator->second;
+    switch (request.state) {
+    case RequestState::Queued:
+        // Its queue item goes stale.
+        CGPathRelease(request.path);
+        --pipeline->queueDepth;
+        break;
+    case RequestState::Running:
+        request.cancelled = true;
+        return true;
+    case RequestState::Ready:
+        destroyCubicTriangleMesh(request.mesh);
+        break;
+    }
+    pipeline->requests.erase(iterator);
+    return true;
+}
+
+TriangulationPipelineStatistics triangulationPipelineGetStatistics(TriangulationPipelineRef pipeline) {
+    std::lock_guard<std::mutex> lock(pipeline->mutex);
+    TriangulationPipelineStatistics result;
+    result.queueDepth = pipeline->queueDepth;
+    result.running = pipeline->running;
+    result.ready = pipeline->requests.size() - pipeline->queueDepth - pipeline->running;
+    result.requests = pipeline->requestCount;
+    result.duplicateRequests = pipeline->duplicateRequests;
+    result.completed = pipeline->completed;
+    result.missedDeadlines = pipeline->missedDeadlines;
+    result.stallSeconds = pipeline->stallSeconds;
+    return result;
+}
@@ -0,0 +1,85 @@
+//
+//  TriangulationPipeline.h
+//  GPUTextComparison
+//
+//  Created by Litherum on 5/27/16.
+//  Copyright © 2016 Litherum. All rights reserved.
+//
+
+#ifndef TriangulationPipeline_h
+#define TriangulationPipeline_h
+
+#include <CoreGraphics/CoreGraphics.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "Triangulator.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Triangulates glyphs on background threads ahead of when they're drawn. Since every frame is laid out up front, the
+// renderer can request the glyphs of the next few frames, and by the time it draws them their meshes are usually
+// done.
+//
+// Requests are single-flight: a key that is already queued, running or done isn't triangulated again. Workers take
+// the earliest deadline first. Finished meshes wait until taken, and taking one never waits on a triangulation. Only
+// triangulationPipelineWait() does, and every time it has to is a missed deadline.
+//
+// Glyphs are identified by a caller-chosen 64-bit key.
+typedef struct TriangulationPipeline* TriangulationPipelineRef;
+
+// threadCount background workers; 0 means one per core but one, leaving a core for the caller.
+TriangulationPipelineRef createTriangulationPipeline(unsigned threadCount, TriangulationFillRule);
+// Drops queued requests, waits for running ones, and releases every mesh not yet taken.
+void destroyTriangulationPipeline(TriangulationPipelineRef);
+
+// Queues path, which is retained until it's triangulated, unless key is already in the pipeline. A flatteningTolerance
+// above 0 makes a level-of-detail mesh; see TriangulationOptions. deadline orders the work, such as the number of the
+// frame that needs it; a request for a queued key with an earlier deadline moves it up. A NULL path is done at once,
+// with an empty mesh. Returns whether key was new.
+bool triangulationPipelineRequest(TriangulationPipelineRef, uint64_t key, CGPathRef, CGFloat flatteningTolerance, uint64_t deadline);
+
+typedef enum TriangulationPipelineStatus {
+    TriangulationPipelineReady,
+    // Queued or running.
+    TriangulationPipelinePending,
+    // Never requested, or already taken.
+    TriangulationPipelineUnknown,
+} TriangulationPipelineStatus;
+
+// If key is done, hands its mesh over, to be released with destroyCubicTriangleMesh(), and forgets the key.
+TriangulationPipelineStatus triangulationPipelineTake(TriangulationPipelineRef, uint64_t key, CubicTriangleMesh*);
+
+// Like triangulationPipelineTake(), but waits for a pending key, triangulating it on this thread if no worker has
+// started it. Returns false if key is unknown.
+bool triangulationPipelineWait(TriangulationPipelineRef, uint64_t key, CubicTriangleMesh*);
+
+// Forgets key, for a glyph that won't be drawn after all: drops it from the queue, or releases its mesh if it's done.
+// If a worker is running it, the worker releases the mesh when it finishes, unless key is requested again first.
+// Must not race triangulationPipelineWait() for the same key. Returns false if key is unknown.
+bool triangulationPipelineCancel(TriangulationPipelineRef, uint64_t key);
+
+typedef struct TriangulationPipelineStatistics {
+    size_t queueDepth;
+    size_t running;
+    // Done, and not yet taken.
+    size_t ready;
+    size_t requests;
+    // Requests for a key already in the pipeline.
+    size_t duplicateRequests;
+    size_t completed;
+    // Calls to triangulationPipelineWait() for a key that wasn't done.
+    size_t missedDeadlines;
+    // Time spent in those calls.
+    double stallSeconds;
+} TriangulationPipelineStatistics;
+
+TriangulationPipelineStatistics triangulationPipelineGetStatistics(TriangulationPipelineRef);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TriangulationPipeline_h */
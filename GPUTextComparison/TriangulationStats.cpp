@@ -0,0 +1,81 @@
+//
+//  TriangulationStats.cpp
+//  GPUTextComparison
+//
+//  Created by Litherum on 5/19/16.
+//  Copyright © 2016 Litherum. All rights reserved.
+//
+
+#include "TriangulationStats.h"
+
+#include <cstdio>
+
+#if TRIANGULATION_STATS
+__thread TriangulationStats* currentTriangulationStats = nullptr;
+__thread unsigned currentTriangulationThread = 0;
+__thread TriangulationPhaseScope* TriangulationPhaseScope::current = nullptr;
+#endif
+
+const char* triangulationPhaseName(TriangulationPhase phase) {
+    switch (phase) {
+    case TriangulationPhase::Insert:
+        return "insert";
+    case TriangulationPhase::HullSeparation:
+        return "hullSeparation";
+    case TriangulationPhase::Classify:
+        return "classify";
+    case TriangulationPhase::CubicSubdivision:
+        return "cubicSubdivision";
+    case TriangulationPhase::EarClipping:
+        return "earClipping";
+    case TriangulationPhase::StencilFan:
+        return "stencilFan";
+    case TriangulationPhase::ConstraintInsertion:
+        return "constraintInsertion";
+    case TriangulationPhase::Mark:
+        return "mark";
+    case TriangulationPhase::FaceEmission:
+        return "faceEmission";
+    }
+    return "unknown";
+}
+
+TriangulationStats& TriangulationStats::operator+=(const TriangulationStats& other) {
+    for (size_t i = 0; i < cubicTypeCount; ++i)
+        curves[i] += other.curves[i];
+    subdivisions += other.subdivisions;
+    degenerateCurves += other.degenerateCurves;
+    hullOverlaps += other.hullOverlaps;
+    hullSubdivisions += other.hullSubdivisions;
+    unresolvedHullOverlaps += other.unresolvedHullOverlaps;
+    constraintInsertions += other.constraintInsertions;
+    cgalFallbacks += other.cgalFallbacks;
+    interiorFaces += other.interiorFaces;
+    curveFaces += other.curveFaces;
+    for (size_t i = 0; i < triangulationPhaseCount; ++i)
+        seconds[i] += other.seconds[i];
+    trace.insert(trace.end(), other.trace.begin(), other.trace.end());
+    return *this;
+}
+
+bool writeChromeTrace(const TriangulationStats& stats, const char* path) {
+    FILE* file = fopen(path, "w");
+    if (!file)
+        return false;
+
+    bool failed = fprintf(file, "{\"traceEvents\":[") < 0;
+    for (size_t i = 0; i < stats.trace.size(); ++i) {
+        auto& event = stats.trace[i];
+        failed |= fprintf(file, "%s\n{\"name\":\"%s\",\"cat\":\"triangulation\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+            i ? "," : "", triangulationPhaseName(event.phase), event.thread, event.start, event.duration) < 0;
+    }
+    static const char* typeNames[cubicTypeCount] = { "degenerate", "quadratic", "serpentine", "loop", "cusp" };
+    failed |= fprintf(file, "\n],\n\"otherData\":{") < 0;
+    for (size_t i = 0; i < cubicTypeCount; ++i)
+        failed |= fprintf(file, "\"%sCurves\":%zu,", typeNames[i], stats.curves[i]) < 0;
+    failed |= fprintf(file, "\"subdivisions\":%zu,\"degenerateCurves\":%zu,\"hullOverlaps\":%zu,\"hullSubdivisions\":%zu,\"unresolvedHullOverlaps\":%zu,",
+        stats.subdivisions, stats.degenerateCurves, stats.hullOverlaps, stats.hullSubdivisions, stats.unresolvedHullOverlaps) < 0;
+    failed |= fprintf(file, "\"constraintInsertions\":%zu,\"cgalFallbacks\":%zu,\"interiorFaces\":%zu,\"curveFaces\":%zu}}\n",
+        stats.constraintInsertions, stats.cgalFallbacks, stats.interiorFaces, stats.curveFaces) < 0;
+    return !fclose(file) && !failed;
+}
@@ -0,0 +1,168 @@
+//
+//  TriangulationStats.h
+//  GPUTextComparison
+//
+//  Created by Litherum on 5/19/16.
+//  Copyright © 2016 Litherum. All rights reserved.
+//
+
+#ifndef TriangulationStats_h
+#define TriangulationStats_h
+
+#include "CubicClassification.h"
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <vector>
+
+// Build with TRIANGULATION_STATS=1 to have Triangulator and cubic() count what they do and time each phase. Otherwise
+// every hook below is an empty inline function, and the instrumentation compiles away entirely.
+#ifndef TRIANGULATION_STATS
+#define TRIANGULATION_STATS 0
+#endif
+
+enum class TriangulationPhase : unsigned {
+    Insert,
+    HullSeparation,
+    Classify,
+    CubicSubdivision,
+    EarClipping,
+    StencilFan,
+    ConstraintInsertion,
+    Mark,
+    FaceEmission
+};
+
+static const size_t triangulationPhaseCount = 9;
+
+const char* triangulationPhaseName(TriangulationPhase);
+
+// Times are in microseconds, as Chrome's trace viewer wants them.
+struct TriangulationTraceEvent {
+    TriangulationPhase phase;
+    unsigned thread;
+    double start;
+    double duration;
+};
+
+struct TriangulationStats {
+    TriangulationStats& operator+=(const TriangulationStats&);
+
+    std::array<size_t, cubicTypeCount> curves {{}};
+    size_t subdivisions { 0 };
+    // Curves with nothing to draw, which become straight edges of the interior instead.
+    size_t degenerateCurves { 0 };
+    // From separating curves' hulls: the overlaps the outlines came with, the splits that fixed them, and the overlaps
+    // left between edges that really touch.
+    size_t hullOverlaps { 0 };
+    size_t hullSubdivisions { 0 };
+    size_t unresolvedHullOverlaps { 0 };
+    size_t constraintInsertions { 0 };
+    size_t cgalFallbacks { 0 };
+    size_t interiorFaces { 0 };
+    size_t curveFaces { 0 };
+    // Seconds spent in each phase, not counting any phase nested inside it.
+    std::array<double, triangulationPhaseCount> seconds {{}};
+
+    // Per-curve work is only timed, never traced, so traces stay small.
+    bool recordTrace { false };
+    std::vector<TriangulationTraceEvent> trace;
+};
+
+// Writes stats.trace in Chrome's trace-event format, for chrome://tracing. The counters go in "otherData".
+bool writeChromeTrace(const TriangulationStats&, const char* path);
+
+#if TRIANGULATION_STATS
+
+extern __thread TriangulationStats* currentTriangulationStats;
+extern __thread unsigned currentTriangulationThread;
+
+// While one of these is alive, triangulation on this thread is recorded into stats. thread becomes the trace's tid.
+class TriangulationStatsScope {
+public:
+    TriangulationStatsScope(TriangulationStats& stats, unsigned thread = 0) : previous(currentTriangulationStats), previousThread(currentTriangulationThread) {
+        currentTriangulationStats = &stats;
+        currentTriangulationThread = thread;
+    }
+
+    ~TriangulationStatsScope() {
+        currentTriangulationStats = previous;
+        currentTriangulationThread = previousThread;
+    }
+
+private:
+    TriangulationStats* previous;
+    unsigned previousThread;
+};
+
+static inline double triangulationClock() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+class TriangulationPhaseScope {
+public:
+    TriangulationPhaseScope(TriangulationPhase phase, bool traced = true) : stats(currentTriangulationStats), phase(phase), traced(traced) {
+        if (!stats)
+            return;
+        parent = current;
+        current = this;
+        start = triangulationClock();
+    }
+
+    ~TriangulationPhaseScope() {
+        if (!stats)
+            return;
+        double elapsed = triangulationClock() - start;
+        stats->seconds[static_cast<size_t>(phase)] += elapsed - nested;
+        if (parent)
+            parent->nested += elapsed;
+        current = parent;
+        if (traced && stats->recordTrace)
+            stats->trace.push_back({ phase, currentTriangulationThread, start * 1e6, elapsed * 1e6 });
+    }
+
+private:
+    static __thread TriangulationPhaseScope* current;
+
+    TriangulationStats* stats;
+    TriangulationPhase phase;
+    bool traced;
+    TriangulationPhaseScope* parent { nullptr };
+    double start { 0 };
+    double nested { 0 };
+};
+
+static inline void countTriangulation(size_t TriangulationStats::* counter, size_t amount = 1) {
+    if (auto stats = currentTriangulationStats)
+        stats->*counter += amount;
+}
+
+static inline void countCurve(CubicType type) {
+    if (auto stats = currentTriangulationStats)
+        ++stats->curves[static_cast<size_t>(type)];
+}
+
+#else
+
+class TriangulationStatsScope {
+public:
+    TriangulationStatsScope(TriangulationStats&, unsigned = 0) {
+    }
+};
+
+class TriangulationPhaseScope {
+public:
+    TriangulationPhaseScope(TriangulationPhase, bool = true) {
+    }
+};
+
+static inline void countTriangulation(size_t TriangulationStats::*, size_t = 1) {
+}
+
+static inline void countCurve(CubicType) {
+}
+
+#endif
+
+#endif /* TriangulationStats_h */
@@ -7,11 +7,20 @@
 //
 
 #include "Triangulator.h"
-#include "CGPathIterator.h"
-#include "RetainPtr.h"
+#include "PathSource.h"
 #include "CubicBeziers.h"
+#include "CubicClassification.h"
+#include "HullSeparation.h"
+#include "InteriorTriangulator.h"
+#include "ParallelFor.h"
+#include "TriangulationStats.h"
 
-#include <queue>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+#include <memory>
+#include <pthread.h>
 #include <boost/optional.hpp>
 
 #pragma clang diagnostic push
@@ -37,8 +46,17 @@ public:
         return depth.value() % 2 == 1;
     }
 
+    int getIndex() const {
+        return index;
+    }
+
+    void setIndex(int newIndex) {
+        index = newIndex;
+    }
+
 private:
     boost::optional<unsigned> depth;
+    int index { -1 };
 };
 
 typedef CGAL::Exact_predicates_inexact_constructions_kernel      K;
@@ -49,107 +67,566 @@ typedef CGAL::Triangulation_data_structure_2<Vb, Fb>             TDS;
 typedef CGAL::Exact_predicates_tag                               Itag;
 typedef CGAL::Constrained_Delaunay_triangulation_2<K, TDS, Itag> CDT;
 
+// The finite faces of a CDT as flat arrays, so labeling them walks contiguous memory instead of chasing handles.
+struct FaceLabelingScratch {
+    void clear() {
+        faces.clear();
+        neighbors.clear();
+        constrained.clear();
+        regions.clear();
+        regionSeeds.clear();
+        regionInside.clear();
+        stack.clear();
+    }
+
+    std::vector<CDT::Face_handle> faces;
+    // Three per face, in the face's own edge order. -1 is the infinite face.
+    std::vector<int> neighbors;
+    // Bit i is set if edge i is constrained.
+    std::vector<uint8_t> constrained;
+    std::vector<int> regions;
+    std::vector<int> regionSeeds;
+    std::vector<uint8_t> regionInside;
+    std::vector<int> stack;
+};
+
+// Everything a Triangulator works in. Each thread keeps one and clears it between glyphs instead of freeing it, so
+// once the buffers have grown to fit the largest glyph seen, triangulating allocates nothing. The exception is the
+// CGAL fallback: its triangulation data structure doesn't take an allocator.
+struct TriangulationScratch {
+    void clear() {
+        border.points.clear();
+        border.contourEnds.clear();
+        contourClosed.clear();
+        curves.clear();
+        interiorTriangles.clear();
+        cubicFaces.clear();
+        hullSeparator.clear();
+        inflectionPieces.clear();
+    }
+
+    InnerBorder border;
+    std::vector<bool> contourClosed;
+    CubicBatch curves;
+    std::vector<CGPoint> interiorTriangles;
+    std::vector<std::array<CubicTriangleVertex, 3>> cubicFaces;
+    CurveHullSeparator hullSeparator;
+    // For the stencil fan: how many pieces each curve was split into at its inflections, and where they're built.
+    std::vector<uint32_t> inflectionPieces;
+    CubicBatch inflectionSplitCurves;
+    InteriorTriangulationScratch interior;
+    FaceLabelingScratch labeling;
+    std::vector<CDT::Face_handle> floodStack;
+    std::vector<CDT::Edge> constrainedEdges;
+    bool inUse { false };
+};
+
+static pthread_key_t createScratchKey() {
+    pthread_key_t key;
+    pthread_key_create(&key, [](void* scratch) {
+        delete static_cast<TriangulationScratch*>(scratch);
+    });
+    return key;
+}
+
+static TriangulationScratch& threadScratch() {
+    static pthread_key_t key = createScratchKey();
+    auto scratch = static_cast<TriangulationScratch*>(pthread_getspecific(key));
+    if (!scratch) {
+        scratch = new TriangulationScratch;
+        pthread_setspecific(key, scratch);
+    }
+    return *scratch;
+}
+
+// Borrows this thread's scratch for the lifetime of one Triangulator, or, with own set, makes its own, for a Triangulator
+// that may outlive the call that made it or be used from other threads.
+class TriangulationScratchLease {
+public:
+    explicit TriangulationScratchLease(bool own = false) : scratch(own ? nullptr : &threadScratch()) {
+        // Borrowing only fails if a face receiver triangulates another path on the same thread.
+        if (!scratch || scratch->inUse) {
+            owned.reset(new TriangulationScratch);
+            scratch = owned.get();
+        }
+        scratch->inUse = true;
+        scratch->clear();
+    }
+
+    ~TriangulationScratchLease() {
+        scratch->inUse = false;
+    }
+
+    TriangulationScratch& get() const {
+        return *scratch;
+    }
+
+private:
+    TriangulationScratch* scratch;
+    std::unique_ptr<TriangulationScratch> owned;
+};
+
+// Usually short-lived: the results only stay valid while the Triangulator does, since they live in its scratch, which
+// is the thread's unless ownsScratch is set.
 class Triangulator {
 public:
-    Triangulator(CGPathRef path) : path(path) {
-        insert();
-        mark();
+    template <typename PathSource>
+    Triangulator(const PathSource& source, const TriangulationOptions& options = TriangulationOptions(), bool ownsScratch = false)
+        : lease(ownsScratch)
+        , options(options)
+        , border(lease.get().border)
+        , contourClosed(lease.get().contourClosed)
+        , interiorTriangles(lease.get().interiorTriangles)
+        , cubicFaces(lease.get().cubicFaces)
+        , curves(lease.get().curves) {
+        insert(source);
+        if (options.stencilFanInterior)
+            fanInterior();
+        else if (!options.allowFastInterior || hasOpenContour || !triangulateInteriorByEarClipping())
+            triangulateInteriorWithCGAL();
     }
 
-    void triangulate(CubicTriangleFaceReceiver receiver) {
-        for (auto facesIterator = cdt.finite_faces_begin(); facesIterator != cdt.finite_faces_end(); ++facesIterator) {
-            if (facesIterator->info().inside()) {
-                auto p0 = facesIterator->vertex(0)->point();
-                auto p1 = facesIterator->vertex(1)->point();
-                auto p2 = facesIterator->vertex(2)->point();
-                receiver({ CGPointMake(p0.x(), p0.y()), { 0, 1, 1 } },
-                         { CGPointMake(p1.x(), p1.y()), { 0, 1, 1 } },
-                         { CGPointMake(p2.x(), p2.y()), { 0, 1, 1 } });
-            }
+    template <typename Receiver>
+    void triangulate(Receiver receiver) {
+        TriangulationPhaseScope phase(TriangulationPhase::FaceEmission);
+        countFaces();
+        for (size_t i = 0; i < interiorTriangles.size(); i += 3) {
+            receiver({ interiorTriangles[i], { 0, 1, 1 } },
+                     { interiorTriangles[i + 1], { 0, 1, 1 } },
+                     { interiorTriangles[i + 2], { 0, 1, 1 } });
         }
 
         for (auto& cubicCurve : cubicFaces)
             receiver(cubicCurve[0], cubicCurve[1], cubicCurve[2]);
     }
 
+    size_t vertexCount() const {
+        return interiorTriangles.size() + 3 * cubicFaces.size();
+    }
+
+    // Writes vertexCount() vertices, in the layout that loopBlinnVertex consumes.
+    void write(vector_float2* positions, vector_float4* coefficients) const {
+        TriangulationPhaseScope phase(TriangulationPhase::FaceEmission);
+        countFaces();
+        const vector_float4 insideCoefficient = { 0, 1, 1, 0 };
+        for (auto& point : interiorTriangles) {
+            vector_float2 position = { static_cast<float>(point.x), static_cast<float>(point.y) };
+            *positions++ = position;
+            *coefficients++ = insideCoefficient;
+        }
+
+        for (auto& cubicCurve : cubicFaces) {
+            for (auto& vertex : cubicCurve) {
+                vector_float2 position = { static_cast<float>(vertex.point.x), static_cast<float>(vertex.point.y) };
+                vector_float4 coefficient = { vertex.coefficient.x, vertex.coefficient.y, vertex.coefficient.z, 0 };
+                *positions++ = position;
+                *coefficients++ = coefficient;
+            }
+        }
+    }
+
+    bool usedCGAL() const {
+        return fellBackToCGAL;
+    }
+
 private:
-    void insertCubicCurve(CDT::Vertex_handle& currentVertex, CGPoint p1, CGPoint p2, CGPoint p3) {
-        auto p0 = CGPointMake(currentVertex->point().x(), currentVertex->point().y());
-        __block std::vector<boost::optional<CubicVertex>> insideBorder(8);
-        __block std::vector<std::array<CubicTriangleVertex, 3>> localCubicFaces;
-        bool degenerate = cubic(p0, p1, p2, p3, ^(CubicVertex v0, CubicVertex v1, CubicVertex v2) {
-            if (v0.order >= 0)
-                insideBorder[v0.order] = v0;
-            if (v1.order >= 0)
-                insideBorder[v1.order] = v1;
-            if (v2.order >= 0)
-                insideBorder[v2.order] = v2;
-            localCubicFaces.push_back({{ { v0.point, v0.coefficient }, { v1.point, v1.coefficient }, { v2.point, v2.coefficient } }});
-        });
+    void countFaces() const {
+        countTriangulation(&TriangulationStats::interiorFaces, interiorTriangles.size() / 3);
+        countTriangulation(&TriangulationStats::curveFaces, cubicFaces.size());
+    }
+
+    bool separatesCurveHulls() const {
+        return options.separateCurveHulls && !options.stencilFanInterior;
+    }
+
+    // Collects every curve in the path up front so they can all be separated and then classified in one batch.
+    template <typename PathSource>
+    void classifyCurves(const PathSource& source) {
+        if (options.flatteningTolerance > 0) {
+            collectCurves(source, curves, nullptr);
+            return;
+        }
+        auto& separator = lease.get().hullSeparator;
+        collectCurves(source, curves, separatesCurveHulls() ? &separator : nullptr);
+        if (separatesCurveHulls()) {
+            TriangulationPhaseScope phase(TriangulationPhase::HullSeparation);
+            auto stats = separator.separate(curves);
+            countTriangulation(&TriangulationStats::hullOverlaps, stats.overlaps);
+            countTriangulation(&TriangulationStats::hullSubdivisions, stats.subdivisions);
+            countTriangulation(&TriangulationStats::unresolvedHullOverlaps, stats.unresolvedOverlaps);
+        }
+        if (options.stencilFanInterior)
+            splitAtInflections();
+        TriangulationPhaseScope phase(TriangulationPhase::Classify);
+        classifyCubics(curves);
+    }
+
+    // A fanned interior takes the inner border as is, so every curve's faces must lie outside it. That only holds while
+    // the control polygon turns one way, so curves are split on either side of where they inflect. Splitting right at
+    // an inflection would leave pieces that classify as cusps at infinity, whose orientation cubic() doesn't work out.
+    void splitAtInflections() {
+        const CGFloat inflectionMargin = 0.01;
+        auto& split = lease.get().inflectionSplitCurves;
+        auto& pieces = lease.get().inflectionPieces;
+        split.clear();
+        pieces.assign(curves.size(), 1);
+        for (size_t i = 0; i < curves.size(); ++i) {
+            std::array<CGPoint, 4> p;
+            for (unsigned j = 0; j < 4; ++j)
+                p[j] = CGPointMake(curves.x[j][i], curves.y[j][i]);
+            // B' x B'' is proportional to (b x c) t^2 + (a x c) t + a x b.
+            CGPoint a = CGPointMake(p[1].x - p[0].x, p[1].y - p[0].y);
+            CGPoint b = CGPointMake(p[2].x - 2 * p[1].x + p[0].x, p[2].y - 2 * p[1].y + p[0].y);
+            CGPoint c = CGPointMake(p[3].x - 3 * p[2].x + 3 * p[1].x - p[0].x, p[3].y - 3 * p[2].y + 3 * p[1].y - p[0].y);
+            CGFloat qa = b.x * c.y - b.y * c.x;
+            CGFloat qb = a.x * c.y - a.y * c.x;
+            CGFloat qc = a.x * b.y - a.y * b.x;
+            std::array<CGFloat, 4> splits;
+            unsigned splitCount = 0;
+            auto addInflection = [&](CGFloat t) {
+                for (CGFloat u : { t - inflectionMargin, t + inflectionMargin }) {
+                    if (u > inflectionMargin && u < 1 - inflectionMargin)
+                        splits[splitCount++] = u;
+                }
+            };
+            if (std::abs(qa) > 1e-12 * (std::abs(qb) + std::abs(qc))) {
+                CGFloat discriminant = qb * qb - 4 * qa * qc;
+                if (discriminant > 0) {
+                    CGFloat root = std::sqrt(discriminant);
+                    addInflection((-qb - root) / (2 * qa));
+                    addInflection((-qb + root) / (2 * qa));
+                }
+            } else if (qb != 0)
+                addInflection(-qc / qb);
+            std::sort(splits.begin(), splits.begin() + splitCount);
+
+            // Each split is at a t rescaled into what's left of the curve.
+            CGFloat consumed = 0;
+            for (unsigned j = 0; j < splitCount; ++j) {
+                CGFloat t = (splits[j] - consumed) / (1 - consumed);
+                consumed = splits[j];
+                auto lerp = [t](CGPoint u, CGPoint v) {
+                    return CGPointMake(u.x + t * (v.x - u.x), u.y + t * (v.y - u.y));
+                };
+                CGPoint p01 = lerp(p[0], p[1]);
+                CGPoint p12 = lerp(p[1], p[2]);
+                CGPoint p23 = lerp(p[2], p[3]);
+                CGPoint p012 = lerp(p01, p12);
+                CGPoint p123 = lerp(p12, p23);
+                CGPoint p0123 = lerp(p012, p123);
+                split.append(p[0], p01, p012, p0123);
+                p = {{ p0123, p123, p23, p[3] }};
+            }
+            split.append(p[0], p[1], p[2], p[3]);
+            pieces[i] += splitCount;
+        }
+        std::swap(curves, split);
+    }
+
+    // Replaces the curve with line segments, as many as Wang's formula says keep it within flatteningTolerance.
+    void flattenCubicCurve(CGPoint p3) {
+        size_t i = nextCurve++;
+        CGPoint p0 = CGPointMake(curves.x[0][i], curves.y[0][i]);
+        CGPoint p1 = CGPointMake(curves.x[1][i], curves.y[1][i]);
+        CGPoint p2 = CGPointMake(curves.x[2][i], curves.y[2][i]);
+        CGFloat d0 = hypot(p0.x - 2 * p1.x + p2.x, p0.y - 2 * p1.y + p2.y);
+        CGFloat d1 = hypot(p1.x - 2 * p2.x + p3.x, p1.y - 2 * p2.y + p3.y);
+        unsigned segments = std::max(1u, static_cast<unsigned>(ceil(sqrt(0.75 * std::max(d0, d1) / options.flatteningTolerance))));
+        for (unsigned j = 1; j < segments; ++j) {
+            CGFloat t = static_cast<CGFloat>(j) / segments;
+            CGFloat s = 1 - t;
+            lineTo(CGPointMake(s * s * s * p0.x + 3 * s * s * t * p1.x + 3 * s * t * t * p2.x + t * t * t * p3.x,
+                s * s * s * p0.y + 3 * s * s * t * p1.y + 3 * s * t * t * p2.y + t * t * t * p3.y));
+        }
+        lineTo(p3);
+    }
+
+    // Separating hulls, or inflections, may have split the path's next curve into several, which follow one another in the batch.
+    void insertCubicCurve(CGPoint p3) {
+        if (options.flatteningTolerance > 0) {
+            flattenCubicCurve(p3);
+            return;
+        }
+        uint32_t pieces = 1;
+        if (separatesCurveHulls())
+            pieces = lease.get().hullSeparator.pieceCount(nextPathCurve);
+        else if (options.stencilFanInterior)
+            pieces = lease.get().inflectionPieces[nextPathCurve];
+        ++nextPathCurve;
+        for (uint32_t i = 1; i < pieces; ++i)
+            insertCubicPiece(CGPointMake(curves.x[3][nextCurve], curves.y[3][nextCurve]));
+        insertCubicPiece(p3);
+    }
+
+    void insertCubicPiece(CGPoint p3) {
+        __block std::array<boost::optional<CubicVertex>, 8> insideBorder;
+        auto faces = &cubicFaces;
+        auto facesBefore = cubicFaces.size();
+        bool degenerate;
+        {
+            TriangulationPhaseScope phase(TriangulationPhase::CubicSubdivision, false);
+            degenerate = cubic(curves, nextCurve++, ^(CubicVertex v0, CubicVertex v1, CubicVertex v2) {
+                if (v0.order >= 0)
+                    insideBorder[v0.order] = v0;
+                if (v1.order >= 0)
+                    insideBorder[v1.order] = v1;
+                if (v2.order >= 0)
+                    insideBorder[v2.order] = v2;
+                faces->push_back({{ { v0.point, v0.coefficient }, { v1.point, v1.coefficient }, { v2.point, v2.coefficient } }});
+            });
+        }
 
         if (degenerate) {
-            auto newVertex = cdt.insert(CDT::Point(p3.x, p3.y));
-            insertConstraint(currentVertex, newVertex);
-            currentVertex = newVertex;
+            countTriangulation(&TriangulationStats::degenerateCurves);
+            cubicFaces.resize(facesBefore);
+            lineTo(p3);
             return;
         }
 
-        for (auto v : localCubicFaces)
-            cubicFaces.push_back(v);
+        // A curve's faces fill between it and the inner border, on its left, which is where its winding number is one
+        // more than the border's. Counterclockwise faces add one in the stencil.
+        if (options.stencilFanInterior) {
+            for (size_t i = facesBefore; i < cubicFaces.size(); ++i) {
+                auto& face = cubicFaces[i];
+                if ((face[1].point.x - face[0].point.x) * (face[2].point.y - face[0].point.y) - (face[2].point.x - face[0].point.x) * (face[1].point.y - face[0].point.y) < 0)
+                    std::swap(face[1], face[2]);
+            }
+        }
 
         assert(insideBorder[0]);
-        CDT::Vertex_handle newVertex;
         for (size_t i = 1; i < insideBorder.size(); ++i) {
             if (!insideBorder[i])
                 break;
-            newVertex = cdt.insert(CDT::Point(insideBorder[i].value().point.x, insideBorder[i].value().point.y));
-            insertConstraint(currentVertex, newVertex);
-            currentVertex = newVertex;
+            lineTo(insideBorder[i].value().point);
+        }
+    }
+
+    void moveTo(CGPoint point) {
+        finishContour(false);
+        border.points.push_back(point);
+        contourOpen = true;
+        subpathBegin = point;
+        currentPoint = point;
+    }
+
+    void lineTo(CGPoint point) {
+        if (!contourOpen) {
+            // Drawing after a close starts a new contour back at the beginning of the subpath.
+            border.points.push_back(currentPoint);
+            contourOpen = true;
         }
+        if (!CGPointEqualToPoint(point, border.points.back()))
+            border.points.push_back(point);
+        currentPoint = point;
     }
 
-    void insert() {
-        CDT::Vertex_handle currentVertex;
-        CDT::Vertex_handle subpathBegin;
-        iterateCGPath(path, [&](CGPathElement element) {
+    void finishContour(bool closed) {
+        if (!contourOpen)
+            return;
+        size_t contourBegin = border.contourEnds.empty() ? 0 : border.contourEnds.back();
+        if (closed && border.points.size() - contourBegin > 1 && CGPointEqualToPoint(border.points[contourBegin], border.points.back()))
+            border.points.pop_back();
+        if (!closed && border.points.size() - contourBegin > 1)
+            hasOpenContour = true;
+        border.contourEnds.push_back(border.points.size());
+        contourClosed.push_back(closed);
+        contourOpen = false;
+    }
+
+    template <typename PathSource>
+    void insert(const PathSource& source) {
+        TriangulationPhaseScope phase(TriangulationPhase::Insert);
+        classifyCurves(source);
+        source.iterate([&](PathElement element) {
             switch (element.type) {
-            case kCGPathElementMoveToPoint:
-                currentVertex = cdt.insert(CDT::Point(element.points[0].x, element.points[0].y));
-                subpathBegin = currentVertex;
+            case PathElementMoveToPoint:
+                moveTo(element.points[0]);
                 break;
-            case kCGPathElementAddLineToPoint: {
-                auto newVertex = cdt.insert(CDT::Point(element.points[0].x, element.points[0].y));
-                insertConstraint(currentVertex, newVertex);
-                currentVertex = newVertex;
+            case PathElementAddLineToPoint:
+                lineTo(element.points[0]);
                 break;
-            }
-            case kCGPathElementAddQuadCurveToPoint: {
-                auto source = currentVertex->point();
-                auto control = element.points[0];
-                auto destination = element.points[1];
-                auto cp1 = CGPointMake(source.x() + 2 * (control.x - source.x()) / 3, source.y() + 2 * (control.y - source.y()) / 3);
-                auto cp2 = CGPointMake(destination.x + 2 * (control.x - destination.x) / 3, destination.y + 2 * (control.y - destination.y) / 3);
-                insertCubicCurve(currentVertex, cp1, cp2, destination);
+            case PathElementAddQuadCurveToPoint:
+                insertCubicCurve(element.points[1]);
                 break;
-            }
-            case kCGPathElementAddCurveToPoint: {
-                insertCubicCurve(currentVertex, element.points[0], element.points[1], element.points[2]);
+            case PathElementAddCurveToPoint:
+                insertCubicCurve(element.points[2]);
                 break;
-            }
-            case kCGPathElementCloseSubpath:
-                insertConstraint(currentVertex, subpathBegin);
-                currentVertex = subpathBegin;
+            case PathElementCloseSubpath:
+                finishContour(true);
+                currentPoint = subpathBegin;
             }
         });
+        finishContour(false);
+    }
+
+    // Each contour, closed or not, as the filled path would close it, fanned from its first point. The triangles face
+    // whichever way the contour turns there, so the stencil sorts out overlaps, crossings and holes.
+    void fanInterior() {
+        TriangulationPhaseScope phase(TriangulationPhase::StencilFan);
+        size_t contourBegin = 0;
+        for (auto contourEnd : border.contourEnds) {
+            for (size_t i = contourBegin + 1; i + 1 < contourEnd; ++i) {
+                auto a = border.points[contourBegin];
+                auto b = border.points[i];
+                auto c = border.points[i + 1];
+                if ((b.x - a.x) * (c.y - a.y) - (c.x - a.x) * (b.y - a.y) == 0)
+                    continue;
+                interiorTriangles.push_back(a);
+                interiorTriangles.push_back(b);
+                interiorTriangles.push_back(c);
+            }
+            contourBegin = contourEnd;
+        }
+    }
+
+    bool triangulateInteriorByEarClipping() {
+        TriangulationPhaseScope phase(TriangulationPhase::EarClipping);
+        return triangulateInterior(border, options.fillRule, interiorTriangles, lease.get().interior);
+    }
+
+    // The general case: constrained Delaunay triangulation of the inner border, labeled by the fill rule.
+    void triangulateInteriorWithCGAL() {
+        fellBackToCGAL = true;
+        countTriangulation(&TriangulationStats::cgalFallbacks);
+        CDT cdt;
+        insertConstraints(cdt);
+        TriangulationPhaseScope phase(TriangulationPhase::Mark);
+        if (options.floodFillLabeling) {
+            mark(cdt, lease.get());
+            appendInsideFaces(cdt);
+        } else
+            labelFaces(cdt);
+    }
+
+    // Constrained edges split the faces into regions, each of which is entirely inside or entirely outside. Finding
+    // the regions is a flood fill over flat arrays; then one winding number per region, at a point inside one of its
+    // faces, decides it. That works for both fill rules, and for contours that overlap or cross.
+    void labelFaces(CDT& cdt) {
+        auto& scratch = lease.get().labeling;
+        scratch.clear();
+        for (auto face = cdt.finite_faces_begin(); face != cdt.finite_faces_end(); ++face) {
+            face->info().setIndex(static_cast<int>(scratch.faces.size()));
+            scratch.faces.push_back(face);
+        }
+        int faceCount = static_cast<int>(scratch.faces.size());
+        scratch.neighbors.resize(3 * faceCount);
+        scratch.constrained.resize(faceCount);
+        for (int i = 0; i < faceCount; ++i) {
+            auto& face = scratch.faces[i];
+            uint8_t constrained = 0;
+            for (int j = 0; j < 3; ++j) {
+                auto neighbor = face->neighbor(j);
+                scratch.neighbors[3 * i + j] = cdt.is_infinite(neighbor) ? -1 : neighbor->info().getIndex();
+                if (face->is_constrained(j))
+                    constrained |= 1 << j;
+            }
+            scratch.constrained[i] = constrained;
+        }
+
+        scratch.regions.assign(faceCount, -1);
+        for (int seed = 0; seed < faceCount; ++seed) {
+            if (scratch.regions[seed] >= 0)
+                continue;
+            int region = static_cast<int>(scratch.regionSeeds.size());
+            scratch.regionSeeds.push_back(seed);
+            scratch.regions[seed] = region;
+            scratch.stack.push_back(seed);
+            while (!scratch.stack.empty()) {
+                int face = scratch.stack.back();
+                scratch.stack.pop_back();
+                for (int j = 0; j < 3; ++j) {
+                    int neighbor = scratch.neighbors[3 * face + j];
+                    if (neighbor < 0 || (scratch.constrained[face] & (1 << j)) || scratch.regions[neighbor] >= 0)
+                        continue;
+                    scratch.regions[neighbor] = region;
+                    scratch.stack.push_back(neighbor);
+                }
+            }
+        }
+
+        for (auto seed : scratch.regionSeeds) {
+            auto& face = scratch.faces[seed];
+            CGPoint centroid = CGPointZero;
+            for (int j = 0; j < 3; ++j) {
+                centroid.x += face->vertex(j)->point().x() / 3;
+                centroid.y += face->vertex(j)->point().y() / 3;
+            }
+            int winding = windingNumber(centroid);
+            scratch.regionInside.push_back(options.fillRule == TriangulationFillRuleNonZero ? winding != 0 : winding % 2 != 0);
+        }
+
+        for (int i = 0; i < faceCount; ++i) {
+            if (!scratch.regionInside[scratch.regions[i]])
+                continue;
+            for (int j = 0; j < 3; ++j) {
+                auto& point = scratch.faces[i]->vertex(j)->point();
+                interiorTriangles.push_back(CGPointMake(point.x(), point.y()));
+            }
+        }
+    }
+
+    // Every contour counts as closed here, the way filling a path closes it.
+    int windingNumber(CGPoint point) const {
+        int winding = 0;
+        size_t contourBegin = 0;
+        for (auto contourEnd : border.contourEnds) {
+            for (size_t i = contourBegin, j = contourEnd - 1; i < contourEnd; j = i++) {
+                auto a = border.points[j];
+                auto b = border.points[i];
+                CGFloat side = (b.x - a.x) * (point.y - a.y) - (point.x - a.x) * (b.y - a.y);
+                if (a.y <= point.y) {
+                    if (b.y > point.y && side > 0)
+                        ++winding;
+                } else if (b.y <= point.y && side < 0)
+                    --winding;
+            }
+            contourBegin = contourEnd;
+        }
+        return winding;
+    }
+
+    void appendInsideFaces(CDT& cdt) {
+        for (auto facesIterator = cdt.finite_faces_begin(); facesIterator != cdt.finite_faces_end(); ++facesIterator) {
+            if (!facesIterator->info().inside())
+                continue;
+            for (int i = 0; i < 3; ++i) {
+                auto& point = facesIterator->vertex(i)->point();
+                interiorTriangles.push_back(CGPointMake(point.x(), point.y()));
+            }
+        }
+    }
+
+    void insertConstraints(CDT& cdt) {
+        TriangulationPhaseScope phase(TriangulationPhase::ConstraintInsertion);
+        size_t contourBegin = 0;
+        for (size_t i = 0; i < border.contourEnds.size(); ++i) {
+            auto contourEnd = border.contourEnds[i];
+            if (contourBegin == contourEnd)
+                continue;
+            auto first = cdt.insert(CDT::Point(border.points[contourBegin].x, border.points[contourBegin].y));
+            auto previous = first;
+            for (auto j = contourBegin + 1; j < contourEnd; ++j) {
+                auto vertex = cdt.insert(CDT::Point(border.points[j].x, border.points[j].y));
+                insertConstraint(cdt, previous, vertex);
+                previous = vertex;
+            }
+            // labelFaces() decides each region by windingNumber(), which closes every contour, so the closing edge of an
+            // open contour must split regions too. mark() counts depth by crossings, so it leaves open contours open.
+            if (contourClosed[i] || !options.floodFillLabeling)
+                insertConstraint(cdt, previous, first);
+            contourBegin = contourEnd;
+        }
     }
 
-    std::list<CDT::Edge> flood(CDT::Face_handle seed, unsigned depth) {
-        std::list<CDT::Edge> result;
-        std::queue<CDT::Face_handle> queue;
-        queue.push(seed);
-        while (!queue.empty()) {
-            auto handle = queue.front();
-            queue.pop();
+    // Fills the region around seed, which is bounded by constrained edges, and appends those edges to constrainedEdges.
+    // The order faces are visited in within a region doesn't matter.
+    static void flood(CDT& cdt, CDT::Face_handle seed, unsigned depth, TriangulationScratch& scratch) {
+        auto& stack = scratch.floodStack;
+        stack.clear();
+        stack.push_back(seed);
+        while (!stack.empty()) {
+            auto handle = stack.back();
+            stack.pop_back();
             if (handle->info().getDepth())
                 continue;
             handle->info().setDepth(depth);
@@ -159,37 +636,185 @@ private:
                 if (neighbor->info().getDepth())
                     continue;
                 if (cdt.is_constrained(edge))
-                    result.push_back(edge);
+                    scratch.constrainedEdges.push_back(edge);
                 else
-                    queue.push(neighbor);
+                    stack.push_back(neighbor);
             }
         }
-        return result;
     }
 
-    void mark() {
-        auto border = flood(cdt.infinite_face(), 0);
-        while (!border.empty()) {
-            auto edge = border.front();
-            border.pop_front();
+    // Regions are flooded first in, first out, so each one gets the smallest depth it can be reached at.
+    static void mark(CDT& cdt, TriangulationScratch& scratch) {
+        scratch.constrainedEdges.clear();
+        flood(cdt, cdt.infinite_face(), 0, scratch);
+        for (size_t i = 0; i < scratch.constrainedEdges.size(); ++i) {
+            auto edge = scratch.constrainedEdges[i];
             auto face = edge.first->neighbor(edge.second);
-            if (!face->info().getDepth()) {
-                auto next = flood(face, edge.first->info().getDepth().value() + 1);
-                border.insert(border.end(), next.begin(), next.end());
-            }
+            if (!face->info().getDepth())
+                flood(cdt, face, edge.first->info().getDepth().value() + 1, scratch);
         }
     }
 
-    void insertConstraint(CDT::Vertex_handle a, CDT::Vertex_handle b) {
-        if (a != b)
-            cdt.insert_constraint(a, b);
+    static void insertConstraint(CDT& cdt, CDT::Vertex_handle a, CDT::Vertex_handle b) {
+        if (a == b)
+            return;
+        cdt.insert_constraint(a, b);
+        countTriangulation(&TriangulationStats::constraintInsertions);
     }
 
-    CDT cdt;
-    std::vector<std::array<CubicTriangleVertex, 3>> cubicFaces;
-    RetainPtr<CGPathRef> path;
+    TriangulationScratchLease lease;
+    TriangulationOptions options;
+    InnerBorder& border;
+    std::vector<bool>& contourClosed;
+    bool contourOpen { false };
+    bool hasOpenContour { false };
+    CGPoint currentPoint { 0, 0 };
+    CGPoint subpathBegin { 0, 0 };
+    std::vector<CGPoint>& interiorTriangles;
+    std::vector<std::array<CubicTriangleVertex, 3>>& cubicFaces;
+    CubicBatch& curves;
+    size_t nextCurve { 0 };
+    // Counts curves as the path has them, before any were split.
+    size_t nextPathCurve { 0 };
+    bool fellBackToCGAL { false };
 };
 
-void triangulate(CGPathRef path, CubicTriangleFaceReceiver receiver) {
-    Triangulator(path).triangulate(receiver);
+// Keeps its Triangulator, with scratch of its own, so writing goes straight from the triangulation to the caller.
+struct TriangulatedPath {
+    template <typename PathSource>
+    TriangulatedPath(const PathSource& source, const TriangulationOptions& options)
+        : triangulator(source, options, true) {
+    }
+
+    Triangulator triangulator;
+};
+
+static TriangulationOptions optionsWithFillRule(TriangulationFillRule fillRule) {
+    TriangulationOptions options;
+    options.fillRule = fillRule;
+    return options;
+}
+
+void triangulate(CGPathRef path, TriangulationFillRule fillRule, CubicTriangleFaceReceiver receiver) {
+    Triangulator(CGPathSource(path), optionsWithFillRule(fillRule)).triangulate(receiver);
+}
+
+TriangulatedPathRef createTriangulatedPath(CGPathRef path, TriangulationFillRule fillRule) {
+    return new TriangulatedPath(CGPathSource(path), optionsWithFillRule(fillRule));
+}
+
+TriangulatedPathRef createTriangulatedPathFromElements(const PathElementType* types, size_t count, const CGPoint* points, TriangulationFillRule fillRule) {
+    return new TriangulatedPath(FlatPathSource(types, count, points), optionsWithFillRule(fillRule));
+}
+
+TriangulatedPathRef createTriangulatedPathFromSVG(const char* pathData, TriangulationFillRule fillRule) {
+    SVGPathSource source(pathData);
+    if (!source.isValid())
+        return nullptr;
+    return new TriangulatedPath(source, optionsWithFillRule(fillRule));
+}
+
+size_t triangulatedPathVertexCount(TriangulatedPathRef triangulatedPath) {
+    return triangulatedPath->triangulator.vertexCount();
+}
+
+void triangulatedPathWriteVertices(TriangulatedPathRef triangulatedPath, vector_float2* positions, vector_float4* coefficients) {
+    triangulatedPath->triangulator.write(positions, coefficients);
+}
+
+void destroyTriangulatedPath(TriangulatedPathRef triangulatedPath) {
+    delete triangulatedPath;
+}
+
+CubicTriangleMesh createCubicTriangleMesh(CGPathRef path, const TriangulationOptions& options) {
+    CubicTriangleMesh mesh = { nullptr, nullptr, 0 };
+    if (!path)
+        return mesh;
+    CGPathSource source(path);
+    Triangulator triangulator(source, options);
+    auto vertexCount = triangulator.vertexCount();
+    if (!vertexCount)
+        return mesh;
+    mesh.positions = static_cast<vector_float2*>(malloc(vertexCount * sizeof(vector_float2)));
+    mesh.coefficients = static_cast<vector_float4*>(malloc(vertexCount * sizeof(vector_float4)));
+    mesh.vertexCount = vertexCount;
+    triangulator.write(mesh.positions, mesh.coefficients);
+    return mesh;
 }
+
+static void triangulateBatch(const CGPathRef* paths, size_t count, unsigned threadCount, TriangulationFillRule fillRule, CubicTriangleMesh* meshes, std::vector<TriangulationStats>* workerStats) {
+    auto options = optionsWithFillRule(fillRule);
+    parallelFor(count, threadCount, [&](size_t i, unsigned worker) {
+        TriangulationStats unused;
+        TriangulationStatsScope scope(workerStats ? (*workerStats)[worker] : unused, worker);
+        meshes[i] = createCubicTriangleMesh(paths[i], options);
+    });
+}
+
+void triangulateBatch(const CGPathRef* paths, size_t count, unsigned threadCount, TriangulationFillRule fillRule, CubicTriangleMesh* meshes) {
+    triangulateBatch(paths, count, threadCount, fillRule, meshes, nullptr);
+}
+
+void triangulateBatch(const CGPathRef* paths, size_t count, unsigned threadCount, TriangulationFillRule fillRule, CubicTriangleMesh* meshes, TriangulationStats& stats) {
+    std::vector<TriangulationStats> workerStats(resolveThreadCount(threadCount));
+    for (auto& worker : workerStats)
+        worker.recordTrace = stats.recordTrace;
+    triangulateBatch(paths, count, threadCount, fillRule, meshes, &workerStats);
+    for (auto& worker : workerStats)
+        stats += worker;
+}
+
+void destroyCubicTriangleMesh(CubicTriangleMesh mesh) {
+    free(mesh.positions);
+    free(mesh.coefficients);
+}
+
+// Each level covers twice the size of the one before it.
+static const float glyphLODPixelsPerEm[GlyphLODLevelCount - 1] = { 8, 16, 32 };
+
+float glyphLODMaximumPixelsPerEm(unsigned level) {
+    return level < GlyphLODLevelCount - 1 ? glyphLODPixelsPerEm[level] : std::numeric_limits<float>::infinity();
+}
+
+unsigned glyphLODLevelForPixelsPerEm(float pixelsPerEm) {
+    unsigned level = 0;
+    while (pixelsPerEm > glyphLODMaximumPixelsPerEm(level))
+        ++level;
+    return level;
+}
+
+void triangulateBatchWithLOD(const CGPathRef* paths, const CGFloat* emSizes, size_t count, float pixelTolerance, unsigned threadCount, TriangulationFillRule fillRule, CubicTriangleMesh* meshes) {
+    // Every level of every path is its own work item, so one big glyph doesn't hold up a worker for all of its levels.
+    parallelFor(count * GlyphLODLevelCount, threadCount, [&](size_t item, unsigned) {
+        size_t i = item / GlyphLODLevelCount;
+        unsigned level = item % GlyphLODLevelCount;
+        auto options = optionsWithFillRule(fillRule);
+        // One pixel is emSize / pixelsPerEm path units.
+        if (level < GlyphLODLevelCount - 1)
+            options.flatteningTolerance = pixelTolerance * emSizes[i] / glyphLODMaximumPixelsPerEm(level);
+        meshes[item] = createCubicTriangleMesh(paths[i], options);
+    });
+}
+
+void triangulateBatchForStencil(const CGPathRef* paths, size_t count, unsigned threadCount, CubicTriangleMesh* meshes) {
+    TriangulationOptions options;
+    options.stencilFanInterior = true;
+    parallelFor(count, threadCount, [&](size_t i, unsigned) {
+        meshes[i] = createCubicTriangleMesh(paths[i], options);
+    });
+}
+
+template <typename PathSource>
+bool triangulateAndAppend(const PathSource& source, const TriangulationOptions& options, std::vector<vector_float2>& positions, std::vector<vector_float4>& coefficients) {
+    Triangulator triangulator(source, options);
+    size_t offset = positions.size();
+    positions.resize(offset + triangulator.vertexCount());
+    coefficients.resize(offset + triangulator.vertexCount());
+    triangulator.write(positions.data() + offset, coefficients.data() + offset);
+    return triangulator.usedCGAL();
+}
+
+template bool triangulateAndAppend(const CGPathSource&, const TriangulationOptions&, std::vector<vector_float2>&, std::vector<vector_float4>&);
+template bool triangulateAndAppend(const FlatPathSource&, const TriangulationOptions&, std::vector<vector_float2>&, std::vector<vector_float4>&);
+template bool triangulateAndAppend(const FlatPath&, const TriangulationOptions&, std::vector<vector_float2>&, std::vector<vector_float4>&);
+template bool triangulateAndAppend(const SVGPathSource&, const TriangulationOptions&, std::vector<vector_float2>&, std::vector<vector_float4>&);
@@ -13,6 +13,7 @@
 #include <simd/simd.h>
 
 #include "CubicBeziers.h"
+#include "PathSource.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -24,10 +25,85 @@ typedef struct CubicTriangleVertex {
 } CubicTriangleVertex;
 
 typedef void (^CubicTriangleFaceReceiver)(CubicTriangleVertex, CubicTriangleVertex, CubicTriangleVertex);
-void triangulate(CGPathRef, CubicTriangleFaceReceiver);
+void triangulate(CGPathRef, TriangulationFillRule, CubicTriangleFaceReceiver);
+
+// Triangulates once, then writes straight into caller-provided storage (such as a mapped MTLBuffer) as
+// float2 positions and float4 coefficients, three vertices per triangle, which is what loopBlinnVertex consumes.
+typedef struct TriangulatedPath* TriangulatedPathRef;
+TriangulatedPathRef createTriangulatedPath(CGPathRef, TriangulationFillRule);
+// The same, from flat arrays laid out as FlatPathSource describes, or from SVG path data. The SVG variant returns
+// NULL if the data is malformed.
+TriangulatedPathRef createTriangulatedPathFromElements(const PathElementType* types, size_t count, const CGPoint* points, TriangulationFillRule);
+TriangulatedPathRef createTriangulatedPathFromSVG(const char* pathData, TriangulationFillRule);
+size_t triangulatedPathVertexCount(TriangulatedPathRef);
+void triangulatedPathWriteVertices(TriangulatedPathRef, vector_float2* positions, vector_float4* coefficients);
+void destroyTriangulatedPath(TriangulatedPathRef);
+
+typedef struct CubicTriangleMesh {
+    vector_float2* positions;
+    vector_float4* coefficients;
+    size_t vertexCount;
+} CubicTriangleMesh;
+
+// Triangulates count paths across threadCount threads (0 means one per core) and fills in meshes[i] for paths[i].
+// A NULL path produces an empty mesh. Every resulting mesh must be released with destroyCubicTriangleMesh().
+void triangulateBatch(const CGPathRef*, size_t count, unsigned threadCount, TriangulationFillRule, CubicTriangleMesh* meshes);
+void destroyCubicTriangleMesh(CubicTriangleMesh);
+
+// Level-of-detail meshes for small text. Level i, for i < GlyphLODLevelCount - 1, is for glyphs drawn at no more than
+// glyphLODMaximumPixelsPerEm(i) pixels per em: every curve becomes line segments that stay within pixelTolerance pixels
+// of it at that size, so the level is all interior triangles. The last level is the full mesh, for any size.
+#define GlyphLODLevelCount 4
+float glyphLODMaximumPixelsPerEm(unsigned level);
+// The smallest level that is accurate enough at pixelsPerEm.
+unsigned glyphLODLevelForPixelsPerEm(float pixelsPerEm);
+// Like triangulateBatch(), but fills in every level: meshes[i * GlyphLODLevelCount + level] is for paths[i]. emSizes[i]
+// is how many path units make one em of paths[i]; for a path from CTFontCreatePathForGlyph(), the font's point size.
+void triangulateBatchWithLOD(const CGPathRef*, const CGFloat* emSizes, size_t count, float pixelTolerance, unsigned threadCount, TriangulationFillRule, CubicTriangleMesh* meshes);
+
+// Meshes for filling with the stencil, which need no interior triangulation. Curves are split around their inflections.
+// Each contour of the inner border (the path with every curve replaced by its hull's vertices on the inside) becomes a
+// fan from its first point, and each curve keeps its Loop-Blinn triangles, all facing counterclockwise. Drawing them
+// all into the stencil, incrementing for counterclockwise triangles and decrementing for clockwise ones wherever
+// k^3 - l*m <= 0, leaves the winding number, so filling where the stencil is nonzero, or odd, applies either fill rule.
+// See WindingReference.h to check a mesh.
+void triangulateBatchForStencil(const CGPathRef*, size_t count, unsigned threadCount, CubicTriangleMesh* meshes);
 
 #ifdef __cplusplus
 }
+
+#include <vector>
+
+struct TriangulationStats;
+
+struct TriangulationOptions {
+    TriangulationFillRule fillRule { TriangulationFillRuleNonZero };
+    // False forces the CGAL interior, for comparison.
+    bool allowFastInterior { true };
+    // Labels CGAL's faces with the old even-odd flood fill instead of by region, so the benchmark can compare them.
+    // Ignores fillRule.
+    bool floodFillLabeling { false };
+    // In path units. Above 0, curves become line segments within this distance of them instead of Loop-Blinn
+    // triangles; see triangulateBatchWithLOD().
+    CGFloat flatteningTolerance { 0 };
+    // Splits curves whose hulls overlap another edge before triangulating; see HullSeparation.h. Doesn't apply when
+    // flattening, or to stencil meshes, where overlaps add up correctly anyway.
+    bool separateCurveHulls { true };
+    // Fans the interior for the stencil instead of triangulating it; see triangulateBatchForStencil(). Ignores fillRule.
+    bool stencilFanInterior { false };
+};
+
+// Triangulates like createTriangulatedPath() and appends the vertices to positions and coefficients. Returns whether
+// CGAL was used. Instantiated for CGPathSource, FlatPathSource, FlatPath and SVGPathSource.
+template <typename PathSource>
+bool triangulateAndAppend(const PathSource&, const TriangulationOptions&, std::vector<vector_float2>& positions, std::vector<vector_float4>& coefficients);
+
+// One mesh of triangulateBatch() or triangulateBatchWithLOD(), on this thread. A NULL path produces an empty mesh.
+CubicTriangleMesh createCubicTriangleMesh(CGPathRef, const TriangulationOptions&);
+
+// triangulateBatch(), adding every worker's counters and timings into stats. Without TRIANGULATION_STATS, stats is
+// left alone.
+void triangulateBatch(const CGPathRef*, size_t count, unsigned threadCount, TriangulationFillRule, CubicTriangleMesh* meshes, TriangulationStats& stats);
 #endif
 
 #endif /* Triangulator_h */
@@ -0,0 +1,165 @@
+//
+//  WindingReference.cpp
+//  GPUTextComparison
+//
+//  Created by Litherum on 6/2/16.
+//  Copyright © 2016 Litherum. All rights reserved.
+//
+
+#include "WindingReference.h"
+
+#include "HullSeparation.h"
+#include "PathSource.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+int stencilMeshWindingNumber(const vector_float2* positions, const vector_float4* coefficients, size_t vertexCount, float x, float y) {
+    // Of the two directions along an edge, exactly one passes, so shared edges go to one side.
+    auto includesEdge = [](double dx, double dy) {
+        return dy < 0 || (dy == 0 && dx < 0);
+    };
+    int winding = 0;
+    for (size_t i = 0; i + 2 < vertexCount; i += 3) {
+        std::array<size_t, 3> v = {{ i, i + 1, i + 2 }};
+        double area = (static_cast<double>(positions[v[1]].x) - positions[v[0]].x) * (static_cast<double>(positions[v[2]].y) - positions[v[0]].y)
+            - (static_cast<double>(positions[v[2]].x) - positions[v[0]].x) * (static_cast<double>(positions[v[1]].y) - positions[v[0]].y);
+        if (area == 0)
+            continue;
+        int direction = area > 0 ? 1 : -1;
+        if (area < 0) {
+            std::swap(v[1], v[2]);
+            area = -area;
+        }
+
+        // Edge j is opposite vertex j, so its edge function is that vertex's barycentric weight, times area.
+        std::array<double, 3> weights;
+        bool covered = true;
+        for (unsigned j = 0; j < 3 && covered; ++j) {
+            auto& a = positions[v[(j + 1) % 3]];
+            auto& b = positions[v[(j + 2) % 3]];
+            double dx = static_cast<double>(b.x) - a.x;
+            double dy = static_cast<double>(b.y) - a.y;
+            weights[j] = dx * (y - a.y) - dy * (x - a.x);
+            covered = weights[j] > 0 || (weights[j] == 0 && includesEdge(dx, dy));
+        }
+        if (!covered)
+            continue;
+
+        if (coefficients) {
+            double k = 0;
+            double l = 0;
+            double m = 0;
+            for (unsigned j = 0; j < 3; ++j) {
+                k += weights[j] / area * coefficients[v[j]].x;
+                l += weights[j] / area * coefficients[v[j]].y;
+                m += weights[j] / area * coefficients[v[j]].z;
+            }
+            if (k * k * k - l * m > 0)
+                continue;
+        }
+        winding += direction;
+    }
+    return winding;
+}
+
+// Counts a piece of curve along which y only goes one way, from t0 to t1. Like the edges in Triangulator's
+// windingNumber(), a piece covers the y of its start but not of its end, going up, and the other way around going down.
+template <typename Evaluate>
+static int monotoneCrossing(Evaluate evaluate, CGFloat t0, CGFloat t1, CGFloat x, CGFloat y) {
+    CGPoint start = evaluate(t0);
+    CGPoint end = evaluate(t1);
+    int direction;
+    if (start.y <= y && y < end.y)
+        direction = 1;
+    else if (end.y <= y && y < start.y)
+        direction = -1;
+    else
+        return 0;
+    // Keep the end below y at t0.
+    if (direction < 0)
+        std::swap(t0, t1);
+    for (unsigned i = 0; i < 64; ++i) {
+        CGFloat middle = (t0 + t1) / 2;
+        if (evaluate(middle).y <= y)
+            t0 = middle;
+        else
+            t1 = middle;
+    }
+    return evaluate((t0 + t1) / 2).x > x ? direction : 0;
+}
+
+static int lineCrossing(CGPoint a, CGPoint b, CGFloat x, CGFloat y) {
+    CGFloat side = (b.x - a.x) * (y - a.y) - (x - a.x) * (b.y - a.y);
+    if (a.y <= y)
+        return b.y > y && side > 0 ? 1 : 0;
+    return b.y <= y && side < 0 ? -1 : 0;
+}
+
+static int cubicCrossing(CGPoint p0, CGPoint p1, CGPoint p2, CGPoint p3, CGFloat x, CGFloat y) {
+    auto evaluate = [&](CGFloat t) {
+        CGFloat s = 1 - t;
+        return CGPointMake(s * s * s * p0.x + 3 * s * s * t * p1.x + 3 * s * t * t * p2.x + t * t * t * p3.x,
+            s * s * s * p0.y + 3 * s * s * t * p1.y + 3 * s * t * t * p2.y + t * t * t * p3.y);
+    };
+    // The y derivative is 3 (a t^2 + 2 b t + c).
+    CGFloat a = p3.y - 3 * p2.y + 3 * p1.y - p0.y;
+    CGFloat b = p2.y - 2 * p1.y + p0.y;
+    CGFloat c = p1.y - p0.y;
+    std::array<CGFloat, 4> splits;
+    unsigned splitCount = 0;
+    splits[splitCount++] = 0;
+    auto addSplit = [&](CGFloat t) {
+        if (t > 0 && t < 1)
+            splits[splitCount++] = t;
+    };
+    if (std::abs(a) > 1e-12 * (std::abs(b) + std::abs(c) + 1)) {
+        CGFloat discriminant = b * b - a * c;
+        if (discriminant >= 0) {
+            CGFloat root = std::sqrt(discriminant);
+            addSplit((-b - root) / a);
+            addSplit((-b + root) / a);
+        }
+    } else if (b != 0)
+        addSplit(-c / (2 * b));
+    std::sort(splits.begin() + 1, splits.begin() + splitCount);
+    splits[splitCount++] = 1;
+
+    int winding = 0;
+    for (unsigned i = 0; i + 1 < splitCount; ++i)
+        winding += monotoneCrossing(evaluate, splits[i], splits[i + 1], x, y);
+    return winding;
+}
+
+int pathWindingNumber(CGPathRef path, CGFloat x, CGFloat y) {
+    int winding = 0;
+    CGPoint current = CGPointZero;
+    CGPoint begin = CGPointZero;
+    CGPathSource(path).iterate([&](PathElement element) {
+        switch (element.type) {
+        case PathElementMoveToPoint:
+            winding += lineCrossing(current, begin, x, y);
+            current = begin = element.points[0];
+            break;
+        case PathElementAddLineToPoint:
+            winding += lineCrossing(current, element.points[0], x, y);
+            current = element.points[0];
+            break;
+        case PathElementAddQuadCurveToPoint: {
+            auto controlPoints = quadraticToCubic(current, element.points[0], element.points[1]);
+            winding += cubicCrossing(current, controlPoints[0], controlPoints[1], element.points[1], x, y);
+            current = element.points[1];
+            break;
+        }
+        case PathElementAddCurveToPoint:
+            winding += cubicCrossing(current, element.points[0], element.points[1], element.points[2], x, y);
+            current = element.points[2];
+            break;
+        case PathElementCloseSubpath:
+            winding += lineCrossing(current, begin, x, y);
+            current = begin;
+        }
+    });
+    return winding + lineCrossing(current, begin, x, y);
+}
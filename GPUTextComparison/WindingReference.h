@@ -0,0 +1,37 @@
+//
+//  WindingReference.h
+//  GPUTextComparison
+//
+//  Created by Litherum on 6/2/16.
+//  Copyright © 2016 Litherum. All rights reserved.
+//
+
+#ifndef WindingReference_h
+#define WindingReference_h
+
+#include <CoreGraphics/CoreGraphics.h>
+#include <simd/simd.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Winding numbers on the CPU, to check meshes that are filled with the stencil against the paths they came from.
+// Counterclockwise is positive, and every subpath counts as closed, the way filling a path closes it.
+
+// What counting the triangles into the stencil leaves at (x, y): each triangle that covers the point, and whose
+// k^3 - l*m <= 0 there, adds 1 if it's counterclockwise and -1 if it's clockwise. coefficients may be NULL, as for
+// writeStencilFan()'s triangles, and then every covering triangle counts. A point on an edge two triangles share is
+// covered by exactly one of them, as when rasterizing.
+int stencilMeshWindingNumber(const vector_float2* positions, const vector_float4* coefficients, size_t vertexCount, float x, float y);
+
+// The path's own winding number at (x, y), from where its segments and curves cross a ray towards +x. Curves are
+// split where they turn around vertically and each piece is solved by bisection, so this is exact to within rounding.
+int pathWindingNumber(CGPathRef, CGFloat x, CGFloat y);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* WindingReference_h */
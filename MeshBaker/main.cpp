@@ -0,0 +1,55 @@
+//
+//  main.cpp
+//  MeshBaker
+//
+//  Created by Litherum on 5/15/16.
+//  Copyright © 2016 Litherum. All rights reserved.
+//
+
+// Triangulates every outline in a corpus (see OutlineCorpus.h) on every core, and writes the meshes out as a
+// GlyphMeshCache which the app can mmap() at launch instead of triangulating anything.
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "GlyphMeshCache.h"
+#include "OutlineCorpus.h"
+#include "Triangulator.h"
+
+int main(int argc, const char * argv[]) {
+    if (argc != 3 && argc != 4) {
+        fprintf(stderr, "Usage: %s <outline corpus> <output mesh cache> [thread count]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    unsigned threadCount = argc == 4 ? static_cast<unsigned>(atoi(argv[3])) : 0;
+
+    std::vector<CorpusOutline> outlines;
+    if (!readOutlineCorpus(argv[1], outlines)) {
+        fprintf(stderr, "Could not read outline corpus %s\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+
+    std::vector<CGPathRef> paths;
+    for (auto& outline : outlines)
+        paths.push_back(outline.path);
+    std::vector<CubicTriangleMesh> meshes(outlines.size());
+    triangulateBatch(paths.data(), paths.size(), threadCount, TriangulationFillRuleNonZero, meshes.data());
+
+    std::vector<GlyphMeshCacheEntry> entries;
+    size_t vertexCount = 0;
+    for (size_t i = 0; i < outlines.size(); ++i) {
+        entries.push_back({ glyphMeshCacheFontKey(outlines[i].fontIdentity.c_str()), outlines[i].glyphID, meshes[i] });
+        vertexCount += meshes[i].vertexCount;
+    }
+    bool success = writeGlyphMeshCache(argv[2], entries.data(), entries.size());
+    for (auto& mesh : meshes)
+        destroyCubicTriangleMesh(mesh);
+
+    if (!success) {
+        fprintf(stderr, "Could not write mesh cache %s\n", argv[2]);
+        return EXIT_FAILURE;
+    }
+    printf("Baked %zu glyphs, %zu vertices\n", outlines.size(), vertexCount);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,138 @@
+//
+//  AtlasBenchmarks.cpp
+//  TriangulationBenchmark
+//
+//  Created by Litherum on 6/5/16.
+//  Copyright © 2016 Litherum. All rights reserved.
+//
+
+#include "Benchmark.h"
+
+#include <cmath>
+#include <functional>
+#include <unordered_set>
+
+#include "GlyphAtlasAllocator.h"
+
+struct AtlasRequest {
+    uint64_t key;
+    uint32_t width;
+    uint32_t height;
+};
+
+// Turns frames into what DisplayViewController asks its atlas for: a key per glyph and quarter-pixel subpixel
+// position, and the pixel size of its bounding box there. Outline control points stand in for
+// CTFontGetBoundingRectsForGlyphs().
+static std::vector<std::vector<AtlasRequest>> atlasRequests(const BenchmarkFixture& fixture) {
+    std::vector<PathBounds> bounds;
+    for (auto path : fixture.paths)
+        bounds.push_back(pathBounds(path));
+
+    std::vector<std::vector<AtlasRequest>> result;
+    for (auto& frame : fixture.frames) {
+        result.emplace_back();
+        for (auto& glyph : frame) {
+            auto& box = bounds[glyph.outline];
+            if (box.isEmpty())
+                continue;
+            CGFloat integer;
+            CGFloat subpixelX = std::floor(std::modf(glyph.position.x, &integer) * 4) / 4;
+            CGFloat subpixelY = std::floor(std::modf(glyph.position.y, &integer) * 4) / 4;
+            uint64_t key = glyph.outline * 16 + static_cast<uint64_t>((subpixelX + 1) * 4) % 4 * 4 + static_cast<uint64_t>((subpixelY + 1) * 4) % 4;
+            auto width = std::ceil(box.maxX + subpixelX) - std::floor(box.minX + subpixelX);
+            auto height = std::ceil(box.maxY + subpixelY) - std::floor(box.minY + subpixelY);
+            result.back().push_back({ key, static_cast<uint32_t>(width), static_cast<uint32_t>(height) });
+        }
+    }
+    return result;
+}
+
+// Replays the requests through GlyphAtlasAllocator with a few page sizes: the app's four 4096 pixel pages, and single
+// small pages that have to evict. Keeps frames in flight safe the way the app does.
+void benchmarkAtlas(JSONWriter& writer, const BenchmarkFixture& fixture) {
+    auto frames = atlasRequests(fixture);
+    size_t requestCount = 0;
+    for (auto& frame : frames)
+        requestCount += frame.size();
+
+    struct Configuration {
+        uint32_t pageSize;
+        uint32_t plotSize;
+        uint32_t maximumPageCount;
+    };
+    const uint32_t protectedFrameCount = 3;
+    writer.beginObject("atlas");
+    writer.value("stream", fixture.streamPath ? fixture.streamPath : "synthetic");
+    writer.value("frames", frames.size());
+    writer.value("glyphsPerFrame", frames.empty() ? 0.0 : static_cast<double>(requestCount) / frames.size());
+    writer.value("missingGlyphs", fixture.missingGlyphs);
+    writer.beginArray("configurations");
+    for (auto configuration : { Configuration { 4096, 512, 4 }, Configuration { 1024, 256, 1 }, Configuration { 512, 128, 1 } }) {
+        auto replay = [&](GlyphAtlasAllocatorRef atlas, std::unordered_set<uint64_t>* allocatedKeys, const std::function<void()>& afterFrame) {
+            size_t allocations = 0;
+            for (auto& frame : frames) {
+                glyphAtlasBeginFrame(atlas);
+                for (auto& request : frame) {
+                    GlyphAtlasRegion region;
+                    if (!glyphAtlasLookup(atlas, request.key, &region, nullptr)) {
+                        if (glyphAtlasAllocate(atlas, request.key, request.width, request.height, GlyphAtlasBounds { 0, 0, static_cast<float>(request.width), static_cast<float>(request.height) }, &region) == GlyphAtlasAllocated && allocatedKeys)
+                            allocatedKeys->insert(request.key);
+                        ++allocations;
+                    }
+                }
+                afterFrame();
+            }
+            return allocations;
+        };
+        auto create = [&] {
+            return createGlyphAtlasAllocator(configuration.pageSize, configuration.pageSize, configuration.plotSize, configuration.maximumPageCount, 1, protectedFrameCount);
+        };
+
+        Measurement replayTime;
+        size_t allocations = 0;
+        for (unsigned i = 0; i < fixture.iterations; ++i) {
+            auto atlas = create();
+            replayTime.add(timed([&] { allocations = replay(atlas, nullptr, [] { }); }));
+            destroyGlyphAtlasAllocator(atlas);
+        }
+
+        // Once more, untimed, sampling every frame.
+        auto atlas = create();
+        double efficiencySum = 0;
+        std::unordered_set<uint64_t> allocatedKeys;
+        replay(atlas, &allocatedKeys, [&] { efficiencySum += glyphAtlasGetStatistics(atlas).packingEfficiency; });
+        auto statistics = glyphAtlasGetStatistics(atlas);
+        size_t moves = 0;
+        double defragmentSeconds = timed([&] { moves = glyphAtlasDefragment(atlas, protectedFrameCount, nullptr); });
+        auto defragmented = glyphAtlasGetStatistics(atlas);
+
+        writer.beginObject();
+        writer.value("pageSize", static_cast<size_t>(configuration.pageSize));
+        writer.value("plotSize", static_cast<size_t>(configuration.plotSize));
+        writer.value("maximumPageCount", static_cast<size_t>(configuration.maximumPageCount));
+        writer.value("seconds", replayTime);
+        writer.value("glyphsPerSecond", requestCount / replayTime.best);
+        writer.value("allocationsPerSecond", allocations / replayTime.best);
+        writer.value("allocations", allocations);
+        // Allocations that didn't fit, and the ones past the first for each glyph, which evictions caused.
+        writer.value("failures", allocations - statistics.allocations);
+        writer.value("reallocations", statistics.allocations - allocatedKeys.size());
+        writer.value("evictedGlyphsPerFrame", frames.empty() ? 0.0 : static_cast<double>(statistics.evictedGlyphs) / frames.size());
+        writer.value("evictedPlots", statistics.evictedPlots);
+        writer.value("pages", static_cast<size_t>(glyphAtlasPageCount(atlas)));
+        writer.value("meanPackingEfficiency", frames.empty() ? 0.0 : efficiencySum / frames.size());
+        writer.value("packingEfficiency", statistics.packingEfficiency);
+        writer.beginObject("defragment");
+        writer.value("seconds", defragmentSeconds);
+        writer.value("moves", moves);
+        writer.value("evictedGlyphs", defragmented.evictedGlyphs - statistics.evictedGlyphs);
+        writer.value("usedPlotsBefore", statistics.usedPlotCount);
+        writer.value("usedPlotsAfter", defragmented.usedPlotCount);
+        writer.value("packingEfficiency", defragmented.packingEfficiency);
+        writer.endObject();
+        writer.endObject();
+        destroyGlyphAtlasAllocator(atlas);
+    }
+    writer.endArray();
+    writer.endObject();
+}
@@ -0,0 +1,177 @@
+//
+//  Benchmark.cpp
+//  TriangulationBenchmark
+//
+//  Created by Litherum on 6/5/16.
+//  Copyright © 2016 Litherum. All rights reserved.
+//
+
+#include "Benchmark.h"
+
+#include <cstdlib>
+#include <new>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+#include <sys/resource.h>
+
+#include "GlyphStream.h"
+#include "PathSource.h"
+
+std::atomic<size_t> allocationCount { 0 };
+
+void* operator new(size_t size) {
+    ++allocationCount;
+    if (void* result = malloc(size ? size : 1))
+        return result;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* pointer) noexcept {
+    free(pointer);
+}
+
+size_t peakMemoryBytes() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#if defined(__APPLE__)
+    return static_cast<size_t>(usage.ru_maxrss);
+#else
+    return static_cast<size_t>(usage.ru_maxrss) * 1024;
+#endif
+}
+
+void JSONWriter::value(const char* key, double number) {
+    prefix(key);
+    fprintf(file, "%.9g", number);
+}
+
+void JSONWriter::value(const char* key, size_t number) {
+    prefix(key);
+    fprintf(file, "%zu", number);
+}
+
+void JSONWriter::value(const char* key, bool boolean) {
+    prefix(key);
+    fputs(boolean ? "true" : "false", file);
+}
+
+void JSONWriter::value(const char* key, const char* string) {
+    prefix(key);
+    fprintf(file, "\"%s\"", string);
+}
+
+void JSONWriter::value(const char* key, const Measurement& measurement) {
+    beginObject(key);
+    value("best", measurement.best);
+    value("mean", measurement.mean());
+    endObject();
+}
+
+void JSONWriter::prefix(const char* key) {
+    if (needsComma)
+        fputc(',', file);
+    fputc('\n', file);
+    for (unsigned i = 0; i < depth; ++i)
+        fputs("  ", file);
+    if (key)
+        fprintf(file, "\"%s\": ", key);
+    needsComma = true;
+}
+
+void JSONWriter::open(const char* key, char bracket) {
+    if (depth)
+        prefix(key);
+    fputc(bracket, file);
+    ++depth;
+    needsComma = false;
+}
+
+void JSONWriter::close(char bracket) {
+    --depth;
+    fputc('\n', file);
+    for (unsigned i = 0; i < depth; ++i)
+        fputs("  ", file);
+    fputc(bracket, file);
+    needsComma = true;
+    if (!depth)
+        fputc('\n', file);
+}
+
+PathBounds pathBounds(CGPathRef path) {
+    PathBounds result;
+    CGPathSource(path).iterate([&](PathElement element) {
+        for (unsigned i = 0; i < pathElementPointCount(element.type); ++i) {
+            result.minX = std::min(result.minX, element.points[i].x);
+            result.minY = std::min(result.minY, element.points[i].y);
+            result.maxX = std::max(result.maxX, element.points[i].x);
+            result.maxY = std::max(result.maxY, element.points[i].y);
+        }
+    });
+    return result;
+}
+
+static std::vector<std::vector<FrameGlyph>> corpusFrames(const std::vector<CorpusOutline>& outlines, const char*& streamPath, size_t& missingGlyphs) {
+    std::vector<std::vector<FrameGlyph>> result;
+    missingGlyphs = 0;
+    GlyphStream stream;
+    if (streamPath && !readGlyphStream(streamPath, stream)) {
+        fprintf(stderr, "Could not read glyph stream %s; using a synthetic one\n", streamPath);
+        streamPath = nullptr;
+    }
+    if (streamPath) {
+        std::unordered_map<std::string, size_t> outlineIndices;
+        for (size_t i = 0; i < outlines.size(); ++i)
+            outlineIndices.emplace(outlines[i].fontIdentity + " " + std::to_string(outlines[i].glyphID), i);
+        for (auto& streamFrame : stream.frames) {
+            result.emplace_back();
+            for (auto& glyph : streamFrame) {
+                auto outline = outlineIndices.find(stream.fontIdentities[glyph.font] + " " + std::to_string(glyph.glyphID));
+                if (outline == outlineIndices.end())
+                    ++missingGlyphs;
+                else
+                    result.back().push_back({ outline->second, glyph.position });
+            }
+        }
+        return result;
+    }
+
+    std::mt19937 random(1);
+    std::vector<double> weights;
+    for (size_t i = 0; i < outlines.size(); ++i)
+        weights.push_back(1.0 / (i + 1));
+    std::discrete_distribution<size_t> zipf(weights.begin(), weights.end());
+    std::uniform_real_distribution<CGFloat> x(0, 800);
+    result.resize(500);
+    for (auto& frame : result) {
+        for (unsigned i = 0; i < 1500; ++i)
+            frame.push_back({ zipf(random), CGPointMake(x(random), 0) });
+    }
+    return result;
+}
+
+bool loadBenchmarkFixture(const char* corpusPath, unsigned iterations, BenchmarkFixture& fixture) {
+    if (!readOutlineCorpus(corpusPath, fixture.outlines) || fixture.outlines.empty())
+        return false;
+    fixture.iterations = iterations;
+    fixture.hardwareThreads = std::max(std::thread::hardware_concurrency(), 1u);
+    for (auto& outline : fixture.outlines)
+        fixture.paths.push_back(outline.path);
+
+    for (auto& outline : fixture.outlines) {
+        auto dash = outline.fontIdentity.rfind('-');
+        char* end = nullptr;
+        CGFloat emSize = dash == std::string::npos ? 0 : strtod(outline.fontIdentity.c_str() + dash + 1, &end);
+        if (!(emSize > 0) || *end) {
+            fixture.emSizes.clear();
+            break;
+        }
+        fixture.emSizes.push_back(emSize);
+    }
+
+    fixture.streamPath = getenv("GLYPH_STREAM_PATH");
+    fixture.frames = corpusFrames(fixture.outlines, fixture.streamPath, fixture.missingGlyphs);
+    return true;
+}
@@ -0,0 +1,191 @@
+//
+//  Benchmark.h
+//  TriangulationBenchmark
+//
+//  Created by Litherum on 6/5/16.
+//  Copyright © 2016 Litherum. All rights reserved.
+//
+
+#ifndef Benchmark_h
+#define Benchmark_h
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <limits>
+#include <vector>
+
+#include "CompactMesh.h"
+#include "CubicClassification.h"
+#include "OutlineCorpus.h"
+#include "Triangulator.h"
+
+// What every area's benchmarks share: timing, the JSON report, and the corpus they all run over. main() reads the
+// corpus once and calls each area's benchmarks in turn, and each writes its own section of the report.
+
+// Every operator new since the program started.
+extern std::atomic<size_t> allocationCount;
+
+template <typename Function>
+double timed(Function function) {
+    auto start = std::chrono::steady_clock::now();
+    function();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+struct Measurement {
+    void add(double seconds) {
+        best = std::min(best, seconds);
+        total += seconds;
+        ++count;
+    }
+
+    double mean() const {
+        return count ? total / count : 0;
+    }
+
+    double best { std::numeric_limits<double>::infinity() };
+    double total { 0 };
+    unsigned count { 0 };
+};
+
+size_t peakMemoryBytes();
+
+// Just enough JSON for one flat report; keys are never escaped.
+class JSONWriter {
+public:
+    JSONWriter(FILE* file) : file(file) {
+    }
+
+    void beginObject(const char* key = nullptr) {
+        open(key, '{');
+    }
+
+    void endObject() {
+        close('}');
+    }
+
+    void beginArray(const char* key) {
+        open(key, '[');
+    }
+
+    void endArray() {
+        close(']');
+    }
+
+    void value(const char* key, double number);
+    void value(const char* key, size_t number);
+    void value(const char* key, bool boolean);
+    void value(const char* key, const char* string);
+    void value(const char* key, const Measurement&);
+
+private:
+    void prefix(const char* key);
+    void open(const char* key, char bracket);
+    void close(char bracket);
+
+    FILE* file;
+    unsigned depth { 0 };
+    bool needsComma { false };
+};
+
+// A glyph drawn in a frame, as an index into the corpus.
+struct FrameGlyph {
+    size_t outline;
+    CGPoint position;
+};
+
+// The control point bounds of a path. Empty paths have the minimum above the maximum.
+struct PathBounds {
+    bool isEmpty() const {
+        return minX > maxX;
+    }
+
+    CGFloat minX { std::numeric_limits<CGFloat>::infinity() };
+    CGFloat minY { std::numeric_limits<CGFloat>::infinity() };
+    CGFloat maxX { -std::numeric_limits<CGFloat>::infinity() };
+    CGFloat maxY { -std::numeric_limits<CGFloat>::infinity() };
+};
+
+PathBounds pathBounds(CGPathRef);
+
+struct BenchmarkFixture {
+    // The em size of a glyph's font, or fallback if the corpus doesn't say.
+    CGFloat emSize(size_t glyph, CGFloat fallback) const {
+        return emSizes.empty() ? fallback : emSizes[glyph];
+    }
+
+    std::vector<CorpusOutline> outlines;
+    // The outlines' paths, for the C APIs that take arrays of them.
+    std::vector<CGPathRef> paths;
+    // Font identities end in the point size (see fontIdentity() in Layout.swift), which is the em size of the
+    // outlines. Empty unless every outline's does.
+    std::vector<CGFloat> emSizes;
+    // The frames of a glyph stream of the same text as the corpus, read from GLYPH_STREAM_PATH. Without one, frames
+    // of the corpus glyphs drawn with a Zipf distribution stand in for text, and streamPath is null.
+    std::vector<std::vector<FrameGlyph>> frames;
+    const char* streamPath { nullptr };
+    size_t missingGlyphs { 0 };
+    unsigned iterations { 1 };
+    unsigned hardwareThreads { 1 };
+};
+
+// Returns false if the corpus can't be read or is empty.
+bool loadBenchmarkFixture(const char* corpusPath, unsigned iterations, BenchmarkFixture&);
+
+// TriangulationBenchmarks.cpp
+
+// Every curve in the corpus, as cubics, the same way Triangulator sees them. Also counts contours per glyph, since
+// labeling the CGAL interior gets slower with more of them (CJK and decorative fonts).
+void gatherCurves(const std::vector<CorpusOutline>&, CubicBatch&, size_t& contourCount, size_t& maximumContours);
+void benchmarkClassification(JSONWriter&, CubicBatch&, unsigned iterations);
+void benchmarkCubic(JSONWriter&, const CubicBatch&, unsigned iterations);
+// Every TriangulationOptions mode, region labeling against flood fill, and a check that open contours fill closed.
+void benchmarkTriangulationModes(JSONWriter&, const BenchmarkFixture&);
+// Returns the best time on one thread.
+double benchmarkBatchTriangulation(JSONWriter&, const BenchmarkFixture&);
+
+// RasterizationBenchmarks.cpp
+
+void benchmarkRasterization(JSONWriter&, const BenchmarkFixture&, const std::vector<CubicTriangleMesh>&);
+void benchmarkBandedCurves(JSONWriter&, const BenchmarkFixture&, const std::vector<CubicTriangleMesh>&, double triangulationSeconds);
+void benchmarkDistanceFields(JSONWriter&, const BenchmarkFixture&);
+
+// AtlasBenchmarks.cpp
+
+void benchmarkAtlas(JSONWriter&, const BenchmarkFixture&);
+
+// StencilBenchmarks.cpp
+
+void benchmarkFlattening(JSONWriter&, const BenchmarkFixture&);
+void benchmarkStencilFan(JSONWriter&, const BenchmarkFixture&);
+
+// HullSeparationBenchmarks.cpp
+
+void benchmarkHullSeparation(JSONWriter&, const BenchmarkFixture&);
+
+// HullTriangulationCheck.cpp
+
+// cubic() triangulates control points in closed form. This checks that against CGAL's Delaunay triangulation on count
+// random cubics, and returns how many came out differently. Where CGAL could have answered more than one way, as for
+// cocircular points, matching any of those answers exactly counts; ambiguousCases, if not null, is set to how many
+// such cases there were.
+unsigned verifyCubicHullTriangulation(unsigned count, unsigned seed, unsigned* ambiguousCases);
+
+// MeshBenchmarks.cpp
+
+// Indexes and compacts meshes, destroying them, and writes what each saves. compactMeshes is filled in for the frame
+// benchmarks.
+void benchmarkMeshFormats(JSONWriter&, const BenchmarkFixture&, std::vector<CubicTriangleMesh>& meshes, std::vector<CompactCubicTriangleMesh>& compactMeshes);
+// Level-of-detail meshes, which need em sizes to pick levels by.
+void benchmarkLOD(JSONWriter&, const BenchmarkFixture&);
+
+// FrameBenchmarks.cpp
+
+void benchmarkFrameStore(JSONWriter&, const BenchmarkFixture&);
+void benchmarkFrameBatching(JSONWriter&, const BenchmarkFixture&, const std::vector<CompactCubicTriangleMesh>&);
+void benchmarkGlyphCache(JSONWriter&, const BenchmarkFixture&, const std::vector<CompactCubicTriangleMesh>&);
+void benchmarkPipeline(JSONWriter&, const BenchmarkFixture&);
+
+#endif /* Benchmark_h */
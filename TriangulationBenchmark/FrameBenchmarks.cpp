@@ -0,0 +1,485 @@
+//
+//  FrameBenchmarks.cpp
+//  TriangulationBenchmark
+//
+//  Created by Litherum on 6/5/16.
+//  Copyright © 2016 Litherum. All rights reserved.
+//
+
+#include "Benchmark.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+#include <unistd.h>
+
+#include "FrameBatcher.h"
+#include "FrameStore.h"
+#include "GlyphCache.h"
+#include "IndexedMesh.h"
+#include "ParallelFor.h"
+#include "TriangulationPipeline.h"
+
+// Lays the frames out into a FrameStore the way FrameSource does, writing a layout file, then reads them back from it.
+// The baseline is what laying out everything up front held: an array per frame of Layout.swift's Glyph, font reference
+// and all.
+void benchmarkFrameStore(JSONWriter& writer, const BenchmarkFixture& fixture) {
+    auto& outlines = fixture.outlines;
+    auto& frames = fixture.frames;
+    const size_t retainedFrameCount = 32;
+    struct EagerGlyph {
+        CGGlyph glyphID;
+        const void* font;
+        uint32_t fontID;
+        CGPoint position;
+    };
+    if (frames.empty())
+        return;
+
+    const char* temporaryDirectory = getenv("TMPDIR");
+    std::string path = std::string(temporaryDirectory ? temporaryDirectory : "/tmp") + "/TriangulationBenchmark-" + std::to_string(getpid()) + ".layout";
+    uint64_t sourceKey = frameStoreSourceKey(path.c_str());
+    size_t glyphCount = 0;
+    for (auto& frame : frames)
+        glyphCount += frame.size();
+
+    writer.beginObject("frameStore");
+    Measurement building;
+    size_t retainedBytes = 0;
+    size_t fontCount = 0;
+    std::vector<CGGlyph> glyphs;
+    std::vector<CGPoint> positions;
+    for (unsigned i = 0; i < fixture.iterations; ++i) {
+        building.add(timed([&] {
+            auto store = createFrameStore(retainedFrameCount, path.c_str(), sourceKey);
+            for (auto& frame : frames) {
+                frameStoreBeginFrame(store);
+                for (size_t begin = 0; begin < frame.size();) {
+                    auto& fontIdentity = outlines[frame[begin].outline].fontIdentity;
+                    glyphs.clear();
+                    positions.clear();
+                    size_t end = begin;
+                    for (; end < frame.size() && outlines[frame[end].outline].fontIdentity == fontIdentity; ++end) {
+                        glyphs.push_back(outlines[frame[end].outline].glyphID);
+                        positions.push_back(frame[end].position);
+                    }
+                    frameStoreAppendRun(store, frameStoreAddFont(store, fontIdentity.c_str()), glyphs.data(), positions.data(), glyphs.size(), CGPointZero);
+                    begin = end;
+                }
+                frameStoreFinishFrame(store);
+            }
+            retainedBytes = frameStoreMemoryBytes(store);
+            fontCount = frameStoreFontCount(store);
+            if (!frameStoreFinish(store))
+                fprintf(stderr, "Could not write layout file %s\n", path.c_str());
+            destroyFrameStore(store);
+        }));
+    }
+    writer.value("frames", frames.size());
+    writer.value("glyphs", glyphCount);
+    writer.value("fonts", fontCount);
+    // Including writing the file, which the app does as it goes.
+    writer.value("buildSeconds", building);
+
+    Measurement opening;
+    Measurement reading;
+    FrameStoreRef store = nullptr;
+    double checksum = 0;
+    for (unsigned i = 0; i < fixture.iterations; ++i) {
+        destroyFrameStore(store);
+        opening.add(timed([&] {
+            store = createFrameStoreFromFile(path.c_str(), sourceKey);
+        }));
+        if (!store)
+            break;
+        checksum = 0;
+        reading.add(timed([&] {
+            for (size_t frame = 0; frame < frameStoreFrameCount(store); ++frame) {
+                FrameView view;
+                if (!frameStoreGetFrame(store, frame, &view))
+                    continue;
+                for (size_t run = 0; run < view.runCount; ++run) {
+                    for (uint32_t glyph = view.runs[run].firstGlyph; glyph < view.runs[run].firstGlyph + view.runs[run].glyphCount; ++glyph)
+                        checksum += view.glyphIDs[glyph] + view.x[glyph] + view.y[glyph] + view.runs[run].font;
+                }
+            }
+        }));
+    }
+    if (!store) {
+        fprintf(stderr, "Could not read layout file %s\n", path.c_str());
+        remove(path.c_str());
+        writer.endObject();
+        return;
+    }
+    destroyFrameStore(store);
+    FILE* file = fopen(path.c_str(), "rb");
+    long fileBytes = 0;
+    if (file && !fseek(file, 0, SEEK_END))
+        fileBytes = ftell(file);
+    if (file)
+        fclose(file);
+    remove(path.c_str());
+
+    std::vector<std::vector<EagerGlyph>> eagerFrames;
+    Measurement eagerReading;
+    double eagerChecksum = 0;
+    std::unordered_map<std::string, uint32_t> fontIndices;
+    for (auto& frame : frames) {
+        eagerFrames.emplace_back();
+        for (auto& glyph : frame) {
+            auto& outline = outlines[glyph.outline];
+            uint32_t font = fontIndices.emplace(outline.fontIdentity, static_cast<uint32_t>(fontIndices.size())).first->second;
+            eagerFrames.back().push_back({ outline.glyphID, &outline.fontIdentity, font, glyph.position });
+        }
+    }
+    for (unsigned i = 0; i < fixture.iterations; ++i) {
+        eagerChecksum = 0;
+        eagerReading.add(timed([&] {
+            for (auto& frame : eagerFrames) {
+                for (auto& glyph : frame)
+                    eagerChecksum += glyph.glyphID + glyph.position.x + glyph.position.y + glyph.fontID;
+            }
+        }));
+    }
+    size_t eagerBytes = glyphCount * sizeof(EagerGlyph) + frames.size() * sizeof(std::vector<EagerGlyph>);
+
+    writer.value("openSeconds", opening);
+    writer.value("readSeconds", reading);
+    writer.value("glyphsPerSecond", glyphCount / reading.best);
+    writer.value("eagerReadSeconds", eagerReading);
+    writer.value("fileBytes", static_cast<size_t>(fileBytes));
+    writer.value("fileBytesPerGlyph", static_cast<double>(fileBytes) / glyphCount);
+    writer.value("eagerBytesPerGlyph", static_cast<double>(sizeof(EagerGlyph)));
+    // What a store still laying out holds, against holding every frame.
+    writer.value("retainedBytes", retainedBytes);
+    writer.value("eagerBytes", eagerBytes);
+    writer.value("retainedByteRatio", static_cast<double>(retainedBytes) / eagerBytes);
+    // Keeps the reads from being optimized away; the two only differ by float rounding of positions.
+    writer.value("checksumDifference", std::abs(checksum - eagerChecksum));
+    writer.endObject();
+}
+
+// The copying baseline's vertex format: scene positions as int16 fixed point with this many steps per scene unit. The
+// 800 by 600 scene fits comfortably; positions beyond +/-2047 clamp.
+static const float compactScenePositionScale = 16;
+
+// Moves a compact mesh's positions to origin, in scene units, and writes them as two int16s per vertex.
+static void writeCompactScenePositions(const int16_t* positions, size_t vertexCount, float unitsPerPathUnit, CGPoint origin, int16_t* scenePositions) {
+    auto clampToInt16 = [](float value) {
+        return static_cast<int16_t>(std::max(-32767.f, std::min(32767.f, std::round(value))));
+    };
+    float scale = compactScenePositionScale / unitsPerPathUnit;
+    float x = origin.x * compactScenePositionScale;
+    float y = origin.y * compactScenePositionScale;
+    for (size_t i = 0; i < vertexCount; ++i) {
+        scenePositions[i * 2] = clampToInt16(positions[i * 2] * scale + x);
+        scenePositions[i * 2 + 1] = clampToInt16(positions[i * 2 + 1] * scale + y);
+    }
+}
+
+// Per-frame CPU cost of getting a frame's glyphs to the GPU, against host memory standing in for Metal buffers, with
+// the app's buffer sizes. Copying is what LoopBlinnViewController used to do: every vertex of every glyph, moved into
+// place, into 1 MB buffers with a draw whenever one fills. Batching writes each mesh once and then only instances.
+void benchmarkFrameBatching(JSONWriter& writer, const BenchmarkFixture& fixture, const std::vector<CompactCubicTriangleMesh>& meshes) {
+    auto& frames = fixture.frames;
+    const size_t vertexBufferSize = 1024 * 1024;
+    const size_t coefficientBufferSize = 1024 * 1024;
+    const size_t indexBufferSize = 256 * 1024;
+    const uint32_t pageVertexCount = 64 * 1024;
+    const uint32_t pageIndexCount = 128 * 1024;
+    const uint32_t maximumPageCount = 16;
+    const size_t instanceBufferSize = 64 * 1024;
+    const uint32_t protectedFrameCount = 3;
+    const size_t positionBytes = 2 * sizeof(int16_t);
+    const size_t coefficientBytes = 4 * sizeof(uint16_t);
+    if (frames.empty())
+        return;
+
+    writer.beginObject("frameBatching");
+    std::vector<uint8_t> vertexBuffer(vertexBufferSize);
+    std::vector<uint8_t> coefficientBuffer(coefficientBufferSize);
+    std::vector<uint8_t> indexBuffer(indexBufferSize);
+    Measurement copying;
+    size_t copiedBytes = 0;
+    size_t copyDraws = 0;
+    for (unsigned i = 0; i < fixture.iterations; ++i) {
+        copiedBytes = 0;
+        copyDraws = 0;
+        copying.add(timed([&] {
+            for (auto& frame : frames) {
+                size_t vertexCount = 0;
+                size_t indexCount = 0;
+                for (auto& glyph : frame) {
+                    auto& mesh = meshes[glyph.outline];
+                    if (!mesh.indexCount)
+                        continue;
+                    if ((vertexCount + mesh.vertexCount) * coefficientBytes > coefficientBufferSize || (indexCount + mesh.indexCount) * sizeof(uint16_t) > indexBufferSize || vertexCount + mesh.vertexCount > IndexedCubicTriangleMeshMaximumVertexCount) {
+                        ++copyDraws;
+                        vertexCount = 0;
+                        indexCount = 0;
+                    }
+                    writeCompactScenePositions(mesh.positions, mesh.vertexCount, mesh.unitsPerPathUnit, glyph.position, reinterpret_cast<int16_t*>(vertexBuffer.data()) + vertexCount * 2);
+                    memcpy(coefficientBuffer.data() + vertexCount * coefficientBytes, mesh.coefficients, mesh.vertexCount * coefficientBytes);
+                    auto indices = reinterpret_cast<uint16_t*>(indexBuffer.data()) + indexCount;
+                    for (size_t j = 0; j < mesh.indexCount; ++j)
+                        indices[j] = static_cast<uint16_t>(vertexCount + mesh.indices[j]);
+                    vertexCount += mesh.vertexCount;
+                    indexCount += mesh.indexCount;
+                    copiedBytes += mesh.vertexCount * (positionBytes + coefficientBytes) + mesh.indexCount * sizeof(uint16_t);
+                }
+                if (indexCount)
+                    ++copyDraws;
+            }
+        }));
+    }
+    writer.beginObject("copy");
+    writer.value("seconds", copying);
+    writer.value("secondsPerFrame", copying.best / frames.size());
+    writer.value("bytesPerFrame", static_cast<double>(copiedBytes) / frames.size());
+    writer.value("drawsPerFrame", static_cast<double>(copyDraws) / frames.size());
+    writer.endObject();
+
+    std::vector<std::vector<uint8_t>> pages;
+    std::vector<uint8_t> instanceBuffer(instanceBufferSize);
+    uint32_t instancesPerChunk = static_cast<uint32_t>(instanceBufferSize / sizeof(FrameBatchInstance));
+    Measurement batching;
+    size_t batchedBytes = 0;
+    size_t batchDraws = 0;
+    size_t chunks = 0;
+    size_t dropped = 0;
+    FrameBatcherStatistics statistics;
+    for (unsigned i = 0; i < fixture.iterations; ++i) {
+        batchedBytes = 0;
+        batchDraws = 0;
+        chunks = 0;
+        dropped = 0;
+        auto batcher = createFrameBatcher(pageVertexCount, pageIndexCount, maximumPageCount, instancesPerChunk, protectedFrameCount);
+        batching.add(timed([&] {
+            for (auto& frame : frames) {
+                frameBatcherBeginFrame(batcher);
+                for (auto& glyph : frame) {
+                    auto& mesh = meshes[glyph.outline];
+                    if (!mesh.indexCount)
+                        continue;
+                    float x = static_cast<float>(glyph.position.x);
+                    float y = static_cast<float>(glyph.position.y);
+                    if (frameBatcherAddInstance(batcher, glyph.outline, x, y))
+                        continue;
+                    FrameBatchMeshPlacement placement;
+                    if (frameBatcherAddMesh(batcher, glyph.outline, static_cast<uint32_t>(mesh.vertexCount), static_cast<uint32_t>(mesh.indexCount), 1 / mesh.unitsPerPathUnit, &placement) != FrameBatchMeshAdded) {
+                        ++dropped;
+                        continue;
+                    }
+                    // Positions, then coefficients, then indices, in one allocation per page.
+                    pages.resize(std::max<size_t>(pages.size(), placement.page + 1));
+                    auto& page = pages[placement.page];
+                    page.resize(pageVertexCount * (positionBytes + coefficientBytes) + pageIndexCount * sizeof(uint16_t));
+                    memcpy(page.data() + placement.firstVertex * positionBytes, mesh.positions, mesh.vertexCount * positionBytes);
+                    memcpy(page.data() + pageVertexCount * positionBytes + placement.firstVertex * coefficientBytes, mesh.coefficients, mesh.vertexCount * coefficientBytes);
+                    memcpy(page.data() + pageVertexCount * (positionBytes + coefficientBytes) + placement.firstIndex * sizeof(uint16_t), mesh.indices, mesh.indexCount * sizeof(uint16_t));
+                    batchedBytes += mesh.vertexCount * (positionBytes + coefficientBytes) + mesh.indexCount * sizeof(uint16_t);
+                    frameBatcherAddInstance(batcher, glyph.outline, x, y);
+                }
+                frameBatcherFinishFrame(batcher);
+                size_t instanceCount;
+                auto instances = frameBatcherInstances(batcher, &instanceCount);
+                size_t drawCount;
+                frameBatcherDraws(batcher, &drawCount);
+                for (size_t first = 0; first < instanceCount; first += instancesPerChunk)
+                    memcpy(instanceBuffer.data(), instances + first, std::min<size_t>(instancesPerChunk, instanceCount - first) * sizeof(FrameBatchInstance));
+                batchedBytes += instanceCount * sizeof(FrameBatchInstance);
+                batchDraws += drawCount;
+                chunks += frameBatcherChunkCount(batcher);
+            }
+        }));
+        statistics = frameBatcherGetStatistics(batcher);
+        destroyFrameBatcher(batcher);
+    }
+    writer.beginObject("batch");
+    writer.value("seconds", batching);
+    writer.value("secondsPerFrame", batching.best / frames.size());
+    writer.value("bytesPerFrame", static_cast<double>(batchedBytes) / frames.size());
+    writer.value("drawsPerFrame", static_cast<double>(batchDraws) / frames.size());
+    writer.value("instanceBuffersPerFrame", static_cast<double>(chunks) / frames.size());
+    writer.value("meshesAdded", statistics.meshesAdded);
+    writer.value("evictedMeshes", statistics.evictedMeshes);
+    writer.value("evictedPages", statistics.evictedPages);
+    // Glyphs not drawn because every page was protected.
+    writer.value("droppedGlyphs", dropped);
+    writer.endObject();
+    writer.value("speedup", copying.best / batching.best);
+    writer.endObject();
+}
+
+// Replays the frames' glyph lookups the way LoopBlinnViewController does, inserting each compact mesh on a miss. The
+// baseline is a map keyed by font identity and glyph, which hashes a string every lookup the way hashing a CTFont's
+// descriptor did. The cache runs unbounded, then with a quarter of the frames' meshes' bytes, on 1 and every thread.
+void benchmarkGlyphCache(JSONWriter& writer, const BenchmarkFixture& fixture, const std::vector<CompactCubicTriangleMesh>& meshes) {
+    auto& outlines = fixture.outlines;
+    auto& frames = fixture.frames;
+    const size_t positionBytes = 2 * sizeof(int16_t);
+    const size_t coefficientBytes = 4 * sizeof(uint16_t);
+    auto meshBytes = [&](size_t outline) {
+        auto& mesh = meshes[outline];
+        return mesh.vertexCount * (positionBytes + coefficientBytes) + mesh.indexCount * sizeof(uint16_t);
+    };
+    size_t lookups = 0;
+    size_t workingSetBytes = 0;
+    std::vector<bool> seen(outlines.size());
+    for (auto& frame : frames) {
+        lookups += frame.size();
+        for (auto& glyph : frame) {
+            if (!seen[glyph.outline])
+                workingSetBytes += meshBytes(glyph.outline);
+            seen[glyph.outline] = true;
+        }
+    }
+    if (!lookups)
+        return;
+
+    writer.beginObject("glyphCache");
+    writer.value("lookups", lookups);
+    writer.value("workingSetBytes", workingSetBytes);
+
+    Measurement baseline;
+    for (unsigned i = 0; i < fixture.iterations; ++i) {
+        std::unordered_map<std::string, std::vector<uint8_t>> map;
+        baseline.add(timed([&] {
+            for (auto& frame : frames) {
+                for (auto& glyph : frame) {
+                    auto& outline = outlines[glyph.outline];
+                    auto& value = map[outline.fontIdentity + " " + std::to_string(outline.glyphID)];
+                    if (value.empty())
+                        value.resize(meshBytes(glyph.outline) + 1);
+                }
+            }
+        }));
+    }
+    writer.beginObject("stringKeys");
+    writer.value("seconds", baseline);
+    writer.value("lookupsPerSecond", lookups / baseline.best);
+    writer.endObject();
+
+    // Interned once, as Layout.swift does per run.
+    std::vector<uint64_t> keys(outlines.size());
+    for (size_t i = 0; i < outlines.size(); ++i)
+        keys[i] = glyphCacheKey(glyphCacheFontID(outlines[i].fontIdentity.c_str()), outlines[i].glyphID, 0);
+
+    writer.beginArray("interned");
+    for (size_t budget : { std::numeric_limits<size_t>::max(), workingSetBytes / 4 }) {
+        for (unsigned threads : { 1u, fixture.hardwareThreads }) {
+            Measurement replay;
+            GlyphCacheStatistics statistics {};
+            for (unsigned i = 0; i < fixture.iterations; ++i) {
+                auto cache = createGlyphCache(budget, 0);
+                replay.add(timed([&] {
+                    parallelFor(frames.size(), threads, [&](size_t f, unsigned) {
+                        for (auto& glyph : frames[f]) {
+                            GlyphCacheValue value;
+                            if (!glyphCacheLookup(cache, keys[glyph.outline], &value)) {
+                                auto& mesh = meshes[glyph.outline];
+                                size_t vertexBytes = mesh.vertexCount * positionBytes;
+                                if (!glyphCacheInsert(cache, keys[glyph.outline], meshBytes(glyph.outline), ^(void* bytes) {
+                                    auto destination = static_cast<uint8_t*>(bytes);
+                                    memcpy(destination, mesh.positions, vertexBytes);
+                                    memcpy(destination + vertexBytes, mesh.coefficients, mesh.vertexCount * coefficientBytes);
+                                    memcpy(destination + vertexBytes + mesh.vertexCount * coefficientBytes, mesh.indices, mesh.indexCount * sizeof(uint16_t));
+                                }, &value))
+                                    continue;
+                            }
+                            glyphCacheReleaseValue(value);
+                        }
+                    });
+                }));
+                statistics = glyphCacheGetStatistics(cache);
+                destroyGlyphCache(cache);
+            }
+            writer.beginObject();
+            writer.value("budget", budget == std::numeric_limits<size_t>::max() ? static_cast<size_t>(0) : budget);
+            writer.value("threads", static_cast<size_t>(threads));
+            writer.value("seconds", replay);
+            writer.value("lookupsPerSecond", lookups / replay.best);
+            writer.value("speedup", baseline.best / replay.best);
+            writer.value("hitRate", static_cast<double>(statistics.hits) / (statistics.hits + statistics.misses));
+            writer.value("evictions", statistics.evictions);
+            writer.value("entries", statistics.entryCount);
+            writer.value("bytes", statistics.bytes);
+            writer.endObject();
+        }
+    }
+    writer.endArray();
+    writer.endObject();
+}
+
+// Replays the frames the way LoopBlinnViewController draws them, at 120 frames per second: each frame requests the
+// glyphs of the next lookAhead frames it hasn't seen yet from a TriangulationPipeline, then takes its own, waiting for
+// any that aren't done. A look-ahead of 0 is triangulating on demand, but on the pipeline's threads.
+void benchmarkPipeline(JSONWriter& writer, const BenchmarkFixture& fixture) {
+    auto& paths = fixture.paths;
+    auto& frames = fixture.frames;
+    const size_t maximumFrameCount = 240;
+    const std::chrono::duration<double> frameDuration(1.0 / 120);
+    const unsigned threads = std::max(fixture.hardwareThreads, 2u) - 1;
+    size_t frameCount = std::min(frames.size(), maximumFrameCount);
+    writer.beginArray("pipeline");
+    for (size_t lookAhead : { 0u, 2u, 8u }) {
+        auto pipeline = createTriangulationPipeline(threads, TriangulationFillRuleNonZero);
+        // What the view controller's cache holds, and what it has asked for.
+        std::vector<bool> cached(paths.size());
+        std::vector<bool> requested(paths.size());
+        size_t maximumQueueDepth = 0;
+        size_t stalledFrames = 0;
+        double worstStallSeconds = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (size_t n = 0; n < frameCount; ++n) {
+            auto frameStart = std::chrono::steady_clock::now();
+            for (size_t ahead = 0; ahead <= lookAhead && n + ahead < frameCount; ++ahead) {
+                for (auto& glyph : frames[n + ahead]) {
+                    if (cached[glyph.outline] || requested[glyph.outline])
+                        continue;
+                    triangulationPipelineRequest(pipeline, glyph.outline, paths[glyph.outline], 0, n + ahead);
+                    requested[glyph.outline] = true;
+                }
+            }
+            maximumQueueDepth = std::max(maximumQueueDepth, triangulationPipelineGetStatistics(pipeline).queueDepth);
+
+            double stallBefore = triangulationPipelineGetStatistics(pipeline).stallSeconds;
+            for (auto& glyph : frames[n]) {
+                if (cached[glyph.outline])
+                    continue;
+                CubicTriangleMesh mesh;
+                if (triangulationPipelineTake(pipeline, glyph.outline, &mesh) != TriangulationPipelineReady)
+                    triangulationPipelineWait(pipeline, glyph.outline, &mesh);
+                destroyCubicTriangleMesh(mesh);
+                cached[glyph.outline] = true;
+            }
+            double stall = triangulationPipelineGetStatistics(pipeline).stallSeconds - stallBefore;
+            if (stall > 0)
+                ++stalledFrames;
+            worstStallSeconds = std::max(worstStallSeconds, stall);
+            std::this_thread::sleep_until(frameStart + std::chrono::duration_cast<std::chrono::steady_clock::duration>(frameDuration));
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        auto statistics = triangulationPipelineGetStatistics(pipeline);
+        destroyTriangulationPipeline(pipeline);
+
+        writer.beginObject();
+        writer.value("lookAheadFrames", lookAhead);
+        writer.value("threads", static_cast<size_t>(threads));
+        writer.value("frames", frameCount);
+        writer.value("seconds", seconds);
+        // Time the render thread spent waiting on meshes, in all and in its worst frame.
+        writer.value("stallSeconds", statistics.stallSeconds);
+        writer.value("worstFrameStallSeconds", worstStallSeconds);
+        writer.value("stalledFrames", stalledFrames);
+        writer.value("missedDeadlines", statistics.missedDeadlines);
+        writer.value("maximumQueueDepth", maximumQueueDepth);
+        writer.value("triangulated", statistics.completed);
+        writer.endObject();
+    }
+    writer.endArray();
+}
@@ -0,0 +1,145 @@
+//
+//  HullSeparationBenchmarks.cpp
+//  TriangulationBenchmark
+//
+//  Created by Litherum on 6/5/16.
+//  Copyright © 2016 Litherum. All rights reserved.
+//
+
+#include "Benchmark.h"
+
+#include "HullSeparation.h"
+#include "PathSource.h"
+
+// Separating curves' hulls on its own: over the corpus, glyph by glyph, and over big made-up paths of many glyphs
+// packed closer than they're wide, so their contours overlap everywhere. Each is done with the grid and, while there
+// are few enough curves for it to finish, by testing every pair.
+void benchmarkHullSeparation(JSONWriter& writer, const BenchmarkFixture& fixture) {
+    auto& paths = fixture.paths;
+    CubicBatch curves;
+    CurveHullSeparator separator;
+    auto separate = [&](const FlatPath& path, bool allPairs) {
+        curves.clear();
+        separator.clear();
+        collectCurves(path, curves, &separator);
+        return separator.separate(curves, allPairs);
+    };
+
+    std::vector<FlatPath> flatPaths(paths.size());
+    CGFloat sizeSum = 0;
+    for (size_t i = 0; i < paths.size(); ++i) {
+        CGPathSource(paths[i]).iterate([&](PathElement element) {
+            flatPaths[i].append(element.type, element.points);
+        });
+        auto bounds = pathBounds(paths[i]);
+        if (bounds.maxX > bounds.minX)
+            sizeSum += bounds.maxX - bounds.minX;
+    }
+    writer.beginObject("hullSeparation");
+
+    size_t glyphsWithOverlaps = 0;
+    size_t maximumSubdivisions = 0;
+    HullSeparationStats corpusStats;
+    for (auto& path : flatPaths) {
+        auto stats = separate(path, false);
+        glyphsWithOverlaps += stats.overlaps > 0;
+        maximumSubdivisions = std::max(maximumSubdivisions, stats.subdivisions);
+        corpusStats += stats;
+    }
+    Measurement grid;
+    Measurement allPairs;
+    for (unsigned i = 0; i < fixture.iterations; ++i) {
+        grid.add(timed([&] {
+            for (auto& path : flatPaths)
+                separate(path, false);
+        }));
+        allPairs.add(timed([&] {
+            for (auto& path : flatPaths)
+                separate(path, true);
+        }));
+    }
+    auto writeSeparationStats = [&](const HullSeparationStats& stats, size_t glyphCount) {
+        writer.value("curves", stats.curves);
+        writer.value("candidatePairs", stats.candidatePairs);
+        writer.value("overlaps", stats.overlaps);
+        writer.value("subdivisions", stats.subdivisions);
+        writer.value("subdivisionsPerGlyph", glyphCount ? static_cast<double>(stats.subdivisions) / glyphCount : 0.0);
+        writer.value("unresolvedOverlaps", stats.unresolvedOverlaps);
+        writer.value("passes", static_cast<size_t>(stats.passes));
+    };
+    writer.beginObject("corpus");
+    writer.value("gridSeconds", grid);
+    writer.value("allPairsSeconds", allPairs);
+    writer.value("glyphsPerSecond", paths.size() / grid.best);
+    writeSeparationStats(corpusStats, paths.size());
+    writer.value("glyphsWithOverlaps", glyphsWithOverlaps);
+    writer.value("maximumSubdivisionsPerGlyph", maximumSubdivisions);
+    writer.endObject();
+
+    // Neighboring edges. In the first, the curve's first control point lies past the line after it, though the curve
+    // itself stays clear, so it must be split until its hull does too. In the second, two curves join smoothly, so
+    // their hulls only meet at the shared point and neither may be split.
+    auto join = [&](const char* key, const CGPoint (&curve)[3], const CGPoint (&next)[3], bool nextIsCurve, bool expectOverlap) {
+        const CGPoint origin[] = { { 0, 0 } };
+        const CGPoint corner[] = { { 0, 100 } };
+        FlatPath path;
+        path.append(PathElementMoveToPoint, origin);
+        path.append(PathElementAddCurveToPoint, curve);
+        if (nextIsCurve)
+            path.append(PathElementAddCurveToPoint, next);
+        else
+            path.append(PathElementAddLineToPoint, next);
+        path.append(PathElementAddLineToPoint, corner);
+        path.append(PathElementCloseSubpath, nullptr);
+        auto stats = separate(path, false);
+        writer.beginObject(key);
+        writeSeparationStats(stats, 1);
+        writer.value("passed", (stats.overlaps > 0) == expectOverlap && !stats.unresolvedOverlaps);
+        writer.endObject();
+    };
+    writer.beginObject("joins");
+    join("controlPointCrossesNextLine", {{ 95, 80 }, { 60, 20 }, { 100, 0 }}, {{ 60, 100 }, { 60, 100 }, { 60, 100 }}, false, true);
+    join("smoothJoin", {{ 30, -40 }, { 100, -40 }, { 100, 0 }}, {{ 100, 40 }, { 70, 100 }, { 100, 100 }}, true, false);
+    writer.endObject();
+
+    // Glyphs half their average width apart, in rows of 32, reusing the corpus as often as it takes.
+    const size_t maximumAllPairsCurves = 4096;
+    CGFloat spacing = paths.empty() ? 1 : std::max(sizeSum / paths.size() / 2, CGFloat(1));
+    FlatPath combined;
+    std::vector<CGPoint> points;
+    writer.beginArray("combined");
+    for (size_t glyphCount : { 16, 128, 1024 }) {
+        if (flatPaths.empty())
+            break;
+        combined.clear();
+        for (size_t i = 0; i < glyphCount; ++i) {
+            CGFloat offsetX = (i % 32) * spacing;
+            CGFloat offsetY = (i / 32) * spacing * 2;
+            flatPaths[i % flatPaths.size()].iterate([&](PathElement element) {
+                points.assign(element.points, element.points + pathElementPointCount(element.type));
+                for (auto& point : points)
+                    point = CGPointMake(point.x + offsetX, point.y + offsetY);
+                combined.append(element.type, points.data());
+            });
+        }
+        HullSeparationStats stats;
+        Measurement combinedGrid;
+        Measurement combinedAllPairs;
+        for (unsigned i = 0; i < fixture.iterations; ++i)
+            combinedGrid.add(timed([&] { stats = separate(combined, false); }));
+        bool comparedAllPairs = stats.curves <= maximumAllPairsCurves;
+        for (unsigned i = 0; comparedAllPairs && i < fixture.iterations; ++i)
+            combinedAllPairs.add(timed([&] { separate(combined, true); }));
+        writer.beginObject();
+        writer.value("glyphs", glyphCount);
+        writer.value("gridSeconds", combinedGrid);
+        if (comparedAllPairs) {
+            writer.value("allPairsSeconds", combinedAllPairs);
+            writer.value("speedup", combinedAllPairs.best / combinedGrid.best);
+        }
+        writeSeparationStats(stats, glyphCount);
+        writer.endObject();
+    }
+    writer.endArray();
+    writer.endObject();
+}
@@ -0,0 +1,183 @@
+//
+//  HullTriangulationCheck.cpp
+//  TriangulationBenchmark
+//
+//  Created by Litherum on 6/4/16.
+//  Copyright © 2016 Litherum. All rights reserved.
+//
+
+#include "Benchmark.h"
+
+#include "CubicHull.h"
+
+#include <array>
+#include <cassert>
+#include <random>
+#include <vector>
+
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wconditional-uninitialized"
+#pragma clang diagnostic ignored "-Wshift-negative-value"
+#pragma clang diagnostic ignored "-Wshorten-64-to-32"
+#include <CGAL/Exact_predicates_inexact_constructions_kernel.h>
+#include <CGAL/Triangulation_vertex_base_with_info_2.h>
+#include <CGAL/Delaunay_triangulation_2.h>
+#pragma clang diagnostic pop
+
+typedef CGAL::Exact_predicates_inexact_constructions_kernel K;
+typedef CGAL::Triangulation_vertex_base_with_info_2<CoefficientTriple, K> Vb;
+typedef CGAL::Triangulation_face_base_2<K> Fb;
+typedef CGAL::Triangulation_data_structure_2<Vb, Fb> TDS;
+typedef CGAL::Delaunay_triangulation_2<K, TDS> Triangulation;
+
+static inline CubicVertex convertTriangulatedVertex(Triangulation::Vertex& v) {
+    auto& point = v.point();
+    auto& info = v.info();
+    return { CGPointMake(point.x(), point.y()),
+        { static_cast<float>(info.k), static_cast<float>(info.l), static_cast<float>(info.m) },
+        -1 };
+}
+
+// FIXME: This might not work if some points are duplicated.
+static inline Triangulation::Vertex_handle toInside(Triangulation::Vertex_handle initial, Triangulation::Vertex_handle v1, Triangulation::Vertex_handle v2, Triangulation::Vertex_handle v3) {
+    auto circulatorBase = initial->incident_edges();
+    auto circulator = circulatorBase;
+    do {
+        auto neighbor = circulator->first->vertex((circulator->second + 1) % 3);
+        assert(circulator->first->vertex((circulator->second + 2) % 3) == initial);
+        assert(neighbor != initial);
+        auto k = neighbor->info().k;
+        auto l = neighbor->info().l;
+        auto m = neighbor->info().m;
+        if (k * k * k - l * m > 0) {
+            ++circulator;
+            continue;
+        }
+        if (neighbor == v1 || neighbor == v2)
+            return neighbor;
+        ++circulator;
+    } while (circulator != circulatorBase);
+    return v3;
+}
+
+static inline int index(std::vector<Triangulation::Vertex_handle>& order, Triangulation::Vertex_handle test) {
+    for (size_t i = 0; i < order.size(); ++i) {
+        if (order[i] == test)
+            return static_cast<int>(i);
+    }
+    return -1;
+}
+
+// What triangulateHull() replaced, kept so verifyCubicHullTriangulation() has something to compare against.
+static std::vector<std::array<CubicVertex, 3>> triangulateWithCGAL(CubicCurve s) {
+    assert(!s.c.flip);
+
+    Triangulation t;
+    auto v0 = t.insert(Triangulation::Point(s.p0.x, s.p0.y));
+    v0->info() = { s.c.c0.k, s.c.c0.l, s.c.c0.m };
+    auto v1 = t.insert(Triangulation::Point(s.p1.x, s.p1.y));
+    v1->info() = { s.c.c1.k, s.c.c1.l, s.c.c1.m };
+    auto v2 = t.insert(Triangulation::Point(s.p2.x, s.p2.y));
+    v2->info() = { s.c.c2.k, s.c.c2.l, s.c.c2.m };
+    auto v3 = t.insert(Triangulation::Point(s.p3.x, s.p3.y));
+    v3->info() = { s.c.c3.k, s.c.c3.l, s.c.c3.m };
+    // With every point the same there are no edges for toInside() to circulate, and nothing to triangulate.
+    if (t.number_of_vertices() < 2)
+        return {};
+
+    std::vector<Triangulation::Vertex_handle> insideBorder = { v0 };
+    auto nextInside = toInside(v0, v1, v2, v3);
+    insideBorder.push_back(nextInside);
+    if (nextInside != v3) {
+        nextInside = toInside(nextInside, v1, v2, v3);
+        insideBorder.push_back(nextInside);
+        if (nextInside != v3)
+            insideBorder.push_back(v3);
+    }
+
+    std::vector<std::array<CubicVertex, 3>> result;
+    for (auto i = t.finite_faces_begin(); i != t.finite_faces_end(); ++i) {
+        auto resultV0 = convertTriangulatedVertex(*i->vertex(0));
+        auto resultV1 = convertTriangulatedVertex(*i->vertex(1));
+        auto resultV2 = convertTriangulatedVertex(*i->vertex(2));
+        resultV0.order = index(insideBorder, i->vertex(0));
+        resultV1.order = index(insideBorder, i->vertex(1));
+        resultV2.order = index(insideBorder, i->vertex(2));
+        result.push_back({ resultV0, resultV1, resultV2 });
+    }
+    return result;
+}
+
+static inline bool sameVertex(const CubicVertex& a, const CubicVertex& b, bool compareOrder) {
+    return CGPointEqualToPoint(a.point, b.point)
+        && a.coefficient.x == b.coefficient.x && a.coefficient.y == b.coefficient.y && a.coefficient.z == b.coefficient.z
+        && (!compareOrder || a.order == b.order);
+}
+
+static bool sameTriangulation(const HullTriangulation& hull, const std::vector<std::array<CubicVertex, 3>>& reference) {
+    if (hull.count != reference.size())
+        return false;
+    std::array<bool, 3> used = {{ false, false, false }};
+    for (unsigned i = 0; i < hull.count; ++i) {
+        bool found = false;
+        for (unsigned j = 0; j < reference.size() && !found; ++j) {
+            for (unsigned rotation = 0; rotation < 3 && !found && !used[j]; ++rotation) {
+                found = sameVertex(hull.triangles[i][0], reference[j][rotation], true)
+                    && sameVertex(hull.triangles[i][1], reference[j][(rotation + 1) % 3], true)
+                    && sameVertex(hull.triangles[i][2], reference[j][(rotation + 2) % 3], true);
+                if (found)
+                    used[j] = true;
+            }
+        }
+        if (!found)
+            return false;
+    }
+    return true;
+}
+
+unsigned verifyCubicHullTriangulation(unsigned count, unsigned seed, unsigned* ambiguousCases) {
+    std::mt19937 generator(seed);
+    std::uniform_real_distribution<CGFloat> coordinate(0, 100);
+    std::uniform_int_distribution<int> gridCoordinate(0, 4);
+    std::uniform_real_distribution<CGFloat> coefficient(-1, 1);
+    unsigned mismatches = 0;
+    unsigned ambiguities = 0;
+    // Where CGAL's answer depends on its internals, any of the answers it could have given will do, but it still has to
+    // be one of them exactly.
+    auto check = [&](const CubicCurve& curve) {
+        bool ambiguous = false;
+        auto reference = triangulateWithCGAL(curve);
+        bool matched = sameTriangulation(triangulateHull(curve, &ambiguous), reference);
+        if (ambiguous) {
+            ++ambiguities;
+            for (unsigned alternative = 1; alternative < HullAlternativeCount && !matched; ++alternative)
+                matched = sameTriangulation(triangulateHull(curve, nullptr, alternative), reference);
+        }
+        if (!matched)
+            ++mismatches;
+    };
+    for (unsigned i = 0; i < count; ++i) {
+        // Every other cubic is snapped to a small grid, so duplicate, collinear and cocircular points come up a lot.
+        std::array<CGPoint, 4> p;
+        for (auto& point : p) {
+            if (i % 2)
+                point = CGPointMake(gridCoordinate(generator), gridCoordinate(generator));
+            else
+                point = CGPointMake(coordinate(generator), coordinate(generator));
+        }
+
+        std::array<CubicCurve, 2> curves;
+        unsigned curveCount = classifyCubic(p[0], p[1], p[2], p[3], curves);
+        for (unsigned j = 0; j < curveCount; ++j)
+            check(curves[j]);
+
+        // Arbitrary coefficients exercise the inside border walk more thoroughly than real curves do.
+        CubicCurve arbitrary = { p[0], p[1], p[2], p[3], { {}, {}, {}, {}, false } };
+        for (auto* triple : { &arbitrary.c.c0, &arbitrary.c.c1, &arbitrary.c.c2, &arbitrary.c.c3 })
+            *triple = { coefficient(generator), coefficient(generator), coefficient(generator) };
+        check(arbitrary);
+    }
+    if (ambiguousCases)
+        *ambiguousCases = ambiguities;
+    return mismatches;
+}
@@ -0,0 +1,79 @@
+//
+//  CoreGraphics.cpp
+//  TriangulationBenchmark
+//
+//  Created by Litherum on 5/18/16.
+//  Copyright © 2016 Litherum. All rights reserved.
+//
+
+#include <CoreGraphics/CoreGraphics.h>
+
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <vector>
+
+struct CGPath {
+    struct Element {
+        CGPathElementType type;
+        std::array<CGPoint, 3> points;
+    };
+
+    std::atomic<unsigned> referenceCount { 1 };
+    std::vector<Element> elements;
+};
+
+CFTypeRef CFRetain(CFTypeRef object) {
+    return CGPathRetain(static_cast<CGPathRef>(object));
+}
+
+void CFRelease(CFTypeRef object) {
+    CGPathRelease(static_cast<CGPathRef>(object));
+}
+
+CGMutablePathRef CGPathCreateMutable() {
+    return new CGPath;
+}
+
+CGPathRef CGPathRetain(CGPathRef path) {
+    if (path)
+        ++const_cast<CGPath*>(path)->referenceCount;
+    return path;
+}
+
+void CGPathRelease(CGPathRef path) {
+    if (path && !--const_cast<CGPath*>(path)->referenceCount)
+        delete path;
+}
+
+void CGPathMoveToPoint(CGMutablePathRef path, const CGAffineTransform* m, CGFloat x, CGFloat y) {
+    assert(!m);
+    path->elements.push_back({ kCGPathElementMoveToPoint, {{ CGPointMake(x, y) }} });
+}
+
+void CGPathAddLineToPoint(CGMutablePathRef path, const CGAffineTransform* m, CGFloat x, CGFloat y) {
+    assert(!m);
+    path->elements.push_back({ kCGPathElementAddLineToPoint, {{ CGPointMake(x, y) }} });
+}
+
+void CGPathAddQuadCurveToPoint(CGMutablePathRef path, const CGAffineTransform* m, CGFloat cpx, CGFloat cpy, CGFloat x, CGFloat y) {
+    assert(!m);
+    path->elements.push_back({ kCGPathElementAddQuadCurveToPoint, {{ CGPointMake(cpx, cpy), CGPointMake(x, y) }} });
+}
+
+void CGPathAddCurveToPoint(CGMutablePathRef path, const CGAffineTransform* m, CGFloat cp1x, CGFloat cp1y, CGFloat cp2x, CGFloat cp2y, CGFloat x, CGFloat y) {
+    assert(!m);
+    path->elements.push_back({ kCGPathElementAddCurveToPoint, {{ CGPointMake(cp1x, cp1y), CGPointMake(cp2x, cp2y), CGPointMake(x, y) }} });
+}
+
+void CGPathCloseSubpath(CGMutablePathRef path) {
+    path->elements.push_back({ kCGPathElementCloseSubpath, {} });
+}
+
+void CGPathApply(CGPathRef path, void* info, CGPathApplierFunction function) {
+    for (auto& element : path->elements) {
+        auto points = element.points;
+        CGPathElement result = { element.type, points.data() };
+        function(info, &result);
+    }
+}
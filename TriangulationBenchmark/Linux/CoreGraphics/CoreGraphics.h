@@ -0,0 +1,81 @@
+//
+//  CoreGraphics.h
+//  TriangulationBenchmark
+//
+//  Created by Litherum on 5/18/16.
+//  Copyright © 2016 Litherum. All rights reserved.
+//
+
+#ifndef CoreGraphics_h
+#define CoreGraphics_h
+
+// Just enough of CoreGraphics for the triangulator to build on Linux. Paths are the only CF type, so CFRetain()
+// and CFRelease() assume they're given one.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef double CGFloat;
+
+typedef struct CGPoint {
+    CGFloat x;
+    CGFloat y;
+} CGPoint;
+
+static inline CGPoint CGPointMake(CGFloat x, CGFloat y) {
+    CGPoint result = { x, y };
+    return result;
+}
+
+static inline bool CGPointEqualToPoint(CGPoint a, CGPoint b) {
+    return a.x == b.x && a.y == b.y;
+}
+
+static const CGPoint CGPointZero = { 0, 0 };
+
+typedef uint16_t CGGlyph;
+
+typedef const void* CFTypeRef;
+CFTypeRef CFRetain(CFTypeRef);
+void CFRelease(CFTypeRef);
+
+typedef struct CGAffineTransform CGAffineTransform;
+typedef const struct CGPath* CGPathRef;
+typedef struct CGPath* CGMutablePathRef;
+
+typedef enum CGPathElementType {
+    kCGPathElementMoveToPoint,
+    kCGPathElementAddLineToPoint,
+    kCGPathElementAddQuadCurveToPoint,
+    kCGPathElementAddCurveToPoint,
+    kCGPathElementCloseSubpath
+} CGPathElementType;
+
+typedef struct CGPathElement {
+    CGPathElementType type;
+    CGPoint* points;
+} CGPathElement;
+
+typedef void (*CGPathApplierFunction)(void* info, const CGPathElement* element);
+
+// Transforms aren't supported; m must be NULL.
+CGMutablePathRef CGPathCreateMutable(void);
+CGPathRef CGPathRetain(CGPathRef);
+void CGPathRelease(CGPathRef);
+void CGPathMoveToPoint(CGMutablePathRef, const CGAffineTransform* m, CGFloat x, CGFloat y);
+void CGPathAddLineToPoint(CGMutablePathRef, const CGAffineTransform* m, CGFloat x, CGFloat y);
+void CGPathAddQuadCurveToPoint(CGMutablePathRef, const CGAffineTransform* m, CGFloat cpx, CGFloat cpy, CGFloat x, CGFloat y);
+void CGPathAddCurveToPoint(CGMutablePathRef, const CGAffineTransform* m, CGFloat cp1x, CGFloat cp1y, CGFloat cp2x, CGFloat cp2y, CGFloat x, CGFloat y);
+void CGPathCloseSubpath(CGMutablePathRef);
+void CGPathApply(CGPathRef, void* info, CGPathApplierFunction);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CoreGraphics_h */
@@ -0,0 +1,18 @@
+//
+//  simd.h
+//  TriangulationBenchmark
+//
+//  Created by Litherum on 5/18/16.
+//  Copyright © 2016 Litherum. All rights reserved.
+//
+
+#ifndef simd_h
+#define simd_h
+
+// The vector types the triangulator uses, as the same clang extended vectors Apple's simd.h defines them as.
+
+typedef float vector_float2 __attribute__((ext_vector_type(2)));
+typedef float vector_float3 __attribute__((ext_vector_type(3)));
+typedef float vector_float4 __attribute__((ext_vector_type(4)));
+
+#endif /* simd_h */
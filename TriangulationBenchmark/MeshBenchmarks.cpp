@@ -0,0 +1,122 @@
+//
+//  MeshBenchmarks.cpp
+//  TriangulationBenchmark
+//
+//  Created by Litherum on 6/5/16.
+//  Copyright © 2016 Litherum. All rights reserved.
+//
+
+#include "Benchmark.h"
+
+#include "IndexedMesh.h"
+
+void benchmarkMeshFormats(JSONWriter& writer, const BenchmarkFixture& fixture, std::vector<CubicTriangleMesh>& meshes, std::vector<CompactCubicTriangleMesh>& compactMeshes) {
+    auto& paths = fixture.paths;
+    // What indexing saves, per glyph. Every soup vertex is a float2 position and a float4 coefficient.
+    std::vector<IndexedCubicTriangleMesh> indexedMeshes(meshes.size());
+    Measurement indexing;
+    for (unsigned i = 0; i < fixture.iterations; ++i) {
+        indexing.add(timed([&] { createIndexedCubicTriangleMeshes(meshes.data(), meshes.size(), 0, indexedMeshes.data()); }));
+        if (i + 1 == fixture.iterations)
+            break;
+        for (auto& mesh : indexedMeshes)
+            destroyIndexedCubicTriangleMesh(mesh);
+    }
+    size_t soupVertices = 0;
+    size_t indexedVertices = 0;
+    size_t indexCount = 0;
+    double missRatioSum = 0;
+    size_t indexingFailures = 0;
+    compactMeshes.resize(meshes.size());
+    CompactMeshError compactError;
+    double maximumPositionErrorEm = 0;
+    double maximumMismatchDistanceEm = 0;
+    const size_t vertexBytes = sizeof(vector_float2) + sizeof(vector_float4);
+    for (size_t i = 0; i < meshes.size(); ++i) {
+        soupVertices += meshes[i].vertexCount;
+        if (meshes[i].vertexCount && !indexedMeshes[i].indexCount)
+            ++indexingFailures;
+        indexedVertices += indexedMeshes[i].vertexCount;
+        indexCount += indexedMeshes[i].indexCount;
+        missRatioSum += averageCacheMissRatio(indexedMeshes[i].indices, indexedMeshes[i].indexCount, indexedMeshes[i].vertexCount, 16) * (indexedMeshes[i].indexCount / 3);
+
+        // The corpus doesn't record units per em, so assume TrueType's usual 2048. Without em sizes, 1/16 path unit.
+        CGFloat emSize = fixture.emSize(i, 0);
+        auto& compactMesh = compactMeshes[i];
+        createCompactCubicTriangleMesh(&indexedMeshes[i], emSize ? 2048 / emSize : 16, &compactMesh);
+        auto error = measureCompactMeshError(indexedMeshes[i], compactMesh, 8);
+        compactError.maximumPositionError = std::max(compactError.maximumPositionError, error.maximumPositionError);
+        compactError.samples += error.samples;
+        compactError.signMismatches += error.signMismatches;
+        compactError.maximumMismatchDistance = std::max(compactError.maximumMismatchDistance, error.maximumMismatchDistance);
+        if (emSize) {
+            maximumPositionErrorEm = std::max(maximumPositionErrorEm, error.maximumPositionError / emSize);
+            maximumMismatchDistanceEm = std::max(maximumMismatchDistanceEm, error.maximumMismatchDistance / emSize);
+        }
+        destroyCubicTriangleMesh(meshes[i]);
+        destroyIndexedCubicTriangleMesh(indexedMeshes[i]);
+    }
+    size_t soupBytes = soupVertices * vertexBytes;
+    size_t indexedBytes = indexedVertices * vertexBytes + indexCount * sizeof(uint16_t);
+    writer.beginObject("indexed");
+    writer.value("seconds", indexing);
+    writer.value("soupVerticesPerGlyph", static_cast<double>(soupVertices) / paths.size());
+    writer.value("indexedVerticesPerGlyph", static_cast<double>(indexedVertices) / paths.size());
+    writer.value("soupBytesPerGlyph", static_cast<double>(soupBytes) / paths.size());
+    writer.value("indexedBytesPerGlyph", static_cast<double>(indexedBytes) / paths.size());
+    writer.value("byteReduction", soupBytes ? 1 - static_cast<double>(indexedBytes) / soupBytes : 0.0);
+    // For a 16 entry FIFO cache, weighted by triangle count. An unindexed soup is always 3.
+    writer.value("averageCacheMissRatio", indexCount ? missRatioSum / (indexCount / 3) : 0.0);
+    writer.value("failures", indexingFailures);
+    writer.endObject();
+
+    // The same meshes at 12 bytes per vertex, and how much the quantization moves the edges. Mismatches are samples
+    // where the k^3 - l*m <= 0 test flips; the distances say how close to the curve they all are.
+    size_t compactBytes = indexedVertices * (2 * sizeof(int16_t) + 4 * sizeof(uint16_t)) + indexCount * sizeof(uint16_t);
+    writer.beginObject("compact");
+    writer.value("bytesPerGlyph", static_cast<double>(compactBytes) / paths.size());
+    writer.value("byteReduction", soupBytes ? 1 - static_cast<double>(compactBytes) / soupBytes : 0.0);
+    writer.value("maximumPositionError", compactError.maximumPositionError);
+    writer.value("samples", compactError.samples);
+    writer.value("signMismatches", compactError.signMismatches);
+    writer.value("maximumMismatchDistance", compactError.maximumMismatchDistance);
+    if (!fixture.emSizes.empty()) {
+        writer.value("maximumPositionErrorEm", maximumPositionErrorEm);
+        writer.value("maximumMismatchDistanceEm", maximumMismatchDistanceEm);
+    }
+    writer.endObject();
+}
+
+void benchmarkLOD(JSONWriter& writer, const BenchmarkFixture& fixture) {
+    auto& paths = fixture.paths;
+    if (fixture.emSizes.empty())
+        return;
+    std::vector<CubicTriangleMesh> lodMeshes(paths.size() * GlyphLODLevelCount);
+    Measurement lod;
+    for (unsigned i = 0; i < fixture.iterations; ++i) {
+        lod.add(timed([&] { triangulateBatchWithLOD(paths.data(), fixture.emSizes.data(), paths.size(), 0.25, 0, TriangulationFillRuleNonZero, lodMeshes.data()); }));
+        if (i + 1 == fixture.iterations)
+            break;
+        for (auto& mesh : lodMeshes)
+            destroyCubicTriangleMesh(mesh);
+    }
+    writer.beginObject("lod");
+    writer.value("seconds", lod);
+    writer.beginArray("levels");
+    for (unsigned level = 0; level < GlyphLODLevelCount; ++level) {
+        size_t vertexCount = 0;
+        for (size_t i = 0; i < paths.size(); ++i)
+            vertexCount += lodMeshes[i * GlyphLODLevelCount + level].vertexCount;
+        writer.beginObject();
+        // The last level, the full mesh, has no limit.
+        if (level + 1 < GlyphLODLevelCount)
+            writer.value("maximumPixelsPerEm", static_cast<double>(glyphLODMaximumPixelsPerEm(level)));
+        writer.value("trianglesPerGlyph", static_cast<double>(vertexCount) / 3 / paths.size());
+        writer.value("verticesPerGlyph", static_cast<double>(vertexCount) / paths.size());
+        writer.endObject();
+    }
+    writer.endArray();
+    writer.endObject();
+    for (auto& mesh : lodMeshes)
+        destroyCubicTriangleMesh(mesh);
+}
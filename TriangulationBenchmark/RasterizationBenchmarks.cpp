@@ -0,0 +1,255 @@
+//
+//  RasterizationBenchmarks.cpp
+//  TriangulationBenchmark
+//
+//  Created by Litherum on 6/5/16.
+//  Copyright © 2016 Litherum. All rights reserved.
+//
+
+#include "Benchmark.h"
+
+#include <cmath>
+
+#include "BandedCurves.h"
+#include "DistanceField.h"
+#include "SoftwareRasterizer.h"
+
+// Lays every mesh out in a grid at about 32 pixels per em and draws them all with SoftwareRasterizer, aliased and
+// antialiased, on one thread and on every thread. The checksums must agree across thread counts.
+void benchmarkRasterization(JSONWriter& writer, const BenchmarkFixture& fixture, const std::vector<CubicTriangleMesh>& meshes) {
+    const size_t imageSize = 2048;
+    const float cellSize = 40;
+    const size_t cellsPerRow = static_cast<size_t>(imageSize / cellSize);
+    std::vector<vector_float2> positions;
+    std::vector<vector_float4> coefficients;
+    for (size_t i = 0; i < meshes.size(); ++i) {
+        auto& mesh = meshes[i];
+        if (!mesh.vertexCount)
+            continue;
+        // Without em sizes, take path units as pixels.
+        float scale = static_cast<float>(32 / fixture.emSize(i, 32));
+        float minX = std::numeric_limits<float>::infinity();
+        float minY = std::numeric_limits<float>::infinity();
+        for (size_t j = 0; j < mesh.vertexCount; ++j) {
+            minX = std::min(minX, mesh.positions[j].x);
+            minY = std::min(minY, mesh.positions[j].y);
+        }
+        // Past the last cell, wrap around and draw over the first ones.
+        size_t cell = i % (cellsPerRow * cellsPerRow);
+        float cellX = (cell % cellsPerRow) * cellSize + 4;
+        float cellY = (cell / cellsPerRow) * cellSize + 4;
+        for (size_t j = 0; j < mesh.vertexCount; ++j) {
+            positions.push_back(vector_float2 { (mesh.positions[j].x - minX) * scale + cellX, (mesh.positions[j].y - minY) * scale + cellY });
+            coefficients.push_back(mesh.coefficients[j]);
+        }
+    }
+
+    std::vector<uint8_t> pixels(imageSize * imageSize);
+    auto checksum = [&] {
+        uint32_t hash = 2166136261u;
+        for (auto pixel : pixels)
+            hash = (hash ^ pixel) * 16777619u;
+        return static_cast<size_t>(hash);
+    };
+    writer.beginArray("rasterize");
+    for (bool antialias : { false, true }) {
+        size_t checksums[2] = { 0, 0 };
+        for (unsigned run = 0; run < 2; ++run) {
+            unsigned threads = run ? fixture.hardwareThreads : 1;
+            Measurement rasterization;
+            RasterizerStats stats;
+            for (unsigned i = 0; i < fixture.iterations; ++i) {
+                std::fill(pixels.begin(), pixels.end(), 0);
+                rasterization.add(timed([&] { stats = rasterizeCubicTrianglesWithStats(positions.data(), coefficients.data(), nullptr, positions.size(), antialias, threads, pixels.data(), imageSize, imageSize, imageSize); }));
+            }
+            checksums[run] = checksum();
+            writer.beginObject();
+            writer.value("antialias", antialias);
+            writer.value("threads", static_cast<size_t>(threads));
+            writer.value("seconds", rasterization);
+            writer.value("trianglesPerSecond", stats.triangles / rasterization.best);
+            writer.value("megapixelsPerSecond", imageSize * imageSize / rasterization.best / 1e6);
+            writer.value("triangles", stats.triangles);
+            writer.value("skippedTriangles", stats.skippedTriangles);
+            writer.value("binnedTriangles", stats.binnedTriangles);
+            writer.value("testedPixels", stats.testedPixels);
+            writer.value("coveredPixels", stats.coveredPixels);
+            writer.value("checksum", checksums[run]);
+            if (run)
+                writer.value("matchesOneThread", checksums[0] == checksums[1]);
+            writer.endObject();
+        }
+    }
+    writer.endArray();
+}
+
+// Band-indexed curve data for the whole corpus, against triangulating it on one thread, and how the two agree: up to
+// 256 glyphs, spread over the corpus, are drawn at 32 and 64 pixels per em by SoftwareRasterizer from their meshes and
+// sampled with bandedCurveCoverage() at the same pixel centers. Without em sizes, the corpus is assumed to be in 2048
+// units per em.
+void benchmarkBandedCurves(JSONWriter& writer, const BenchmarkFixture& fixture, const std::vector<CubicTriangleMesh>& meshes, double triangulationSeconds) {
+    auto& paths = fixture.paths;
+    // Cubics stay within 1/1024 em of the smallest em.
+    CGFloat emSize = fixture.emSizes.empty() ? 2048 : *std::min_element(fixture.emSizes.begin(), fixture.emSizes.end());
+    BandedCurveOptions options;
+    options.cubicTolerance = emSize / 1024;
+    options.maximumBandCount = 16;
+    writer.beginObject("bandedCurves");
+
+    Measurement preparation;
+    BandedCurveData data;
+    for (unsigned i = 0; i < fixture.iterations; ++i) {
+        preparation.add(timed([&] { createBandedCurveData(paths.data(), paths.size(), options, &data); }));
+        if (i + 1 < fixture.iterations)
+            destroyBandedCurveData(data);
+    }
+    size_t soupVertices = 0;
+    for (auto& mesh : meshes)
+        soupVertices += mesh.vertexCount;
+    size_t bytes = bandedCurveDataByteCount(&data);
+    size_t curves = 0;
+    for (size_t i = 0; i < data.glyphCount; ++i) {
+        auto& glyph = data.glyphs[i];
+        for (unsigned j = 0; j < glyph.horizontalBandCount + glyph.verticalBandCount; ++j)
+            curves += data.bands[glyph.firstBand + j].curveCount;
+    }
+    writer.value("seconds", preparation);
+    writer.value("glyphsPerSecond", paths.size() / preparation.best);
+    writer.value("speedupOverTriangulation", triangulationSeconds / preparation.best);
+    writer.value("bytesPerGlyph", static_cast<double>(bytes) / paths.size());
+    writer.value("texelsPerGlyph", static_cast<double>(data.curveTexelCount) / paths.size());
+    writer.value("averageCurvesPerBand", data.bandCount ? static_cast<double>(curves) / data.bandCount : 0.0);
+    writer.value("soupBytesPerGlyph", static_cast<double>(soupVertices * (sizeof(vector_float2) + sizeof(vector_float4))) / paths.size());
+
+    const size_t sampleCount = 256;
+    size_t stride = std::max<size_t>(paths.size() / sampleCount, 1);
+    std::vector<vector_float2> positions;
+    std::vector<uint8_t> pixels;
+    writer.beginArray("coverage");
+    for (CGFloat pixelsPerEm : { 32, 64 }) {
+        size_t sampledPixels = 0;
+        size_t coveredPixels = 0;
+        size_t mismatches = 0;
+        for (size_t i = 0; i < paths.size(); i += stride) {
+            auto& mesh = meshes[i];
+            auto& glyph = data.glyphs[i];
+            if (!mesh.vertexCount || !(glyph.minX <= glyph.maxX))
+                continue;
+            float scale = static_cast<float>(pixelsPerEm / fixture.emSize(i, 2048));
+            // A pixel of margin all around.
+            size_t width = static_cast<size_t>(std::ceil((glyph.maxX - glyph.minX) * scale)) + 2;
+            size_t height = static_cast<size_t>(std::ceil((glyph.maxY - glyph.minY) * scale)) + 2;
+            if (width * height > 1 << 20)
+                continue;
+            positions.resize(mesh.vertexCount);
+            for (size_t j = 0; j < mesh.vertexCount; ++j)
+                positions[j] = vector_float2 { (mesh.positions[j].x - glyph.minX) * scale + 1, (mesh.positions[j].y - glyph.minY) * scale + 1 };
+            pixels.assign(width * height, 0);
+            rasterizeCubicTriangles(positions.data(), mesh.coefficients, nullptr, mesh.vertexCount, false, 1, pixels.data(), width, height, width);
+            for (size_t y = 0; y < height; ++y) {
+                for (size_t x = 0; x < width; ++x) {
+                    float pathX = (x + 0.5f - 1) / scale + glyph.minX;
+                    float pathY = (y + 0.5f - 1) / scale + glyph.minY;
+                    bool covered = bandedCurveCoverage(&data, i, pathX, pathY, scale) >= 0.5f;
+                    coveredPixels += covered;
+                    mismatches += covered != (pixels[y * width + x] != 0);
+                }
+            }
+            sampledPixels += width * height;
+        }
+        writer.beginObject();
+        writer.value("pixelsPerEm", static_cast<double>(pixelsPerEm));
+        writer.value("sampledPixels", sampledPixels);
+        writer.value("coveredPixels", coveredPixels);
+        writer.value("mismatchedPixels", mismatches);
+        writer.value("mismatchRatio", sampledPixels ? static_cast<double>(mismatches) / sampledPixels : 0.0);
+        writer.endObject();
+    }
+    writer.endArray();
+    destroyBandedCurveData(data);
+    writer.endObject();
+}
+
+// Distance fields at 32 pixels per em, one per glyph, against the bitmaps an atlas keeps per size and per quarter-pixel
+// subpixel position (see atlasRequests() in AtlasBenchmarks.cpp). Accuracy is measured on a spread of glyphs, since it
+// checks every output pixel against every segment.
+void benchmarkDistanceFields(JSONWriter& writer, const BenchmarkFixture& fixture) {
+    auto& paths = fixture.paths;
+    const CGFloat pixelsPerEm = 32;
+    const CGFloat range = 4;
+    const CGFloat renderSizes[] = { 16, 32, 64, 128 };
+    const size_t measuredGlyphs = 256;
+    // Without em sizes, take path units as pixels.
+    std::vector<CGFloat> sizes = fixture.emSizes.empty() ? std::vector<CGFloat>(paths.size(), pixelsPerEm) : fixture.emSizes;
+    // Zeroed, so destroying them before the first run is harmless.
+    std::vector<GlyphDistanceField> fields(paths.size(), GlyphDistanceField());
+
+    writer.beginObject("distanceField");
+    writer.value("pixelsPerEm", pixelsPerEm);
+    writer.value("range", range);
+    writer.beginArray("bitmapBytesPerGlyph");
+    for (auto renderSize : renderSizes) {
+        size_t bytes = 0;
+        for (size_t i = 0; i < paths.size(); ++i) {
+            auto bounds = pathBounds(paths[i]);
+            if (bounds.isEmpty())
+                continue;
+            CGFloat scale = renderSize / sizes[i];
+            // Every subpixel position can add a column and a row.
+            bytes += 16 * static_cast<size_t>((std::ceil((bounds.maxX - bounds.minX) * scale) + 1) * (std::ceil((bounds.maxY - bounds.minY) * scale) + 1));
+        }
+        writer.beginObject();
+        writer.value("pixelsPerEm", renderSize);
+        writer.value("bytes", static_cast<double>(bytes) / paths.size());
+        writer.endObject();
+    }
+    writer.endArray();
+
+    writer.beginArray("types");
+    for (auto type : { DistanceFieldTypeSingle, DistanceFieldTypeMulti }) {
+        writer.beginObject();
+        writer.value("type", type == DistanceFieldTypeMulti ? "multi" : "single");
+        writer.beginArray("generate");
+        for (unsigned threads : { 1u, fixture.hardwareThreads }) {
+            Measurement generation;
+            for (unsigned i = 0; i < fixture.iterations; ++i) {
+                for (auto& field : fields)
+                    destroyGlyphDistanceField(field);
+                generation.add(timed([&] { createGlyphDistanceFields(paths.data(), sizes.data(), paths.size(), type, pixelsPerEm, range, threads, fields.data()); }));
+            }
+            writer.beginObject();
+            writer.value("threads", static_cast<size_t>(threads));
+            writer.value("seconds", generation);
+            writer.value("glyphsPerSecond", paths.size() / generation.best);
+            writer.endObject();
+        }
+        writer.endArray();
+
+        size_t bytes = 0;
+        for (auto& field : fields)
+            bytes += static_cast<size_t>(field.width) * field.height * field.channelCount;
+        writer.value("bytesPerGlyph", static_cast<double>(bytes) / paths.size());
+        writer.beginArray("accuracy");
+        for (auto renderSize : renderSizes) {
+            DistanceFieldError total;
+            size_t stride = std::max<size_t>(paths.size() / measuredGlyphs, 1);
+            for (size_t i = 0; i < paths.size(); i += stride) {
+                auto error = measureDistanceFieldError(paths[i], fields[i], renderSize / sizes[i]);
+                total.samples += error.samples;
+                total.mismatches += error.mismatches;
+                total.maximumMismatchDistance = std::max(total.maximumMismatchDistance, error.maximumMismatchDistance);
+            }
+            writer.beginObject();
+            writer.value("pixelsPerEm", renderSize);
+            writer.value("mismatchRatio", total.samples ? static_cast<double>(total.mismatches) / total.samples : 0.0);
+            writer.value("maximumMismatchDistance", total.maximumMismatchDistance);
+            writer.endObject();
+        }
+        writer.endArray();
+        writer.endObject();
+    }
+    writer.endArray();
+    writer.endObject();
+    for (auto& field : fields)
+        destroyGlyphDistanceField(field);
+}
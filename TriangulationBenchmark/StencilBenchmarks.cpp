@@ -0,0 +1,249 @@
+//
+//  StencilBenchmarks.cpp
+//  TriangulationBenchmark
+//
+//  Created by Litherum on 6/5/16.
+//  Copyright © 2016 Litherum. All rights reserved.
+//
+
+#include "Benchmark.h"
+
+#include "CurveFlattener.h"
+#include "PathSource.h"
+#include "WindingReference.h"
+
+// What NaiveStencilViewController did before CurveFlattener: every curve cut into 10 segments into a new CGPath, which
+// is then walked again to fan its lines into a growing array.
+static std::vector<float> fixedStencilFan(CGPathRef path) {
+    const unsigned definition = 10;
+    auto lerp = [](CGFloat t, CGPoint a, CGPoint b) {
+        return CGPointMake(t * b.x + (1 - t) * a.x, t * b.y + (1 - t) * a.y);
+    };
+    CGMutablePathRef approximated = CGPathCreateMutable();
+    CGPoint current = CGPointZero;
+    CGPoint subpathBegin = CGPointZero;
+    CGPathSource(path).iterate([&](PathElement element) {
+        switch (element.type) {
+        case PathElementMoveToPoint:
+            CGPathMoveToPoint(approximated, nullptr, element.points[0].x, element.points[0].y);
+            current = subpathBegin = element.points[0];
+            break;
+        case PathElementAddLineToPoint:
+            CGPathAddLineToPoint(approximated, nullptr, element.points[0].x, element.points[0].y);
+            current = element.points[0];
+            break;
+        case PathElementAddQuadCurveToPoint:
+            for (unsigned i = 1; i <= definition; ++i) {
+                CGFloat t = static_cast<CGFloat>(i) / definition;
+                auto p = lerp(t, lerp(t, current, element.points[0]), lerp(t, element.points[0], element.points[1]));
+                CGPathAddLineToPoint(approximated, nullptr, p.x, p.y);
+            }
+            current = element.points[1];
+            break;
+        case PathElementAddCurveToPoint:
+            for (unsigned i = 1; i <= definition; ++i) {
+                CGFloat t = static_cast<CGFloat>(i) / definition;
+                auto ab = lerp(t, current, element.points[0]);
+                auto bc = lerp(t, element.points[0], element.points[1]);
+                auto cd = lerp(t, element.points[1], element.points[2]);
+                auto p = lerp(t, lerp(t, ab, bc), lerp(t, bc, cd));
+                CGPathAddLineToPoint(approximated, nullptr, p.x, p.y);
+            }
+            current = element.points[2];
+            break;
+        case PathElementCloseSubpath:
+            CGPathAddLineToPoint(approximated, nullptr, subpathBegin.x, subpathBegin.y);
+            current = subpathBegin;
+            break;
+        }
+    });
+
+    std::vector<float> result;
+    bool hasPrevious = false;
+    CGPoint previous = CGPointZero;
+    CGPathSource(approximated).iterate([&](PathElement element) {
+        if (element.type == PathElementMoveToPoint) {
+            previous = element.points[0];
+            hasPrevious = true;
+        } else if (element.type == PathElementAddLineToPoint) {
+            if (hasPrevious) {
+                float triangle[] = { 0, 0, static_cast<float>(previous.x), static_cast<float>(previous.y), static_cast<float>(element.points[0].x), static_cast<float>(element.points[0].y) };
+                result.insert(result.end(), triangle, triangle + 6);
+            }
+            previous = element.points[0];
+        }
+    });
+    CGPathRelease(approximated);
+    return result;
+}
+
+// Stencil fan geometry from fixedStencilFan(), against CurveFlattener at a fifth of a pixel at several sizes. Without em
+// sizes, the corpus is assumed to be in 2048 units per em.
+void benchmarkFlattening(JSONWriter& writer, const BenchmarkFixture& fixture) {
+    auto& paths = fixture.paths;
+    const CGFloat pixelTolerance = 0.2;
+    writer.beginObject("flattening");
+
+    Measurement fixed;
+    size_t fixedVertices = 0;
+    for (unsigned i = 0; i < fixture.iterations; ++i) {
+        fixedVertices = 0;
+        fixed.add(timed([&] {
+            for (auto path : paths)
+                fixedVertices += fixedStencilFan(path).size() / 2;
+        }));
+    }
+    writer.beginObject("fixed10");
+    writer.value("seconds", fixed);
+    writer.value("glyphsPerSecond", paths.size() / fixed.best);
+    writer.value("verticesPerGlyph", static_cast<double>(fixedVertices) / paths.size());
+    writer.endObject();
+
+    std::vector<float> vertices;
+    auto flatten = [&](const char* key, CGFloat pixelsPerEm, unsigned fixedSegmentCount) {
+        Measurement measurement;
+        size_t vertexCount = 0;
+        for (unsigned i = 0; i < fixture.iterations; ++i) {
+            vertexCount = 0;
+            measurement.add(timed([&] {
+                for (size_t j = 0; j < paths.size(); ++j) {
+                    CGFloat tolerance = pixelTolerance * fixture.emSize(j, 2048) / pixelsPerEm;
+                    size_t count = stencilFanVertexCount(paths[j], tolerance, fixedSegmentCount);
+                    vertices.resize(std::max(vertices.size(), count * 2));
+                    writeStencilFan(paths[j], tolerance, fixedSegmentCount, vertices.data());
+                    vertexCount += count;
+                }
+            }));
+        }
+        writer.beginObject(key);
+        if (!fixedSegmentCount)
+            writer.value("pixelsPerEm", static_cast<double>(pixelsPerEm));
+        writer.value("seconds", measurement);
+        writer.value("glyphsPerSecond", paths.size() / measurement.best);
+        writer.value("verticesPerGlyph", static_cast<double>(vertexCount) / paths.size());
+        writer.value("vertexRatio", fixedVertices ? static_cast<double>(vertexCount) / fixedVertices : 0.0);
+        writer.value("speedup", fixed.best / measurement.best);
+        writer.endObject();
+    };
+    // The same segments as fixed10, but without the intermediate path; closing edges that go nowhere are dropped.
+    flatten("fixed10Flattener", 1, 10);
+    writer.beginArray("adaptive");
+    for (CGFloat pixelsPerEm : { 16, 32, 64, 128, 512 })
+        flatten(nullptr, pixelsPerEm, 0);
+    writer.endArray();
+    writer.endObject();
+}
+
+// The stencil fan mesh, which fans the inner border instead of triangulating it, against triangulating it for Loop-Blinn
+// and against flattening at a fifth of a pixel at 32 pixels per em for NaiveStencil. Triangles are what the GPU draws,
+// so they count both passes' worth of geometry. Coverage is checked against the path's own winding number over a grid
+// on each of a spread of glyphs; Loop-Blinn meshes are filled directly instead, so they aren't checked.
+void benchmarkStencilFan(JSONWriter& writer, const BenchmarkFixture& fixture) {
+    auto& paths = fixture.paths;
+    const CGFloat pixelTolerance = 0.2;
+    const CGFloat pixelsPerEm = 32;
+    const size_t measuredGlyphs = 256;
+    const unsigned gridSize = 64;
+    writer.beginObject("stencilFan");
+
+    std::vector<CubicTriangleMesh> meshes(paths.size());
+    Measurement loopBlinnBuild;
+    double loopBlinnTriangles = 0;
+    auto build = [&](const char* key, const TriangulationOptions& options, Measurement& measurement, double& triangles) {
+        for (unsigned i = 0; i < fixture.iterations; ++i) {
+            measurement.add(timed([&] {
+                for (size_t j = 0; j < paths.size(); ++j)
+                    meshes[j] = createCubicTriangleMesh(paths[j], options);
+            }));
+            triangles = 0;
+            for (auto& mesh : meshes) {
+                triangles += mesh.vertexCount / 3;
+                if (i + 1 < fixture.iterations)
+                    destroyCubicTriangleMesh(mesh);
+            }
+        }
+        writer.beginObject(key);
+        writer.value("seconds", measurement);
+        writer.value("glyphsPerSecond", paths.size() / measurement.best);
+        writer.value("trianglesPerGlyph", triangles / paths.size());
+        writer.value("triangleRatio", loopBlinnTriangles ? triangles / loopBlinnTriangles : 1.0);
+        writer.value("speedup", loopBlinnBuild.best / measurement.best);
+        writer.endObject();
+    };
+    build("loopBlinn", TriangulationOptions(), loopBlinnBuild, loopBlinnTriangles);
+    for (auto& mesh : meshes)
+        destroyCubicTriangleMesh(mesh);
+    TriangulationOptions options;
+    options.stencilFanInterior = true;
+    Measurement stencilFanBuild;
+    double stencilFanTriangles = 0;
+    build("stencilFan", options, stencilFanBuild, stencilFanTriangles);
+
+    auto tolerance = [&](size_t glyph) {
+        return pixelTolerance * fixture.emSize(glyph, 2048) / pixelsPerEm;
+    };
+    std::vector<std::vector<float>> flattened(paths.size());
+    Measurement flattenedBuild;
+    double flattenedTriangles = 0;
+    for (unsigned i = 0; i < fixture.iterations; ++i) {
+        flattenedBuild.add(timed([&] {
+            for (size_t j = 0; j < paths.size(); ++j) {
+                flattened[j].resize(stencilFanVertexCount(paths[j], tolerance(j), 0) * 2);
+                writeStencilFan(paths[j], tolerance(j), 0, flattened[j].data());
+            }
+        }));
+    }
+    for (auto& vertices : flattened)
+        flattenedTriangles += vertices.size() / 6;
+    writer.beginObject("flattened");
+    writer.value("pixelsPerEm", pixelsPerEm);
+    writer.value("seconds", flattenedBuild);
+    writer.value("glyphsPerSecond", paths.size() / flattenedBuild.best);
+    writer.value("trianglesPerGlyph", flattenedTriangles / paths.size());
+    writer.value("triangleRatio", loopBlinnTriangles ? flattenedTriangles / loopBlinnTriangles : 1.0);
+    writer.value("speedup", loopBlinnBuild.best / flattenedBuild.best);
+    writer.endObject();
+
+    // Coverage is whether the winding number is nonzero, as the stencil test sees it.
+    size_t samples = 0;
+    size_t stencilFanCoverageMismatches = 0;
+    size_t stencilFanWindingMismatches = 0;
+    size_t flattenedCoverageMismatches = 0;
+    std::vector<vector_float2> flattenedPositions;
+    size_t stride = std::max<size_t>(paths.size() / measuredGlyphs, 1);
+    for (size_t i = 0; i < paths.size(); i += stride) {
+        auto bounds = pathBounds(paths[i]);
+        if (!(bounds.minX < bounds.maxX && bounds.minY < bounds.maxY))
+            continue;
+        flattenedPositions.resize(flattened[i].size() / 2);
+        for (size_t j = 0; j < flattenedPositions.size(); ++j)
+            flattenedPositions[j] = { flattened[i][2 * j], flattened[i][2 * j + 1] };
+        for (unsigned y = 0; y < gridSize; ++y) {
+            for (unsigned x = 0; x < gridSize; ++x) {
+                CGFloat sampleX = bounds.minX + (x + 0.5) * (bounds.maxX - bounds.minX) / gridSize;
+                CGFloat sampleY = bounds.minY + (y + 0.5) * (bounds.maxY - bounds.minY) / gridSize;
+                int expected = pathWindingNumber(paths[i], sampleX, sampleY);
+                int stencilFan = stencilMeshWindingNumber(meshes[i].positions, meshes[i].coefficients, meshes[i].vertexCount, sampleX, sampleY);
+                int flat = stencilMeshWindingNumber(flattenedPositions.data(), nullptr, flattenedPositions.size(), sampleX, sampleY);
+                ++samples;
+                if ((stencilFan != 0) != (expected != 0))
+                    ++stencilFanCoverageMismatches;
+                if (stencilFan != expected)
+                    ++stencilFanWindingMismatches;
+                if ((flat != 0) != (expected != 0))
+                    ++flattenedCoverageMismatches;
+            }
+        }
+    }
+    writer.beginObject("accuracy");
+    writer.value("samples", samples);
+    writer.value("stencilFanCoverageMismatches", samples ? static_cast<double>(stencilFanCoverageMismatches) / samples : 0.0);
+    // Where curve faces overlap, the stencil can count to 2 where the path winds once, which fills the same.
+    writer.value("stencilFanWindingMismatches", samples ? static_cast<double>(stencilFanWindingMismatches) / samples : 0.0);
+    writer.value("flattenedCoverageMismatches", samples ? static_cast<double>(flattenedCoverageMismatches) / samples : 0.0);
+    writer.endObject();
+
+    for (auto& mesh : meshes)
+        destroyCubicTriangleMesh(mesh);
+    writer.endObject();
+}
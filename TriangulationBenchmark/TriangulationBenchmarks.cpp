@@ -0,0 +1,245 @@
+//
+//  TriangulationBenchmarks.cpp
+//  TriangulationBenchmark
+//
+//  Created by Litherum on 6/5/16.
+//  Copyright © 2016 Litherum. All rights reserved.
+//
+
+#include "Benchmark.h"
+
+#include <array>
+
+#include "CubicBeziers.h"
+#include "PathSource.h"
+#include "TriangulationStats.h"
+#include "WindingReference.h"
+
+void gatherCurves(const std::vector<CorpusOutline>& outlines, CubicBatch& batch, size_t& contourCount, size_t& maximumContours) {
+    contourCount = 0;
+    maximumContours = 0;
+    for (auto& outline : outlines) {
+        CGPoint current = CGPointZero;
+        CGPoint begin = CGPointZero;
+        size_t contours = 0;
+        CGPathSource(outline.path).iterate([&](PathElement element) {
+            switch (element.type) {
+            case PathElementMoveToPoint:
+                current = begin = element.points[0];
+                ++contours;
+                break;
+            case PathElementAddLineToPoint:
+                current = element.points[0];
+                break;
+            case PathElementAddQuadCurveToPoint: {
+                auto control = element.points[0];
+                auto destination = element.points[1];
+                batch.append(current,
+                    CGPointMake(current.x + 2 * (control.x - current.x) / 3, current.y + 2 * (control.y - current.y) / 3),
+                    CGPointMake(destination.x + 2 * (control.x - destination.x) / 3, destination.y + 2 * (control.y - destination.y) / 3),
+                    destination);
+                current = destination;
+                break;
+            }
+            case PathElementAddCurveToPoint:
+                batch.append(current, element.points[0], element.points[1], element.points[2]);
+                current = element.points[2];
+                break;
+            case PathElementCloseSubpath:
+                current = begin;
+            }
+        });
+        contourCount += contours;
+        maximumContours = std::max(maximumContours, contours);
+    }
+}
+
+static const char* cubicTypeNames[cubicTypeCount] = { "degenerate", "quadratic", "serpentine", "loop", "cusp" };
+
+void benchmarkClassification(JSONWriter& writer, CubicBatch& curves, unsigned iterations) {
+    Measurement classify;
+    for (unsigned i = 0; i < iterations; ++i)
+        classify.add(timed([&] { classifyCubics(curves); }));
+    writer.beginObject("classify");
+    writer.value("seconds", classify);
+    writer.value("curvesPerSecond", curves.size() / classify.best);
+    writer.beginObject("buckets");
+    for (size_t i = 0; i < cubicTypeCount; ++i)
+        writer.value(cubicTypeNames[i], curves.buckets[i].size());
+    writer.endObject();
+    writer.endObject();
+}
+
+void benchmarkCubic(JSONWriter& writer, const CubicBatch& curves, unsigned iterations) {
+    Measurement cubicTime;
+    size_t cubicTriangles = 0;
+    size_t* cubicTriangleCounter = &cubicTriangles;
+    size_t cubicAllocations = 0;
+    for (unsigned i = 0; i < iterations; ++i) {
+        cubicTriangles = 0;
+        size_t allocationsBefore = allocationCount;
+        cubicTime.add(timed([&] {
+            for (size_t j = 0; j < curves.size(); ++j) {
+                cubic(CGPointMake(curves.x[0][j], curves.y[0][j]), CGPointMake(curves.x[1][j], curves.y[1][j]),
+                    CGPointMake(curves.x[2][j], curves.y[2][j]), CGPointMake(curves.x[3][j], curves.y[3][j]),
+                    ^(CubicVertex, CubicVertex, CubicVertex) {
+                        ++*cubicTriangleCounter;
+                    });
+            }
+        }));
+        cubicAllocations = allocationCount - allocationsBefore;
+    }
+    writer.beginObject("cubic");
+    writer.value("seconds", cubicTime);
+    writer.value("triangles", cubicTriangles);
+    writer.value("trianglesPerSecond", cubicTriangles / cubicTime.best);
+    writer.value("allocationsPerCurve", static_cast<double>(cubicAllocations) / curves.size());
+    writer.endObject();
+}
+
+static void writeStats(JSONWriter& writer, const TriangulationStats& stats) {
+    writer.beginObject("curves");
+    for (size_t i = 0; i < cubicTypeCount; ++i)
+        writer.value(cubicTypeNames[i], stats.curves[i]);
+    writer.endObject();
+    writer.value("subdivisions", stats.subdivisions);
+    writer.value("degenerateCurves", stats.degenerateCurves);
+    writer.value("hullOverlaps", stats.hullOverlaps);
+    writer.value("hullSubdivisions", stats.hullSubdivisions);
+    writer.value("unresolvedHullOverlaps", stats.unresolvedHullOverlaps);
+    writer.value("constraintInsertions", stats.constraintInsertions);
+    writer.value("cgalFallbacks", stats.cgalFallbacks);
+    writer.value("interiorFaces", stats.interiorFaces);
+    writer.value("curveFaces", stats.curveFaces);
+}
+
+static void benchmarkTriangulation(JSONWriter& writer, const char* key, const BenchmarkFixture& fixture, const TriangulationOptions& options) {
+    auto& outlines = fixture.outlines;
+    Measurement total;
+    std::array<Measurement, triangulationPhaseCount> phases;
+    TriangulationStats stats;
+    size_t vertexCount = 0;
+    size_t firstAllocations = 0;
+    size_t allocations = 0;
+    std::vector<vector_float2> positions;
+    std::vector<vector_float4> coefficients;
+    for (unsigned i = 0; i < fixture.iterations; ++i) {
+        stats = TriangulationStats();
+        TriangulationStatsScope scope(stats);
+        vertexCount = 0;
+        size_t allocationsBefore = allocationCount;
+        total.add(timed([&] {
+            for (auto& outline : outlines) {
+                positions.clear();
+                coefficients.clear();
+                triangulateAndAppend(CGPathSource(outline.path), options, positions, coefficients);
+                vertexCount += positions.size();
+            }
+        }));
+        allocations = allocationCount - allocationsBefore;
+        if (!i)
+            firstAllocations = allocations;
+        for (size_t j = 0; j < triangulationPhaseCount; ++j)
+            phases[j].add(stats.seconds[j]);
+    }
+
+    writer.beginObject(key);
+    writer.value("seconds", total);
+    writer.beginObject("phases");
+    for (size_t i = 0; i < triangulationPhaseCount; ++i)
+        writer.value(triangulationPhaseName(static_cast<TriangulationPhase>(i)), phases[i]);
+    writer.endObject();
+    writer.value("triangles", vertexCount / 3);
+    writer.value("trianglesPerSecond", vertexCount / 3 / total.best);
+    // The first pass grows each thread's scratch buffers; later passes should reuse them.
+    writer.value("firstPassAllocationsPerGlyph", static_cast<double>(firstAllocations) / outlines.size());
+    writer.value("allocationsPerGlyph", static_cast<double>(allocations) / outlines.size());
+    writeStats(writer, stats);
+    writer.endObject();
+}
+
+// A C whose contour is left open, so filling it closes it with a chord across its notch. Counts the grid samples where
+// the mesh and the path's own winding number disagree about coverage, for each fill rule the CGAL interior labels.
+static void checkOpenContour(JSONWriter& writer) {
+    const unsigned gridSize = 64;
+    const CGPoint points[] = { { 100, 0 }, { 0, 0 }, { 0, 100 }, { 100, 100 }, { 100, 60 }, { 30, 60 }, { 30, 40 } };
+    CGMutablePathRef path = CGPathCreateMutable();
+    CGPathMoveToPoint(path, nullptr, points[0].x, points[0].y);
+    for (size_t i = 1; i < sizeof(points) / sizeof(points[0]); ++i)
+        CGPathAddLineToPoint(path, nullptr, points[i].x, points[i].y);
+
+    writer.beginObject("openContour");
+    for (auto fillRule : { TriangulationFillRuleNonZero, TriangulationFillRuleEvenOdd }) {
+        TriangulationOptions options;
+        options.fillRule = fillRule;
+        auto mesh = createCubicTriangleMesh(path, options);
+        size_t mismatches = 0;
+        for (unsigned y = 0; y < gridSize; ++y) {
+            for (unsigned x = 0; x < gridSize; ++x) {
+                CGFloat sampleX = (x + 0.5) * 100 / gridSize;
+                CGFloat sampleY = (y + 0.5) * 100 / gridSize;
+                bool covered = stencilMeshWindingNumber(mesh.positions, mesh.coefficients, mesh.vertexCount, sampleX, sampleY) != 0;
+                mismatches += covered != (pathWindingNumber(path, sampleX, sampleY) != 0);
+            }
+        }
+        destroyCubicTriangleMesh(mesh);
+        writer.value(fillRule == TriangulationFillRuleNonZero ? "nonZeroMismatches" : "evenOddMismatches", mismatches);
+    }
+    writer.endObject();
+    CGPathRelease(path);
+}
+
+void benchmarkTriangulationModes(JSONWriter& writer, const BenchmarkFixture& fixture) {
+    TriangulationOptions options;
+    benchmarkTriangulation(writer, "triangulate", fixture, options);
+    options.separateCurveHulls = false;
+    benchmarkTriangulation(writer, "triangulateWithoutHullSeparation", fixture, options);
+    options.separateCurveHulls = true;
+    options.allowFastInterior = false;
+    benchmarkTriangulation(writer, "triangulateWithCGALInterior", fixture, options);
+    TriangulationOptions stencilFanOptions;
+    stencilFanOptions.stencilFanInterior = true;
+    benchmarkTriangulation(writer, "triangulateStencilFan", fixture, stencilFanOptions);
+
+    // Even-odd, because the flood fill only does even-odd. Compare phases.mark.
+    writer.beginObject("labeling");
+    options.fillRule = TriangulationFillRuleEvenOdd;
+    benchmarkTriangulation(writer, "regions", fixture, options);
+    options.floodFillLabeling = true;
+    benchmarkTriangulation(writer, "floodFill", fixture, options);
+    writer.endObject();
+    checkOpenContour(writer);
+}
+
+double benchmarkBatchTriangulation(JSONWriter& writer, const BenchmarkFixture& fixture) {
+    auto& paths = fixture.paths;
+    std::vector<CubicTriangleMesh> meshes(paths.size());
+    std::vector<unsigned> threadCounts;
+    for (unsigned threads = 1; threads < fixture.hardwareThreads; threads *= 2)
+        threadCounts.push_back(threads);
+    threadCounts.push_back(fixture.hardwareThreads);
+    double oneThreadSeconds = 0;
+    writer.beginArray("batch");
+    for (auto threads : threadCounts) {
+        Measurement batch;
+        size_t batchAllocations = 0;
+        for (unsigned i = 0; i < fixture.iterations; ++i) {
+            size_t allocationsBefore = allocationCount;
+            batch.add(timed([&] { triangulateBatch(paths.data(), paths.size(), threads, TriangulationFillRuleNonZero, meshes.data()); }));
+            batchAllocations = allocationCount - allocationsBefore;
+            for (auto& mesh : meshes)
+                destroyCubicTriangleMesh(mesh);
+        }
+        if (threads == 1)
+            oneThreadSeconds = batch.best;
+        writer.beginObject();
+        writer.value("threads", static_cast<size_t>(threads));
+        writer.value("seconds", batch);
+        writer.value("glyphsPerSecond", paths.size() / batch.best);
+        // Includes each mesh's own two buffers, and worker threads starting with empty scratch.
+        writer.value("allocationsPerGlyph", static_cast<double>(batchAllocations) / paths.size());
+        writer.endObject();
+    }
+    writer.endArray();
+    return oneThreadSeconds;
+}
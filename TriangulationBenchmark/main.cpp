@@ -0,0 +1,103 @@
+//
+//  main.cpp
+//  TriangulationBenchmark
+//
+//  Created by Litherum on 5/18/16.
+//  Copyright © 2016 Litherum. All rights reserved.
+//
+
+// Replays an outline corpus (see OutlineCorpus.h) through cubic() and Triangulator with no window or GPU, and prints
+// per-phase timings, throughput, allocation counts and peak memory as JSON, so runs can be compared over time.
+// Phase timings and counters need TRIANGULATION_STATS=1, which both build files for this target set.
+// Set GLYPH_STREAM_PATH to a glyph stream (see GlyphStream.h) of the same text to replay it through the glyph atlas,
+// the frame store, the frame batcher and the triangulation pipeline.
+// Each area's benchmarks live in their own file, and share the fixture, timing and report in Benchmark.h.
+
+#include <cstdlib>
+
+#include "Benchmark.h"
+#include "SIMDLanes.h"
+#include "TriangulationStats.h"
+
+int main(int argc, const char * argv[]) {
+    if (argc < 2 || argc > 5) {
+        fprintf(stderr, "Usage: %s <outline corpus> [iterations] [output JSON] [Chrome trace JSON]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    unsigned iterations = argc >= 3 ? std::max(atoi(argv[2]), 1) : 10;
+    FILE* output = stdout;
+    if (argc >= 4 && !(output = fopen(argv[3], "w"))) {
+        fprintf(stderr, "Could not open %s\n", argv[3]);
+        return EXIT_FAILURE;
+    }
+
+    BenchmarkFixture fixture;
+    if (!loadBenchmarkFixture(argv[1], iterations, fixture)) {
+        fprintf(stderr, "Could not read outline corpus %s\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+    auto& paths = fixture.paths;
+    CubicBatch curves;
+    size_t contourCount;
+    size_t maximumContours;
+    gatherCurves(fixture.outlines, curves, contourCount, maximumContours);
+
+    JSONWriter writer(output);
+    writer.beginObject();
+    writer.value("corpus", argv[1]);
+    writer.value("glyphs", fixture.outlines.size());
+    writer.value("curves", curves.size());
+    writer.value("contoursPerGlyph", static_cast<double>(contourCount) / fixture.outlines.size());
+    writer.value("maximumContours", maximumContours);
+    writer.value("iterations", static_cast<size_t>(iterations));
+    writer.value("simdLanes", SIMD::laneCount);
+    writer.value("statsEnabled", static_cast<size_t>(TRIANGULATION_STATS));
+
+    benchmarkClassification(writer, curves, iterations);
+    benchmarkCubic(writer, curves, iterations);
+    benchmarkTriangulationModes(writer, fixture);
+    double oneThreadBatchSeconds = benchmarkBatchTriangulation(writer, fixture);
+
+    std::vector<CubicTriangleMesh> meshes(paths.size());
+    triangulateBatch(paths.data(), paths.size(), 0, TriangulationFillRuleNonZero, meshes.data());
+    benchmarkRasterization(writer, fixture, meshes);
+    benchmarkBandedCurves(writer, fixture, meshes, oneThreadBatchSeconds);
+    benchmarkAtlas(writer, fixture);
+    benchmarkFrameStore(writer, fixture);
+    benchmarkDistanceFields(writer, fixture);
+    benchmarkFlattening(writer, fixture);
+    benchmarkStencilFan(writer, fixture);
+    benchmarkPipeline(writer, fixture);
+    benchmarkHullSeparation(writer, fixture);
+
+    std::vector<CompactCubicTriangleMesh> compactMeshes;
+    benchmarkMeshFormats(writer, fixture, meshes, compactMeshes);
+    benchmarkFrameBatching(writer, fixture, compactMeshes);
+    benchmarkGlyphCache(writer, fixture, compactMeshes);
+    for (auto& mesh : compactMeshes)
+        destroyCompactCubicTriangleMesh(mesh);
+    benchmarkLOD(writer, fixture);
+
+    if (argc == 5) {
+        // One more run across every core, traced.
+        TriangulationStats stats;
+        stats.recordTrace = true;
+        triangulateBatch(paths.data(), paths.size(), 0, TriangulationFillRuleNonZero, meshes.data(), stats);
+        for (auto& mesh : meshes)
+            destroyCubicTriangleMesh(mesh);
+        if (!writeChromeTrace(stats, argv[4])) {
+            fprintf(stderr, "Could not write trace %s\n", argv[4]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    unsigned ambiguousHulls = 0;
+    writer.value("hullMismatches", static_cast<size_t>(verifyCubicHullTriangulation(10000, 1, &ambiguousHulls)));
+    writer.value("ambiguousHulls", static_cast<size_t>(ambiguousHulls));
+    writer.value("peakMemoryBytes", peakMemoryBytes());
+    writer.endObject();
+
+    if (output != stdout)
+        fclose(output);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,263 @@
+#!/usr/bin/env python3
+#
+#  make_corpus.py
+#  TriangulationBenchmark
+#
+#  Created by Litherum on 5/18/16.
+#  Copyright © 2016 Litherum. All rights reserved.
+#
+
+# Writes an outline corpus (see OutlineCorpus.h) of every distinct glyph a text uses, read straight out of a TrueType
+# font, so a corpus can be made without CoreText. On a Mac, running the app with OUTLINE_CORPUS_PATH set exports the
+# glyphs that layout() actually produces instead. To measure glyphs with many contours, make one from a CJK font, such
+# as a TrueType build of Noto Sans CJK or WenQuanYi, with a text in that script.
+#
+# Optionally also writes a glyph stream (see GlyphStream.h): the text laid out into 800 by 600 point frames, the way
+# layout() does, though with plain greedy line breaking, no kerning and no shaping.
+#
+#     make_corpus.py <font.ttf> <text file> <point size> <output corpus> [output glyph stream]
+
+import struct
+import sys
+
+
+class Font:
+    def __init__(self, path):
+        self.data = open(path, 'rb').read()
+        # Collections (.ttc), which is how most CJK fonts ship: use the first font.
+        start = struct.unpack_from('>I', self.data, 12)[0] if self.data[:4] == b'ttcf' else 0
+        numTables = struct.unpack_from('>H', self.data, start + 4)[0]
+        self.tables = {}
+        for i in range(numTables):
+            tag, _, offset, length = struct.unpack_from('>4sIII', self.data, start + 12 + 16 * i)
+            self.tables[tag.decode('latin-1')] = offset
+        head = self.tables['head']
+        self.unitsPerEm = struct.unpack_from('>H', self.data, head + 18)[0]
+        self.longLoca = struct.unpack_from('>h', self.data, head + 50)[0] == 1
+        self.glyphCount = struct.unpack_from('>H', self.data, self.tables['maxp'] + 4)[0]
+        self.cmap = self.readCmap()
+        hhea = self.tables['hhea']
+        self.ascender, self.descender, self.lineGap = struct.unpack_from('>hhh', self.data, hhea + 4)
+        self.advanceCount = struct.unpack_from('>H', self.data, hhea + 34)[0]
+
+    def advance(self, glyph):
+        return struct.unpack_from('>H', self.data, self.tables['hmtx'] + 4 * min(glyph, self.advanceCount - 1))[0]
+
+    def readCmap(self):
+        cmap = self.tables['cmap']
+        subtableCount = struct.unpack_from('>H', self.data, cmap + 2)[0]
+        for i in range(subtableCount):
+            platform, encoding, offset = struct.unpack_from('>HHI', self.data, cmap + 4 + 8 * i)
+            subtable = cmap + offset
+            if platform == 3 and encoding == 1 and struct.unpack_from('>H', self.data, subtable)[0] == 4:
+                return self.readCmapFormat4(subtable)
+        raise Exception('No Unicode BMP format 4 cmap')
+
+    def readCmapFormat4(self, subtable):
+        segmentCount = struct.unpack_from('>H', self.data, subtable + 6)[0] // 2
+        ends = subtable + 14
+        starts = ends + 2 * segmentCount + 2
+        deltas = starts + 2 * segmentCount
+        rangeOffsets = deltas + 2 * segmentCount
+        result = {}
+        for i in range(segmentCount):
+            end = struct.unpack_from('>H', self.data, ends + 2 * i)[0]
+            start = struct.unpack_from('>H', self.data, starts + 2 * i)[0]
+            delta = struct.unpack_from('>h', self.data, deltas + 2 * i)[0]
+            rangeOffset = struct.unpack_from('>H', self.data, rangeOffsets + 2 * i)[0]
+            for c in range(start, end + 1):
+                if c == 0xFFFF:
+                    continue
+                if rangeOffset == 0:
+                    glyph = (c + delta) & 0xFFFF
+                else:
+                    address = rangeOffsets + 2 * i + rangeOffset + 2 * (c - start)
+                    glyph = struct.unpack_from('>H', self.data, address)[0]
+                    if glyph:
+                        glyph = (glyph + delta) & 0xFFFF
+                result[c] = glyph
+        return result
+
+    def glyphRange(self, glyph):
+        loca = self.tables['loca']
+        if self.longLoca:
+            begin, end = struct.unpack_from('>II', self.data, loca + 4 * glyph)
+        else:
+            begin, end = [2 * x for x in struct.unpack_from('>HH', self.data, loca + 2 * glyph)]
+        return self.tables['glyf'] + begin, end - begin
+
+    # Returns a list of contours, each a list of (x, y, onCurve).
+    def contours(self, glyph):
+        offset, length = self.glyphRange(glyph)
+        if length == 0:
+            return []
+        contourCount = struct.unpack_from('>h', self.data, offset)[0]
+        if contourCount < 0:
+            return self.compositeContours(offset + 10)
+        endPoints = struct.unpack_from('>%dH' % contourCount, self.data, offset + 10)
+        pointCount = endPoints[-1] + 1 if contourCount else 0
+        position = offset + 10 + 2 * contourCount
+        instructionLength = struct.unpack_from('>H', self.data, position)[0]
+        position += 2 + instructionLength
+
+        flags = []
+        while len(flags) < pointCount:
+            flag = self.data[position]
+            position += 1
+            flags.append(flag)
+            if flag & 8:
+                flags.extend([flag] * self.data[position])
+                position += 1
+
+        def coordinates(shortBit, sameBit):
+            nonlocal position
+            result = []
+            value = 0
+            for flag in flags:
+                if flag & shortBit:
+                    delta = self.data[position]
+                    position += 1
+                    value += delta if flag & sameBit else -delta
+                elif not flag & sameBit:
+                    value += struct.unpack_from('>h', self.data, position)[0]
+                    position += 2
+                result.append(value)
+            return result
+
+        xs = coordinates(2, 16)
+        ys = coordinates(4, 32)
+        result = []
+        begin = 0
+        for end in endPoints:
+            result.append([(xs[i], ys[i], bool(flags[i] & 1)) for i in range(begin, end + 1)])
+            begin = end + 1
+        return result
+
+    def compositeContours(self, position):
+        result = []
+        while True:
+            flags, glyph = struct.unpack_from('>HH', self.data, position)
+            position += 4
+            if flags & 1:
+                dx, dy = struct.unpack_from('>hh', self.data, position)
+                position += 4
+            else:
+                dx, dy = struct.unpack_from('>bb', self.data, position)
+                position += 2
+            if not flags & 2:
+                raise Exception('Point-matched composite glyphs are not supported')
+            scale = (1, 0, 0, 1)
+            if flags & 8:
+                s = struct.unpack_from('>h', self.data, position)[0] / 16384
+                scale = (s, 0, 0, s)
+                position += 2
+            elif flags & 0x40:
+                sx, sy = [v / 16384 for v in struct.unpack_from('>hh', self.data, position)]
+                scale = (sx, 0, 0, sy)
+                position += 4
+            elif flags & 0x80:
+                scale = tuple(v / 16384 for v in struct.unpack_from('>hhhh', self.data, position))
+                position += 8
+            for contour in self.contours(glyph):
+                result.append([(scale[0] * x + scale[2] * y + dx, scale[1] * x + scale[3] * y + dy, on) for x, y, on in contour])
+            if not flags & 0x20:
+                return result
+
+
+def formatNumber(value):
+    return '%.17g' % value
+
+
+# TrueType contours are quadratic B-splines: two off-curve points in a row imply an on-curve point between them.
+def writeContour(out, contour, scale):
+    points = [(x * scale, y * scale, on) for x, y, on in contour]
+    if not points:
+        return
+    start = next((i for i, p in enumerate(points) if p[2]), None)
+    if start is None:
+        a, b = points[0], points[1]
+        points.insert(1, ((a[0] + b[0]) / 2, (a[1] + b[1]) / 2, True))
+        start = 1
+    points = points[start:] + points[:start] + [points[start]]
+    out.write('M %s %s\n' % (formatNumber(points[0][0]), formatNumber(points[0][1])))
+    control = None
+    for x, y, on in points[1:]:
+        if on:
+            if control:
+                out.write('Q %s %s %s %s\n' % (formatNumber(control[0]), formatNumber(control[1]), formatNumber(x), formatNumber(y)))
+            else:
+                out.write('L %s %s\n' % (formatNumber(x), formatNumber(y)))
+            control = None
+        else:
+            if control:
+                mx, my = (control[0] + x) / 2, (control[1] + y) / 2
+                out.write('Q %s %s %s %s\n' % (formatNumber(control[0]), formatNumber(control[1]), formatNumber(mx), formatNumber(my)))
+            control = (x, y)
+    out.write('Z\n')
+
+
+def writeGlyphStream(out, font, identity, text, scale, width=800, height=600):
+    ascent = font.ascender * scale
+    descent = -font.descender * scale
+    lineHeight = (font.ascender - font.descender + font.lineGap) * scale
+    lines = []
+    for paragraph in text.split('\n'):
+        line = []
+        lineWidth = 0
+        for word in paragraph.replace('\r', '').split(' '):
+            glyphs = [font.cmap[ord(c)] for c in word + ' ' if ord(c) in font.cmap and not (c.isspace() and c != ' ')]
+            advances = [font.advance(glyph) * scale for glyph in glyphs]
+            # A trailing space may hang past the edge.
+            if line and lineWidth + sum(advances[:-1]) > width:
+                lines.append(line)
+                line = []
+                lineWidth = 0
+            for glyph, advance in zip(glyphs, advances):
+                line.append((glyph, lineWidth))
+                lineWidth += advance
+        lines.append(line)
+
+    baseline = None
+    for line in lines:
+        if baseline is None or baseline - lineHeight < descent:
+            out.write('frame\n')
+            baseline = height - ascent
+        else:
+            baseline -= lineHeight
+        for glyph, x in line:
+            out.write('%s %d %s %s\n' % (identity, glyph, formatNumber(x), formatNumber(baseline)))
+
+
+def main():
+    if len(sys.argv) not in (5, 6):
+        sys.stderr.write('Usage: %s <font.ttf> <text file> <point size> <output corpus> [output glyph stream]\n' % sys.argv[0])
+        sys.exit(1)
+    fontPath, textPath, size, outputPath = sys.argv[1], sys.argv[2], float(sys.argv[3]), sys.argv[4]
+    font = Font(fontPath)
+    fontName = fontPath.rsplit('/', 1)[-1].rsplit('.', 1)[0]
+    identity = '%s-%s' % (fontName, size)
+    scale = size / font.unitsPerEm
+
+    glyphs = []
+    for c in open(textPath, encoding='utf-8').read():
+        glyph = font.cmap.get(ord(c))
+        if c.isspace() and c != ' ' or glyph is None or glyph in glyphs:
+            continue
+        glyphs.append(glyph)
+
+    with open(outputPath, 'w') as out:
+        out.write('# %s at %s points: every distinct glyph in %s\n' % (fontName, size, textPath.rsplit('/', 1)[-1]))
+        for glyph in glyphs:
+            out.write('glyph %s %d\n' % (identity, glyph))
+            for contour in font.contours(glyph):
+                writeContour(out, contour, scale)
+            out.write('end\n')
+
+    if len(sys.argv) == 6:
+        with open(sys.argv[5], 'w') as out:
+            out.write('# %s at %s points: %s laid out in frames\n' % (fontName, size, textPath.rsplit('/', 1)[-1]))
+            writeGlyphStream(out, font, identity, open(textPath, encoding='utf-8').read(), scale)
+
+
+if __name__ == '__main__':
+    main()